@@ -49,33 +49,183 @@
   } while (0)
 
 
+static DissectStats stats;
+
+/*! \brief  Scope of decoded strings and byte vectors, NULL for the file. */
+static wmem_allocator_t* sized_scope = NULL;
+
+/*! \brief  Pooled strings of the capture file, SizedData -> itself. */
+static wmem_map_t* string_pool = NULL;
+
+/*! \brief  Hash the bytes of a SizedData (FNV-1a).
+ */
+static guint sized_data_hash (gconstpointer key);
+
+/*! \brief  Compare the bytes of two SizedData.
+ */
+static gboolean sized_data_equal (gconstpointer a, gconstpointer b);
+
+
+DissectStats* dissect_stats (void)
+{
+  return &stats;
+}
+
+
+void set_sized_data_scope (wmem_allocator_t* scope)
+{
+  sized_scope = scope;
+}
+
+
+gboolean sized_data_outlives_packet (void)
+{
+  return !sized_scope;
+}
+
+
+guint8* alloc_sized_data (guint nbytes)
+{
+  stats.sized_allocs++;
+  stats.sized_bytes += nbytes + 1;
+  return (guint8*)wmem_alloc (sized_scope ? sized_scope : wmem_file_scope(),
+                              (1+ nbytes) * sizeof(guint8));
+}
+
+
+guint sized_data_hash (gconstpointer key)
+{
+  const SizedData* data = (const SizedData*) key;
+  guint32 hash = 2166136261U;
+  guint i;
+
+  for (i = 0; i < data->nbytes; ++i) {
+    hash ^= data->bytes[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+
+gboolean sized_data_equal (gconstpointer a, gconstpointer b)
+{
+  const SizedData* da = (const SizedData*) a;
+  const SizedData* db = (const SizedData*) b;
+
+  return da->nbytes == db->nbytes &&
+    memcmp(da->bytes, db->bytes, da->nbytes) == 0;
+}
+
+
+guint8* intern_ascii_string (const guint8* bytes, guint nbytes)
+{
+  SizedData lookup;
+  SizedData* pooled;
+  guint8* copy;
+
+  if (sized_scope) {
+    /* nothing is kept past the packet, a pool would only grow */
+    copy = alloc_sized_data(nbytes);
+    memcpy(copy, bytes, nbytes);
+    copy[nbytes] = 0;
+    return copy;
+  }
+
+  if (!string_pool) {
+    string_pool = wmem_map_new(wmem_file_scope(), sized_data_hash, sized_data_equal);
+  }
+
+  lookup.nbytes = nbytes;
+  lookup.bytes = (guint8*) bytes;
+  pooled = (SizedData*) wmem_map_lookup(string_pool, &lookup);
+  if (pooled) {
+    stats.sized_interned++;
+    return pooled->bytes;
+  }
+
+  pooled = wmem_new(wmem_file_scope(), SizedData);
+  pooled->nbytes = nbytes;
+  pooled->bytes = alloc_sized_data(nbytes);
+  memcpy(pooled->bytes, bytes, nbytes);
+  pooled->bytes[nbytes] = 0;
+  wmem_map_insert(string_pool, pooled, pooled);
+  return pooled->bytes;
+}
+
+
+void reset_string_pool (void)
+{
+  string_pool = NULL;
+}
+
+
+static const char* string_err_d[ErrDCount] =
+{
+  "[ERR D1] ",
+  "[ERR D2] Integer does not fall within the bounds of the specified type",
+  "[ERR D3] ",
+  "[ERR D4] Retrieved differently typed value from dictionary",
+  "[ERR D5] Mandatory field not present, undefined previous value",
+  "[ERR D6] Mandatory field not present, empty previous value",
+  "[ERR D7] Invalid subtraction length",
+  "[ERR D8] ",
+  "[ERR D9] Template does not exist",
+  "[ERR BUDGET] Work budget of the packet exceeded"
+};
+
+
+const char* err_d_message(guint8 err_no)
+{
+  if (err_no < 1 || err_no > ErrDCount) {
+    return "[ERR] ";
+  }
+  return string_err_d[err_no - 1];
+}
+
+
 void err_d(guint8 err_no, FieldData* fdata)
 {
-  char * string_err_d[15] =
-  {
-    "[ERR D1] ",
-    "[ERR D2] Integer does not fall within the bounds of the specified type",
-    "[ERR D3] ",
-    "[ERR D4] Retrieved differently typed value from dictionary",
-    "[ERR D5] Mandatory field not present, undefined previous value",
-    "[ERR D6] Mandatory field not present, empty previous value",
-    "[ERR D7] Invalid subtraction length",
-    "[ERR D8] ",
-    "[ERR D9] Template does not exist"
-  };
+  const char* message = err_d_message(err_no);
 
   fdata->status = FieldError;
-  fdata->value.ascii.bytes = (guint8*)wmem_strdup_printf(wmem_file_scope(), "%s", string_err_d[err_no - 1]);
+  fdata->error = err_no;
+  fdata->value.ascii.bytes = (guint8*) message;
+  fdata->value.ascii.nbytes = strlen(message);
 }
 
 
 void ShiftBytes(DissectPosition* position)
 {
+  if (position->offjmp > position->nbytes) {
+    position->offjmp = position->nbytes;
+    position->overrun = TRUE;
+  }
   ShiftBuffer(position->offjmp, position->offset,
               position->nbytes, position->bytes);
 }
 
 
+guint dissect_stop_bit_length (DissectPosition* position)
+{
+  guint nbytes = count_stop_bit_encoded (position->nbytes,
+                                         position->bytes);
+  if (nbytes == 0) {
+    position->overrun = TRUE;
+  }
+  return nbytes;
+}
+
+
+guint dissect_claim_bytes (DissectPosition* position, guint nbytes)
+{
+  if (nbytes > position->nbytes) {
+    position->overrun = TRUE;
+    return position->nbytes;
+  }
+  return nbytes;
+}
+
+
 gboolean dissect_shift_pmap (DissectPosition* position)
 {
   if (position->pmap_idx >= position->pmap_len) {
@@ -115,6 +265,7 @@ gboolean dissect_shift_null(DissectPosition* position)
     }
   }
   else {
+    position->overrun = TRUE;
 #ifdef OVERRUN_DEBUG
     DBG0("index out of bounds (nbytes == 0)");
 #endif
@@ -133,10 +284,11 @@ void basic_dissect_pmap (const DissectPosition* parent_position,
   position->pmap_len = 0;
   position->pmap_idx = 0;
   position->pmap     = 0;
+  position->overrun  = parent_position->overrun;
+  position->work     = parent_position->work;
 
   /* Decode the pmap. */
-  position->offjmp = count_stop_bit_encoded (position->nbytes,
-                                             position->bytes);
+  position->offjmp = dissect_stop_bit_length (position);
 
   position->pmap_len = number_decoded_bits (position->offjmp);
   if (position->pmap_len == 0) {
@@ -150,13 +302,14 @@ void basic_dissect_pmap (const DissectPosition* parent_position,
 }
 
 
-void basic_dissect_uint32 (DissectPosition* position, FieldData* fdata)
+guint32 basic_dissect_uint32 (DissectPosition* position, FieldData* fdata)
 {
-  position->offjmp = count_stop_bit_encoded (position->nbytes,
-                                             position->bytes);
+  guint32 value;
+  position->offjmp = dissect_stop_bit_length (position);
   fdata->nbytes = position->offjmp;
-  fdata->value.u32 = decode_uint32 (position->offjmp,
-                                    position->bytes);
+  value = decode_uint32 (position->offjmp,
+                         position->bytes);
+  fdata->value.u32 = value;
   if (Int32MaxBytes == fdata->nbytes) {
     if ((position->bytes[0] & Int32ExtraBits) > 0) {
       err_d(2, fdata);
@@ -165,16 +318,18 @@ void basic_dissect_uint32 (DissectPosition* position, FieldData* fdata)
     err_d(2, fdata);
   }
   ShiftBytes(position);
+  return value;
 }
 
 
-void basic_dissect_uint64 (DissectPosition* position, FieldData* fdata)
+guint64 basic_dissect_uint64 (DissectPosition* position, FieldData* fdata)
 {
-  position->offjmp = count_stop_bit_encoded (position->nbytes,
-                                             position->bytes);
+  guint64 value;
+  position->offjmp = dissect_stop_bit_length (position);
   fdata->nbytes = position->offjmp;
-  fdata->value.u64 = decode_uint64 (position->offjmp,
-                                    position->bytes);
+  value = decode_uint64 (position->offjmp,
+                         position->bytes);
+  fdata->value.u64 = value;
    if (Int64MaxBytes == fdata->nbytes) {
     if ((position->bytes[0] & Int64ExtraBits) > 0) {
       err_d(2, fdata);
@@ -183,16 +338,18 @@ void basic_dissect_uint64 (DissectPosition* position, FieldData* fdata)
     err_d(2, fdata);
   }
   ShiftBytes(position);
+  return value;
 }
 
 
-void basic_dissect_int32 (DissectPosition* position, FieldData* fdata)
+gint32 basic_dissect_int32 (DissectPosition* position, FieldData* fdata)
 {
-  position->offjmp = count_stop_bit_encoded (position->nbytes,
-                                             position->bytes);
+  gint32 value;
+  position->offjmp = dissect_stop_bit_length (position);
   fdata->nbytes = position->offjmp;
-  fdata->value.i32 = decode_int32 (position->offjmp,
-                                   position->bytes);
+  value = decode_int32 (position->offjmp,
+                        position->bytes);
+  fdata->value.i32 = value;
   if (Int32MaxBytes == fdata->nbytes) {
     if ((position->bytes[0] & Int32SignBit) == Int32SignBit) {
       if ((position->bytes[0] & Int32ExtraBits) != Int32ExtraBits) {
@@ -208,16 +365,18 @@ void basic_dissect_int32 (DissectPosition* position, FieldData* fdata)
     err_d(2, fdata);
   }
   ShiftBytes(position);
+  return value;
 }
 
 
-void basic_dissect_int64 (DissectPosition* position, FieldData* fdata)
+gint64 basic_dissect_int64 (DissectPosition* position, FieldData* fdata)
 {
-  position->offjmp = count_stop_bit_encoded (position->nbytes,
-                                             position->bytes);
+  gint64 value;
+  position->offjmp = dissect_stop_bit_length (position);
   fdata->nbytes = position->offjmp;
-  fdata->value.i64 = decode_int64 (position->offjmp,
-                                   position->bytes);
+  value = decode_int64 (position->offjmp,
+                        position->bytes);
+  fdata->value.i64 = value;
   if (Int64MaxBytes == fdata->nbytes) {
     if ((position->bytes[0] & Int64SignBit) == Int64SignBit) {
       if ((position->bytes[0] & Int64ExtraBits) != Int64ExtraBits) {
@@ -232,6 +391,7 @@ void basic_dissect_int64 (DissectPosition* position, FieldData* fdata)
     err_d(2, fdata);
   }
   ShiftBytes(position);
+  return value;
 }
 
 
@@ -239,12 +399,21 @@ void basic_dissect_ascii_string (DissectPosition* position, FieldData* fdata)
 {
   guint8* bytes;
   guint32 nbytes;
-  position->offjmp = count_stop_bit_encoded (position->nbytes,
-                                             position->bytes);
+  position->offjmp = dissect_stop_bit_length (position);
   nbytes = position->offjmp;
   fdata->nbytes = nbytes;
-  bytes = (guint8*)wmem_alloc (wmem_file_scope(), (1+ nbytes) * sizeof(guint8));
-  if (bytes) {
+  if (nbytes <= InternMaxBytes) {
+    /* decode to scratch, the pool keeps one copy per distinct value */
+    guint8 scratch[InternMaxBytes + 1];
+    guint len;
+    decode_ascii_string (nbytes, position->bytes, scratch);
+    scratch[nbytes] = 0;
+    len = strlen((char*) scratch);
+    fdata->value.ascii.bytes = intern_ascii_string (scratch, len);
+    fdata->value.ascii.nbytes = len;
+  }
+  else {
+    bytes = alloc_sized_data (nbytes);
     decode_ascii_string (position->offjmp, position->bytes, bytes);
     bytes[nbytes] = 0;
     fdata->value.ascii.bytes = bytes;
@@ -26,6 +26,7 @@
 #ifndef BASIC_DISSECT_H_INCLUDED_
 #define BASIC_DISSECT_H_INCLUDED_
 
+#include <epan/wmem/wmem.h>
 #include "basic-field.h"
 
 /*! \brief The sign bit for a 5 byte encoded Int32 */
@@ -40,6 +41,8 @@
 #define Int32MaxBytes 5
 /*! \brief The maximum number of stop bit encoded bytes an Int64 can occupy */
 #define Int64MaxBytes 10
+/*! \brief Longest ascii string shared through the string pool */
+#define InternMaxBytes 64
 
 /*! \brief The different states a value can have throughout the application.
  */
@@ -60,11 +63,31 @@ struct field_data_struct
   guint start;
   guint nbytes;
   FieldStatus status;
+  guint8 error;      /* n of [ERR Dn] when status is FieldError */
   FieldValue value;
 };
 typedef struct field_data_struct FieldData;
 
 
+/*! \brief Number of dynamic error codes, D1 to D9 and the budget error */
+#define ErrDCount 10
+
+/*! \brief Code of the error of a packet over its work budget.
+ *         The plugin's own, shown as [ERR BUDGET] and not as a D code. */
+#define ErrDBudget 10
+
+
+/*! \brief  Work done on a packet so far, held against the budget. */
+struct dissect_work_struct
+{
+  guint fields;        /* fields decoded */
+  guint elements;      /* sequence elements decoded */
+  guint string_bytes;  /* bytes of the delta and tail strings built */
+  gboolean exceeded;   /* over budget, nothing more is decoded */
+};
+typedef struct dissect_work_struct DissectWork;
+
+
 /*! \brief  Hold current dissection state/position. */
 struct dissect_position_struct
 {
@@ -76,23 +99,115 @@ struct dissect_position_struct
   guint pmap_len;
   guint pmap_idx;
   gboolean* pmap;
+
+  gboolean overrun; /* A field ran past the end of the bytes. */
+
+  DissectWork work; /* Of the packet, zeroed with the position. */
 };
 typedef struct dissect_position_struct DissectPosition;
 
 
+/*! \brief  Work done by the dissector since the plugin was loaded.
+ *          Lets a profile relate buffers allocated to fields decoded.
+ */
+struct dissect_stats_struct
+{
+  guint64 fields;        /* fields decoded, elements of sequences too */
+  guint64 sized_fields;  /* strings and byte vectors decoded */
+  guint64 sized_allocs;  /* buffers allocated for them */
+  guint64 sized_bytes;   /* bytes allocated for them */
+  guint64 sized_interned; /* found in the string pool instead */
+  guint64 errors;        /* fields with a dynamic error */
+};
+typedef struct dissect_stats_struct DissectStats;
+
+
+/*! \brief  Counters of the work done by the dissector.
+ */
+DissectStats* dissect_stats (void);
+
+
+/*! \brief  Set the scope decoded strings and byte vectors live in.
+ *          A tool dropping the decoded fields with their packet passes the
+ *          packet scope, so that memory does not grow with the capture:
+ *          the strings are then not pooled and the dictionaries keep
+ *          copies of the values they store.
+ * \param scope  NULL for the capture file, the default.
+ */
+void set_sized_data_scope (wmem_allocator_t* scope);
+
+
+/*! \brief  Tell whether decoded strings and byte vectors live as long as
+ *          the capture file.
+ */
+gboolean sized_data_outlives_packet (void);
+
+
+/*! \brief  Allocate the buffer of a decoded string or byte vector.
+ *          The buffer lives as long as the capture file, or the scope
+ *          given to set_sized_data_scope.
+ * \param nbytes  Length of the value, a terminator is added.
+ * \return  The buffer.
+ */
+guint8* alloc_sized_data (guint nbytes);
+
+
+/*! \brief  Share a decoded ascii string with the equal ones of the capture.
+ *          Symbols and currencies repeat all over a capture, each distinct
+ *          value is kept once. The result must not be modified.
+ * \param bytes  Decoded string, may be scratch memory.
+ * \param nbytes  Length of the string, at most InternMaxBytes.
+ * \return  NUL terminated string living as long as the capture file, a
+ *          copy in the scope given to set_sized_data_scope if any.
+ */
+guint8* intern_ascii_string (const guint8* bytes, guint nbytes);
+
+
+/*! \brief  Forget the pooled strings, their memory goes with the capture file.
+ */
+void reset_string_pool (void);
+
+
 /*! \brief  Throw a dynamic error
+* The message is shared, not allocated per error.
 * \param err_no the dynamic error code
 * \param fdata the field data
 */
 void err_d(guint8 err_no, FieldData* fdata);
 
 
+/*! \brief  Message of a dynamic error.
+* \param err_no the dynamic error code, 1 to ErrDCount
+* \return "[ERR Dn] ..." text
+*/
+const char* err_d_message(guint8 err_no);
+
+
 /*! \brief  Shift the byte position of a dissection.
+ *          Never moves past the end of the bytes, a longer jump
+ *          marks the position as overrun.
  * \sa ShiftBuffer
  */
 void ShiftBytes(DissectPosition* position);
 
 
+/*! \brief  Length of the stop bit encoded field at the position.
+ * \param position  The dissector's current position, marked as overrun
+ *                  if the field is not terminated within the bytes.
+ * \return  Number of bytes of the field, 0 if it is not terminated.
+ */
+guint dissect_stop_bit_length (DissectPosition* position);
+
+
+/*! \brief  Claim bytes of a sized field.
+ * \param position  The dissector's current position, marked as overrun
+ *                  if fewer bytes are left.
+ * \param nbytes  Length announced by the field.
+ * \return  Number of bytes available, at most nbytes.
+ */
+guint dissect_claim_bytes (DissectPosition* position, guint nbytes);
+
+
 /*! \brief  Claim and retrieve a bit in the PMAP.
  * \param position  The dissector's current position.
  * \return  TRUE or FALSE depending on the PMAP bit value.
@@ -127,30 +242,34 @@ void basic_dissect_pmap (const DissectPosition* parent_position,
 
 /*! \brief  Given a byte stream, dissect an unsigned 32bit integer.
  * \param position  Position in the packet.
- * \param dnode  Dissect tree node.
+ * \param fdata  Result data.
+ * \return  The decoded value, wrapped if it is out of bounds.
  */
-void basic_dissect_uint32 (DissectPosition* position, FieldData* fdata);
+guint32 basic_dissect_uint32 (DissectPosition* position, FieldData* fdata);
 
 
 /*! \brief  Given a byte stream, dissect an unsigned 64bit integer.
  * \param position  Position in the packet.
  * \param fdata  Result data.
+ * \return  The decoded value, wrapped if it is out of bounds.
  */
-void basic_dissect_uint64 (DissectPosition* position, FieldData* fdata);
+guint64 basic_dissect_uint64 (DissectPosition* position, FieldData* fdata);
 
 
 /*! \brief  Given a byte stream, dissect a signed 32bit integer.
  * \param position  Position in the packet.
  * \param fdata  Result data.
+ * \return  The decoded value, wrapped if it is out of bounds.
  */
-void basic_dissect_int32 (DissectPosition* position, FieldData* fdata);
+gint32 basic_dissect_int32 (DissectPosition* position, FieldData* fdata);
 
 
 /*! \brief  Given a byte stream, dissect a signed 64bit integer.
  * \param position  Position in the packet.
  * \param fdata  Result data.
+ * \return  The decoded value, wrapped if it is out of bounds.
  */
-void basic_dissect_int64 (DissectPosition* position, FieldData* fdata);
+gint64 basic_dissect_int64 (DissectPosition* position, FieldData* fdata);
 
 
 /*! \brief  Given a byte stream, dissect an ASCII string.
@@ -46,6 +46,47 @@ static gboolean string_to_decimal_value (const char* str, FieldValue* value);
 static gboolean is_number(const char* str);
 
 
+/*! \brief Largest exponent magnitude FAST allows for a decimal. */
+#define DECIMAL_MAX_EXPONENT 63
+
+/*! \brief Powers of ten fitting in 64 bits, to count digits. */
+static const guint64 pow10_u64[20] =
+{
+  G_GUINT64_CONSTANT(1),
+  G_GUINT64_CONSTANT(10),
+  G_GUINT64_CONSTANT(100),
+  G_GUINT64_CONSTANT(1000),
+  G_GUINT64_CONSTANT(10000),
+  G_GUINT64_CONSTANT(100000),
+  G_GUINT64_CONSTANT(1000000),
+  G_GUINT64_CONSTANT(10000000),
+  G_GUINT64_CONSTANT(100000000),
+  G_GUINT64_CONSTANT(1000000000),
+  G_GUINT64_CONSTANT(10000000000),
+  G_GUINT64_CONSTANT(100000000000),
+  G_GUINT64_CONSTANT(1000000000000),
+  G_GUINT64_CONSTANT(10000000000000),
+  G_GUINT64_CONSTANT(100000000000000),
+  G_GUINT64_CONSTANT(1000000000000000),
+  G_GUINT64_CONSTANT(10000000000000000),
+  G_GUINT64_CONSTANT(100000000000000000),
+  G_GUINT64_CONSTANT(1000000000000000000),
+  G_GUINT64_CONSTANT(10000000000000000000)
+};
+
+/*! \brief Powers of ten exactly representable as a double. */
+static const gdouble pow10_double[23] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*! \brief Number of decimal digits of an unsigned number.
+ */
+static guint count_digits (guint64 n);
+
+
 void init_field_value (FieldValue* value)
 {
   memset(value, 0, sizeof(FieldValue));
@@ -79,6 +120,12 @@ void copy_field_value (FieldTypeIdentifier type,
 }
 
 
+void share_field_value (const FieldValue* src, FieldValue* dest)
+{
+  *dest = *src;
+}
+
+
 void cleanup_field_value (FieldTypeIdentifier type, FieldValue* value)
 {
   switch (type) {
@@ -255,3 +302,91 @@ gboolean string_to_decimal_value (const char* str, FieldValue* value)
 
   return TRUE;
 }
+
+
+guint count_digits (guint64 n)
+{
+  guint digits = 1;
+  while (digits < 20 && n >= pow10_u64[digits]) {
+    ++digits;
+  }
+  return digits;
+}
+
+
+gsize decimal_to_string (const DecimalFieldValue* value, char* buf)
+{
+  char digits[20];
+  guint64 n;
+  guint ndigits;
+  guint i;
+  gint32 expt = value->exponent;
+  char* p = buf;
+
+  if (expt < -DECIMAL_MAX_EXPONENT || expt > DECIMAL_MAX_EXPONENT) {
+    buf[0] = '\0';
+    return 0;
+  }
+
+  if (value->mantissa < 0) {
+    *p++ = '-';
+    /* negate in unsigned arithmetic, G_MININT64 has no positive twin */
+    n = (guint64) 0 - (guint64) value->mantissa;
+  } else {
+    n = (guint64) value->mantissa;
+  }
+
+  ndigits = count_digits(n);
+  for (i = ndigits; i > 0; --i) {
+    digits[i - 1] = (char) ('0' + n % 10);
+    n /= 10;
+  }
+
+  if (expt >= 0) {
+    memcpy(p, digits, ndigits);
+    p += ndigits;
+    if (digits[0] != '0') {
+      memset(p, '0', expt);
+      p += expt;
+    }
+  } else {
+    guint frac = (guint) -expt;
+    if (ndigits > frac) {
+      memcpy(p, digits, ndigits - frac);
+      p += ndigits - frac;
+      *p++ = '.';
+      memcpy(p, digits + ndigits - frac, frac);
+      p += frac;
+    } else {
+      *p++ = '0';
+      *p++ = '.';
+      memset(p, '0', frac - ndigits);
+      p += frac - ndigits;
+      memcpy(p, digits, ndigits);
+      p += ndigits;
+    }
+  }
+
+  *p = '\0';
+  return (gsize) (p - buf);
+}
+
+
+gdouble decimal_to_double (const DecimalFieldValue* value)
+{
+  gdouble result = (gdouble) value->mantissa;
+  gint32 expt = value->exponent;
+
+  while (expt > 22) {
+    result *= pow10_double[22];
+    expt -= 22;
+  }
+  while (expt < -22) {
+    result /= pow10_double[22];
+    expt += 22;
+  }
+  if (expt >= 0) {
+    return result * pow10_double[expt];
+  }
+  return result / pow10_double[-expt];
+}
@@ -114,6 +114,13 @@ void copy_field_value (FieldTypeIdentifier type, const FieldValue* src,
                        FieldValue* dest);
 
 
+/*! \brief  Make dest refer to the value of src, sized data is not copied.
+ *  \param src FieldValue to be shared.
+ *  \param dest FieldValue that will refer to the same data.
+ */
+void share_field_value (const FieldValue* src, FieldValue* dest);
+
+
 /*! \brief  Clean up a FieldValue's data members. 
  *  \param type The type of the FieldValue.
  *  \param value The FieldValue to be freed.
@@ -128,5 +135,26 @@ void cleanup_field_value (FieldTypeIdentifier type, FieldValue* value);
  */
 gboolean string_to_field_value(const char* str, FieldTypeIdentifier type, FieldValue* value);
 
+
+/*! \brief Longest text decimal_to_string can produce, including the NUL.
+ *         Sign, 20 digits, the point and up to 63 zeros of padding.
+ */
+#define DECIMAL_STRING_MAX 88
+
+/*! \brief  Format a decimal in positional notation, without printf.
+ *  \param value The decimal, the exponent must be within [-63, 63].
+ *  \param buf Output, at least DECIMAL_STRING_MAX bytes.
+ *  \return Length of the text written to buf, 0 if the exponent is
+ *          out of range.
+ */
+gsize decimal_to_string (const DecimalFieldValue* value, char* buf);
+
+
+/*! \brief  Convert a decimal to a floating point number.
+ *  \param value The decimal.
+ *  \return mantissa * 10^exponent
+ */
+gdouble decimal_to_double (const DecimalFieldValue* value);
+
 #endif
 
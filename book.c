@@ -0,0 +1,574 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file book.c
+ * \brief  Limit order books rebuilt from decoded incremental refreshes.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "debug.h"
+#include "template.h"
+#include "basic-dissect.h"
+#include "book.h"
+
+/* MDUpdateAction values */
+#define BOOK_ACTION_NEW         0
+#define BOOK_ACTION_CHANGE      1
+#define BOOK_ACTION_DELETE      2
+#define BOOK_ACTION_DELETE_THRU 3
+#define BOOK_ACTION_DELETE_FROM 4
+#define BOOK_ACTION_OVERLAY     5
+
+/* MDEntryType of an empty book, clears both sides */
+#define BOOK_ENTRY_EMPTY 'J'
+
+/*! \brief  Values of one market data entry gathered from the fields.
+ */
+struct book_entry_struct
+{
+  gboolean  has[BookRoleEnumLimit];
+  gboolean  nested;       /* entries came from a sequence instead */
+  guint64   security_id;
+  gint      entry_type;   /* BookSide, or BOOK_ENTRY_EMPTY */
+  gint64    action;
+  gint64    price_level;
+  BookLevel level;
+};
+typedef struct book_entry_struct BookEntry;
+
+struct book_resolve_struct
+{
+  wmem_map_t* roles;
+  const BookFieldNames* fields;
+  gboolean has_price;
+};
+
+static const char* default_field_names[BookRoleEnumLimit] =
+{
+  NULL,
+  "SecurityID",
+  "MDEntryType",
+  "MDUpdateAction",
+  "MDEntryPx",
+  "MDEntrySize",
+  "MDPriceLevel"
+};
+
+static gboolean resolve_field (GNode* node, gpointer data);
+static void gather_entry (BookSet* set, wmem_map_t* roles,
+                          const GNode* tnode, const GNode* dnode,
+                          BookEntry* entry,
+                          BookTop* tops, guint* ntops, guint max_tops);
+static void set_entry_value (BookEntry* entry, BookRole role,
+                             FieldTypeIdentifier type, const FieldValue* value);
+static gboolean value_as_int (FieldTypeIdentifier type, const FieldValue* value,
+                              gint64* result);
+static void apply_entry (BookSet* set, const BookEntry* entry,
+                         BookTop* tops, guint* ntops, guint max_tops);
+static gint find_level (const OrderBook* book, gint side,
+                        const BookLevel* level, gboolean exact);
+static void insert_level (OrderBook* book, gint side, guint idx,
+                          const BookLevel* level);
+static void remove_levels (OrderBook* book, gint side, guint idx, guint count);
+static void record_top (const OrderBook* book,
+                        BookTop* tops, guint* ntops, guint max_tops);
+static gint compare_price (const BookLevel* a, const BookLevel* b);
+
+wmem_map_t* book_resolve_roles (wmem_allocator_t* scope, GNode* templates,
+                                const BookFieldNames* fields)
+{
+  struct book_resolve_struct resolve;
+
+  if (!templates) {
+    return NULL;
+  }
+
+  resolve.roles = wmem_map_new(scope, g_direct_hash, g_direct_equal);
+  resolve.fields = fields;
+  resolve.has_price = FALSE;
+
+  g_node_traverse(templates, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+                  resolve_field, &resolve);
+
+  if (!resolve.has_price) {
+    return NULL;
+  }
+  return resolve.roles;
+}
+
+BookSet* book_set_new (wmem_allocator_t* scope)
+{
+  BookSet* set = wmem_new0(scope, BookSet);
+  set->scope = scope;
+  set->books = wmem_map_new(scope, g_int64_hash, g_int64_equal);
+  return set;
+}
+
+void book_apply_message (BookSet* set, wmem_map_t* roles,
+                         const GNode* tmpl, const GNode* data,
+                         BookTop* tops, guint* ntops, guint max_tops)
+{
+  BookEntry entry;
+
+  if (!set || !roles || !tmpl || !data) {
+    return;
+  }
+
+  memset(&entry, 0, sizeof(BookEntry));
+  gather_entry(set, roles, tmpl->children, data->children, &entry,
+               tops, ntops, max_tops);
+
+  /* a flat message is a single entry */
+  if (!entry.nested) {
+    apply_entry(set, &entry, tops, ntops, max_tops);
+  }
+}
+
+gdouble book_level_price (const BookLevel* level)
+{
+  DecimalFieldValue price;
+
+  price.mantissa = level->mantissa;
+  price.exponent = level->exponent;
+  return decimal_to_double(&price);
+}
+
+/*! \brief  g_node_traverse callback, record the role of a field.
+ */
+gboolean resolve_field (GNode* node, gpointer data)
+{
+  struct book_resolve_struct* resolve = (struct book_resolve_struct*) data;
+  const FieldType* ftype = (const FieldType*) node->data;
+  gint role;
+
+  if (!ftype || !ftype->name) {
+    return FALSE;
+  }
+
+  for (role = BookRoleSecurityID; role < BookRoleEnumLimit; ++role) {
+    const char* name = resolve->fields ? resolve->fields->names[role] : NULL;
+    if (!name || !name[0]) {
+      name = default_field_names[role];
+    }
+    if (strcmp(ftype->name, name) == 0) {
+      wmem_map_insert(resolve->roles, ftype, GINT_TO_POINTER(role));
+      if (role == BookRolePrice) {
+        resolve->has_price = TRUE;
+      }
+      break;
+    }
+  }
+  return FALSE;
+}
+
+/*! \brief  Walk sibling fields collecting the values of an entry.
+ *          Every element of a sequence is an entry of its own which
+ *          inherits what was collected so far (e.g. SecurityID).
+ */
+void gather_entry (BookSet* set, wmem_map_t* roles,
+                   const GNode* tnode, const GNode* dnode,
+                   BookEntry* entry,
+                   BookTop* tops, guint* ntops, guint max_tops)
+{
+  while (tnode && dnode) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* fdata = (const FieldData*) dnode->data;
+
+    if (fdata && fdata->status == FieldExists) {
+      BookRole role = (BookRole) GPOINTER_TO_INT(wmem_map_lookup(roles, ftype));
+
+      if (role != BookRoleNone) {
+        set_entry_value(entry, role, ftype->type, &fdata->value);
+      }
+
+      if (ftype->type == FieldTypeGroup) {
+        gather_entry(set, roles, tnode->children, dnode->children, entry,
+                     tops, ntops, max_tops);
+      }
+      else if (ftype->type == FieldTypeSequence &&
+               tnode->children && tnode->children->next) {
+        const GNode* group_tnode = tnode->children->next;
+        const GNode* element;
+
+        for (element = dnode->children; element; element = element->next) {
+          BookEntry nested = *entry;
+          nested.nested = FALSE;
+          gather_entry(set, roles, group_tnode->children, element->children,
+                       &nested, tops, ntops, max_tops);
+          if (!nested.nested) {
+            apply_entry(set, &nested, tops, ntops, max_tops);
+          }
+        }
+        entry->nested = TRUE;
+      }
+    }
+
+    tnode = tnode->next;
+    dnode = dnode->next;
+  }
+}
+
+void set_entry_value (BookEntry* entry, BookRole role,
+                      FieldTypeIdentifier type, const FieldValue* value)
+{
+  gint64 n = 0;
+
+  switch (role) {
+    case BookRoleEntryType:
+      if (type == FieldTypeAsciiString) {
+        if (value->ascii.nbytes == 0) {
+          return;
+        }
+        switch (value->ascii.bytes[0]) {
+          case '0':
+            entry->entry_type = BookBid;
+            break;
+          case '1':
+            entry->entry_type = BookAsk;
+            break;
+          case BOOK_ENTRY_EMPTY:
+            entry->entry_type = BOOK_ENTRY_EMPTY;
+            break;
+          default:
+            /* trades, statistics, ... do not change the book */
+            return;
+        }
+      }
+      else if (value_as_int(type, value, &n) && (n == 0 || n == 1)) {
+        entry->entry_type = (n == 0) ? BookBid : BookAsk;
+      }
+      else {
+        return;
+      }
+      break;
+
+    case BookRolePrice:
+      if (type == FieldTypeDecimal) {
+        entry->level.mantissa = value->decimal.mantissa;
+        entry->level.exponent = value->decimal.exponent;
+      }
+      else if (value_as_int(type, value, &n)) {
+        entry->level.mantissa = n;
+        entry->level.exponent = 0;
+      }
+      else {
+        return;
+      }
+      break;
+
+    default:
+      if (!value_as_int(type, value, &n)) {
+        return;
+      }
+      switch (role) {
+        case BookRoleSecurityID:
+          entry->security_id = (guint64) n;
+          break;
+        case BookRoleUpdateAction:
+          entry->action = n;
+          break;
+        case BookRoleSize:
+          entry->level.size = n;
+          break;
+        case BookRolePriceLevel:
+          entry->price_level = n;
+          break;
+        default:
+          return;
+      }
+      break;
+  }
+  entry->has[role] = TRUE;
+}
+
+gboolean value_as_int (FieldTypeIdentifier type, const FieldValue* value,
+                       gint64* result)
+{
+  switch (type) {
+    case FieldTypeUInt32:
+      *result = value->u32;
+      return TRUE;
+    case FieldTypeUInt64:
+      *result = (gint64) value->u64;
+      return TRUE;
+    case FieldTypeInt32:
+      *result = value->i32;
+      return TRUE;
+    case FieldTypeInt64:
+      *result = value->i64;
+      return TRUE;
+    case FieldTypeDecimal:
+      {
+        gint64 n = value->decimal.mantissa;
+        gint32 exp = value->decimal.exponent;
+        for (; exp > 0 && n != 0; --exp) {
+          /* not an integer a book can use */
+          if (n > G_MAXINT64 / 10 || n < G_MININT64 / 10) {
+            return FALSE;
+          }
+          n *= 10;
+        }
+        for (; exp < 0 && n != 0; ++exp) n /= 10;
+        *result = n;
+      }
+      return TRUE;
+    case FieldTypeAsciiString:
+      {
+        /* FIX sends some numeric tags as strings */
+        guint i;
+        gint64 n = 0;
+        if (value->ascii.nbytes == 0) {
+          return FALSE;
+        }
+        for (i = 0; i < value->ascii.nbytes; ++i) {
+          if (!g_ascii_isdigit(value->ascii.bytes[i]) ||
+              n > (G_MAXINT64 - (value->ascii.bytes[i] - '0')) / 10) {
+            return FALSE;
+          }
+          n = n * 10 + (value->ascii.bytes[i] - '0');
+        }
+        *result = n;
+      }
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/*! \brief  Apply one market data entry to the book of its instrument.
+ */
+void apply_entry (BookSet* set, const BookEntry* entry,
+                  BookTop* tops, guint* ntops, guint max_tops)
+{
+  OrderBook* book;
+  gint side;
+  gint64 action;
+  gint idx;
+
+  if (!entry->has[BookRoleEntryType]) {
+    return;
+  }
+
+  book = (OrderBook*) wmem_map_lookup(set->books, &entry->security_id);
+  if (!book) {
+    book = wmem_new0(set->scope, OrderBook);
+    book->security_id = entry->security_id;
+    wmem_map_insert(set->books, &book->security_id, book);
+  }
+
+  set->updates++;
+
+  if (entry->entry_type == BOOK_ENTRY_EMPTY) {
+    book->depth[BookBid] = 0;
+    book->depth[BookAsk] = 0;
+    record_top(book, tops, ntops, max_tops);
+    return;
+  }
+
+  side = entry->entry_type;
+  action = entry->has[BookRoleUpdateAction] ? entry->action : BOOK_ACTION_NEW;
+
+  /* Price level books say where the level is, otherwise go by price */
+  if (entry->has[BookRolePriceLevel]) {
+    if (entry->price_level < 1) {
+      return;
+    }
+    idx = (gint) MIN(entry->price_level - 1, BOOK_DEPTH);
+  }
+  else if (entry->has[BookRolePrice]) {
+    idx = find_level(book, side, &entry->level,
+                     action != BOOK_ACTION_NEW && action != BOOK_ACTION_OVERLAY);
+    if (idx < 0 && action != BOOK_ACTION_DELETE_THRU
+        && action != BOOK_ACTION_DELETE_FROM) {
+      return;
+    }
+  }
+  else {
+    idx = 0;
+  }
+
+  switch (action) {
+    case BOOK_ACTION_NEW:
+      if (!entry->has[BookRolePriceLevel] &&
+          idx < book->depth[side] &&
+          compare_price(&book->levels[side][idx], &entry->level) == 0) {
+        /* same price again, a by-price book just updates the level */
+        book->levels[side][idx] = entry->level;
+      }
+      else {
+        insert_level(book, side, (guint) idx, &entry->level);
+      }
+      break;
+
+    case BOOK_ACTION_CHANGE:
+    case BOOK_ACTION_OVERLAY:
+      if (idx < book->depth[side]) {
+        book->levels[side][idx] = entry->level;
+      }
+      else {
+        insert_level(book, side, (guint) idx, &entry->level);
+      }
+      break;
+
+    case BOOK_ACTION_DELETE:
+      remove_levels(book, side, (guint) idx, 1);
+      break;
+
+    case BOOK_ACTION_DELETE_THRU:
+      /* levels 1 thru N, or the ones better than a price not in the book */
+      if (idx < 0) {
+        remove_levels(book, side, 0,
+                      (guint) find_level(book, side, &entry->level, FALSE));
+      }
+      else {
+        remove_levels(book, side, 0, (guint) idx + 1);
+      }
+      break;
+
+    case BOOK_ACTION_DELETE_FROM:
+      /* levels N to the end, or the ones worse than a price not in the book */
+      if (idx < 0) {
+        idx = find_level(book, side, &entry->level, FALSE);
+      }
+      remove_levels(book, side, (guint) idx, BOOK_DEPTH);
+      break;
+
+    default:
+      DBG1("Unknown MDUpdateAction %d", (gint) action);
+      break;
+  }
+
+  record_top(book, tops, ntops, max_tops);
+}
+
+/*! \brief  Find where a price sits in one side of a book.
+ * \param exact  TRUE to only accept a level with the same price.
+ * \return  Index of the level, -1 if exact and not found.
+ */
+gint find_level (const OrderBook* book, gint side,
+                 const BookLevel* level, gboolean exact)
+{
+  guint i;
+
+  for (i = 0; i < book->depth[side]; ++i) {
+    gint cmp = compare_price(level, &book->levels[side][i]);
+    if (cmp == 0) {
+      return (gint) i;
+    }
+    /* bids are best when highest, asks when lowest */
+    if (!exact && ((side == BookBid) ? cmp > 0 : cmp < 0)) {
+      return (gint) i;
+    }
+  }
+  return exact ? -1 : (gint) book->depth[side];
+}
+
+void insert_level (OrderBook* book, gint side, guint idx,
+                   const BookLevel* level)
+{
+  BookLevel* levels = book->levels[side];
+  guint depth = book->depth[side];
+
+  if (idx >= BOOK_DEPTH) {
+    return;
+  }
+  if (idx > depth) {
+    idx = depth;
+  }
+  if (depth == BOOK_DEPTH) {
+    /* the worst level falls off the book */
+    depth--;
+  }
+  memmove(&levels[idx + 1], &levels[idx], (depth - idx) * sizeof(BookLevel));
+  levels[idx] = *level;
+  book->depth[side] = (guint8) (depth + 1);
+}
+
+void remove_levels (OrderBook* book, gint side, guint idx, guint count)
+{
+  BookLevel* levels = book->levels[side];
+  guint depth = book->depth[side];
+
+  if (idx >= depth) {
+    return;
+  }
+  if (count > depth - idx) {
+    count = depth - idx;
+  }
+  memmove(&levels[idx], &levels[idx + count],
+          (depth - idx - count) * sizeof(BookLevel));
+  book->depth[side] = (guint8) (depth - count);
+}
+
+void record_top (const OrderBook* book,
+                 BookTop* tops, guint* ntops, guint max_tops)
+{
+  BookTop* top = NULL;
+  gint side;
+  guint i;
+
+  if (!tops) {
+    return;
+  }
+  for (i = 0; i < *ntops; ++i) {
+    if (tops[i].security_id == book->security_id) {
+      top = &tops[i];
+      break;
+    }
+  }
+  if (!top) {
+    if (*ntops >= max_tops) {
+      return;
+    }
+    top = &tops[(*ntops)++];
+  }
+
+  top->security_id = book->security_id;
+  for (side = 0; side < BookSideEnumLimit; ++side) {
+    top->depth[side] = book->depth[side];
+    if (book->depth[side]) {
+      top->best[side] = book->levels[side][0];
+    } else {
+      memset(&top->best[side], 0, sizeof(BookLevel));
+    }
+  }
+}
+
+gint compare_price (const BookLevel* a, const BookLevel* b)
+{
+  if (a->exponent == b->exponent) {
+    return (a->mantissa > b->mantissa) - (a->mantissa < b->mantissa);
+  }
+  {
+    gdouble pa = book_level_price(a);
+    gdouble pb = book_level_price(b);
+    return (pa > pb) - (pa < pb);
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * tab-width: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,141 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file book.h
+ * \brief  Limit order books rebuilt from decoded incremental refreshes.
+ *  Every instrument has a fixed depth book kept in flat arrays of
+ *  price levels. Decoded messages are matched to the book by the
+ *  role of their fields (SecurityID, MDEntryType, ...), which is
+ *  resolved once per template tree.
+ */
+
+#ifndef BOOK_H_INCLUDED_
+#define BOOK_H_INCLUDED_
+
+#include <glib.h>
+#include <epan/wmem/wmem.h>
+
+/*! \brief Number of price levels kept per side. */
+#define BOOK_DEPTH 10
+
+/*! \brief Role of a template field in book building.
+ */
+enum book_role_enum
+{
+  BookRoleNone,
+  BookRoleSecurityID,
+  BookRoleEntryType,
+  BookRoleUpdateAction,
+  BookRolePrice,
+  BookRoleSize,
+  BookRolePriceLevel,
+  BookRoleEnumLimit
+};
+typedef enum book_role_enum BookRole;
+
+/*! \brief Sides of a book.
+ */
+enum BookSide { BookBid, BookAsk, BookSideEnumLimit };
+
+/*! \brief Field names to look for, indexed by BookRole.
+ *         NULL entries use the FIX tag name.
+ */
+struct book_field_names_struct
+{
+  const char* names[BookRoleEnumLimit];
+};
+typedef struct book_field_names_struct BookFieldNames;
+
+/*! \brief One price level.
+ */
+struct book_level_struct
+{
+  gint64 mantissa;  /*!< Price as a FAST decimal. */
+  gint32 exponent;
+  gint64 size;
+};
+typedef struct book_level_struct BookLevel;
+
+/*! \brief Book of one instrument, both sides best level first.
+ */
+struct order_book_struct
+{
+  guint64   security_id;
+  guint8    depth[BookSideEnumLimit];
+  BookLevel levels[BookSideEnumLimit][BOOK_DEPTH];
+};
+typedef struct order_book_struct OrderBook;
+
+/*! \brief Top of an instrument's book after a packet was applied.
+ */
+struct book_top_struct
+{
+  guint64   security_id;
+  guint8    depth[BookSideEnumLimit];
+  BookLevel best[BookSideEnumLimit];
+};
+typedef struct book_top_struct BookTop;
+
+/*! \brief  Books of all instruments of a capture.
+ */
+struct book_set_struct
+{
+  wmem_allocator_t* scope;
+  wmem_map_t* books;   /*!< security id -> OrderBook */
+  guint64 updates;     /*!< Entries applied. */
+};
+typedef struct book_set_struct BookSet;
+
+/*! \brief  Find the fields of a template tree that feed the books.
+ * \param scope  Scope the returned map lives in.
+ * \param templates  Root of the templates tree.
+ * \param fields  Field names to look for.
+ * \return  Map of FieldType pointer -> BookRole, NULL if no
+ *          template has a price field.
+ */
+wmem_map_t* book_resolve_roles (wmem_allocator_t* scope, GNode* templates,
+                                const BookFieldNames* fields);
+
+/*! \brief  Create an empty set of books.
+ * \param scope  Scope the books live in, usually the capture file.
+ * \return  The new set.
+ */
+BookSet* book_set_new (wmem_allocator_t* scope);
+
+/*! \brief  Apply the entries of a decoded message to the books.
+ * \param set  Books to update.
+ * \param roles  Map returned by book_resolve_roles.
+ * \param tmpl  Template of the message.
+ * \param data  Decoded message.
+ * \param tops  Return value. Top of every book touched, an instrument
+ *              already in the array is updated in place.
+ * \param ntops  Number of entries used in tops, updated.
+ * \param max_tops  Size of tops.
+ */
+void book_apply_message (BookSet* set, wmem_map_t* roles,
+                         const GNode* tmpl, const GNode* data,
+                         BookTop* tops, guint* ntops, guint max_tops);
+
+/*! \brief  Price of a level as a floating point number.
+ * \param level  The level.
+ * \return  mantissa * 10^exponent
+ */
+gdouble book_level_price (const BookLevel* level);
+
+#endif
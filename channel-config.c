@@ -0,0 +1,253 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file channel-config.c
+ * \brief  Index of the configured channels and import of exchange
+ *         channel configurations.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+#include <wsutil/inet_addr.h>
+
+#include "debug.h"
+#include "error_log.h"
+#include "feed-header.h"
+#include "recovery.h"
+#include "channel-config.h"
+
+/*! \brief  Key of a (group, port) in the index.
+ */
+static guint64 channel_key (guint32 group, guint port);
+
+/*! \brief  Text of the first child element with the given name.
+ * \return  The text to free with xmlFree, NULL if there is no such child.
+ */
+static xmlChar* child_text (xmlNodePtr node, const char* name);
+
+/*! \brief  Read the connections of a channel element.
+ */
+static void import_cme_connections (wmem_allocator_t* scope,
+                                    wmem_array_t* channels,
+                                    const xmlChar* channel_id,
+                                    xmlNodePtr connections);
+
+ChannelIndex* channel_index_new (wmem_allocator_t* scope)
+{
+  ChannelIndex* index = wmem_new(scope, ChannelIndex);
+  index->scope = scope;
+  index->channels = wmem_map_new(scope, g_int64_hash, g_int64_equal);
+  return index;
+}
+
+void channel_index_insert (ChannelIndex* index, guint32 group, guint port,
+                           gpointer channel)
+{
+  guint64 key = channel_key(group, port);
+
+  /* the key is kept by the first channel of the (group, port) */
+  if (wmem_map_lookup(index->channels, &key)) {
+    wmem_map_insert(index->channels, &key, channel);
+  }
+  else {
+    wmem_map_insert(index->channels, wmem_memdup(index->scope, &key, sizeof(guint64)), channel);
+  }
+}
+
+gpointer channel_index_lookup (const ChannelIndex* index, const address* addr,
+                               guint port)
+{
+  guint64 key;
+  gpointer channel = NULL;
+
+  if (addr->type == AT_IPv4 && addr->len == 4) {
+    guint32 group;
+    memcpy(&group, addr->data, 4);
+    key = channel_key(group, port);
+    channel = wmem_map_lookup(index->channels, &key);
+  }
+  if (!channel) {
+    key = channel_key(0, port);
+    channel = wmem_map_lookup(index->channels, &key);
+  }
+  return channel;
+}
+
+gboolean parse_group_address (const char* text, guint32* group)
+{
+  *group = 0;
+  if (!text || !text[0]) {
+    return TRUE;
+  }
+  return ws_inet_pton4(text, group);
+}
+
+wmem_array_t* import_cme_channels (wmem_allocator_t* scope,
+                                   const char* filename)
+{
+  xmlDocPtr doc;
+  xmlNodePtr cur;
+  wmem_array_t* channels;
+
+  doc = xmlParseFile(filename);
+  if (doc == NULL) {
+    fast_log_static_error(1, -1, " Invalid channel configuration XML syntax");
+    return NULL;
+  }
+
+  cur = xmlDocGetRootElement(doc);
+  if (cur == NULL) {
+    xmlFreeDoc(doc);
+    return NULL;
+  }
+
+  channels = wmem_array_new(scope, sizeof(ImportedChannel));
+
+  for (cur = cur->xmlChildrenNode; cur; cur = cur->next) {
+    if (cur->type == XML_ELEMENT_NODE &&
+        !xmlStrcmp(cur->name, (const xmlChar*) "channel")) {
+      xmlChar* id = xmlGetProp(cur, (const xmlChar*) "id");
+      xmlNodePtr child;
+
+      if (!id) {
+        continue;
+      }
+      for (child = cur->xmlChildrenNode; child; child = child->next) {
+        if (child->type == XML_ELEMENT_NODE &&
+            !xmlStrcmp(child->name, (const xmlChar*) "connections")) {
+          import_cme_connections(scope, channels, id, child);
+        }
+      }
+      xmlFree(id);
+    }
+  }
+
+  xmlFreeDoc(doc);
+  return channels;
+}
+
+guint64 channel_key (guint32 group, guint port)
+{
+  return ((guint64) group << 16) | (port & 0xffff);
+}
+
+xmlChar* child_text (xmlNodePtr node, const char* name)
+{
+  xmlNodePtr child;
+
+  for (child = node->xmlChildrenNode; child; child = child->next) {
+    if (child->type == XML_ELEMENT_NODE &&
+        !xmlStrcmp(child->name, (const xmlChar*) name)) {
+      return xmlNodeGetContent(child);
+    }
+  }
+  return NULL;
+}
+
+void import_cme_connections (wmem_allocator_t* scope,
+                             wmem_array_t* channels,
+                             const xmlChar* channel_id,
+                             xmlNodePtr connections)
+{
+  xmlNodePtr cur;
+
+  for (cur = connections->xmlChildrenNode; cur; cur = cur->next) {
+    ImportedChannel channel;
+    xmlNodePtr type_node;
+    xmlChar* feed_type = NULL;
+    xmlChar* protocol;
+    xmlChar* ip;
+    xmlChar* port;
+    xmlChar* feed;
+
+    if (cur->type != XML_ELEMENT_NODE ||
+        xmlStrcmp(cur->name, (const xmlChar*) "connection")) {
+      continue;
+    }
+
+    for (type_node = cur->xmlChildrenNode; type_node; type_node = type_node->next) {
+      if (type_node->type == XML_ELEMENT_NODE &&
+          !xmlStrcmp(type_node->name, (const xmlChar*) "type")) {
+        feed_type = xmlGetProp(type_node, (const xmlChar*) "feed-type");
+        break;
+      }
+    }
+    protocol = child_text(cur, "protocol");
+    ip = child_text(cur, "ip");
+    port = child_text(cur, "port");
+    feed = child_text(cur, "feed");
+
+    memset(&channel, 0, sizeof(ImportedChannel));
+    channel.tcp = protocol && xmlStrstr(protocol, (const xmlChar*) "TCP") != NULL;
+    channel.port = port ? (guint) strtoul((const char*) port, NULL, 10) : 0;
+
+    /* replay servers are reached by their host address, no group */
+    if (!channel.tcp &&
+        !parse_group_address((const char*) ip, &channel.group)) {
+      DBG1("Bad group address of channel %s", (const char*) channel_id);
+      channel.port = 0;
+    }
+
+    if (feed && feed[0] == 'A') {
+      channel.line = LineA;
+    }
+    else if (feed && feed[0] == 'B') {
+      channel.line = LineB;
+    }
+
+    if (feed_type) {
+      if (feed_type[0] == 'I') {
+        channel.recovery_role = RecoveryIncremental;
+      }
+      else if (feed_type[0] == 'S') {
+        channel.recovery_role = RecoverySnapshot;
+      }
+      channel.feed_group = wmem_strdup_printf(scope, "%s-%s",
+                                              (const char*) channel_id,
+                                              (const char*) feed_type);
+    }
+    if (channel.recovery_role != RecoveryNone) {
+      channel.market = wmem_strdup(scope, (const char*) channel_id);
+    }
+
+    if (channel.port > 0 && channel.port < 65536) {
+      wmem_array_append_one(channels, channel);
+    }
+
+    xmlFree(feed_type);
+    xmlFree(protocol);
+    xmlFree(ip);
+    xmlFree(port);
+    xmlFree(feed);
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * tab-width: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
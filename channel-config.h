@@ -0,0 +1,103 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file channel-config.h
+ * \brief  Index of the configured channels and import of exchange
+ *         channel configurations.
+ *  A channel is keyed by its multicast group and port, a channel
+ *  configured without a group matches every group on its port.
+ */
+
+#ifndef CHANNEL_CONFIG_H_INCLUDED_
+#define CHANNEL_CONFIG_H_INCLUDED_
+
+#include <glib.h>
+#include <epan/address.h>
+#include <epan/wmem/wmem.h>
+
+/*! \brief Channels of the port list by (group, port).
+ */
+struct channel_index_struct
+{
+  wmem_allocator_t* scope;
+  wmem_map_t* channels;   /*!< (group << 16 | port) -> channel */
+};
+typedef struct channel_index_struct ChannelIndex;
+
+/*! \brief Channel read from an exchange configuration file.
+ */
+struct imported_channel_struct
+{
+  gboolean tcp;
+  guint32  group;         /*!< IPv4 group, network byte order, 0 for any. */
+  guint    port;
+  guint8   line;          /*!< FeedLine */
+  guint8   recovery_role; /*!< RecoveryRole */
+  gchar*   feed_group;
+  gchar*   market;
+};
+typedef struct imported_channel_struct ImportedChannel;
+
+/*! \brief  Create an empty channel index.
+ * \param scope  Scope of the index.
+ * \return  The index.
+ */
+ChannelIndex* channel_index_new (wmem_allocator_t* scope);
+
+/*! \brief  Add a channel to the index, replacing the one of the same
+ *          group and port.
+ * \param index  The index.
+ * \param group  IPv4 group in network byte order, 0 for any group.
+ * \param port  UDP or TCP port.
+ * \param channel  Value stored.
+ */
+void channel_index_insert (ChannelIndex* index, guint32 group, guint port,
+                           gpointer channel);
+
+/*! \brief  Find the channel of an address and port.
+ *          The channel of the group is preferred to the one of any group.
+ * \param index  The index.
+ * \param addr  Destination (group) address of the packet.
+ * \param port  Port of the packet.
+ * \return  The channel, NULL if none.
+ */
+gpointer channel_index_lookup (const ChannelIndex* index, const address* addr,
+                               guint port);
+
+/*! \brief  Parse a dotted IPv4 group address.
+ * \param text  The address, NULL or empty for any group.
+ * \param group  Return value, network byte order, 0 for any group.
+ * \return  FALSE if the text is not an IPv4 address.
+ */
+gboolean parse_group_address (const char* text, guint32* group);
+
+/*! \brief  Read the channels of a CME config.xml.
+ *          Incremental, snapshot and instrument definition feeds are
+ *          read as UDP channels, historical replay as TCP channels.
+ *          The A and B feeds of a channel are the lines of one feed
+ *          group, the incremental and snapshot feeds of a channel
+ *          recover one market.
+ * \param scope  Scope of the result.
+ * \param filename  The config.xml.
+ * \return  Array of ImportedChannel, NULL if the file can't be read.
+ */
+wmem_array_t* import_cme_channels (wmem_allocator_t* scope,
+                                   const char* filename);
+
+#endif
@@ -37,16 +37,29 @@
    *       map<field_key,value>
    */
 
+/*! \brief Bytes of sized data, terminator included, kept inside a TypedValue. */
+#define TYPED_VALUE_INLINE_MAX 24
+
 /*!
  * \brief Struct to allow a field type to be associated with the value.
  * Dictionary stored values are typed because it is an error to attempt to use
  * mismatched types when retrieving values.
+ * Strings and byte vectors that fit, terminator included, are copied to
+ * inline_bytes. Longer ones are not owned, they point at the buffer of the
+ * decoded field that was stored, which lives as long as the capture file.
+ * When decoded buffers go with their packet, see set_sized_data_scope,
+ * longer ones are copied to heap_bytes instead, which is reused by later
+ * stores of the same key.
  */
 struct typed_value_struct
 {
   FieldTypeIdentifier type;
   gboolean empty;
-  FieldValue value;
+  guint32 generation;  /* generation of the conversation when stored */
+  FieldValue value;    /* sized data may point at inline_bytes or heap_bytes */
+  guint heap_size;
+  guint8* heap_bytes;
+  guint8 inline_bytes[TYPED_VALUE_INLINE_MAX];
 };
 typedef struct typed_value_struct TypedValue;
 
@@ -54,21 +67,48 @@ typedef struct typed_value_struct TypedValue;
  * \brief Struct to track all dictionaries
  * Tracks all dictionaries, normal and template.  Stores the dictionaries in a
  * hash table for fast insert/lookup.
+ * Clearing the dictionaries bumps the generation, values stored under an
+ * older generation are undefined and get recycled by the next store.
+ * A stale value could only come back to life if it was left untouched
+ * for 2^32 resets.
  */
 struct _conversation_tables {
   GHashTable* normal;
   GHashTable* templates;
+  guint32 generation;
 };
 typedef struct _conversation_tables ConversationTables;
 
+/*!
+ * \brief A stored value as it was before a store, see checkpoint_dictionaries
+ * A value created by the store is saved as stale, which reads as absent.
+ * The stored value keeps its heap buffer, bytes saved from it are copied
+ * to undo_bytes and copied back by a rollback.
+ * A clear is undone too, stored is then NULL and ctables got cleared.
+ */
+struct dictionary_undo_struct
+{
+  TypedValue* stored;
+  TypedValue saved;
+  ConversationTables* ctables;  /* of a clear, or of a created value */
+  guint32 generation;           /* generation of ctables before the clear */
+  gboolean heap_saved;          /* saved bytes are in undo_bytes */
+  guint heap_offset;            /* of the saved bytes in undo_bytes */
+};
+typedef struct dictionary_undo_struct DictionaryUndo;
+
 /* Private (static) headers. */
 static GHashTable* src_table = 0;
+static GArray* undo_log = 0;
+static GArray* undo_marks = 0;  /* length of undo_log at each checkpoint */
+static GByteArray* undo_bytes = 0;  /* heap bytes saved by undo_log */
+static gboolean journaling = FALSE;
 
 /*!
  * \brief Retrieves a dictionary by name, or creates it if it doesn't exist.
  * \param name The name of the dictionary to retrieve
  */
-static GHashTable* get_dictionary(const FieldType * ftype, address src, address dest);
+static GHashTable* get_dictionary(const FieldType * ftype, ConversationTables* conversation_tables);
 
 /*!
  * \brief Duplicates an integer into the heap
@@ -82,6 +122,35 @@ static guint32* int_dup(guint32 i);
  */
 static void free_typed_value(TypedValue* val);
 
+/*!
+ * \brief Keeps a field value in a TypedValue
+ * Short sized data is copied inline, longer one is borrowed, or copied
+ * to the heap buffer if it goes with its packet.
+ * \param val The TypedValue to store into
+ * \param type The type of the value
+ * \param src The value to keep
+ */
+static void store_typed_value(TypedValue* val, FieldTypeIdentifier type,
+                              const FieldValue* src);
+
+/*!
+ * \brief Hands out the value of a TypedValue
+ * Inline and heap sized data is copied out, it is overwritten by the next
+ * store.
+ * \param val The TypedValue to read
+ * \param dest Return value.
+ */
+static void load_typed_value(const TypedValue* val, FieldValue* dest);
+
+/*!
+ * \brief Retrieves the previous value of the given field
+ * See get_dictionary_value and peek_dictionary_value.
+ * \param borrow TRUE to borrow inline and heap sized data instead of a copy
+ */
+static gboolean lookup_dictionary_value(const FieldType* ftype,
+                                        FieldData* fdata, address src,
+                                        address dest, gboolean borrow);
+
 /*!
  * \brief Frees a conversation table including its children
  * Frees the conversation table pointed to by p.  First calls
@@ -108,12 +177,9 @@ static ConversationTables * get_conversation_table(address src, address dest);
  */
 static void free_typed_value(TypedValue* val);
 
-GHashTable* get_dictionary(const FieldType * ftype, address src, address dest){
-  ConversationTables* conversation_tables = NULL;
+GHashTable* get_dictionary(const FieldType * ftype, ConversationTables* conversation_tables){
   GHashTable* dictionary = NULL;
 
-  conversation_tables = get_conversation_table(src, dest);
-
   /* Determine if we need a template or a non-template dictionary */
   if(g_strcmp0(ftype->dictionary,TEMPLATE_DICTIONARY) == 0){
     dictionary = (GHashTable*)g_hash_table_lookup(conversation_tables->templates, &(ftype->tid));
@@ -131,7 +197,7 @@ GHashTable* get_dictionary(const FieldType * ftype, address src, address dest){
       dictionary = g_hash_table_new_full(&g_str_hash,&g_str_equal,
 				       (GDestroyNotify)&g_free,
 				       (GDestroyNotify)&free_typed_value);
-      g_hash_table_insert(conversation_tables->normal, ftype->dictionary, dictionary);
+      g_hash_table_insert(conversation_tables->normal, g_strdup(ftype->dictionary), dictionary);
     }
   }
   /* Should never be run */
@@ -173,6 +239,7 @@ ConversationTables * get_conversation_table(address src, address dest){
 				       &g_free,(GDestroyNotify)&g_hash_table_destroy);
     conversation_tables->templates = g_hash_table_new_full(&g_int_hash, &g_int_equal,
 				       &g_free,(GDestroyNotify)&g_hash_table_destroy);
+    conversation_tables->generation = 0;
     g_hash_table_insert(dest_table, copyAddress(&dest), conversation_tables);
   }
 
@@ -192,68 +259,218 @@ void free_conversation_table(gconstpointer p){
 
 }
 
+void reset_dictionaries(void)
+{
+  while (journaling) {
+    commit_dictionaries();
+  }
+  if (src_table) {
+    g_hash_table_destroy(src_table);
+    src_table = 0;
+  }
+}
+
 void clear_dictionaries(address src, address dest)
 {
-  GList* list;
-  GList* node;
   ConversationTables * ctables = get_conversation_table(src, dest);
 
-  /* Free all the key/value pairs in all the dictionaries, but keep the
-   * dictionaries as they will probably be used again later */
-  list = g_hash_table_get_keys(ctables->normal);
-  node = list;
-  while(node) {
-    GHashTable* dictionary = (GHashTable*)g_hash_table_lookup(ctables->normal,
-                                                 ((char*)node->data));
-    g_hash_table_remove_all(dictionary);
-    node = g_list_next(node);
+  /* Keep the dictionaries and their values, they will be used again on
+   * the next packet. Everything stored so far just becomes undefined. */
+  if (journaling) {
+    DictionaryUndo undo;
+    memset(&undo, 0, sizeof(DictionaryUndo));
+    undo.ctables = ctables;
+    undo.generation = ctables->generation;
+    undo.heap_offset = undo_bytes->len;
+    g_array_append_val(undo_log, undo);
   }
-  g_list_free(list);
-
-  /* Same as above, free the value, not the dictionaries as the dictionaries
-   * will probably be used again */
-  list = g_hash_table_get_keys(ctables->templates);
-  node = list;
-  while(node) {
-    GHashTable* dictionary = (GHashTable*)g_hash_table_lookup(ctables->templates,
-                                                 ((char*)node->data));
-    g_hash_table_remove_all(dictionary);
-    node = g_list_next(node);
+  ctables->generation++;
+}
+
+void checkpoint_dictionaries(void)
+{
+  guint mark;
+
+  if (!undo_log) {
+    undo_log = g_array_new(FALSE, FALSE, sizeof(DictionaryUndo));
+    undo_marks = g_array_new(FALSE, FALSE, sizeof(guint));
+    undo_bytes = g_byte_array_new();
   }
-  g_list_free(list);
+  mark = undo_log->len;
+  g_array_append_val(undo_marks, mark);
+  journaling = TRUE;
+}
+
+void rollback_dictionaries(void)
+{
+  guint mark;
+  guint i;
 
-  return;
+  if (!journaling) {
+    return;
+  }
+  mark = g_array_index(undo_marks, guint, undo_marks->len - 1);
+  /* newest first, a value may have been stored twice */
+  for (i = undo_log->len; i > mark; --i) {
+    DictionaryUndo* undo = &g_array_index(undo_log, DictionaryUndo, i - 1);
+    guint8* heap_bytes;
+    guint heap_size;
+    if (!undo->stored) {
+      undo->ctables->generation = undo->generation;
+      continue;
+    }
+    /* the heap buffer only grows, the saved bytes fit back in */
+    heap_bytes = undo->stored->heap_bytes;
+    heap_size = undo->stored->heap_size;
+    *undo->stored = undo->saved;
+    undo->stored->heap_bytes = heap_bytes;
+    undo->stored->heap_size = heap_size;
+    if (undo->heap_saved) {
+      memcpy(heap_bytes, undo_bytes->data + undo->heap_offset,
+             undo->saved.value.bytevec.nbytes + 1);
+      undo->stored->value.bytevec.bytes = heap_bytes;
+    }
+  }
+  /* created values are stale in the generation that was restored */
+  for (i = mark; i < undo_log->len; ++i) {
+    DictionaryUndo* undo = &g_array_index(undo_log, DictionaryUndo, i);
+    if (undo->stored && undo->ctables) {
+      undo->stored->generation = undo->ctables->generation - 1;
+    }
+  }
+  if (mark < undo_log->len) {
+    DictionaryUndo* undo = &g_array_index(undo_log, DictionaryUndo, mark);
+    g_byte_array_set_size(undo_bytes, undo->heap_offset);
+  }
+  g_array_set_size(undo_log, mark);
+  g_array_set_size(undo_marks, undo_marks->len - 1);
+  journaling = undo_marks->len > 0;
 }
 
-void free_typed_value(TypedValue* val)
+void commit_dictionaries(void)
 {
-  if (!val->empty) {
-    cleanup_field_value(val->type, &val->value);
+  if (!journaling) {
+    return;
+  }
+  g_array_set_size(undo_marks, undo_marks->len - 1);
+  journaling = undo_marks->len > 0;
+  /* an enclosing checkpoint may still undo these stores */
+  if (journaling) {
+    return;
   }
+  g_array_set_size(undo_log, 0);
+  g_byte_array_set_size(undo_bytes, 0);
+}
+
+void free_typed_value(TypedValue* val)
+{
+  g_free(val->heap_bytes);
   g_free(val);
 }
 
+void store_typed_value(TypedValue* val, FieldTypeIdentifier type,
+                       const FieldValue* src)
+{
+  guint nbytes;
+  guint8* bytes;
+
+  switch (type) {
+    case FieldTypeAsciiString:
+    case FieldTypeUnicodeString:
+    case FieldTypeByteVector:
+      nbytes = src->bytevec.nbytes;
+      if (nbytes < TYPED_VALUE_INLINE_MAX) {
+        bytes = val->inline_bytes;
+      }
+      else if (sized_data_outlives_packet()) {
+        /* the dictionary takes over the buffer of longer sized data */
+        share_field_value(src, &val->value);
+        break;
+      }
+      else {
+        if (val->heap_size < nbytes + 1) {
+          g_free(val->heap_bytes);
+          val->heap_bytes = (guint8*)g_malloc(nbytes + 1);
+          val->heap_size = nbytes + 1;
+        }
+        bytes = val->heap_bytes;
+      }
+      memcpy(bytes, src->bytevec.bytes, nbytes);
+      bytes[nbytes] = 0;
+      val->value.bytevec.nbytes = nbytes;
+      val->value.bytevec.bytes = bytes;
+      break;
+    default:
+      val->value = *src;
+      break;
+  }
+}
+
+void load_typed_value(const TypedValue* val, FieldValue* dest)
+{
+  guint nbytes = val->value.bytevec.nbytes;
+
+  if ((val->type == FieldTypeAsciiString ||
+       val->type == FieldTypeUnicodeString ||
+       val->type == FieldTypeByteVector) &&
+      (val->value.bytevec.bytes == val->inline_bytes ||
+       (val->heap_bytes && val->value.bytevec.bytes == val->heap_bytes))) {
+    if (val->type == FieldTypeAsciiString && nbytes <= InternMaxBytes) {
+      dest->ascii.bytes = intern_ascii_string(val->value.ascii.bytes, nbytes);
+    }
+    else {
+      dest->bytevec.bytes = alloc_sized_data(nbytes);
+      memcpy(dest->bytevec.bytes, val->value.bytevec.bytes, nbytes + 1);
+    }
+    dest->bytevec.nbytes = nbytes;
+    return;
+  }
+  share_field_value(&val->value, dest);
+}
+
 
 gboolean get_dictionary_value(const FieldType* ftype,
                               FieldData* fdata, address src, address dest)
+{
+  return lookup_dictionary_value(ftype, fdata, src, dest, FALSE);
+}
+
+gboolean peek_dictionary_value(const FieldType* ftype,
+                               FieldData* fdata, address src, address dest)
+{
+  return lookup_dictionary_value(ftype, fdata, src, dest, TRUE);
+}
+
+gboolean lookup_dictionary_value(const FieldType* ftype,
+                                 FieldData* fdata, address src,
+                                 address dest, gboolean borrow)
 {
   gboolean found = FALSE;
+  ConversationTables* ctables = 0;
   GHashTable* dictionary = 0;
   const TypedValue* prev = 0;
 
-  dictionary = get_dictionary(ftype, src, dest);
+  ctables = get_conversation_table(src, dest);
+  dictionary = get_dictionary(ftype, ctables);
   if (!ftype->key) {
     BAILOUT(FALSE, "No key on field.");
   }
   prev = (TypedValue*)g_hash_table_lookup(dictionary,ftype->key);
+  if (prev && prev->generation != ctables->generation) {
+    /* stored before the dictionaries were cleared */
+    prev = 0;
+  }
   if (prev) {
     /* Determine if the types match */
     if (prev->type == ftype->type) {
-      /* Copy the previous value for use */
+      /* Borrow the previous value for use */
       found = TRUE;
       fdata->status = prev->empty ? FieldEmpty : FieldExists;
-      if (fdata->status == FieldExists) {
-        copy_field_value(ftype->type, &prev->value, &fdata->value);
+      if (fdata->status == FieldExists && borrow) {
+        share_field_value(&prev->value, &fdata->value);
+      }
+      else if (fdata->status == FieldExists) {
+        load_typed_value(prev, &fdata->value);
       }
     }
     else {
@@ -267,7 +484,7 @@ gboolean get_dictionary_value(const FieldType* ftype,
     /* TODO FIX THIS remove the || TRUE once the other todo has been handled*/
     if(ftype->mandatory || TRUE){
       fdata->status = FieldExists;
-      copy_field_value(ftype->type, &ftype->value, &fdata->value);
+      share_field_value(&ftype->value, &fdata->value);
     }
     else {
       /* TODO Determine if the default value is empty
@@ -287,32 +504,61 @@ gboolean get_dictionary_value(const FieldType* ftype,
 void set_dictionary_value(const FieldType* ftype,
                           const FieldData* fdata, address src, address dest)
 {
+  ConversationTables* ctables = 0;
   GHashTable* dictionary = 0;
   TypedValue* prev_value = 0;
   TypedValue* new_value = 0;
 
-  dictionary = get_dictionary(ftype, src, dest);
+  /* an error carries its message, the previous value is kept */
+  if (fdata->status == FieldError) {
+    return;
+  }
+  ctables = get_conversation_table(src, dest);
+  dictionary = get_dictionary(ftype, ctables);
 
   if(!ftype->key) {
     return;
   }
 
   prev_value = (TypedValue*)g_hash_table_lookup(dictionary, ftype->key);
-  /* Recycle the previous value */
+  /* Recycle the previous value and its storage, even one of an older
+   * generation */
   if (prev_value) {
-    if (!prev_value->empty) {
-      cleanup_field_value(ftype->type, &prev_value->value);
-    }
     new_value = prev_value;
   }
   else {
-    new_value = (TypedValue*)g_malloc(sizeof(TypedValue));
+    new_value = (TypedValue*)g_malloc0(sizeof(TypedValue));
+  }
+  if (journaling) {
+    DictionaryUndo undo;
+    memset(&undo, 0, sizeof(DictionaryUndo));
+    undo.stored = new_value;
+    undo.heap_offset = undo_bytes->len;
+    if (prev_value) {
+      undo.saved = *prev_value;
+      undo.saved.heap_bytes = 0;
+      undo.saved.heap_size = 0;
+      if ((prev_value->type == FieldTypeAsciiString ||
+           prev_value->type == FieldTypeUnicodeString ||
+           prev_value->type == FieldTypeByteVector) &&
+          prev_value->heap_bytes && !prev_value->empty &&
+          prev_value->value.bytevec.bytes == prev_value->heap_bytes) {
+        undo.heap_saved = TRUE;
+        g_byte_array_append(undo_bytes, prev_value->heap_bytes,
+                            prev_value->value.bytevec.nbytes + 1);
+      }
+    }
+    else {
+      undo.ctables = ctables;
+    }
+    g_array_append_val(undo_log, undo);
   }
   /* Copy in the values */
   new_value->type = ftype->type;
   new_value->empty = fdata->status == FieldEmpty;
+  new_value->generation = ctables->generation;
   if (!new_value->empty) {
-    copy_field_value(ftype->type, &fdata->value, &new_value->value);
+    store_typed_value(new_value, ftype->type, &fdata->value);
   }
   if (new_value) {
     /* Only have to insert if we created a new value. */
@@ -35,15 +35,45 @@
 #define GLOBAL_DICTIONARY "global"
 #define TEMPLATE_DICTIONARY "template"
 
+/*!
+ * \brief Drops the dictionaries of every conversation
+ * Called when a new capture file is opened, stored values refer to the
+ * decoded fields of the previous one.
+ */
+void reset_dictionaries(void);
+
 /*!
  * \brief Clears the contents of all the dictionaries
+ * Constant time, the stored values are marked undefined and their
+ * storage is reused by later stores.
  */
 void clear_dictionaries(address src, address dest);
 
+/*!
+ * \brief Starts recording the stores to the dictionaries
+ * A message cut short at the end of a TCP segment is decoded again once
+ * the next segment arrived, the stores it made must be undone first.
+ * Checkpoints nest, the rollback and the commit apply to the latest one.
+ */
+void checkpoint_dictionaries(void);
+
+/*!
+ * \brief Undoes the stores and clears since the latest checkpoint, and
+ * stops recording unless a checkpoint encloses it
+ */
+void rollback_dictionaries(void);
+
+/*!
+ * \brief Keeps the stores since the latest checkpoint, an enclosing
+ * checkpoint may still undo them
+ */
+void commit_dictionaries(void);
+
 /*!
  * \brief Retrieves the previous value of the given field
- * Will do a deep copy of the stored value and return the copy.
- * Caller is responsible for memory.
+ * Sized data is a borrowed view of the stored buffer, it must not be
+ * modified. It stays valid for the life of the capture file. Short
+ * values are kept inline in the dictionary and handed out as a copy.
  * If the field has a default or initial value and is undefined in the dictionary,
  * the default or initial value is returned
  * \param ftype The field to retrieve the previous value of
@@ -52,11 +82,23 @@ void clear_dictionaries(address src, address dest);
  */
 gboolean get_dictionary_value(const FieldType* ftype, FieldData* fdata, address src, address dest);
 
+/*!
+ * \brief Retrieves the previous value of the given field without a copy
+ * Same as get_dictionary_value, but short sized data is a borrowed view
+ * of the inline storage of the dictionary too. It is only valid until the
+ * next store of the field, use it to build a new value.
+ */
+gboolean peek_dictionary_value(const FieldType* ftype, FieldData* fdata, address src, address dest);
+
 /*!
  * \brief Sets the value of the field for future look up
- * Will do a deep copy of the given value to remove external modification.
+ * Short sized data is copied. The buffer of longer sized data is handed
+ * over without a copy, it must not be modified afterwards and must live as
+ * long as the capture file. It is copied too when sized data goes with its
+ * packet, see set_sized_data_scope.
  * \param ftype The field to set the value of.
- * \param fdata Data to store, only 'empty' and 'value' members matter here.
+ * \param fdata Data to store, only 'status' and 'value' members matter here.
+ * A field in error is not stored, the previous value is kept.
  */
 void set_dictionary_value(const FieldType* ftype,
                           const FieldData* fdata, address src, address dest);
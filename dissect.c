@@ -50,6 +50,97 @@ gboolean dissect_ascii_delta(const FieldType* ftype, FieldData* fdata,
                              DissectPosition* position, address* src, address* dest);
 
 
+/*! \brief  Given a byte stream, dissect the tail of an ascii string and
+ *          put it over the end of the base value.
+ * \param ftype  Type of the field.
+ * \param fdata  Field data, gets the combined string.
+ * \param position  Position in the packet.
+ */
+static void dissect_ascii_tail(const FieldType* ftype, FieldData* fdata,
+                               DissectPosition* position, address* src, address* dest);
+
+
+/*! \brief  Borrow the base value of a delta or tail: the previous
+ *          value, else the initial one, else an empty one. An empty
+ *          previous value gives the base of a tail, a delta rejects it.
+ * \param lookup  Gets the base, its status is the one of the dictionary.
+ */
+static void peek_base(const FieldType* ftype, FieldData* lookup,
+                      address* src, address* dest);
+
+
+/*! \brief  Length of a decoded ascii string, up to its terminator.
+ * \param str  Decoded string.
+ * \param nbytes  Bytes decoded.
+ * \return Length of the string.
+ */
+static guint decoded_length(const guint8* str, guint nbytes);
+
+
+/*! \brief  Store an integer that is out of bounds, wrapped as it was
+ *          decoded, for the operator of the next message. The field
+ *          itself keeps its error.
+ * \param value  The wrapped value, nullable adjustment applied.
+ */
+static void set_wrapped_value(const FieldType* ftype, const FieldData* fdata,
+                              const FieldValue* value, address* src, address* dest);
+
+
+/*! \brief  Walk the fields of a skipped template without building data.
+ *          Every field is decoded into scratch data and stored as the
+ *          full decode does, the dictionaries end up the same.
+ * \param tnode  First template node of the fields.
+ * \param position  Position in the packet.
+ */
+static void skip_walk(const GNode* tnode, DissectPosition* position,
+                      address* src, address* dest);
+
+
+/*! \brief  Step over a group of a skipped template.
+ * \param tnode  Template node of the group.
+ * \param position  Position in the packet.
+ */
+static void skip_group(const GNode* tnode, DissectPosition* position,
+                       address* src, address* dest);
+
+
+/*! \brief  Whether a field is over the work budget of its packet.
+ * \param position  Position in the packet, with its work.
+ * \return  TRUE if the field must not be decoded.
+ */
+static gboolean over_budget(const DissectPosition* position);
+
+
+/*! \brief  Charge the bytes of a delta or tail string to the budget.
+ * \param nbytes  Length of the string to build.
+ * \param fdata  Field of the string, gets the error if over budget.
+ * \return  FALSE if the string must not be built.
+ */
+static gboolean charge_string_bytes(DissectPosition* position, guint nbytes,
+                                    FieldData* fdata);
+
+
+/*! \brief  Stop the packet at a field over its budget.
+ */
+static void exceed_budget(DissectPosition* position, FieldData* fdata);
+
+
+/*! \brief  Base of a delta or tail without a value to build on. */
+static guint8 empty_base[1] = { 0 };
+
+/*! \brief  Scope of the data trees, NULL for the capture file. */
+static wmem_allocator_t* tree_scope = NULL;
+
+/*! \brief  Template id of the previous message, for messages without. */
+static guint32 template_id = 0;
+
+/*! \brief  Work budget of every packet. */
+static DissectBudget budget =
+{
+  BudgetMaxFields, BudgetMaxElements, BudgetMaxStringBytes
+};
+
+
 #define SetupDissectStack(ftype, fdata, tnode, dnode) \
   const FieldType* ftype; \
   FieldData* fdata; \
@@ -88,7 +179,7 @@ gboolean dissect_int_op(gint64* delta,
           fdata->status = FieldExists;
 
           if(ftype->hasDefault) {
-            copy_field_value(ftype->type, &ftype->value, &fdata->value);
+            share_field_value(&ftype->value, &fdata->value);
           } else {
             /* Zero out all bytes (regardless of integer type) */
             memset(&fdata->value, 0, sizeof(FieldValue));
@@ -153,24 +244,31 @@ gboolean dissect_ascii_delta(const FieldType* ftype, FieldData* fdata,
                              DissectPosition* position, address* src, address* dest)
 {
   FieldData fdata_temp;
-  FieldData input_str;
   FieldData lookup;
   gint32 subtract;
-  gint64 cut_length;
-  gint64 input_str_len;
+  guint cut_length;
+  guint input_nbytes;
+  guint input_len;
+  const guint8* input;
+  guint8* bytes;
+  guint8 scratch[InternMaxBytes + 1];
   gboolean append_to_front;
 
-  /* get the subtraction length */
+  /* get the subtraction length, nullable if the field is optional */
   basic_dissect_int32(position, &fdata_temp);
   subtract = fdata_temp.value.i32;
-
-  /* get the previous string */
-  if(!get_dictionary_value(ftype, &lookup, *src, *dest)) {
-    return TRUE;
+  if (!ftype->mandatory && 0 < subtract) {
+    subtract -= 1;
   }
 
-  /* get the input string */
-  basic_dissect_ascii_string (position, &input_str);
+  /* borrow the base string */
+  peek_base(ftype, &lookup, src, dest);
+
+  /* skip the input string, it is decoded straight into the result */
+  input = position->bytes;
+  input_nbytes = dissect_stop_bit_length (position);
+  position->offjmp = input_nbytes;
+  ShiftBytes(position);
 
   /* ERROR catching for D7 */
 
@@ -178,7 +276,6 @@ gboolean dissect_ascii_delta(const FieldType* ftype, FieldData* fdata,
   if(fdata_temp.nbytes > 5){
 
     err_d(7, fdata);
-    cleanup_field_value(FieldTypeAsciiString, &lookup.value);
     return FALSE;
   }
   /* subtraction length equal to 5 and... */
@@ -186,7 +283,12 @@ gboolean dissect_ascii_delta(const FieldType* ftype, FieldData* fdata,
      (FieldError == fdata_temp.status)) {
 
     err_d(7, fdata);
-    cleanup_field_value(FieldTypeAsciiString, &lookup.value);
+    return FALSE;
+  }
+
+  /* an empty previous value has nothing to apply the delta to */
+  if (FieldEmpty == lookup.status) {
+    err_d(6, fdata);
     return FALSE;
   }
 
@@ -200,59 +302,169 @@ gboolean dissect_ascii_delta(const FieldType* ftype, FieldData* fdata,
     /* if the previous value is shorter than the
      * subtraction length, this is an error.
      */
-    cleanup_field_value(FieldTypeAsciiString, &input_str.value);
-    cleanup_field_value(FieldTypeAsciiString, &lookup.value);
-
     err_d(7, fdata);
     return FALSE;
 
   }
 
-  /* malloc space for new string */
+  /* previous string and input into one buffer, short results are built
+   * on the stack and pooled */
   cut_length = lookup.value.ascii.nbytes - subtract;
-  input_str_len = input_str.value.ascii.nbytes;
-  fdata->value.ascii.nbytes = cut_length + input_str_len;
-  fdata->value.ascii.bytes = (guint8 *) wmem_alloc(wmem_file_scope(), (fdata->value.ascii.nbytes + 1) * sizeof(guint8));
+  if (!charge_string_bytes(position, cut_length + input_nbytes, fdata)) {
+    return FALSE;
+  }
+  if (cut_length + input_nbytes <= InternMaxBytes) {
+    bytes = scratch;
+  }
+  else {
+    bytes = alloc_sized_data(cut_length + input_nbytes);
+  }
 
   if(append_to_front)
   {
-    /* append input string to front */
-    memcpy(fdata->value.ascii.bytes,
-           input_str.value.ascii.bytes,
-           input_str_len);
+    /* input string in front */
+    decode_ascii_string(input_nbytes, input, bytes);
+    input_len = decoded_length(bytes, input_nbytes);
 
     /* append cut string to end */
-    memcpy(fdata->value.ascii.bytes + input_str_len,
+    memcpy(bytes + input_len,
            lookup.value.ascii.bytes + subtract,
            cut_length);
   }
   else
   {
-    /* append cut string to front */
-    memcpy(fdata->value.ascii.bytes,
+    /* cut string in front */
+    memcpy(bytes,
            lookup.value.ascii.bytes,
            cut_length);
 
     /* append input string to end */
-    memcpy(fdata->value.ascii.bytes + cut_length,
-           input_str.value.ascii.bytes,
-           input_str_len);
+    decode_ascii_string(input_nbytes, input, bytes + cut_length);
+    input_len = decoded_length(bytes + cut_length, input_nbytes);
   }
 
-  /* null terminator */
-  fdata->value.ascii.bytes[fdata->value.ascii.nbytes] = 0;
-
-  cleanup_field_value(FieldTypeAsciiString, &input_str.value);
-  cleanup_field_value(FieldTypeAsciiString, &lookup.value);
+  fdata->value.ascii.nbytes = cut_length + input_len;
+  if (bytes == scratch) {
+    bytes = intern_ascii_string(scratch, fdata->value.ascii.nbytes);
+  }
+  else {
+    /* null terminator */
+    bytes[fdata->value.ascii.nbytes] = 0;
+  }
+  fdata->value.ascii.bytes = bytes;
 
   return FALSE;
 }
 
+void dissect_ascii_tail(const FieldType* ftype, FieldData* fdata,
+                        DissectPosition* position, address* src, address* dest)
+{
+  FieldData lookup;
+  guint base_len;
+  guint input_nbytes;
+  guint input_len;
+  guint keep;
+  const guint8* input;
+  guint8* bytes;
+  guint8 scratch[InternMaxBytes + 1];
+
+  peek_base(ftype, &lookup, src, dest);
+  base_len = lookup.value.ascii.nbytes;
+
+  /* skip the tail, it is decoded straight into the result */
+  input = position->bytes;
+  input_nbytes = dissect_stop_bit_length (position);
+  position->offjmp = input_nbytes;
+  ShiftBytes(position);
+
+  if (!charge_string_bytes(position, base_len + input_nbytes, fdata)) {
+    return;
+  }
+  if (base_len + input_nbytes <= InternMaxBytes) {
+    bytes = scratch;
+  }
+  else {
+    bytes = alloc_sized_data(base_len + input_nbytes);
+  }
+
+  /* the tail goes after the base, then over as many bytes of its end */
+  decode_ascii_string(input_nbytes, input, bytes + base_len);
+  input_len = decoded_length(bytes + base_len, input_nbytes);
+  keep = input_len < base_len ? base_len - input_len : 0;
+  memcpy(bytes, lookup.value.ascii.bytes, keep);
+  memmove(bytes + keep, bytes + base_len, input_len);
+
+  fdata->value.ascii.nbytes = keep + input_len;
+  if (bytes == scratch) {
+    bytes = intern_ascii_string(scratch, fdata->value.ascii.nbytes);
+  }
+  else {
+    bytes[fdata->value.ascii.nbytes] = 0;
+  }
+  fdata->value.ascii.bytes = bytes;
+}
+
+
+void peek_base(const FieldType* ftype, FieldData* lookup,
+               address* src, address* dest)
+{
+  lookup->status = FieldUndefined;
+  peek_dictionary_value(ftype, lookup, *src, *dest);
+  if (FieldEmpty == lookup->status && ftype->hasDefault) {
+    share_field_value(&ftype->value, &lookup->value);
+  }
+  else if (FieldExists != lookup->status) {
+    lookup->value.bytevec.nbytes = 0;
+    lookup->value.bytevec.bytes = empty_base;
+  }
+}
+
+
+guint decoded_length(const guint8* str, guint nbytes)
+{
+  guint len = 0;
+  while (len < nbytes && str[len]) {
+    ++len;
+  }
+  return len;
+}
+
+
+void dissect_set_tree_scope (wmem_allocator_t* scope)
+{
+  tree_scope = scope;
+}
+
+
+void dissect_reset (void)
+{
+  template_id = 0;
+}
+
+
+guint32 dissect_template_id (void)
+{
+  return template_id;
+}
+
+
+void dissect_set_template_id (guint32 id)
+{
+  template_id = id;
+}
+
+
+void dissect_set_budget (const DissectBudget* limits)
+{
+  budget = *limits;
+}
+
+
 GNode* dissect_fast_bytes (wmem_map_t* templates, DissectPosition* position, GNode* parent, address* src, address* dest)
 {
-  static guint32 template_id = 0;
   GNode* tmpl = 0; /* Template. */
   FieldData* fdata; /* Template ID data node. */
+  gboolean journaled;
 
   basic_dissect_pmap (position, position);
 
@@ -281,13 +493,38 @@ GNode* dissect_fast_bytes (wmem_map_t* templates, DissectPosition* position, GNo
     return 0;
   }
 
+  /* A message over its budget is left half decoded, its stores are
+   * recorded to be undone. */
+  journaled = budget.max_fields || budget.max_elements ||
+              budget.max_string_bytes;
+  if (journaled) {
+    checkpoint_dictionaries();
+  }
+
   /* Dissect the packet. */
-  {
+  if (((const FieldType*) tmpl->data)->skip) {
+    skip_walk(tmpl->children, position, src, dest);
+  }
+  else {
     GNode* data_node = 0;
     dissector_walk(tmpl->children, position,
                    parent, data_node, src, dest);
   }
 
+  if (position->work.exceeded) {
+    /* The dictionaries go back to where the message started, the next
+     * packet decodes as if it had not been sent, and the rest of this
+     * packet is not looked at. */
+    if (journaled) {
+      rollback_dictionaries();
+    }
+    position->offjmp = position->nbytes;
+    ShiftBytes(position);
+  }
+  else if (journaled) {
+    commit_dictionaries();
+  }
+
   fdata->nbytes = position->offset - fdata->start;
   return tmpl;
 }
@@ -325,11 +562,28 @@ GNode* dissect_descend (const GNode* tnode,
   }
 
   /* Set up data. */
-  fdata = (FieldData*) wmem_new(wmem_file_scope(), FieldData);
+  fdata = (FieldData*) wmem_new(tree_scope ? tree_scope : wmem_file_scope(), FieldData);
 
-  dnode_next = wmem_node_new(wmem_file_scope(), fdata);
+  dnode_next = wmem_node_new(tree_scope ? tree_scope : wmem_file_scope(), fdata);
   g_node_insert_after(parent, dnode, dnode_next);
 
+  if (position->work.exceeded || over_budget(position)) {
+    /* Left empty past the budget, the data tree keeps the shape of the
+     * template for the displays. */
+    fdata->start  = position->offset;
+    fdata->nbytes = 0;
+    fdata->status = FieldEmpty;
+    fdata->error  = 0;
+    init_field_value(&fdata->value);
+    if (!position->work.exceeded) {
+      exceed_budget(position, fdata);
+      dissect_stats()->errors++;
+    }
+    return dnode_next;
+  }
+  position->work.fields++;
+  dissect_stats()->fields++;
+
   dissect_value(tnode, position, dnode_next, src, dest);
 
   if(!(dnode_next->parent)){
@@ -365,6 +619,7 @@ void dissect_value (const GNode* tnode,
   fdata->start  = start;
   fdata->nbytes = 0;
   fdata->status  = FieldEmpty;
+  fdata->error  = 0;
   init_field_value(&fdata->value);
 
   /* Assure the appropriate function exists. */
@@ -390,7 +645,7 @@ void dissect_value (const GNode* tnode,
         break;
 
       case FieldOperatorConstant:
-        copy_field_value(ftype->type, &ftype->value, &fdata->value);
+        share_field_value(&ftype->value, &fdata->value);
         operator_used = TRUE;
         break;
 
@@ -398,6 +653,10 @@ void dissect_value (const GNode* tnode,
         operator_used = dissect_default(tnode, position, dnode, src, dest);
         break;
 
+      case FieldOperatorTail:
+        operator_used = dissect_tail(tnode, position, dnode, src, dest);
+        break;
+
       default:
         break;
     }
@@ -407,6 +666,9 @@ void dissect_value (const GNode* tnode,
       (*dissect_fn_map[ftype->type]) (tnode, position, dnode, src, dest);
     }
   }
+  if (fdata->status == FieldError) {
+    dissect_stats()->errors++;
+  }
   /* Make sure the window is correct. */
   fdata->start = start;
   fdata->nbytes = position->offset - start;
@@ -511,6 +773,30 @@ gboolean dissect_copy(const GNode* tnode,
 }
 
 
+gboolean dissect_tail(const GNode* tnode,
+                      DissectPosition* position, GNode* dnode, address* src, address* dest)
+{
+  SetupDissectStack(ftype, fdata, tnode, dnode);
+
+  if (dissect_shift_pmap(position)) {
+    /* a tail follows, put over the base value by the type */
+    return FALSE;
+  }
+
+  get_dictionary_value(ftype, fdata, *src, *dest);
+  if (FieldUndefined == fdata->status && ftype->mandatory) {
+    err_d(6, fdata);
+  }
+  else if (FieldEmpty == fdata->status && ftype->mandatory) {
+    err_d(7, fdata);
+  }
+  else if (FieldUndefined == fdata->status) {
+    fdata->status = FieldEmpty;
+  }
+  return TRUE;
+}
+
+
 gboolean dissect_default(const GNode* tnode,
                          DissectPosition* position, GNode* dnode, address* src, address* dest)
 {
@@ -521,27 +807,44 @@ gboolean dissect_default(const GNode* tnode,
   if(presence_bit) {
     used = FALSE;
   } else {
-    copy_field_value(ftype->type, &ftype->value, &fdata->value);
+    share_field_value(&ftype->value, &fdata->value);
     set_dictionary_value(ftype, fdata, *src, *dest);
   }
   return used;
 }
 
 
+void set_wrapped_value(const FieldType* ftype, const FieldData* fdata,
+                       const FieldValue* value, address* src, address* dest)
+{
+  FieldData stored = *fdata;
+
+  stored.status = FieldExists;
+  stored.value = *value;
+  set_dictionary_value(ftype, &stored, *src, *dest);
+}
+
+
 void dissect_uint32 (const GNode* tnode,
                      DissectPosition* position, GNode* dnode, address* src, address* dest)
 {
   gint64 delta = 0;
   gboolean dissect_it = FALSE;
+  FieldValue wrapped;
   SetupDissectStack(ftype, fdata,  tnode, dnode);
 
   dissect_it = dissect_int_op(&delta, ftype, fdata, position, src, dest);
 
   if(dissect_it) {
-    basic_dissect_uint32(position, fdata);
+    wrapped.u32 = basic_dissect_uint32(position, fdata);
     if (!ftype->mandatory) {
       delta = -1;
     }
+    if (fdata->status == FieldError) {
+      wrapped.u32 = (guint32) (wrapped.u32 + delta);
+      set_wrapped_value(ftype, fdata, &wrapped, src, dest);
+      return;
+    }
   }
 
   fdata->value.u32 = (guint32) (fdata->value.u32 + delta);
@@ -554,15 +857,21 @@ void dissect_uint64 (const GNode* tnode,
 {
   gboolean dissect_it = FALSE;
   gint64 delta = 0;
+  FieldValue wrapped;
   SetupDissectStack(ftype, fdata,  tnode, dnode);
 
   dissect_it = dissect_int_op(&delta, ftype, fdata, position, src, dest);
 
   if (dissect_it) {
-    basic_dissect_uint64 (position, fdata);
+    wrapped.u64 = basic_dissect_uint64 (position, fdata);
     if (!ftype->mandatory) {
       delta = -1;
     }
+    if (fdata->status == FieldError) {
+      wrapped.u64 += delta;
+      set_wrapped_value(ftype, fdata, &wrapped, src, dest);
+      return;
+    }
   }
 
   fdata->value.u64 += delta;
@@ -575,16 +884,21 @@ void dissect_int32 (const GNode* tnode,
 {
   gboolean dissect_it = FALSE;
   gint64 delta = 0;
+  FieldValue wrapped;
   SetupDissectStack(ftype, fdata,  tnode, dnode);
 
   dissect_it = dissect_int_op(&delta, ftype, fdata, position, src, dest);
 
   if (dissect_it) {
-    basic_dissect_int32 (position, fdata);
-    if (!ftype->mandatory && 0 < fdata->value.i32) {
+    wrapped.i32 = basic_dissect_int32 (position, fdata);
+    if (!ftype->mandatory && 0 < wrapped.i32) {
       delta = -1;
     }
-
+    if (fdata->status == FieldError) {
+      wrapped.i32 = (gint32) (wrapped.i32 + delta);
+      set_wrapped_value(ftype, fdata, &wrapped, src, dest);
+      return;
+    }
   }
 
   fdata->value.i32 = (gint32) (fdata->value.i32 + delta);
@@ -597,16 +911,22 @@ void dissect_int64 (const GNode* tnode,
 {
   gboolean dissect_it = FALSE;
   gint64 delta = 0;
+  FieldValue wrapped;
   SetupDissectStack(ftype, fdata,  tnode, dnode);
 
   dissect_it = dissect_int_op(&delta, ftype, fdata, position, src, dest);
 
   if (dissect_it) {
-    basic_dissect_int64 (position, fdata);
+    wrapped.i64 = basic_dissect_int64 (position, fdata);
 
-    if (!ftype->mandatory && 0 < fdata->value.i64) {
+    if (!ftype->mandatory && 0 < wrapped.i64) {
       delta = -1;
     }
+    if (fdata->status == FieldError) {
+      wrapped.i64 += delta;
+      set_wrapped_value(ftype, fdata, &wrapped, src, dest);
+      return;
+    }
   }
 
   fdata->value.i64 += delta;
@@ -637,12 +957,19 @@ void dissect_decimal (const GNode* tnode,
     dissect_int_op(&delta, ftype, &expt_data, position, src, dest);
     expt = (gint32) (delta + expt_data.value.decimal.exponent);
 
-    dissect_int_op(&delta, ftype, &mant_data, position, src, dest);
-    mant = delta + mant_data.value.decimal.mantissa;
+    /* only the exponent delta is nullable, the mantissa one never is */
+    mant = expt_data.value.decimal.mantissa;
+    if (FieldError != expt_data.status) {
+      basic_dissect_int64(position, &mant_data);
+      mant += mant_data.value.i64;
+    }
   }
   else {
-    /* Grab exponent. */
+    /* Grab exponent, an optional decimal is absent with it. */
     dissect_value (expt_node, position, dnode, src, dest);
+    if (FieldExists != fdata->status) {
+      return;
+    }
     expt = fdata->value.i32;
     /* Grab mantissa. */
     dissect_value (mant_node, position, dnode, src, dest);
@@ -672,9 +999,11 @@ void dissect_ascii_string (const GNode* tnode,
       dissect_it = TRUE;
       break;
     case FieldOperatorDelta:
-    case FieldOperatorTail:
         dissect_it = dissect_ascii_delta(ftype, fdata, position, src, dest);
       break;
+    case FieldOperatorTail:
+      dissect_ascii_tail(ftype, fdata, position, src, dest);
+      break;
     default:
       DBG0("Invalid Operator.");
       break;
@@ -682,8 +1011,13 @@ void dissect_ascii_string (const GNode* tnode,
   if (dissect_it) {
     basic_dissect_ascii_string (position, fdata);
   }
+  if (FieldExists == fdata->status) {
+    dissect_stats()->sized_fields++;
+  }
 
-  set_dictionary_value(ftype, fdata, *src, *dest);
+  if (!position->work.exceeded) {
+    set_dictionary_value(ftype, fdata, *src, *dest);
+  }
 }
 
 
@@ -715,51 +1049,75 @@ void dissect_byte_vector (const GNode* tnode,
     case FieldOperatorNone:
       dissect_it = TRUE;
       break;
-    case FieldOperatorDelta:
     case FieldOperatorTail:
       {
-        SizedData* vec;
+        FieldData lookup;
+        const guint8* input;
+        guint input_len;
+        guint base_len;
+        guint keep;
+        guint8* bytes;
+
+        peek_base(ftype, &lookup, src, dest);
+        base_len = lookup.value.bytevec.nbytes;
+
+        /* the tail has the nullability of the field */
+        dissect_value (length_node, position, dnode, src, dest);
+        input_len = dissect_claim_bytes (position, fdata->value.u32);
+        input = position->bytes;
+        position->offjmp = input_len;
+        ShiftBytes(position);
+
+        /* the tail replaces as many bytes at the end of the base */
+        keep = input_len < base_len ? base_len - input_len : 0;
+        if (!charge_string_bytes(position, keep + input_len, fdata)) {
+          break;
+        }
+        bytes = alloc_sized_data(keep + input_len);
+        memcpy(bytes, lookup.value.bytevec.bytes, keep);
+        decode_byte_vector(input_len, input, bytes + keep);
+        bytes[keep + input_len] = 0;
+
+        fdata->value.bytevec.nbytes = keep + input_len;
+        fdata->value.bytevec.bytes = bytes;
+      }
+      break;
+    case FieldOperatorDelta:
+      {
         FieldData fdata_temp;
-        FieldData input_str;
         FieldData lookup;
+        const guint8* input;
+        guint input_len;
         gint64 subtract;
         gint64 cut_length;
-        gint64 input_str_len;
+        guint8* bytes;
         gboolean append_to_front;
 
-        /* get the subtraction length */
+        /* get the subtraction length, nullable if the field is optional */
         basic_dissect_int64(position, &fdata_temp);
         subtract = fdata_temp.value.i64;
-
-        /* get the previous string */
-        if(!get_dictionary_value(ftype, &lookup, *src, *dest))
-        {
-          dissect_it = TRUE;
-          break;
+        if (!ftype->mandatory && 0 < subtract) {
+          subtract -= 1;
         }
 
-        /* get the input string */
-        /* ----------------------------- TODO: generalize this. */
-        vec = &input_str.value.bytevec;
-
-        /* See how big the byte vector is. */
-        dissect_value (length_node, position, dnode, src, dest);
-
-        vec->nbytes = fdata->value.u32;
+        /* borrow the base value */
+        peek_base(ftype, &lookup, src, dest);
 
-        /* Get the byte vector. */
-        position->offjmp = vec->nbytes;
+        /* See how big the input byte vector is, it is never nullable. */
+        basic_dissect_uint32 (position, fdata);
+        input_len = dissect_claim_bytes (position, fdata->value.u32);
 
-        vec->bytes = (guint8*)wmem_alloc (wmem_file_scope(), (1+vec->nbytes) * sizeof(guint8));
+        /* Skip it, it is decoded straight into the result. */
+        input = position->bytes;
+        position->offjmp = input_len;
+        ShiftBytes(position);
 
-        if (vec->bytes) {
-          decode_byte_vector (vec->nbytes, position->bytes, vec->bytes);
-          vec->bytes[vec->nbytes] = 0;
+        /* an empty previous value has nothing to apply the delta to */
+        if (FieldEmpty == lookup.status) {
+          err_d(6, fdata);
+          break;
         }
 
-        ShiftBytes(position);
-        /* --------------------------------- */
-
         /* append to front or tail? */
         append_to_front = (subtract < 0);
         if(append_to_front)
@@ -771,47 +1129,45 @@ void dissect_byte_vector (const GNode* tnode,
            * subtraction length, this is an error.
            *
            */
-          cleanup_field_value(FieldTypeByteVector, &input_str.value);
-          cleanup_field_value(FieldTypeByteVector, &lookup.value);
 	  err_d(7, fdata);
+          break;
         }
 
-        /* malloc space for new string */
+        /* one new buffer: the kept part of the borrowed previous value
+         * and the input are copied into it */
         cut_length = lookup.value.bytevec.nbytes - subtract;
-        input_str_len = input_str.value.bytevec.nbytes;
-        fdata->value.bytevec.nbytes = cut_length + input_str_len;
-        fdata->value.bytevec.bytes = (guint8 *)wmem_alloc(wmem_file_scope(), (fdata->value.bytevec.nbytes + 1)*sizeof(guint8));
+        if (!charge_string_bytes(position, (guint) cut_length + input_len,
+                                 fdata)) {
+          break;
+        }
+        bytes = alloc_sized_data(cut_length + input_len);
 
         if(append_to_front)
         {
-          /* append input string to front */
-          memcpy(fdata->value.bytevec.bytes,
-                 input_str.value.bytevec.bytes,
-                 input_str_len);
+          /* input in front */
+          decode_byte_vector(input_len, input, bytes);
 
-          /* append cut string to end */
-          memcpy(fdata->value.bytevec.bytes + input_str_len,
+          /* append cut value to end */
+          memcpy(bytes + input_len,
                  lookup.value.bytevec.bytes + subtract,
                  cut_length);
         }
         else
         {
-          /* append cut string to front */
-          memcpy(fdata->value.bytevec.bytes,
+          /* cut value in front */
+          memcpy(bytes,
                  lookup.value.bytevec.bytes,
                  cut_length);
 
-          /* append input string to end */
-          memcpy(fdata->value.bytevec.bytes + cut_length,
-                 input_str.value.bytevec.bytes,
-                 input_str_len);
+          /* append input to end */
+          decode_byte_vector(input_len, input, bytes + cut_length);
         }
 
-        /* null terminator */
-        fdata->value.bytevec.bytes[fdata->value.ascii.nbytes] = 0;
+        fdata->value.bytevec.nbytes = cut_length + input_len;
+        fdata->value.bytevec.bytes = bytes;
 
-        cleanup_field_value(FieldTypeByteVector, &input_str.value);
-        cleanup_field_value(FieldTypeByteVector, &lookup.value);
+        /* null terminator */
+        fdata->value.bytevec.bytes[fdata->value.bytevec.nbytes] = 0;
       }
       break;
     default:
@@ -825,12 +1181,12 @@ void dissect_byte_vector (const GNode* tnode,
     /* See how big the byte vector is. */
     dissect_value (length_node, position, dnode, src, dest);
 
-    vec->nbytes = fdata->value.u32;
+    vec->nbytes = dissect_claim_bytes (position, fdata->value.u32);
 
     /* Get the byte vector. */
     position->offjmp = vec->nbytes;
 
-    vec->bytes = (guint8*)wmem_alloc (wmem_file_scope(), (1+vec->nbytes) * sizeof(guint8));
+    vec->bytes = alloc_sized_data (vec->nbytes);
 
     if (vec->bytes) {
       decode_byte_vector (vec->nbytes, position->bytes, vec->bytes);
@@ -839,7 +1195,12 @@ void dissect_byte_vector (const GNode* tnode,
 
     ShiftBytes(position);
   }
-  set_dictionary_value(ftype, fdata, *src, *dest);
+  if (FieldExists == fdata->status) {
+    dissect_stats()->sized_fields++;
+  }
+  if (!position->work.exceeded) {
+    set_dictionary_value(ftype, fdata, *src, *dest);
+  }
 }
 
 
@@ -863,6 +1224,8 @@ void dissect_group (const GNode* tnode,
   dissector_walk (tnode->children, nested_position, dnode, 0, src, dest);
 
   position->offjmp = nested_position->offset - position->offset;
+  position->overrun = nested_position->overrun;
+  position->work = nested_position->work;
   ShiftBytes(position);
 }
 
@@ -888,14 +1251,121 @@ void dissect_sequence (const GNode* tnode,
   parent = dnode;
   dnode  = 0;
   for (i = 0; i < length; ++i) {
+    /* bits past a truncated PMAP are zeros, the elements may still
+     * have PMAPs and fields of their own */
     if (!position->nbytes) {
       DBG0("Sequence bailing, no space left in packet.");
       break;
     }
-    if (position->pmap_idx >= position->pmap_len) {
-      DBG0("Sequence bailing, no space left in pmap.");
+    /* elements may take no byte at all, the length alone is no bound */
+    if (position->work.exceeded) {
       break;
     }
+    position->work.elements++;
     dnode = dissect_descend (group_tnode, position, parent, dnode, src, dest);
   }
 }
+
+
+void skip_walk(const GNode* tnode, DissectPosition* position,
+               address* src, address* dest)
+{
+  for (; tnode; tnode = tnode->next) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    FieldData fdata;
+    GNode dnode;
+
+    if (FieldTypeGroup == ftype->type) {
+      skip_group(tnode, position, src, dest);
+      continue;
+    }
+
+    /* decoded into scratch data, its value only goes to the dictionary */
+    memset(&dnode, 0, sizeof(GNode));
+    dnode.data = &fdata;
+
+    if (FieldTypeSequence == ftype->type &&
+        tnode->children && tnode->children->next) {
+      guint32 i;
+
+      dissect_value(tnode->children, position, &dnode, src, dest);
+      if (FieldExists != fdata.status) {
+        continue;
+      }
+      for (i = 0; i < fdata.value.u32; ++i) {
+        if (!position->nbytes || position->work.exceeded) {
+          break;
+        }
+        /* no field holds the error of a skipped template */
+        if (budget.max_elements &&
+            ++position->work.elements > budget.max_elements) {
+          position->work.exceeded = TRUE;
+          break;
+        }
+        skip_group(tnode->children->next, position, src, dest);
+      }
+    }
+    else {
+      dissect_value(tnode, position, &dnode, src, dest);
+    }
+  }
+}
+
+
+void skip_group(const GNode* tnode, DissectPosition* position,
+                address* src, address* dest)
+{
+  DissectPosition stacked_position;
+  DissectPosition* nested_position = position;
+  const FieldType* ftype = (const FieldType*) tnode->data;
+
+  if (!ftype->mandatory && !dissect_shift_pmap(position)) {
+    return;
+  }
+
+  if (ftype->value.pmap_exists) {
+    basic_dissect_pmap(position, &stacked_position);
+    nested_position = &stacked_position;
+  }
+
+  skip_walk(tnode->children, nested_position, src, dest);
+
+  position->offjmp = nested_position->offset - position->offset;
+  position->overrun = nested_position->overrun;
+  position->work = nested_position->work;
+  ShiftBytes(position);
+}
+
+
+gboolean over_budget(const DissectPosition* position)
+{
+  return (budget.max_fields &&
+          position->work.fields >= budget.max_fields) ||
+         (budget.max_elements &&
+          position->work.elements > budget.max_elements);
+}
+
+
+gboolean charge_string_bytes(DissectPosition* position, guint nbytes,
+                             FieldData* fdata)
+{
+  if (nbytes > G_MAXUINT - position->work.string_bytes) {
+    position->work.string_bytes = G_MAXUINT;
+  }
+  else {
+    position->work.string_bytes += nbytes;
+  }
+  if (budget.max_string_bytes &&
+      position->work.string_bytes > budget.max_string_bytes) {
+    exceed_budget(position, fdata);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+void exceed_budget(DissectPosition* position, FieldData* fdata)
+{
+  err_d(ErrDBudget, fdata);
+  position->work.exceeded = TRUE;
+}
@@ -34,6 +34,52 @@
 #include "basic-dissect.h"
 #include "address-utils.h"
 
+/*! \brief  Default work budget of a packet, far above a sane packet. */
+#define BudgetMaxFields       100000
+#define BudgetMaxElements     50000
+#define BudgetMaxStringBytes  (1 << 20)
+
+/*! \brief  Most work a single packet may cost, 0 for no limit.
+ *          A packet over its budget gets an [ERR BUDGET] field where it
+ *          went over, the rest of it is not decoded and the dictionary
+ *          stores of the message that went over are undone.
+ */
+struct dissect_budget_struct
+{
+  guint max_fields;        /* fields, sequence elements included */
+  guint max_elements;      /* sequence elements */
+  guint max_string_bytes;  /* bytes of the delta and tail strings built */
+};
+typedef struct dissect_budget_struct DissectBudget;
+
+/*! \brief  Set the work budget of every packet dissected from now on.
+ * \param budget  Limits, copied.
+ */
+void dissect_set_budget (const DissectBudget* budget);
+
+/*! \brief  Choose where the data trees are allocated.
+ *          The plugin keeps them with the capture file so a packet can
+ *          be displayed again. A headless decoder drops every tree once
+ *          it was consumed and passes the packet scope.
+ * \param scope  Allocator of the data trees, NULL for the capture file.
+ */
+void dissect_set_tree_scope (wmem_allocator_t* scope);
+
+/*! \brief  Forget the template id of the previous message, a message
+ *          without one in the next capture file has no template.
+ */
+void dissect_reset (void);
+
+/*! \brief  Template id of the previous message, the one a message
+ *          without a template id is dissected with.
+ */
+guint32 dissect_template_id (void);
+
+/*! \brief  Set the template id of the previous message, to restore it
+ *          after a trial decode.
+ */
+void dissect_set_template_id (guint32 id);
+
 /*! \brief Dissect a FAST message by the bytes.
  * \param position  Current position in bytes.
  * \param parent  Return value. The message data is built under it.
@@ -89,6 +135,16 @@ void dissect_optional (const GNode* tnode,
 gboolean dissect_copy (const GNode* tnode,
                        DissectPosition* position, GNode* dnode, address* src, address* dest);
 
+/*! \brief Given a byte stream with a tail operator, take the previous
+ *            value if no tail is sent
+ * \param tnode  Template tree node.
+ * \param position  Position in the packet.
+ * \param dnode  Dissect tree node.
+ * \return true if the tail operator is used, false if a tail follows
+ */
+gboolean dissect_tail (const GNode* tnode,
+                       DissectPosition* position, GNode* dnode, address* src, address* dest);
+
 /*! \brief Given a byte stream with a default operator, dissect it
  *            if it is used
  * \param tnode  Template tree node.
@@ -22,43 +22,116 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <wsutil/report_err.h>
 
+/*! \brief Occurrences of an error written out before it is only counted */
+#define LOG_REPEAT_LIMIT 10
+/*! \brief Records written per second at most, across all errors */
+#define LOG_RATE_LIMIT 100
+
+#define LOG_BANNER "**********************************************************************"
+
 static gboolean config_display_dialogs;
 static gboolean config_log_to_file;
 static const char* config_log_file_name;
 
-void fast_log_dynamic_error(const FieldType* ftype, const FieldData* fdata)
+static FILE* log_file = NULL;
+static gchar* log_file_opened = NULL;  /* name log_file was opened with */
+static GHashTable* error_counts = NULL;
+static time_t rate_second = 0;
+static guint rate_count = 0;
+
+/*! \brief  Open the log file once, it stays open between errors.
+ *  \return The log file, NULL if not logging to a file.
+ */
+static FILE* get_log_file (void);
+
+/*! \brief  Close the log file, flushing pending records.
+ */
+static void close_log_file (void);
+
+/*! \brief  Take a record from the per second budget.
+ *  \return FALSE if the budget of the current second is used up.
+ */
+static gboolean rate_allows (void);
+
+static guint error_count_hash (gconstpointer key);
+static gboolean error_count_equal (gconstpointer a, gconstpointer b);
+
+ErrorCount* fast_log_dynamic_error(const FieldType* ftype, const FieldData* fdata)
 {
+  ErrorCount lookup;
+  ErrorCount* count;
+  const char* message = (const char*) fdata->value.ascii.bytes;
   time_t ltime;
   FILE *log;
 
-  /* get current cal time */
-  ltime=time(NULL);
+  if (!error_counts) {
+    error_counts = g_hash_table_new_full(error_count_hash, error_count_equal,
+                                         g_free, NULL);
+  }
+
+  /* aggregate by (error code, template, field) */
+  lookup.code = fdata->error;
+  lookup.tid = ftype->tid;
+  lookup.field_id = ftype->id;
+  count = (ErrorCount*) g_hash_table_lookup(error_counts, &lookup);
+  if (!count) {
+    count = g_new0(ErrorCount, 1);
+    count->code = lookup.code;
+    count->tid = lookup.tid;
+    count->field_id = lookup.field_id;
+    count->field_name = ftype->name;
+    g_hash_table_insert(error_counts, count, count);
+  }
+  count->seen++;
+
+  if (count->seen > LOG_REPEAT_LIMIT || !rate_allows()) {
+    count->suppressed++;
+    return count;
+  }
 
   /* write error log to a string */
   fprintf(stderr,
           "%s\n\nField Name:\t%s\nField ID:\t%d\nTemplate ID:\t%d\n\n%s\n",
-          fdata->value.ascii.bytes,     /* error message  */
+          message,                      /* error message  */
           ftype->name,                  /* field name     */
           ftype->id,                    /* field id       */
           ftype->tid,                   /* template id    */
-          "**********************************************************************");
+          LOG_BANNER);
+  if (count->seen == LOG_REPEAT_LIMIT) {
+    fprintf(stderr, "Further occurrences of this error are only counted.\n");
+  }
 
   /* write error log to file if user preference is set */
-  if(config_log_to_file) {
-    log = fopen(config_log_file_name, "a");
+  log = get_log_file();
+  if(log) {
+    ltime = time(NULL);
     fprintf(log,
             "%s\n%s\n\nField Name:\t%s\nField ID:\t%d\nTemplate ID:\t%d\n\n%s\n",
             asctime(localtime(&ltime)),   /* time stamp     */
-            fdata->value.ascii.bytes,     /* error message  */
+            message,                      /* error message  */
             ftype->name,                  /* field name     */
             ftype->id,                    /* field id       */
             ftype->tid,                   /* template id    */
-            "**********************************************************************");
-    fclose(log);
+            LOG_BANNER);
+  }
+  return count;
+}
+
+const ErrorCount* fast_error_count(const FieldType* ftype, const FieldData* fdata)
+{
+  ErrorCount lookup;
+
+  if (!error_counts) {
+    return NULL;
   }
+  lookup.code = fdata->error;
+  lookup.tid = ftype->tid;
+  lookup.field_id = ftype->id;
+  return (const ErrorCount*) g_hash_table_lookup(error_counts, &lookup);
 }
 
 void fast_log_static_error(int err_no, int line, const char* extra_error_info)
@@ -105,28 +178,123 @@ void fast_log_static_error(int err_no, int line, const char* extra_error_info)
           err,
           line_string,
           extra_error_info,
-          "**********************************************************************");
+          LOG_BANNER);
 
-  /* write error message to file if user preference is set */
-  if(config_log_to_file){
-    log = fopen(config_log_file_name, "a");
+  /* write error message to file if user preference is set,
+   * template errors are rare, flush them right away */
+  log = get_log_file();
+  if(log){
     fprintf(log,
             "%s\n%s\n%s%s\n%s\n",
             asctime(localtime(&ltime)),
             err,
             line_string,
             extra_error_info,
-            "**********************************************************************");
-    fclose(log);
+            LOG_BANNER);
+    fflush(log);
   }
 
   g_free(line_string);
 }
 
+void fast_log_summary(void)
+{
+  GHashTableIter iter;
+  gpointer key;
+  FILE* log;
+  const char* message;
+  int label;
+
+  if (!error_counts) {
+    return;
+  }
+
+  log = get_log_file();
+  g_hash_table_iter_init(&iter, error_counts);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    const ErrorCount* count = (const ErrorCount*) key;
+    if (!count->suppressed) {
+      continue;
+    }
+    /* the [ERR ...] label of the message */
+    message = err_d_message(count->code);
+    label = (int) (strchr(message, ']') - message) + 1;
+    fprintf(stderr,
+            "%.*s on field %s (%d) of template %d: %" G_GINT64_MODIFIER "u occurrences, %" G_GINT64_MODIFIER "u not shown\n",
+            label, message, count->field_name ? count->field_name : "",
+            count->field_id, count->tid, count->seen, count->suppressed);
+    if (log) {
+      fprintf(log,
+              "%.*s on field %s (%d) of template %d: %" G_GINT64_MODIFIER "u occurrences, %" G_GINT64_MODIFIER "u not shown\n",
+              label, message, count->field_name ? count->field_name : "",
+              count->field_id, count->tid, count->seen, count->suppressed);
+    }
+  }
+  if (log) {
+    fflush(log);
+  }
+
+  g_hash_table_remove_all(error_counts);
+}
+
 void fast_set_log_settings(gboolean display, gboolean log, const gchar* log_file_name) {
   config_display_dialogs = display;
   config_log_to_file = log;
   config_log_file_name = log_file_name;
 
+  /* reopened with the new settings on the next error */
+  close_log_file();
+
   fprintf(stderr, "output log file: %s\n", config_log_file_name);
 }
+
+FILE* get_log_file (void)
+{
+  if (!config_log_to_file || !config_log_file_name || !config_log_file_name[0]) {
+    return NULL;
+  }
+  if (log_file && g_strcmp0(log_file_opened, config_log_file_name) != 0) {
+    close_log_file();
+  }
+  if (!log_file) {
+    log_file = fopen(config_log_file_name, "a");
+    if (log_file) {
+      log_file_opened = g_strdup(config_log_file_name);
+    }
+  }
+  return log_file;
+}
+
+void close_log_file (void)
+{
+  if (log_file) {
+    fclose(log_file);
+    log_file = NULL;
+  }
+  g_free(log_file_opened);
+  log_file_opened = NULL;
+}
+
+gboolean rate_allows (void)
+{
+  time_t now = time(NULL);
+
+  if (now != rate_second) {
+    rate_second = now;
+    rate_count = 0;
+  }
+  return rate_count++ < LOG_RATE_LIMIT;
+}
+
+guint error_count_hash (gconstpointer key)
+{
+  const ErrorCount* count = (const ErrorCount*) key;
+  return (guint) count->code * 31u * 31u + (guint) count->tid * 31u + (guint) count->field_id;
+}
+
+gboolean error_count_equal (gconstpointer a, gconstpointer b)
+{
+  const ErrorCount* ca = (const ErrorCount*) a;
+  const ErrorCount* cb = (const ErrorCount*) b;
+  return ca->code == cb->code && ca->tid == cb->tid && ca->field_id == cb->field_id;
+}
@@ -31,11 +31,35 @@
  */
 void fast_set_log_settings(gboolean display, gboolean log, const gchar* log_file_name);
 
+/*! \brief Occurrences of one dynamic error on one field, counted until
+ *         fast_log_summary.
+ */
+struct error_count_struct
+{
+  int code;           /* n of [ERR Dn] */
+  int tid;
+  int field_id;
+  const char* field_name;
+  guint64 seen;
+  guint64 suppressed;
+  guint32 first_frame;  /* frames of the capture, kept by the caller */
+  guint32 last_frame;
+};
+typedef struct error_count_struct ErrorCount;
+
 /*! \brief log a dynamic error that has occurred
 *  \param ftype field type for the field that caused the error
 *  \param fdata field data for the field that caused the error
+*  \return the count of this error on this field, this one included
+*/
+ErrorCount* fast_log_dynamic_error(const FieldType* ftype, const FieldData* fdata);
+
+/*! \brief the count of a dynamic error on a field
+*  \param ftype field type for the field that caused the error
+*  \param fdata field data for the field that caused the error
+*  \return NULL if it was not logged since the last summary
 */
-void fast_log_dynamic_error(const FieldType* ftype, const FieldData* fdata);
+const ErrorCount* fast_error_count(const FieldType* ftype, const FieldData* fdata);
 
 /*! \brief log a static error that has occurred
 *  \param ftype field type for the field that caused the error
@@ -43,4 +67,9 @@ void fast_log_dynamic_error(const FieldType* ftype, const FieldData* fdata);
 */
 void fast_log_static_error(int type, int line, const char* extra_error_info);
 
+/*! \brief write how often each dynamic error occurred beyond what was logged,
+ *         then start counting afresh. Called at the end of a capture.
+ */
+void fast_log_summary(void);
+
 #endif
@@ -0,0 +1,271 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file feed-header.c
+ * \brief  Exchange specific packet headers and sequence tracking.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "debug.h"
+#include "feed-header.h"
+
+static guint32 get_be32 (const guint8* p);
+static guint32 get_le32 (const guint8* p);
+static guint16 get_be16 (const guint8* p);
+static void seq_window_advance (SeqTracker* tracker, guint32 seq);
+
+static const char* seq_verdict_names[SeqVerdictEnumLimit] =
+{
+  "In order",
+  "First",
+  "Gap",
+  "Duplicate",
+  "Out of order",
+  "Reset"
+};
+
+guint8 feed_flavor_by_name (const char* name)
+{
+  if (!g_ascii_strcasecmp(name, "generic")) {
+    return GenericImplem;
+  }
+  if (!g_ascii_strcasecmp(name, "cme")) {
+    return CMEImplem;
+  }
+  if (!g_ascii_strcasecmp(name, "umdf")) {
+    return UMDFImplem;
+  }
+  if (!g_ascii_strcasecmp(name, "moex")) {
+    return MOEXImplem;
+  }
+  return NImplem;
+}
+
+guint feed_header_length (guint8 flavor)
+{
+  switch (flavor) {
+    case CMEImplem:
+      return 5;
+    case UMDFImplem:
+      return 10;
+    case MOEXImplem:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+gboolean parse_feed_header (guint8 flavor, const guint8* bytes, guint nbytes,
+                            FeedHeader* header)
+{
+  memset(header, 0, sizeof(FeedHeader));
+  header->nbytes = feed_header_length(flavor);
+
+  if (nbytes < header->nbytes) {
+    return FALSE;
+  }
+
+  switch (flavor) {
+    case CMEImplem:
+      /* 4 byte big endian sequence number, 1 byte sub-channel */
+      header->has_seq    = TRUE;
+      header->seq_num    = get_be32(bytes);
+      header->subchannel = bytes[4];
+      break;
+    case UMDFImplem:
+      /* sequence number, number of chunks, current chunk, chunk length */
+      header->has_seq   = TRUE;
+      header->seq_num   = get_be32(bytes);
+      header->chunks    = get_be16(bytes + 4);
+      header->cur_chunk = get_be16(bytes + 6);
+      header->msg_len   = get_be16(bytes + 8);
+      break;
+    case MOEXImplem:
+      /* 4 byte little endian sequence number */
+      header->has_seq = TRUE;
+      header->seq_num = get_le32(bytes);
+      break;
+    default:
+      break;
+  }
+  return TRUE;
+}
+
+void seq_tracker_init (SeqTracker* tracker)
+{
+  memset(tracker, 0, sizeof(SeqTracker));
+}
+
+SeqVerdict seq_tracker_update (SeqTracker* tracker, guint32 seq,
+                               gboolean continuation, guint32* delta)
+{
+  guint32 back;
+
+  *delta = 0;
+  tracker->packets++;
+
+  if (!tracker->started) {
+    tracker->started = TRUE;
+    tracker->highest = seq;
+    tracker->window  = 1;
+    return SeqFirst;
+  }
+
+  if (seq > tracker->highest) {
+    guint32 missing = seq - tracker->highest - 1;
+    seq_window_advance(tracker, seq);
+    if (missing == 0) {
+      return SeqInOrder;
+    }
+    tracker->gaps++;
+    tracker->missing += missing;
+    *delta = missing;
+    return SeqGap;
+  }
+
+  if (seq == tracker->highest && continuation) {
+    return SeqInOrder;
+  }
+
+  back = tracker->highest - seq;
+  *delta = back;
+
+  if (back < SEQ_WINDOW_BITS) {
+    guint64 bit = G_GUINT64_CONSTANT(1) << back;
+    if (tracker->window & bit) {
+      tracker->duplicates++;
+      return SeqDuplicate;
+    }
+    tracker->window |= bit;
+  }
+  else if (seq <= 1) {
+    /* numbering starts over, typically a session restart */
+    tracker->resets++;
+    tracker->highest = seq;
+    tracker->window  = 1;
+    *delta = 0;
+    return SeqReset;
+  }
+
+  /* too old to be told from a duplicate, assume it fills a gap */
+  tracker->out_of_order++;
+  if (tracker->missing) {
+    tracker->missing--;
+  }
+  return SeqOutOfOrder;
+}
+
+const char* seq_verdict_name (SeqVerdict verdict)
+{
+  if (verdict >= SeqVerdictEnumLimit) {
+    return "Unknown";
+  }
+  return seq_verdict_names[verdict];
+}
+
+/*! \brief  Move the window of seen sequence numbers to a new highest.
+ * \param tracker  Channel state.
+ * \param seq  New highest sequence number.
+ */
+void seq_window_advance (SeqTracker* tracker, guint32 seq)
+{
+  guint32 shift = seq - tracker->highest;
+  if (shift >= SEQ_WINDOW_BITS) {
+    tracker->window = 0;
+  } else {
+    tracker->window <<= shift;
+  }
+  tracker->window |= 1;
+  tracker->highest = seq;
+}
+
+void line_arbiter_init (LineArbiter* arbiter)
+{
+  memset(arbiter, 0, sizeof(LineArbiter));
+}
+
+gboolean line_arbiter_update (LineArbiter* arbiter, const FeedHeader* header,
+                              guint8 line, guint32 frame, gint64 ts,
+                              ArbiterSlot* first)
+{
+  ArbiterSlot* slot =
+    &arbiter->slots[(header->seq_num + header->cur_chunk) % ARBITER_WINDOW];
+
+  if (slot->used &&
+      slot->seq_num == header->seq_num &&
+      slot->chunk == header->cur_chunk) {
+    *first = *slot;
+    arbiter->duplicates++;
+    return FALSE;
+  }
+
+  /* older packets drop out of the ring as newer ones take their slot */
+  slot->used    = TRUE;
+  slot->seq_num = header->seq_num;
+  slot->chunk   = header->cur_chunk;
+  slot->line    = line;
+  slot->frame   = frame;
+  slot->ts      = ts;
+  if (line < LineEnumLimit) {
+    arbiter->first[line]++;
+  }
+  return TRUE;
+}
+
+const char* feed_line_name (guint8 line)
+{
+  switch (line) {
+    case LineA:
+      return "A";
+    case LineB:
+      return "B";
+    default:
+      return "-";
+  }
+}
+
+guint32 get_be32 (const guint8* p)
+{
+  return ((guint32)p[0] << 24) | ((guint32)p[1] << 16) |
+         ((guint32)p[2] << 8)  |  (guint32)p[3];
+}
+
+guint32 get_le32 (const guint8* p)
+{
+  return ((guint32)p[3] << 24) | ((guint32)p[2] << 16) |
+         ((guint32)p[1] << 8)  |  (guint32)p[0];
+}
+
+guint16 get_be16 (const guint8* p)
+{
+  return (guint16)(((guint16)p[0] << 8) | p[1]);
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * tab-width: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,185 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file feed-header.h
+ * \brief  Exchange specific packet headers and sequence tracking.
+ *  Parses the headers that CME, UMDF and MOEX put in front of the
+ *  FAST encoded messages and keeps track of the packet sequence
+ *  numbers of a channel. Independent of Wireshark.
+ */
+
+#ifndef FEED_HEADER_H_INCLUDED_
+#define FEED_HEADER_H_INCLUDED_
+
+#include <glib.h>
+
+/*! \brief Application protocol (exchange flavor) of a channel.
+ */
+enum ProtocolImplem { GenericImplem, CMEImplem, UMDFImplem, MOEXImplem, NImplem };
+
+/*! \brief Decoded exchange packet header.
+ */
+struct feed_header_struct
+{
+  guint    nbytes;      /*!< Header length, FAST messages start after it. */
+  gboolean has_seq;     /*!< TRUE if the flavor carries a sequence number. */
+  guint32  seq_num;     /*!< Packet sequence number. */
+  guint8   subchannel;  /*!< CME sub-channel. */
+  guint16  chunks;      /*!< UMDF number of chunks of the message. */
+  guint16  cur_chunk;   /*!< UMDF chunk carried by this packet. */
+  guint16  msg_len;     /*!< UMDF length of the chunk. */
+};
+typedef struct feed_header_struct FeedHeader;
+
+/*! \brief Verdict on the sequence number of a packet.
+ */
+enum seq_verdict_enum
+{
+  SeqInOrder,     /*!< Exactly the expected sequence number. */
+  SeqFirst,       /*!< First packet seen on the channel. */
+  SeqGap,         /*!< Jumped ahead, some packets are missing. */
+  SeqDuplicate,   /*!< Sequence number has already been seen. */
+  SeqOutOfOrder,  /*!< Late packet that fills an earlier gap. */
+  SeqReset,       /*!< Channel restarted its numbering. */
+  SeqVerdictEnumLimit
+};
+typedef enum seq_verdict_enum SeqVerdict;
+
+/*! \brief Number of recent sequence numbers remembered to tell
+ *         duplicates from late packets.
+ */
+#define SEQ_WINDOW_BITS 64
+
+/*! \brief Sequence state of one channel, fixed size.
+ */
+struct seq_tracker_struct
+{
+  gboolean started;
+  guint32  highest;    /*!< Highest sequence number seen. */
+  guint64  window;     /*!< Bit i set if (highest - i) was seen. */
+  guint64  packets;
+  guint64  gaps;
+  guint64  missing;    /*!< Packets still not received. */
+  guint64  duplicates;
+  guint64  out_of_order;
+  guint64  resets;
+};
+typedef struct seq_tracker_struct SeqTracker;
+
+/*! \brief Line of a feed published twice (A/B lines).
+ */
+enum FeedLine { LineNone, LineA, LineB, LineEnumLimit };
+
+/*! \brief Number of recent packets remembered by an arbiter.
+ */
+#define ARBITER_WINDOW 4096
+
+/*! \brief First arrival of a packet on any line of a feed.
+ */
+struct arbiter_slot_struct
+{
+  gboolean used;
+  guint32  seq_num;
+  guint16  chunk;
+  guint8   line;    /*!< One of FeedLine. */
+  guint32  frame;   /*!< Frame number of the first arrival. */
+  gint64   ts;      /*!< Arrival time in nanoseconds. */
+};
+typedef struct arbiter_slot_struct ArbiterSlot;
+
+/*! \brief A/B arbitration state of a feed, fixed size ring.
+ */
+struct line_arbiter_struct
+{
+  ArbiterSlot slots[ARBITER_WINDOW];
+  guint64 first[LineEnumLimit];  /*!< Packets won by each line. */
+  guint64 duplicates;
+};
+typedef struct line_arbiter_struct LineArbiter;
+
+/*! \brief  Flavor from its name, as given on a command line.
+ * \param name  generic, cme, umdf or moex, in any case.
+ * \return  One of ProtocolImplem, NImplem if the name is unknown.
+ */
+guint8 feed_flavor_by_name (const char* name);
+
+/*! \brief  Length of the packet header of an exchange flavor.
+ * \param flavor  One of ProtocolImplem.
+ * \return  Number of bytes preceding the first FAST message.
+ */
+guint feed_header_length (guint8 flavor);
+
+/*! \brief  Parse the packet header of an exchange flavor.
+ * \param flavor  One of ProtocolImplem.
+ * \param bytes  Start of the packet.
+ * \param nbytes  Length of the packet.
+ * \param header  Return value.
+ * \return  FALSE if the packet is too short for the header.
+ */
+gboolean parse_feed_header (guint8 flavor, const guint8* bytes, guint nbytes,
+                            FeedHeader* header);
+
+/*! \brief  Reset a sequence tracker.
+ * \param tracker  Tracker to reset.
+ */
+void seq_tracker_init (SeqTracker* tracker);
+
+/*! \brief  Account a sequence number received on a channel.
+ * \param tracker  Channel state.
+ * \param seq  Received sequence number.
+ * \param continuation  TRUE if the packet continues the message of
+ *                      the previous one (UMDF chunks share a number).
+ * \param delta  Return value. Number of missing packets for SeqGap,
+ *               distance behind the highest number otherwise.
+ * \return  Verdict for the packet.
+ */
+SeqVerdict seq_tracker_update (SeqTracker* tracker, guint32 seq,
+                               gboolean continuation, guint32* delta);
+
+/*! \brief  Name of a sequence verdict.
+ * \param verdict  The verdict.
+ * \return  Printable name.
+ */
+const char* seq_verdict_name (SeqVerdict verdict);
+
+/*! \brief  Reset an arbiter.
+ * \param arbiter  Arbiter to reset.
+ */
+void line_arbiter_init (LineArbiter* arbiter);
+
+/*! \brief  Arbitrate a packet received on one line of a feed.
+ * \param arbiter  Feed state.
+ * \param header  Parsed header, must carry a sequence number.
+ * \param line  Line the packet was received on.
+ * \param frame  Frame number of the packet.
+ * \param ts  Arrival time in nanoseconds.
+ * \param first  Return value. First arrival if this one is a duplicate.
+ * \return  TRUE if this is the first arrival of the packet.
+ */
+gboolean line_arbiter_update (LineArbiter* arbiter, const FeedHeader* header,
+                              guint8 line, guint32 frame, gint64 ts,
+                              ArbiterSlot* first);
+
+/*! \brief  Name of a feed line.
+ * \param line  One of FeedLine.
+ * \return  Printable name.
+ */
+const char* feed_line_name (guint8 line);
+
+#endif
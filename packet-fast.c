@@ -43,14 +43,25 @@
 #include <epan/column-info.h>
 #include <epan/conversation.h>
 #include <epan/uat.h>
+#include <epan/expert.h>
+#include <epan/tap.h>
+#include <epan/stats_tree.h>
+#include <epan/to_str.h>
+#include <epan/range.h>
+#include <epan/dissectors/packet-tcp.h>
 
 #include "debug.h"
 #include "dissect.h"
+#include "decode.h"
 #include "parse-template.h"
 #include "template.h"
 #include "dictionaries.h"
 #include "debug-tree.h"
 #include "error_log.h"
+#include "feed-header.h"
+#include "book.h"
+#include "recovery.h"
+#include "channel-config.h"
 
 #include "wmem_aux.h"
 
@@ -63,6 +74,13 @@ typedef struct _fast_port_item_t {
   guint  port;
   guint8 flavor;
   gchar* template_file;
+  gchar* feed_group;
+  guint8 line;
+  guint8 recovery_role;
+  gchar* market;
+  guint8 framing;
+  gchar* group;
+  guint  last_port;
 } fast_uat_item_t;
 
 typedef struct _fast_templates_storage
@@ -70,15 +88,93 @@ typedef struct _fast_templates_storage
   gchar*      filename;
   GNode*      templates;
   wmem_map_t* templates_table;
+  wmem_map_t* book_roles;
+  wmem_map_t* recovery_fields;
   gboolean    used;
+  guint       probed_flavors; /* flavors of the heuristic probes, bitmask */
 } fast_templates_storage_t;
 
+/* Book field names of a template file */
+typedef struct _fast_book_uat_item_t {
+  gchar* template_file;
+  gchar* security_id;
+  gchar* entry_type;
+  gchar* update_action;
+  gchar* price;
+  gchar* size;
+  gchar* price_level;
+} fast_book_uat_item_t;
+
+/* Recovery field names of a template file */
+typedef struct _fast_recovery_uat_item_t {
+  gchar* template_file;
+  gchar* security_id;
+  gchar* rpt_seq;
+  gchar* last_msg_seq;
+} fast_recovery_uat_item_t;
+
+/* Everything configured for a port, built from the UAT */
+typedef struct _fast_channel
+{
+  fast_templates_storage_t* stor;
+  guint8 flavor;
+  gchar* feed_group;
+  guint8 line;
+  guint8 recovery_role;
+  gchar* market;
+  guint8 framing;
+} fast_channel_t;
+
 typedef struct _fast_conversation_data
 {
   guint8 flavor;
   wmem_map_t* templates_table;
+  SeqTracker  seq;            /* packet sequence state of the channel */
+  wmem_tree_t* seq_anomalies; /* frame number -> fast_seq_anomaly_t */
+  guint8 line;                /* A/B line of the feed, if arbitrated */
+  LineArbiter* arbiter;       /* shared by all lines of the feed group */
+  wmem_tree_t* arb_duplicates; /* frame number -> fast_arb_duplicate_t */
+  wmem_map_t* book_roles;     /* NULL unless order books are built */
+  guint8 recovery_role;       /* snapshot or incremental channel */
+  RecoveryMarket* market;     /* shared by the channels of the market */
+  wmem_map_t* recovery_fields;
+  guint8 framing;             /* how messages are delimited on TCP */
 } fast_conversation_data_t;
 
+/* Packet already received on another line of the feed */
+typedef struct _fast_arb_duplicate
+{
+  guint32  first_frame;
+  guint8   first_line;
+  nstime_t delta;
+} fast_arb_duplicate_t;
+
+/* Sequence verdict of a frame, only stored for anomalous frames */
+typedef struct _fast_seq_anomaly
+{
+  SeqVerdict verdict;
+  guint32    delta;
+} fast_seq_anomaly_t;
+
+/* Probe of an unknown flow against the configured channels */
+typedef struct _fast_heur_probe
+{
+  tvbuff_t*    tvb;
+  packet_info* pinfo;
+  const fast_channel_t* match;
+} fast_heur_probe_t;
+
+/* Data handed to the "fast" tap for every sequenced packet */
+typedef struct _fast_seq_tap_info
+{
+  guint8     flavor;
+  guint32    seq_num;
+  SeqVerdict verdict;
+  guint32    delta;
+  guint8     line;
+  gboolean   arb_duplicate;
+} fast_seq_tap_info_t;
+
 /* Checks to see if a particular packet information element is needed for the packet list */
 #define CHECK_COL(cinfo, el) \
   /* We are constructing columns, and they're writable */ \
@@ -89,15 +185,73 @@ typedef struct _fast_conversation_data
 
 static const char* UNNAMED = "unnamed";
 
+static const value_string fast_line_vals[] = {
+  { LineNone, "None" },
+  { LineA, "A" },
+  { LineB, "B" },
+  { 0, NULL }
+};
+
 /*! Global id of our protocol plugin used by Wireshark. */
 static int proto_fast = -1;
 /* Initialize the protocol and registered fields. */
 static int hf_fast[FieldTypeEnumLimit];
 static int hf_fast_tid        = -1;
+static int hf_fast_header     = -1;
+static int hf_fast_seq_num    = -1;
+static int hf_fast_subchannel = -1;
+static int hf_fast_chunks     = -1;
+static int hf_fast_cur_chunk  = -1;
+static int hf_fast_chunk_len  = -1;
+static int hf_fast_seq_missing = -1;
+static int hf_fast_line       = -1;
+static int hf_fast_arb_first  = -1;
+static int hf_fast_arb_delta  = -1;
+static int hf_fast_book             = -1;
+static int hf_fast_book_security_id = -1;
+static int hf_fast_book_bid         = -1;
+static int hf_fast_book_bid_size    = -1;
+static int hf_fast_book_ask         = -1;
+static int hf_fast_book_ask_size    = -1;
+static int hf_fast_book_spread      = -1;
+static int hf_fast_book_depth       = -1;
+static int hf_fast_decimal_value    = -1;
+static int hf_fast_error_code  = -1;
+static int hf_fast_error_count = -1;
+static int hf_fast_error_first = -1;
+static int hf_fast_error_last  = -1;
+static int hf_fast_recovery          = -1;
+static int hf_fast_recovery_applied  = -1;
+static int hf_fast_recovery_buffered = -1;
+static int hf_fast_recovery_stale    = -1;
+static int hf_fast_recovery_synced   = -1;
+static int hf_fast_recovery_replayed = -1;
+static int hf_fast_recovery_latency  = -1;
+static int hf_fast_recovery_last_msg_seq = -1;
+static int hf_fast_recovery_market_latency = -1;
+static int hf_fast_block_len = -1;
 static gboolean message_error = FALSE;
 
 /* Initialize the subtree pointer. */
 static gint ett_fast = -1;
+static gint ett_fast_header = -1;
+static gint ett_fast_book = -1;
+static gint ett_fast_recovery = -1;
+static gint ett_fast_error = -1;
+
+static expert_field ei_fast_seq_gap = EI_INIT;
+static expert_field ei_fast_seq_dup = EI_INIT;
+static expert_field ei_fast_seq_ooo = EI_INIT;
+static expert_field ei_fast_seq_reset = EI_INIT;
+static expert_field ei_fast_recovery_sync = EI_INIT;
+static expert_field ei_fast_recovery_gap = EI_INIT;
+static expert_field ei_fast_recovery_market = EI_INIT;
+static expert_field ei_fast_stream_overlong = EI_INIT;
+static expert_field ei_fast_err_d[ErrDCount] =
+  { EI_INIT, EI_INIT, EI_INIT, EI_INIT, EI_INIT, EI_INIT, EI_INIT, EI_INIT, EI_INIT, EI_INIT };
+
+static int fast_tap = -1;
+static int fast_errors_tap = -1;
 
 
 /****** Preference controls ******/
@@ -117,19 +271,77 @@ static gboolean showFieldMandatoriness = 0;
 static gboolean config_show_dialog_windows = 1;
 static gboolean config_log_errors = 1;
 static const char* config_log_file_name = NULL;
+static const char* config_cme_file = NULL;
+static const char* config_cme_templates = NULL;
+static range_t* config_skip_templates = NULL;
 static uat_t   *config_port_list_uat = NULL;
+/*! Work budget of a packet, a limit of 0 is none */
+static guint config_max_fields = BudgetMaxFields;
+static guint config_max_elements = BudgetMaxElements;
+static guint config_max_string_bytes = BudgetMaxStringBytes;
+/*! Longest message of a TCP stream, a limit of 0 is none */
+#define FAST_MAX_STREAM_MESSAGE (1 << 16)
+static guint config_max_stream_message = FAST_MAX_STREAM_MESSAGE;
+/*! Build order books from the decoded messages */
+static gboolean config_books_enabled = 0;
+static fast_book_uat_item_t* fast_book_uats = NULL;
+static guint            config_n_book_items = 0;
+static uat_t   *config_book_fields_uat = NULL;
+static fast_recovery_uat_item_t* fast_recovery_uats = NULL;
+static guint            config_n_recovery_items = 0;
+static uat_t   *config_recovery_fields_uat = NULL;
 
-enum ProtocolImplem { GenericImplem, CMEImplem, UMDFImplem, MOEXImplem, NImplem };
 enum Protocol { UDPImplem, TCPImplem, NOImplem };
 
+/* How FAST messages are delimited on a TCP stream. Block lengths are the
+ * stop bit encoded uInt32 preamble of FAST Session Control Protocol feeds.
+ */
+enum Framing { FramingNone, FramingBlockLength, FramingStopBit };
+
+/*! Framing of the imported CME TCP channels */
+static gint config_cme_framing = FramingBlockLength;
+
+static dissector_handle_t fast_handle = NULL;
 static wmem_map_t* templates_map = NULL;
-static wmem_map_t* port_map = NULL;
+static ChannelIndex* channel_index = NULL;
+static wmem_list_t* probe_channels = NULL; /* one per template file and flavor */
+static guint8 registered_ports[NOImplem][65536 / 8];
+/*! Line arbiters by feed group name, file scope. */
+static wmem_map_t* arbiters_map = NULL;
+/*! Order books of the capture, file scope. */
+static BookSet* book_set = NULL;
+/*! Recovery state by market name, file scope. */
+static wmem_map_t* markets_map = NULL;
+
+/*! Flows the heuristic gave up on, conversation -> packets probed. */
+static wmem_map_t* heur_verdicts = NULL;
+
+/*! Packets of a flow probed before it is taken as not FAST. */
+#define FAST_HEUR_TRIES 3
+/*! Bytes of a packet trial decoded by the heuristic. */
+#define FAST_HEUR_PROBE_BYTES 256
+/*! Longest PMAP the heuristic accepts. */
+#define FAST_HEUR_MAX_PMAP 8
+
+/* PDUs and messages of the frame being dissected, TCP can hand over
+ * several PDUs in one frame */
+static guint32 frame_pdu = 0;
+static guint   frame_messages = 0;
+
+/*! Most books a single packet can report. */
+#define FAST_MAX_BOOK_TOPS 64
 
 struct packet_data_struct
 {
   wmem_list_t* dataTrees;
   wmem_list_t* tmplTrees;
   guint32 frameNum;
+  BookTop* bookTops;   /* top of the books touched by this packet */
+  guint    nBookTops;
+  RecoveryMarks* recovery; /* NULL unless the packet moved recovery state */
+  wmem_list_t* errors;     /* ErrorCount hit, NULL if none */
+  gboolean streamTruncated; /* last message continues in the next segment */
+  guint32  streamEnd;       /* offset of that message */
 };
 typedef struct packet_data_struct packet_data_t;
 
@@ -137,19 +349,85 @@ typedef struct packet_data_struct packet_data_t;
 /*** Forward declarations. ***/
 
 static int dissect_fast (tvbuff_t*, packet_info*, proto_tree*, void*);
+static gboolean dissect_fast_heur (tvbuff_t*, packet_info*, proto_tree*, void*);
+static fast_conversation_data_t* get_conversation_data (packet_info* pinfo);
+static fast_conversation_data_t* new_conversation_data (conversation_t* conversation,
+                                                        const fast_channel_t* channel);
+static void probe_channel (gpointer value, gpointer user_data);
+static gboolean probe_messages (tvbuff_t* tvb, packet_info* pinfo,
+                                const fast_channel_t* channel);
+static guint get_fast_block_len (packet_info* pinfo, tvbuff_t* tvb,
+                                 int offset, void* data);
+static int dissect_fast_block (tvbuff_t* tvb, packet_info* pinfo,
+                               proto_tree* tree, void* data);
+static gboolean block_len_overlong (guint preamble, guint32 length);
+static int dissect_fast_stream (tvbuff_t* tvb, packet_info* pinfo,
+                                proto_tree* tree,
+                                fast_conversation_data_t* fast_data);
+static packet_data_t* dissect_messages (tvbuff_t* tvb, packet_info* pinfo,
+                                        proto_tree* tree, proto_tree* fast_tree,
+                                        fast_conversation_data_t* fast_data,
+                                        guint offset, gboolean stream);
+static packet_data_t* decode_messages (tvbuff_t* tvb, packet_info* pinfo,
+                                       fast_conversation_data_t* fast_data,
+                                       guint offset, gboolean stream);
+static void display_messages (tvbuff_t* tvb, packet_info* pinfo,
+                              proto_tree* fast_tree, packet_data_t* packet_data);
+static gboolean dissect_feed_header (tvbuff_t* tvb, packet_info* pinfo,
+                                     proto_tree* tree,
+                                     fast_conversation_data_t* fast_data,
+                                     guint* header_len);
+static gboolean arbitrate_lines (tvbuff_t* tvb, packet_info* pinfo,
+                                 proto_tree* tree,
+                                 fast_conversation_data_t* fast_data,
+                                 const FeedHeader* header);
+static void add_channel (const fast_uat_item_t* item, guint32 group);
+static void fast_init_routine (void);
+static void fast_cleanup_routine (void);
+static wmem_map_t* resolve_book_roles (const fast_templates_storage_t* stor);
+static wmem_map_t* resolve_recovery_fields (const fast_templates_storage_t* stor);
+static void display_books (tvbuff_t* tvb, proto_tree* tree,
+                           const packet_data_t* packet_data);
+static void display_recovery (tvbuff_t* tvb, proto_tree* tree,
+                              packet_info* pinfo,
+                              const packet_data_t* packet_data);
+static void collect_errors (const GNode* tnode, const GNode* dnode,
+                            guint32 frame, packet_data_t* packet_data);
+static void record_error (const FieldType* ftype, const FieldData* fdata,
+                          guint32 frame, packet_data_t* packet_data);
+static void register_fast_stat_trees (void);
 static void display_message (tvbuff_t* tvb, proto_tree* tree,
                              const GNode* tmpl, const GNode* parent,
 			     packet_info* pinfo);
 static void display_fields (tvbuff_t* tvb, proto_tree* tree,
                             const GNode* tnode, const GNode* dnode,
                             packet_info* pinfo);
-static char * to_decimal(gint32 expt, gint64 mant);
 static char * generate_field_info(const FieldType* ftype);
 
 UAT_VS_DEF(fast_uats, proto, fast_uat_item_t, guint8, 0, "UDP")
 UAT_DEC_CB_DEF(fast_uats, port, fast_uat_item_t)
 UAT_VS_DEF(fast_uats, flavor, fast_uat_item_t, guint8, 0, "Generic")
 UAT_FILENAME_CB_DEF(fast_uats, template_file, fast_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_uats, feed_group, fast_uat_item_t)
+UAT_VS_DEF(fast_uats, line, fast_uat_item_t, guint8, 0, "None")
+UAT_VS_DEF(fast_uats, recovery_role, fast_uat_item_t, guint8, 0, "None")
+UAT_CSTRING_CB_DEF(fast_uats, market, fast_uat_item_t)
+UAT_VS_DEF(fast_uats, framing, fast_uat_item_t, guint8, 0, "None")
+UAT_CSTRING_CB_DEF(fast_uats, group, fast_uat_item_t)
+UAT_DEC_CB_DEF(fast_uats, last_port, fast_uat_item_t)
+
+UAT_FILENAME_CB_DEF(fast_book_uats, template_file, fast_book_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_book_uats, security_id, fast_book_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_book_uats, entry_type, fast_book_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_book_uats, update_action, fast_book_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_book_uats, price, fast_book_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_book_uats, size, fast_book_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_book_uats, price_level, fast_book_uat_item_t)
+
+UAT_FILENAME_CB_DEF(fast_recovery_uats, template_file, fast_recovery_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_recovery_uats, security_id, fast_recovery_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_recovery_uats, rpt_seq, fast_recovery_uat_item_t)
+UAT_CSTRING_CB_DEF(fast_recovery_uats, last_msg_seq, fast_recovery_uat_item_t)
 
 /*! \brief  Register the plugin with Wireshark.
  * This function is called by Wireshark
@@ -164,6 +442,10 @@ fast_config_port_list_copy_cb(void* n, const void* o, size_t siz _U_)
   new_item->proto = old_item->proto;
   new_item->port  = old_item->port;
   new_item->flavor = old_item->flavor;
+  new_item->line = old_item->line;
+  new_item->recovery_role = old_item->recovery_role;
+  new_item->framing = old_item->framing;
+  new_item->last_port = old_item->last_port;
 
   if (old_item->template_file) {
     new_item->template_file = g_strdup(old_item->template_file);
@@ -171,20 +453,52 @@ fast_config_port_list_copy_cb(void* n, const void* o, size_t siz _U_)
     new_item->template_file = NULL;
   }
 
+  if (old_item->feed_group) {
+    new_item->feed_group = g_strdup(old_item->feed_group);
+  } else {
+    new_item->feed_group = NULL;
+  }
+
+  if (old_item->market) {
+    new_item->market = g_strdup(old_item->market);
+  } else {
+    new_item->market = NULL;
+  }
+
+  if (old_item->group) {
+    new_item->group = g_strdup(old_item->group);
+  } else {
+    new_item->group = NULL;
+  }
+
   return new_item;
 }
 
 static gboolean
-fast_config_port_list_update_cb(void* r _U_, char** err)
+fast_config_port_list_update_cb(void* r, char** err)
 {
     const fast_uat_item_t* item = (const fast_uat_item_t*)r;
+    guint32 group;
 
-    if(item->port < 65536 && item->port > 0)
-        return TRUE;
+    if(item->port >= 65536 || item->port == 0) {
+        if (err)
+            *err = g_strdup("Port value must be in range of 1 to 65535");
+        return FALSE;
+    }
 
-    if (err)
-        *err = g_strdup("Port value must be in range of 1 to 65535");
-    return FALSE;
+    if(item->last_port != 0 && (item->last_port >= 65536 || item->last_port < item->port)) {
+        if (err)
+            *err = g_strdup("Last port must be 0 or in range of Port to 65535");
+        return FALSE;
+    }
+
+    if(!parse_group_address(item->group, &group)) {
+        if (err)
+            *err = g_strdup("Group must be an IPv4 address or empty");
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
 static void
@@ -193,6 +507,65 @@ fast_config_port_list_free_cb(void*r)
   fast_uat_item_t* item = (fast_uat_item_t *)r;
 
   if (item->template_file) g_free(item->template_file);
+  if (item->feed_group) g_free(item->feed_group);
+  if (item->market) g_free(item->market);
+  if (item->group) g_free(item->group);
+}
+
+static void *
+fast_config_book_fields_copy_cb(void* n, const void* o, size_t siz _U_)
+{
+  fast_book_uat_item_t* new_item = (fast_book_uat_item_t*)n;
+  const fast_book_uat_item_t* old_item = (const fast_book_uat_item_t *)o;
+
+  new_item->template_file = g_strdup(old_item->template_file);
+  new_item->security_id   = g_strdup(old_item->security_id);
+  new_item->entry_type    = g_strdup(old_item->entry_type);
+  new_item->update_action = g_strdup(old_item->update_action);
+  new_item->price         = g_strdup(old_item->price);
+  new_item->size          = g_strdup(old_item->size);
+  new_item->price_level   = g_strdup(old_item->price_level);
+
+  return new_item;
+}
+
+static void
+fast_config_book_fields_free_cb(void*r)
+{
+  fast_book_uat_item_t* item = (fast_book_uat_item_t *)r;
+
+  g_free(item->template_file);
+  g_free(item->security_id);
+  g_free(item->entry_type);
+  g_free(item->update_action);
+  g_free(item->price);
+  g_free(item->size);
+  g_free(item->price_level);
+}
+
+static void *
+fast_config_recovery_fields_copy_cb(void* n, const void* o, size_t siz _U_)
+{
+  fast_recovery_uat_item_t* new_item = (fast_recovery_uat_item_t*)n;
+  const fast_recovery_uat_item_t* old_item = (const fast_recovery_uat_item_t *)o;
+
+  new_item->template_file = g_strdup(old_item->template_file);
+  new_item->security_id   = g_strdup(old_item->security_id);
+  new_item->rpt_seq       = g_strdup(old_item->rpt_seq);
+  new_item->last_msg_seq  = g_strdup(old_item->last_msg_seq);
+
+  return new_item;
+}
+
+static void
+fast_config_recovery_fields_free_cb(void*r)
+{
+  fast_recovery_uat_item_t* item = (fast_recovery_uat_item_t *)r;
+
+  g_free(item->template_file);
+  g_free(item->security_id);
+  g_free(item->rpt_seq);
+  g_free(item->last_msg_seq);
 }
 
 void proto_register_fast (void)
@@ -205,16 +578,91 @@ void proto_register_fast (void)
     { &hf_fast[FieldTypeInt32],         { "int32",      "fast.int32",       FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeInt64],         { "int64",      "fast.int64",       FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeDecimal],       { "decimal",    "fast.decimal",     FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
+    { &hf_fast_decimal_value,           { "Decimal value", "fast.decimal.value", FT_DOUBLE, BASE_NONE, NULL, 0, "Value of a decimal field", HFILL } },
+    { &hf_fast_error_code,  { "Error code",       "fast.error.code",     FT_UINT8,  BASE_DEC, NULL, 0, "n of the [ERR Dn] dynamic error", HFILL } },
+    { &hf_fast_error_count, { "Occurrences",      "fast.error.count",    FT_UINT32, BASE_DEC, NULL, 0, "Times the error hit this field of this template in the capture", HFILL } },
+    { &hf_fast_error_first, { "First occurrence", "fast.error.first",    FT_FRAMENUM, BASE_NONE, NULL, 0, "First frame with the error on this field", HFILL } },
+    { &hf_fast_error_last,  { "Last occurrence",  "fast.error.last",     FT_FRAMENUM, BASE_NONE, NULL, 0, "Last frame with the error on this field", HFILL } },
     { &hf_fast[FieldTypeAsciiString],   { "ascii",      "fast.ascii",       FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeUnicodeString], { "unicode",    "fast.unicode",     FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeByteVector],    { "byteVector", "fast.bytevector",  FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeGroup],         { "group",      "fast.group",       FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeSequence],      { "sequence",   "fast.sequence",    FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
     { &hf_fast[FieldTypeError],         { "error",      "fast.ERROR",       FT_NONE,     BASE_NONE, NULL, 0, "Dynamic error in packet", HFILL } },
-    { &hf_fast_tid,                     { "tid",        "fast.tid",         FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } }
+    { &hf_fast_tid,                     { "tid",        "fast.tid",         FT_NONE,     BASE_NONE, NULL, 0, "", HFILL } },
+    { &hf_fast_header,      { "Packet header",    "fast.header",         FT_NONE,   BASE_NONE, NULL, 0, "Exchange specific packet header", HFILL } },
+    { &hf_fast_seq_num,     { "Sequence number",  "fast.seq",            FT_UINT32, BASE_DEC,  NULL, 0, "Packet sequence number", HFILL } },
+    { &hf_fast_subchannel,  { "Sub-channel",      "fast.subchannel",     FT_UINT8,  BASE_DEC,  NULL, 0, "CME sub-channel", HFILL } },
+    { &hf_fast_chunks,      { "Chunks",           "fast.chunks",         FT_UINT16, BASE_DEC,  NULL, 0, "UMDF number of chunks", HFILL } },
+    { &hf_fast_cur_chunk,   { "Current chunk",    "fast.chunk",          FT_UINT16, BASE_DEC,  NULL, 0, "UMDF current chunk", HFILL } },
+    { &hf_fast_chunk_len,   { "Chunk length",     "fast.chunk_len",      FT_UINT16, BASE_DEC,  NULL, 0, "UMDF chunk length", HFILL } },
+    { &hf_fast_seq_missing, { "Missing packets",  "fast.seq.missing",    FT_UINT32, BASE_DEC,  NULL, 0, "Packets missing before this one", HFILL } },
+    { &hf_fast_line,        { "Line",             "fast.line",           FT_UINT8,  BASE_DEC,  VALS(fast_line_vals), 0, "A/B line of the feed", HFILL } },
+    { &hf_fast_arb_first,   { "First arrival",    "fast.arb.first",      FT_FRAMENUM, BASE_NONE, NULL, 0, "Frame the packet was first received in", HFILL } },
+    { &hf_fast_arb_delta,   { "Line latency",     "fast.arb.delta",      FT_RELATIVE_TIME, BASE_NONE, NULL, 0, "Time since the first arrival on the other line", HFILL } },
+    { &hf_fast_book,        { "Order book",       "fast.book",           FT_NONE,   BASE_NONE, NULL, 0, "Book after this packet", HFILL } },
+    { &hf_fast_book_security_id, { "SecurityID",  "fast.book.security_id", FT_UINT64, BASE_DEC, NULL, 0, "Instrument of the book", HFILL } },
+    { &hf_fast_book_bid,    { "Best bid",         "fast.book.bid",       FT_DOUBLE, BASE_NONE, NULL, 0, "Best bid price", HFILL } },
+    { &hf_fast_book_bid_size, { "Best bid size",  "fast.book.bid_size",  FT_INT64,  BASE_DEC,  NULL, 0, "Size at the best bid", HFILL } },
+    { &hf_fast_book_ask,    { "Best ask",         "fast.book.ask",       FT_DOUBLE, BASE_NONE, NULL, 0, "Best ask price", HFILL } },
+    { &hf_fast_book_ask_size, { "Best ask size",  "fast.book.ask_size",  FT_INT64,  BASE_DEC,  NULL, 0, "Size at the best ask", HFILL } },
+    { &hf_fast_book_spread, { "Spread",           "fast.book.spread",    FT_DOUBLE, BASE_NONE, NULL, 0, "Best ask minus best bid", HFILL } },
+    { &hf_fast_book_depth,  { "Depth",            "fast.book.depth",     FT_STRING, BASE_NONE, NULL, 0, "Bid and ask levels in the book", HFILL } },
+    { &hf_fast_recovery,    { "Recovery",         "fast.recovery",       FT_NONE,   BASE_NONE, NULL, 0, "Snapshot/incremental recovery", HFILL } },
+    { &hf_fast_recovery_applied,  { "Applied",    "fast.recovery.applied",  FT_UINT32, BASE_DEC, NULL, 0, "Incrementals a synchronized consumer applies", HFILL } },
+    { &hf_fast_recovery_buffered, { "Buffered",   "fast.recovery.buffered", FT_UINT32, BASE_DEC, NULL, 0, "Incrementals waiting for a snapshot", HFILL } },
+    { &hf_fast_recovery_stale,    { "Stale",      "fast.recovery.stale",    FT_UINT32, BASE_DEC, NULL, 0, "Incrementals already contained in a snapshot", HFILL } },
+    { &hf_fast_recovery_synced,   { "Synchronized instruments", "fast.recovery.synced", FT_UINT32, BASE_DEC, NULL, 0, "Instruments a consumer can synchronize on here", HFILL } },
+    { &hf_fast_recovery_replayed, { "Replayed",   "fast.recovery.replayed", FT_UINT32, BASE_DEC, NULL, 0, "Buffered incrementals released by the synchronization", HFILL } },
+    { &hf_fast_recovery_latency,  { "Recovery latency", "fast.recovery.latency", FT_RELATIVE_TIME, BASE_NONE, NULL, 0, "Time since the first buffered incremental", HFILL } },
+    { &hf_fast_recovery_last_msg_seq, { "LastMsgSeqNumProcessed", "fast.recovery.last_msg_seq", FT_UINT32, BASE_DEC, NULL, 0, "Incremental packets after this one apply on top of the snapshot", HFILL } },
+    { &hf_fast_recovery_market_latency, { "Market recovery latency", "fast.recovery.market_latency", FT_RELATIVE_TIME, BASE_NONE, NULL, 0, "Time until every instrument of the market was synchronized", HFILL } },
+    { &hf_fast_block_len,   { "Block length",     "fast.block_len",      FT_UINT32, BASE_DEC,  NULL, 0, "Length of the FAST message following the block length preamble", HFILL } }
 
   };
 
+  static ei_register_info ei[] = {
+    { &ei_fast_seq_gap,   { "fast.seq.gap",          PI_SEQUENCE, PI_WARN, "Sequence gap", EXPFILL } },
+    { &ei_fast_seq_dup,   { "fast.seq.duplicate",    PI_SEQUENCE, PI_NOTE, "Duplicate packet", EXPFILL } },
+    { &ei_fast_seq_ooo,   { "fast.seq.out_of_order", PI_SEQUENCE, PI_WARN, "Out of order packet", EXPFILL } },
+    { &ei_fast_seq_reset, { "fast.seq.reset",        PI_SEQUENCE, PI_NOTE, "Sequence number reset", EXPFILL } },
+    { &ei_fast_recovery_sync,   { "fast.recovery.sync",   PI_SEQUENCE, PI_CHAT, "Synchronization point", EXPFILL } },
+    { &ei_fast_recovery_gap,    { "fast.recovery.gap",    PI_SEQUENCE, PI_WARN, "RptSeq gap, instrument needs recovery", EXPFILL } },
+    { &ei_fast_recovery_market, { "fast.recovery.market", PI_SEQUENCE, PI_NOTE, "Market synchronized", EXPFILL } },
+    { &ei_fast_stream_overlong, { "fast.stream.overlong", PI_MALFORMED, PI_ERROR, "Message longer than the TCP message limit, rest of the segment skipped", EXPFILL } },
+    { &ei_fast_err_d[0], { "fast.err.d1", PI_MALFORMED, PI_ERROR, "[ERR D1]", EXPFILL } },
+    { &ei_fast_err_d[1], { "fast.err.d2", PI_MALFORMED, PI_ERROR, "[ERR D2] Integer does not fall within the bounds of the specified type", EXPFILL } },
+    { &ei_fast_err_d[2], { "fast.err.d3", PI_MALFORMED, PI_ERROR, "[ERR D3]", EXPFILL } },
+    { &ei_fast_err_d[3], { "fast.err.d4", PI_MALFORMED, PI_ERROR, "[ERR D4] Retrieved differently typed value from dictionary", EXPFILL } },
+    { &ei_fast_err_d[4], { "fast.err.d5", PI_MALFORMED, PI_ERROR, "[ERR D5] Mandatory field not present, undefined previous value", EXPFILL } },
+    { &ei_fast_err_d[5], { "fast.err.d6", PI_MALFORMED, PI_ERROR, "[ERR D6] Mandatory field not present, empty previous value", EXPFILL } },
+    { &ei_fast_err_d[6], { "fast.err.d7", PI_MALFORMED, PI_ERROR, "[ERR D7] Invalid subtraction length", EXPFILL } },
+    { &ei_fast_err_d[7], { "fast.err.d8", PI_MALFORMED, PI_ERROR, "[ERR D8]", EXPFILL } },
+    { &ei_fast_err_d[8], { "fast.err.d9", PI_MALFORMED, PI_ERROR, "[ERR D9] Template does not exist", EXPFILL } },
+    { &ei_fast_err_d[9], { "fast.err.budget", PI_MALFORMED, PI_ERROR, "[ERR BUDGET] Work budget of the packet exceeded", EXPFILL } }
+  };
+
+  static const value_string fast_recovery_role_vals[] = {
+    { RecoveryNone, "None" },
+    { RecoveryIncremental, "Incremental" },
+    { RecoverySnapshot, "Snapshot" },
+    { 0, NULL }
+  };
+
+  static const value_string fast_framing_vals[] = {
+    { FramingNone, "None" },
+    { FramingBlockLength, "Block length" },
+    { FramingStopBit, "Stop bit" },
+    { 0, NULL }
+  };
+
+  static const enum_val_t fast_framing_enum_vals[] = {
+    { "none", "None", FramingNone },
+    { "block_length", "Block length", FramingBlockLength },
+    { "stop_bit", "Stop bit", FramingStopBit },
+    { NULL, NULL, 0 }
+  };
+
   static const value_string fast_transport_proto_vals[] = {
     { UDPImplem, "UDP" },
     { TCPImplem, "TCP" },
@@ -234,14 +682,45 @@ void proto_register_fast (void)
     UAT_FLD_DEC(fast_uats, port, "Port", "Port Number"),
     UAT_FLD_VS(fast_uats, flavor, "Implementation", fast_application_proto_vals, "Application protocol (exchnage flavor)"),
     UAT_FLD_FILENAME(fast_uats, template_file, "XML template file", "Enter a valid filesystem path"),
+    UAT_FLD_CSTRING(fast_uats, feed_group, "Feed group", "Ports with the same feed group are lines of the same feed"),
+    UAT_FLD_VS(fast_uats, line, "Line", fast_line_vals, "A/B line of the feed, packets are arbitrated between lines"),
+    UAT_FLD_VS(fast_uats, recovery_role, "Channel role", fast_recovery_role_vals, "Snapshot or incremental channel of the market"),
+    UAT_FLD_CSTRING(fast_uats, market, "Market", "Snapshot and incremental channels with the same market recover together"),
+    UAT_FLD_VS(fast_uats, framing, "TCP framing", fast_framing_vals, "Messages of a TCP stream are preceded by their length, or follow each other back to back.\nNone dissects every segment on its own"),
+    UAT_FLD_CSTRING(fast_uats, group, "Group", "Multicast group of the channel, empty for every address on the port"),
+    UAT_FLD_DEC(fast_uats, last_port, "Last port", "Channel on every port from Port to this one, 0 for Port alone"),
     UAT_END_FIELDS
   };
 
   /* Subtree array. */
+  static uat_field_t fast_book_uats_flds[] = {
+    UAT_FLD_FILENAME(fast_book_uats, template_file, "XML template file", "Template file the names apply to"),
+    UAT_FLD_CSTRING(fast_book_uats, security_id, "SecurityID", "Field identifying the instrument"),
+    UAT_FLD_CSTRING(fast_book_uats, entry_type, "MDEntryType", "Field telling bid (0) from offer (1)"),
+    UAT_FLD_CSTRING(fast_book_uats, update_action, "MDUpdateAction", "Field with new (0), change (1), delete (2)"),
+    UAT_FLD_CSTRING(fast_book_uats, price, "Price", "Field with the price of the entry"),
+    UAT_FLD_CSTRING(fast_book_uats, size, "Size", "Field with the size of the entry"),
+    UAT_FLD_CSTRING(fast_book_uats, price_level, "MDPriceLevel", "Field with the level of the entry, empty to go by price"),
+    UAT_END_FIELDS
+  };
+
+  static uat_field_t fast_recovery_uats_flds[] = {
+    UAT_FLD_FILENAME(fast_recovery_uats, template_file, "XML template file", "Template file the names apply to"),
+    UAT_FLD_CSTRING(fast_recovery_uats, security_id, "SecurityID", "Field identifying the instrument"),
+    UAT_FLD_CSTRING(fast_recovery_uats, rpt_seq, "RptSeq", "Field with the sequence number of the entry per instrument"),
+    UAT_FLD_CSTRING(fast_recovery_uats, last_msg_seq, "LastMsgSeqNumProcessed", "Field of a snapshot with the last incremental it includes"),
+    UAT_END_FIELDS
+  };
+
   static gint *ett[] = {
-    &ett_fast
+    &ett_fast,
+    &ett_fast_header,
+    &ett_fast_book,
+    &ett_fast_recovery,
+    &ett_fast_error
   };
   module_t* module;
+  expert_module_t* expert_fast;
 
 
   if (proto_fast != -1)  return;
@@ -255,7 +734,12 @@ void proto_register_fast (void)
   /* Register header fields and subtree. */
   proto_register_field_array(proto_fast, hf, array_length(hf));
   proto_register_subtree_array(ett, array_length(ett));
+  expert_fast = expert_register_protocol(proto_fast);
+  expert_register_field_array(expert_fast, ei, array_length(ei));
 
+  fast_tap = register_tap("fast");
+  fast_errors_tap = register_tap("fast_errors");
+  register_fast_stat_trees();
 
   /* registers our module's dissector registration hook */
   module = prefs_register_protocol(proto_fast,
@@ -291,6 +775,109 @@ void proto_register_fast (void)
                                 "Enter a valid port numbers",
                                 config_port_list_uat);
 
+  prefs_register_bool_preference(module,
+                                   "build_books",
+                                   "Build order books",
+                                   "Rebuild per instrument order books from the decoded market data entries.\n"
+                                   "Every packet is decoded on the first pass when enabled",
+                                   &config_books_enabled);
+
+  config_book_fields_uat = uat_new("FAST Book Fields",
+                                   sizeof(fast_book_uat_item_t),
+                                   "fast_book_fields",
+                                   TRUE,
+                                   (void*)&fast_book_uats,
+                                   &config_n_book_items,
+                                   UAT_AFFECTS_DISSECTION,
+                                   NULL,
+                                   fast_config_book_fields_copy_cb,
+                                   NULL,
+                                   fast_config_book_fields_free_cb,
+                                   proto_reg_handoff_fast,
+                                   NULL,
+                                   fast_book_uats_flds);
+
+  prefs_register_uat_preference(module,
+                                "book_fields",
+                                "Order book field names",
+                                "Names of the book fields per template file, empty names use the FIX tag names",
+                                config_book_fields_uat);
+
+  config_recovery_fields_uat = uat_new("FAST Recovery Fields",
+                                       sizeof(fast_recovery_uat_item_t),
+                                       "fast_recovery_fields",
+                                       TRUE,
+                                       (void*)&fast_recovery_uats,
+                                       &config_n_recovery_items,
+                                       UAT_AFFECTS_DISSECTION,
+                                       NULL,
+                                       fast_config_recovery_fields_copy_cb,
+                                       NULL,
+                                       fast_config_recovery_fields_free_cb,
+                                       proto_reg_handoff_fast,
+                                       NULL,
+                                       fast_recovery_uats_flds);
+
+  prefs_register_uat_preference(module,
+                                "recovery_fields",
+                                "Recovery field names",
+                                "Names of the recovery fields per template file, empty names use the FIX tag names",
+                                config_recovery_fields_uat);
+
+  prefs_register_filename_preference(module,
+                                     "cme_config_file",
+                                     "CME channel configuration",
+                                     "config.xml of the CME channels, its feeds are added to the port list",
+                                     &config_cme_file);
+
+  prefs_register_filename_preference(module,
+                                     "cme_template_file",
+                                     "CME templates",
+                                     "XML template file of the imported CME channels",
+                                     &config_cme_templates);
+
+  prefs_register_enum_preference(module,
+                                 "cme_tcp_framing",
+                                 "CME TCP framing",
+                                 "How messages are delimited on the imported historical replay (TCP) channels.\n"
+                                 "None dissects every segment on its own",
+                                 &config_cme_framing, fast_framing_enum_vals, FALSE);
+
+  range_convert_str(&config_skip_templates, "", G_MAXUINT32);
+  prefs_register_range_preference(module,
+                                  "skip_templates",
+                                  "Skipped templates",
+                                  "Ids of the templates whose messages are only decoded to keep the dictionaries\n"
+                                  "up to date, e.g. 4,10-12. Their fields are neither built nor shown",
+                                  &config_skip_templates, G_MAXUINT32);
+
+  prefs_register_uint_preference(module,
+                                 "max_fields",
+                                 "Most fields per packet",
+                                 "Work budget of a packet: decoding stops with [ERR BUDGET] past this many fields,\n"
+                                 "sequence elements included, and the dictionary stores of the message are undone. 0 is no limit",
+                                 10, &config_max_fields);
+
+  prefs_register_uint_preference(module,
+                                 "max_sequence_elements",
+                                 "Most sequence elements per packet",
+                                 "Work budget of a packet: decoding stops with [ERR BUDGET] past this many sequence elements. 0 is no limit",
+                                 10, &config_max_elements);
+
+  prefs_register_uint_preference(module,
+                                 "max_string_bytes",
+                                 "Most delta and tail string bytes per packet",
+                                 "Work budget of a packet: decoding stops with [ERR BUDGET] once the strings and byte vectors\n"
+                                 "built by delta and tail operators add up to more bytes. 0 is no limit",
+                                 10, &config_max_string_bytes);
+
+  prefs_register_uint_preference(module,
+                                 "max_stream_message",
+                                 "Longest TCP message",
+                                 "A block length above this many bytes is taken for a corrupt stream and the rest of the segment\n"
+                                 "is skipped, as is a message cut by the segment end once this many bytes are held back. 0 is no limit",
+                                 10, &config_max_stream_message);
+
   prefs_register_bool_preference(module,
                                    "show_empty",
                                    "Show empty optional fields",
@@ -347,15 +934,107 @@ void proto_register_fast (void)
                                      &config_log_file_name);
 
 
+  register_init_routine(fast_init_routine);
+  register_cleanup_routine(fast_cleanup_routine);
+
   register_dissector("fast", dissect_fast, proto_fast);
 }
 
+/*! \brief  Reset per capture file state.
+ */
+void fast_init_routine(void)
+{
+  arbiters_map = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+  book_set = book_set_new(wmem_file_scope());
+  markets_map = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+  /* stored values refer to the decoded fields of the previous file */
+  reset_dictionaries();
+  reset_string_pool();
+  dissect_reset();
+  heur_verdicts = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+}
+
+/*! \brief  End of a capture file, report the errors that were not logged.
+ */
+void fast_cleanup_routine(void)
+{
+  fast_log_summary();
+}
+
+/*! \brief  Find the book fields of a template file.
+ *  \param stor  Parsed template file.
+ *  \return  Role map, NULL if books are off or the templates have no price.
+ */
+wmem_map_t* resolve_book_roles (const fast_templates_storage_t* stor)
+{
+  BookFieldNames fields;
+  guint i;
+
+  if (!config_books_enabled) {
+    return NULL;
+  }
+
+  memset(&fields, 0, sizeof(BookFieldNames));
+  for (i = 0; i < config_n_book_items; i++) {
+    const fast_book_uat_item_t* item = &fast_book_uats[i];
+    if (item->template_file && strcmp(item->template_file, stor->filename) == 0) {
+      fields.names[BookRoleSecurityID]   = item->security_id;
+      fields.names[BookRoleEntryType]    = item->entry_type;
+      fields.names[BookRoleUpdateAction] = item->update_action;
+      fields.names[BookRolePrice]        = item->price;
+      fields.names[BookRoleSize]         = item->size;
+      fields.names[BookRolePriceLevel]   = item->price_level;
+      break;
+    }
+  }
+
+  return book_resolve_roles(wmem_epan_scope(), stor->templates, &fields);
+}
+
+/*! \brief  Find the recovery fields of a template file.
+ *  \param stor  Parsed template file.
+ *  \return  Field map, NULL if the templates have no RptSeq.
+ */
+wmem_map_t* resolve_recovery_fields (const fast_templates_storage_t* stor)
+{
+  RecoveryFieldNames fields;
+  guint i;
+
+  memset(&fields, 0, sizeof(RecoveryFieldNames));
+  for (i = 0; i < config_n_recovery_items; i++) {
+    const fast_recovery_uat_item_t* item = &fast_recovery_uats[i];
+    if (item->template_file && strcmp(item->template_file, stor->filename) == 0) {
+      fields.names[RecoveryFieldSecurityID]    = item->security_id;
+      fields.names[RecoveryFieldRptSeq]        = item->rpt_seq;
+      fields.names[RecoveryFieldLastMsgSeqNum] = item->last_msg_seq;
+      break;
+    }
+  }
+
+  return recovery_resolve_fields(wmem_epan_scope(), stor->templates, &fields);
+}
+
 static void fast_templates_mark_unused(gpointer key _U_, gpointer value, gpointer data _U_)
 {
     fast_templates_storage_t* stor = (fast_templates_storage_t*)value;
     stor->used = FALSE;
 }
 
+static void fast_templates_mark_skipped(gpointer key _U_, gpointer value, gpointer data _U_)
+{
+    const fast_templates_storage_t* stor = (fast_templates_storage_t*)value;
+    GNode* tmpl;
+
+    if (!stor->templates)
+        return;
+
+    for (tmpl = stor->templates->children; tmpl; tmpl = tmpl->next) {
+        FieldType* tfield = (FieldType*) tmpl->data;
+        tfield->skip = config_skip_templates &&
+                       value_is_in_range(config_skip_templates, (guint32) tfield->id);
+    }
+}
+
 static void fast_templates_find_unused(gpointer key _U_, gpointer value, gpointer data)
 {
     const fast_templates_storage_t* stor = (fast_templates_storage_t*)value;
@@ -382,12 +1061,20 @@ static void fast_templates_clean_unused(gpointer key, gpointer user_data)
 void proto_reg_handoff_fast(void)
 {
   static gboolean initialized = FALSE;
-  static dissector_handle_t fast_handle;
+  DissectBudget budget;
 
   fast_set_log_settings(config_show_dialog_windows, config_log_errors, config_log_file_name);
 
+  budget.max_fields = config_max_fields;
+  budget.max_elements = config_max_elements;
+  budget.max_string_bytes = config_max_string_bytes;
+  dissect_set_budget(&budget);
+
   if(enabled && !initialized){
     fast_handle = create_dissector_handle(&dissect_fast, proto_fast);
+    /* off by default, any UDP payload starting with a known tid passes */
+    heur_dissector_add("udp", dissect_fast_heur, "FAST over UDP on unconfigured ports",
+                       "fast_udp", proto_fast, HEURISTIC_DISABLE);
     templates_map = wmem_map_new(wmem_epan_scope(), g_str_hash, g_str_equal);
     initialized = TRUE;
   }
@@ -400,41 +1087,44 @@ void proto_reg_handoff_fast(void)
     dissector_delete_all("udp.port", fast_handle);
     dissector_delete_all("tcp.port", fast_handle);
 
-    port_map = wmem_map_new(wmem_epan_scope(), g_direct_hash, g_direct_equal);
+    channel_index = channel_index_new(wmem_epan_scope());
+    probe_channels = wmem_list_new(wmem_epan_scope());
+    memset(registered_ports, 0, sizeof(registered_ports));
 
     for(i = 0; i < config_n_port_items; i++) {
-        fast_templates_storage_t* stor = NULL;
-        /* listen for TCP or UDP, depending on user preference */
-        const char* config_port_field = 0;
-        switch(fast_uats[i].proto) {
-        case UDPImplem:
-            config_port_field = "udp.port";
-            break;
-        case TCPImplem:
-            config_port_field = "tcp.port";
-            break;
-        }
-
-        /* Tell Wireshark what underlying protocol and port we use. */
-        dissector_add_uint(config_port_field, fast_uats[i].port, fast_handle);
-
-        stor = (fast_templates_storage_t*) wmem_map_lookup(templates_map, fast_uats[i].template_file);
-
-        if(!stor) {
-            stor = (fast_templates_storage_t*) wmem_alloc(wmem_epan_scope(), sizeof(fast_templates_storage_t));
-            stor->filename = wmem_strdup(wmem_epan_scope(), fast_uats[i].template_file);
-            stor->templates = parse_templates_xml(fast_uats[i].template_file);
-            stor->templates_table = create_templates_table(stor->templates);
-            wmem_map_insert(templates_map, stor->filename, stor);
+        guint32 group;
+        if (parse_group_address(fast_uats[i].group, &group)) {
+          add_channel(&fast_uats[i], group);
         }
+    }
 
-        wmem_map_insert(port_map, GUINT_TO_POINTER(fast_uats[i].port), stor);
-
-        fprintf(stderr, "Using xml file %s ...\n", fast_uats[i].template_file);
-
-        stor->used = TRUE;
+    /* channels of an exchange configuration file share a template file */
+    if (config_cme_file && config_cme_file[0] &&
+        config_cme_templates && config_cme_templates[0]) {
+      wmem_array_t* imported = import_cme_channels(wmem_epan_scope(), config_cme_file);
+      guint n = imported ? wmem_array_get_count(imported) : 0;
+
+      for (i = 0; i < n; i++) {
+        const ImportedChannel* ichannel = (const ImportedChannel*) wmem_array_index(imported, i);
+        fast_uat_item_t item;
+
+        memset(&item, 0, sizeof(fast_uat_item_t));
+        item.proto = ichannel->tcp ? TCPImplem : UDPImplem;
+        item.port = ichannel->port;
+        item.flavor = CMEImplem;
+        item.template_file = (gchar*) config_cme_templates;
+        item.feed_group = ichannel->feed_group;
+        item.line = ichannel->line;
+        item.recovery_role = ichannel->recovery_role;
+        item.market = ichannel->market;
+        item.framing = (guint8) config_cme_framing;
+        add_channel(&item, ichannel->group);
+      }
+      fprintf(stderr, "Imported %u channels from %s ...\n", n, config_cme_file);
     }
 
+    wmem_map_foreach(templates_map, fast_templates_mark_skipped, NULL);
+
     {
         GPtrArray* unused_templates = g_ptr_array_new_full(wmem_map_size(templates_map), NULL);
         wmem_map_foreach(templates_map, fast_templates_find_unused, unused_templates);
@@ -446,12 +1136,166 @@ void proto_reg_handoff_fast(void)
   }
 }
 
+/*! \brief  Index a channel of the port list and listen on its ports.
+ *  \param item the channel
+ *  \param group its multicast group, 0 for any
+ */
+void add_channel (const fast_uat_item_t* item, guint32 group)
+{
+  fast_templates_storage_t* stor = NULL;
+  fast_channel_t* channel = NULL;
+  guint last_port = MAX(item->port, item->last_port);
+  guint port;
+  guint flavors;
+  /* listen for TCP or UDP, depending on user preference */
+  const char* config_port_field = 0;
+  switch(item->proto) {
+  case UDPImplem:
+      config_port_field = "udp.port";
+      break;
+  case TCPImplem:
+      config_port_field = "tcp.port";
+      break;
+  default:
+      return;
+  }
+
+  stor = (fast_templates_storage_t*) wmem_map_lookup(templates_map, item->template_file);
+
+  if(!stor) {
+      stor = (fast_templates_storage_t*) wmem_alloc(wmem_epan_scope(), sizeof(fast_templates_storage_t));
+      stor->filename = wmem_strdup(wmem_epan_scope(), item->template_file);
+      stor->templates = parse_templates_xml(item->template_file);
+      stor->templates_table = create_templates_table(stor->templates);
+      stor->book_roles = NULL;
+      stor->recovery_fields = NULL;
+      stor->used = FALSE;
+      wmem_map_insert(templates_map, stor->filename, stor);
+
+      fprintf(stderr, "Using xml file %s ...\n", item->template_file);
+  }
+
+  /* resolve once per template file */
+  if (!stor->used) {
+    stor->book_roles = resolve_book_roles(stor);
+    stor->recovery_fields = resolve_recovery_fields(stor);
+    stor->probed_flavors = 0;
+  }
+
+  channel = wmem_new0(wmem_epan_scope(), fast_channel_t);
+  channel->stor = stor;
+  channel->flavor = item->flavor;
+  channel->line = item->line;
+  if (item->proto == TCPImplem) {
+    channel->framing = item->framing;
+  }
+  if (item->market && item->market[0]) {
+    channel->recovery_role = item->recovery_role;
+    channel->market = wmem_strdup(wmem_epan_scope(), item->market);
+    if (channel->recovery_role != RecoveryNone && !stor->recovery_fields) {
+      fprintf(stderr, "No RptSeq field in %s, market %s is not recovered."
+              " Set the field names in the FAST Recovery Fields table.\n",
+              item->template_file, item->market);
+    }
+  }
+  if (item->feed_group && item->feed_group[0]) {
+    channel->feed_group = wmem_strdup(wmem_epan_scope(), item->feed_group);
+  }
+
+  for (port = item->port; port <= last_port; port++) {
+    channel_index_insert(channel_index, group, port, channel);
+
+    /* Tell Wireshark what underlying protocol and port we use,
+     * once per port however many groups use it. */
+    if (!(registered_ports[item->proto][port / 8] & (1 << (port % 8)))) {
+      registered_ports[item->proto][port / 8] |= 1 << (port % 8);
+      dissector_add_uint(config_port_field, port, fast_handle);
+    }
+  }
+
+  /* the heuristic tries every template file and header once */
+  flavors = 1 << channel->flavor;
+  if (channel->framing == FramingNone && !(stor->probed_flavors & flavors)) {
+    stor->probed_flavors |= flavors;
+    wmem_list_append(probe_channels, channel);
+  }
+
+  stor->used = TRUE;
+}
+
 /*! \brief Hook function that Wireshark calls to dissect a packet.
  *  \param tvb the actual packet data
  *  \param pinfo metadata for this packet
  *  \param tree where we put the data we want wireshark to print
  */
 int dissect_fast(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data_unused _U_)
+{
+  fast_conversation_data_t* fast_data = NULL;
+  proto_item* ti;
+  proto_tree* fast_tree;
+  guint header_offset;
+
+  fast_data = get_conversation_data(pinfo);
+  if (!fast_data)
+    return 0;
+
+  /* fill in protocol column */
+  if (CHECK_COL(pinfo->cinfo, COL_PROTOCOL))
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "FAST");
+
+  /* clear anything out of the info column */
+  if (CHECK_COL(pinfo->cinfo, COL_INFO))
+    col_clear(pinfo->cinfo, COL_INFO);
+
+  frame_pdu = 0;
+  frame_messages = 0;
+
+  /* TCP streams are cut into messages first, a message spanning
+   * segments is reassembled by TCP.
+   */
+  switch (fast_data->framing) {
+    case FramingBlockLength:
+      tcp_dissect_pdus(tvb, pinfo, tree, TRUE, 1, get_fast_block_len,
+                       dissect_fast_block, fast_data);
+      return tvb_captured_length(tvb);
+    case FramingStopBit:
+      return dissect_fast_stream(tvb, pinfo, tree, fast_data);
+  }
+
+  ti = proto_tree_add_item(tree, proto_fast, tvb, 0, -1, ENC_NA);
+  fast_tree = proto_item_add_subtree(ti, ett_fast);
+
+  /* Sequence tracking has to see every packet, not only the displayed
+   * ones. Packets already received on the other line are not decoded again.
+   */
+  if (!dissect_feed_header(tvb, pinfo, fast_tree, fast_data, &header_offset)) {
+    return tvb_reported_length(tvb);
+  }
+
+  /* Only do dissection if we are asked, or the books or the recovery
+   * model need the messages
+   */
+  if (tree || fast_data->book_roles || fast_data->market) {
+    dissect_messages(tvb, pinfo, tree, fast_tree, fast_data, header_offset, FALSE);
+  }
+
+  /* flag sequence anomalies in the info column */
+  if (CHECK_COL(pinfo->cinfo, COL_INFO)) {
+    const fast_seq_anomaly_t* anomaly = (const fast_seq_anomaly_t*)
+      wmem_tree_lookup32(fast_data->seq_anomalies, pinfo->fd->num);
+    if (anomaly) {
+      col_append_fstr(pinfo->cinfo, COL_INFO, " [%s]", seq_verdict_name(anomaly->verdict));
+    }
+  }
+
+  return tvb_reported_length(tvb);
+}
+
+/*! \brief  Find or set up the channel state of the packet's conversation.
+ *  \param pinfo packet metadata
+ *  \return the state, NULL if the port is not configured
+ */
+fast_conversation_data_t* get_conversation_data (packet_info* pinfo)
 {
   conversation_t* conversation = NULL;
   fast_conversation_data_t* fast_data = NULL;
@@ -462,178 +1306,982 @@ int dissect_fast(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data
 
   if(!fast_data)
   {
-    guint i;
-    fast_templates_storage_t* stor = (fast_templates_storage_t*)wmem_map_lookup(port_map, GUINT_TO_POINTER(pinfo->destport));
-    if(!stor)
+    const fast_channel_t* channel = (fast_channel_t*)channel_index_lookup(channel_index, &pinfo->dst, pinfo->destport);
+    /* replies of a TCP server come from the configured port */
+    if(!channel)
+      channel = (fast_channel_t*)channel_index_lookup(channel_index, &pinfo->src, pinfo->srcport);
+    if(!channel)
+      return NULL;
+
+    fast_data = new_conversation_data(conversation, channel);
+  }
+
+  return fast_data;
+}
+
+/*! \brief  Set up the channel state of a conversation.
+ *  \param conversation the conversation
+ *  \param channel configuration of the channel
+ *  \return the state, attached to the conversation
+ */
+fast_conversation_data_t* new_conversation_data (conversation_t* conversation,
+                                                 const fast_channel_t* channel)
+{
+  fast_conversation_data_t* fast_data = wmem_new0(wmem_file_scope(), fast_conversation_data_t);
+
+  fast_data->templates_table = channel->stor->templates_table;
+  fast_data->book_roles = channel->stor->book_roles;
+  fast_data->flavor = channel->flavor;
+  fast_data->framing = channel->framing;
+  seq_tracker_init(&fast_data->seq);
+  fast_data->seq_anomalies = wmem_tree_new(wmem_file_scope());
+
+  /* lines of the same feed group share one arbiter */
+  if (channel->feed_group && channel->line != LineNone) {
+    fast_data->line = channel->line;
+    fast_data->arbiter = (LineArbiter*)wmem_map_lookup(arbiters_map, channel->feed_group);
+    if (!fast_data->arbiter) {
+      fast_data->arbiter = wmem_new(wmem_file_scope(), LineArbiter);
+      line_arbiter_init(fast_data->arbiter);
+      wmem_map_insert(arbiters_map, wmem_strdup(wmem_file_scope(), channel->feed_group), fast_data->arbiter);
+    }
+    fast_data->arb_duplicates = wmem_tree_new(wmem_file_scope());
+  }
+
+  /* snapshot and incremental channels of a market share its state */
+  if (channel->market && channel->recovery_role != RecoveryNone &&
+      channel->stor->recovery_fields) {
+    fast_data->recovery_role = channel->recovery_role;
+    fast_data->recovery_fields = channel->stor->recovery_fields;
+    fast_data->market = (RecoveryMarket*)wmem_map_lookup(markets_map, channel->market);
+    if (!fast_data->market) {
+      fast_data->market = recovery_market_new(wmem_file_scope());
+      wmem_map_insert(markets_map, wmem_strdup(wmem_file_scope(), channel->market), fast_data->market);
+    }
+  }
+  conversation_add_proto_data(conversation, proto_fast, fast_data);
+
+  return fast_data;
+}
+
+/*! \brief  Heuristic for UDP flows on ports missing from the port list.
+ *  The first packets of a flow are probed against the template files of
+ *  the configured channels. A flow found to be FAST is bound to the FAST
+ *  dissector, the others are not probed again.
+ */
+gboolean dissect_fast_heur (tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data _U_)
+{
+  conversation_t* conversation;
+  fast_heur_probe_t probe;
+  fast_channel_t channel;
+  guint tries;
+
+  if (!probe_channels || !heur_verdicts) {
+    return FALSE;
+  }
+
+  conversation = find_or_create_conversation(pinfo);
+  if (conversation_get_proto_data(conversation, proto_fast)) {
+    dissect_fast(tvb, pinfo, tree, NULL);
+    return TRUE;
+  }
+
+  tries = GPOINTER_TO_UINT(wmem_map_lookup(heur_verdicts, conversation));
+  if (tries >= FAST_HEUR_TRIES) {
+    return FALSE;
+  }
+
+  probe.tvb = tvb;
+  probe.pinfo = pinfo;
+  probe.match = NULL;
+  wmem_list_foreach(probe_channels, probe_channel, &probe);
+
+  if (!probe.match) {
+    wmem_map_insert(heur_verdicts, conversation, GUINT_TO_POINTER(tries + 1));
+    return FALSE;
+  }
+
+  /* only the templates and the header apply, the rest is per port */
+  memset(&channel, 0, sizeof(fast_channel_t));
+  channel.stor = probe.match->stor;
+  channel.flavor = probe.match->flavor;
+  new_conversation_data(conversation, &channel);
+  conversation_set_dissector(conversation, fast_handle);
+
+  dissect_fast(tvb, pinfo, tree, NULL);
+  return TRUE;
+}
+
+/*! \brief  wmem_list_foreach callback, probe a packet against a channel.
+ */
+void probe_channel (gpointer value, gpointer user_data)
+{
+  fast_heur_probe_t* probe = (fast_heur_probe_t*) user_data;
+  const fast_channel_t* channel = (const fast_channel_t*) value;
+
+  if (probe->match || channel->framing != FramingNone ||
+      !channel->stor->templates_table) {
+    return;
+  }
+  if (probe_messages(probe->tvb, probe->pinfo, channel)) {
+    probe->match = channel;
+  }
+}
+
+/*! \brief  Check that a packet starts with a message of the channel.
+ *  The PMAP and template id are checked first, then the beginning of
+ *  the packet is decoded. The probe leaves no trace in the dictionaries,
+ *  the template id of the previous message, the dissector statistics
+ *  nor the capture file scope.
+ *  \return TRUE if the message decodes without error
+ */
+gboolean probe_messages (tvbuff_t* tvb, packet_info* pinfo,
+                         const fast_channel_t* channel)
+{
+  guint header_len = feed_header_length(channel->flavor);
+  guint length = tvb_captured_length(tvb);
+  guint nbytes;
+  const guint8* bytes;
+  guint pmap_len;
+  guint tid_len;
+  guint32 tid;
+  guint32 prev_tid;
+  DissectPosition position;
+  DissectStats work;
+  GNode* tmpl;
+  gboolean decoded;
+
+  if (length <= header_len) {
+    return FALSE;
+  }
+  nbytes = MIN(length - header_len, FAST_HEUR_PROBE_BYTES);
+  bytes = tvb_get_ptr(tvb, header_len, nbytes);
+
+  /* the first message of a packet has to carry its template id,
+   * the first bit of the PMAP */
+  pmap_len = count_stop_bit_encoded(MIN(nbytes, FAST_HEUR_MAX_PMAP), bytes);
+  if (pmap_len == 0 || !(bytes[0] & 0x40)) {
+    return FALSE;
+  }
+  tid_len = count_stop_bit_encoded(MIN(nbytes - pmap_len, Int32MaxBytes),
+                                   bytes + pmap_len);
+  if (tid_len == 0) {
+    return FALSE;
+  }
+  tid = decode_uint32(tid_len, bytes + pmap_len);
+  if (!wmem_map_lookup(channel->stor->templates_table, &tid)) {
+    return FALSE;
+  }
+
+  /* trial decode of the first message */
+  memset(&position, 0, sizeof(DissectPosition));
+  position.nbytes = nbytes;
+  position.bytes  = bytes;
+  work = *dissect_stats();
+  prev_tid = dissect_template_id();
+
+  /* the trial tree and its values go with the packet */
+  dissect_set_tree_scope(wmem_packet_scope());
+  set_sized_data_scope(wmem_packet_scope());
+  checkpoint_dictionaries();
+  tmpl = dissect_fast_bytes(channel->stor->templates_table, &position,
+                            wmem_node_new(wmem_packet_scope(), 0),
+                            &pinfo->src, &pinfo->dst);
+  rollback_dictionaries();
+  set_sized_data_scope(NULL);
+  dissect_set_tree_scope(NULL);
+  dissect_set_template_id(prev_tid);
+
+  /* a message longer than the probe is cut by the probe, not the packet */
+  decoded = tmpl && dissect_stats()->errors == work.errors &&
+            (!position.overrun || nbytes < length - header_len);
+  *dissect_stats() = work;
+
+  return decoded;
+}
+
+/*! \brief  Length of the block starting at offset, preamble included.
+ *  \return 0 if the preamble itself continues in the next segment
+ */
+guint get_fast_block_len (packet_info* pinfo, tvbuff_t* tvb,
+                          int offset, void* data _U_)
+{
+  guint available = tvb_captured_length_remaining(tvb, offset);
+  guint nbytes = MIN(available, Int32MaxBytes);
+  const guint8* bytes = tvb_get_ptr(tvb, offset, nbytes);
+  guint preamble = count_stop_bit_encoded(nbytes, bytes);
+  guint32 length;
+
+  if (preamble == 0) {
+    /* tcp_dissect_pdus asks for one more segment on 0 */
+    if (nbytes < Int32MaxBytes && pinfo->can_desegment) {
       return 0;
+    }
+    /* not a block length, give up on the rest of the segment */
+    return available;
+  }
+
+  length = decode_uint32(preamble, bytes);
+  if (block_len_overlong(preamble, length)) {
+    /* a corrupt stream, give up on the rest of the segment */
+    return available;
+  }
+  return preamble + length;
+}
+
+/*! \brief  Tell a block length of a corrupt stream, too long to be
+ *          held back or wrapping around with its preamble.
+ */
+gboolean block_len_overlong (guint preamble, guint32 length)
+{
+  return length > G_MAXUINT - preamble ||
+    (config_max_stream_message && length > config_max_stream_message);
+}
+
+/*! \brief  Dissect one block of a block length framed TCP stream.
+ *  \param tvb the block, preamble included, reassembled if needed
+ *  \param data the conversation state
+ */
+int dissect_fast_block (tvbuff_t* tvb, packet_info* pinfo,
+                        proto_tree* tree, void* data)
+{
+  fast_conversation_data_t* fast_data = (fast_conversation_data_t*) data;
+  guint nbytes = MIN(tvb_captured_length(tvb), Int32MaxBytes);
+  guint preamble = count_stop_bit_encoded(nbytes, tvb_get_ptr(tvb, 0, nbytes));
+  guint32 length;
+  proto_item* ti;
+  proto_tree* fast_tree;
+  proto_item* len_item;
+
+  ti = proto_tree_add_item(tree, proto_fast, tvb, 0, -1, ENC_NA);
+  fast_tree = proto_item_add_subtree(ti, ett_fast);
+
+  if (preamble == 0) {
+    return tvb_captured_length(tvb);
+  }
+  length = decode_uint32(preamble, tvb_get_ptr(tvb, 0, preamble));
+  len_item = proto_tree_add_uint(fast_tree, hf_fast_block_len, tvb, 0,
+                                 preamble, length);
+  if (block_len_overlong(preamble, length)) {
+    /* get_fast_block_len handed over the rest of the segment */
+    expert_add_info(pinfo, len_item, &ei_fast_stream_overlong);
+    return tvb_captured_length(tvb);
+  }
 
-    fast_data = wmem_new(wmem_file_scope(), fast_conversation_data_t);
+  if (tree || fast_data->book_roles || fast_data->market) {
+    dissect_messages(tvb, pinfo, tree, fast_tree, fast_data, preamble, FALSE);
+  }
 
-    fast_data->templates_table = stor->templates_table;
+  return tvb_captured_length(tvb);
+}
 
-    for(i = 0; i < config_n_port_items; i++) {
-      if(fast_uats[i].port == pinfo->destport)
-        fast_data->flavor = fast_uats[i].flavor;
+/*! \brief  Dissect a TCP stream of back to back messages.
+ *  Where a message ends is only known once it is decoded, a message cut
+ *  by the end of the segment is decoded again with the next segment.
+ */
+int dissect_fast_stream (tvbuff_t* tvb, packet_info* pinfo,
+                         proto_tree* tree,
+                         fast_conversation_data_t* fast_data)
+{
+  packet_data_t* packet_data;
+  proto_item* ti;
+  proto_tree* fast_tree;
+
+  ti = proto_tree_add_item(tree, proto_fast, tvb, 0, -1, ENC_NA);
+  fast_tree = proto_item_add_subtree(ti, ett_fast);
+
+  /* always decoded, the messages tell where the segment is cut */
+  packet_data = dissect_messages(tvb, pinfo, tree, fast_tree, fast_data, 0, TRUE);
+
+  if (packet_data->streamTruncated) {
+    guint held = tvb_captured_length(tvb) - packet_data->streamEnd;
+
+    /* a corrupt message would be held back segment after segment */
+    if (config_max_stream_message && held >= config_max_stream_message) {
+      expert_add_info(pinfo, ti, &ei_fast_stream_overlong);
+    }
+    else if (pinfo->can_desegment) {
+      pinfo->desegment_offset = packet_data->streamEnd;
+      pinfo->desegment_len = DESEGMENT_ONE_MORE_SEGMENT;
+      proto_item_set_len(ti, packet_data->streamEnd);
     }
-    conversation_add_proto_data(conversation, proto_fast, fast_data);
   }
 
-  /* fill in protocol column */
-  if (CHECK_COL(pinfo->cinfo, COL_PROTOCOL))
-    col_set_str(pinfo->cinfo, COL_PROTOCOL, "FAST");
+  return tvb_captured_length(tvb);
+}
 
-  /* clear anything out of the info column */
-  if (CHECK_COL(pinfo->cinfo, COL_INFO))
-    col_clear(pinfo->cinfo, COL_INFO);
+/*! \brief  Decode the messages of a PDU, queue its errors and show them.
+ *  \param tvb packet data
+ *  \param pinfo packet metadata
+ *  \param tree top level tree, NULL when nothing is displayed
+ *  \param fast_tree FAST protocol tree
+ *  \param fast_data conversation (channel) state
+ *  \param offset first byte of the messages
+ *  \param stream TRUE if the last message can be cut by the segment end
+ *  \return the decoded PDU
+ */
+packet_data_t* dissect_messages (tvbuff_t* tvb, packet_info* pinfo,
+                                 proto_tree* tree, proto_tree* fast_tree,
+                                 fast_conversation_data_t* fast_data,
+                                 guint offset, gboolean stream)
+{
+  packet_data_t* packet_data = decode_messages(tvb, pinfo, fast_data, offset, stream);
+
+  if (packet_data->errors) {
+    tap_queue_packet(fast_errors_tap, pinfo, packet_data);
+  }
+
+  /* display only when a tree was asked for */
+  if (tree) {
+    display_messages(tvb, pinfo, fast_tree, packet_data);
+  }
+  return packet_data;
+}
+
+/*! \brief  Decode the messages of a PDU on the first pass, later passes
+ *          get them back from the frame.
+ *  \param tvb packet data
+ *  \param pinfo packet metadata
+ *  \param fast_data conversation (channel) state
+ *  \param offset first byte of the messages
+ *  \param stream TRUE if the last message can be cut by the segment end
+ *  \return the decoded PDU
+ */
+packet_data_t* decode_messages (tvbuff_t* tvb, packet_info* pinfo,
+                                fast_conversation_data_t* fast_data,
+                                guint offset, gboolean stream)
+{
+  guint32 pdu = frame_pdu++;
+  packet_data_t* packet_data = (packet_data_t*) p_get_proto_data(wmem_file_scope(), pinfo, proto_fast, pdu);
+  DissectPosition stacked_position;
+  DissectPosition* position;
+  BookTop book_tops[FAST_MAX_BOOK_TOPS];
+  guint n_book_tops = 0;
+  RecoveryMarks marks;
+  gint64 now;
+
+  /* if this packet has already been dissected, reuse it */
+  if (packet_data) {
+    return packet_data;
+  }
+
+  now = (gint64)pinfo->abs_ts.secs * 1000000000 + pinfo->abs_ts.nsecs;
+  memset(&marks, 0, sizeof(RecoveryMarks));
+
+  /* Store pointers to display tree so it can be
+   * loaded if user clicks on this packet again.
+   */
+  packet_data = (packet_data_t*)wmem_new0(wmem_file_scope(), packet_data_t);
+  packet_data->dataTrees = wmem_list_new(wmem_file_scope());
+  packet_data->tmplTrees = wmem_list_new(wmem_file_scope());
+  packet_data->frameNum = pinfo->fd->num;
+
+  /* decode straight from the frame, a reassembled PDU is the only copy */
+  position = &stacked_position;
+  memset(position, 0, sizeof(DissectPosition));
+  position->offjmp = offset;
+  position->offset = 0;
+  position->nbytes = tvb_captured_length (tvb);
+  position->bytes  = tvb_get_ptr (tvb, 0, position->nbytes);
+
+  ShiftBytes(position);
+
+  while (position->nbytes) {
+    GNode* tmpl;
+    GNode* data = wmem_node_new(wmem_file_scope(), 0);
+    guint64 errors = dissect_stats()->errors;
+    guint message_start = position->offset;
+
+    if (stream) {
+      checkpoint_dictionaries();
+    }
+
+    /* call function in dissect.c that dissects the data */
+    tmpl = dissect_fast_bytes (fast_data->templates_table, position, data, &pinfo->src, &pinfo->dst);
+
+    /* The message continues in the next segment, forget it for now */
+    if (stream && position->overrun) {
+      rollback_dictionaries();
+      packet_data->streamTruncated = TRUE;
+      packet_data->streamEnd = message_start;
+      break;
+    }
+    if (stream) {
+      commit_dictionaries();
+    }
+
+    /* If no template is found for the message make a fake message/template then break out */
+    if(tmpl == NULL){
+      GNode* tnode;
+      GNode* vnode;
+      GNode* dnode;
+      FieldType* tfield;
+      FieldType* vfield;
+      FieldData* fdata;
+
+      /* Create a template that contains one ascii field */
+      tnode = create_field(FieldTypeUInt32, FieldOperatorCopy);
+      tfield = (FieldType*) tnode->data;
+      tfield->name = "Error Template";
+      /* Put the erronous tid in as this templates id */
+      fdata = (FieldData*)data->data;
+      tfield->id = fdata->value.u32;
+      vnode = create_field(FieldTypeAsciiString, FieldOperatorNone);
+      vfield = (FieldType*) vnode->data;
+      vfield->name = "Error Message";
+      vfield->id = 0;
+      vfield->tid = tfield->id;
+      g_node_insert_after(tnode,0,vnode);
+      tmpl = tnode;
+
+      /* Create data for the above template that describes the error */
+      fdata = (FieldData*) wmem_new(wmem_file_scope(), FieldData);
+
+      g_node_unlink(data);
+      data = wmem_node_new(wmem_file_scope(), fdata);
+      fdata->start = 0;
+      fdata->nbytes = 0;
+      fdata->status = FieldEmpty;
+      fdata->value.u32 = -1;
+
+      fdata = (FieldData*) wmem_new(wmem_file_scope(), FieldData);
+      dnode = wmem_node_new(wmem_file_scope(), fdata);
+      g_node_insert_after(data, NULL, dnode);
+      fdata->start = 0;
+      fdata->nbytes = 0;
+
+      /* throw dynamic error D9: template does not exist */
+      err_d(9, fdata);
+      dissect_stats()->errors++;
+
+      /* Stop parsing the packet as we don't know whats going on any more */
+      position->nbytes = 0;
+    }
+    else {
+      if (fast_data->book_roles) {
+        book_apply_message(book_set, fast_data->book_roles, tmpl, data,
+                           book_tops, &n_book_tops, FAST_MAX_BOOK_TOPS);
+      }
+      if (fast_data->market) {
+        recovery_apply_message(fast_data->market, fast_data->recovery_fields,
+                               fast_data->recovery_role, tmpl, data,
+                               pinfo->fd->num, now, &marks);
+      }
+    }
+    if (dissect_stats()->errors != errors) {
+      collect_errors(tmpl->children, data->children, pinfo->fd->num, packet_data);
+    }
+    wmem_list_append(packet_data->dataTrees, data);
+    wmem_list_append(packet_data->tmplTrees, tmpl);
+  }
+
+  /* TODO: Issue 87 should remove this */
+  switch(fast_data->flavor)
+  {
+  case CMEImplem:
+  case UMDFImplem:
+  case  MOEXImplem:
+    /* resets the dictionaries for CME and UMDF between packets */
+    clear_dictionaries(pinfo->src, pinfo->dst);
+    break;
+  }
+
+  if (n_book_tops) {
+    packet_data->bookTops = (BookTop*) wmem_memdup(wmem_file_scope(), book_tops,
+                                                   n_book_tops * sizeof(BookTop));
+    packet_data->nBookTops = n_book_tops;
+  }
+  if (marks.applied || marks.buffered || marks.stale ||
+      marks.sync_points || marks.has_last_msg_seq) {
+    packet_data->recovery = (RecoveryMarks*) wmem_memdup(wmem_file_scope(), &marks,
+                                                         sizeof(RecoveryMarks));
+  }
+
+  p_add_proto_data(wmem_file_scope(), pinfo, proto_fast, pdu, packet_data);
+  return packet_data;
+}
+
+/*! \brief  Show the decoded messages of a PDU.
+ *  \param tvb packet data
+ *  \param pinfo packet metadata
+ *  \param fast_tree FAST protocol tree
+ *  \param packet_data decoded PDU
+ */
+void display_messages (tvbuff_t* tvb, packet_info* pinfo,
+                       proto_tree* fast_tree, packet_data_t* packet_data)
+{
+  wmem_list_frame_t* tmplTrees = wmem_list_head(packet_data->tmplTrees);
+  wmem_list_frame_t* dataTrees = wmem_list_head(packet_data->dataTrees);
+  GNode* template_node;
+  GNode* parent;
+
+  while (tmplTrees && dataTrees) {
+    template_node  = (GNode*) wmem_list_frame_data(tmplTrees);
+    parent         = (GNode*) wmem_list_frame_data(dataTrees);
+    message_error = FALSE;
+    display_message (tvb, fast_tree, template_node, parent, pinfo);
+
+    /* add info to the info column, counting the messages of every PDU */
+    frame_messages++;
+    if (CHECK_COL(pinfo->cinfo, COL_INFO)) {
+      if(message_error) {
+        /* leave error message in info column */
+      } else if(frame_messages > 1) {
+        col_add_fstr(pinfo->cinfo, COL_INFO,"%d messages", frame_messages);
+      } else {
+        /* dig up template name and tid from previously dissected message */
+        col_add_fstr(pinfo->cinfo, COL_INFO,"%s - tid: %d",
+                     ((FieldType *)template_node->data)->name,
+                     ((FieldType *)template_node->data)->id);
+      }
+    }
+
+    tmplTrees = wmem_list_frame_next(tmplTrees);
+    dataTrees = wmem_list_frame_next(dataTrees);
+  }
+
+  display_books(tvb, fast_tree, packet_data);
+  display_recovery(tvb, fast_tree, pinfo, packet_data);
+}
+
+/*! \brief  Dissect the exchange packet header, track its sequence number
+ *          and arbitrate it between the lines of its feed.
+ *  \param tvb packet data
+ *  \param pinfo packet metadata
+ *  \param tree FAST protocol tree, may be NULL
+ *  \param fast_data conversation (channel) state
+ *  \param header_len Return value. Number of header bytes preceding
+ *                    the FAST messages
+ *  \return FALSE if the packet was already received on another line
+ */
+gboolean dissect_feed_header (tvbuff_t* tvb, packet_info* pinfo,
+                              proto_tree* tree,
+                              fast_conversation_data_t* fast_data,
+                              guint* header_len)
+{
+  FeedHeader header;
+  fast_seq_tap_info_t* tap_info;
+  proto_item* seq_item = NULL;
+  SeqVerdict verdict = SeqInOrder;
+  guint32 delta = 0;
+  gboolean first_arrival;
+
+  *header_len = feed_header_length(fast_data->flavor);
+  if (*header_len == 0 || tvb_captured_length(tvb) < *header_len) {
+    return TRUE;
+  }
+
+  parse_feed_header(fast_data->flavor, tvb_get_ptr(tvb, 0, *header_len),
+                    *header_len, &header);
+
+  if (!PINFO_FD_VISITED(pinfo)) {
+    verdict = seq_tracker_update(&fast_data->seq, header.seq_num,
+                                 header.cur_chunk > 1, &delta);
+    /* keep the verdict of anomalous frames only, the rest are in order */
+    if (verdict != SeqInOrder && verdict != SeqFirst) {
+      fast_seq_anomaly_t* anomaly = wmem_new(wmem_file_scope(), fast_seq_anomaly_t);
+      anomaly->verdict = verdict;
+      anomaly->delta = delta;
+      wmem_tree_insert32(fast_data->seq_anomalies, pinfo->fd->num, anomaly);
+    }
+  } else {
+    const fast_seq_anomaly_t* anomaly = (const fast_seq_anomaly_t*)
+      wmem_tree_lookup32(fast_data->seq_anomalies, pinfo->fd->num);
+    if (anomaly) {
+      verdict = anomaly->verdict;
+      delta = anomaly->delta;
+    }
+  }
 
-  /* Only do dissection if we are asked */
   if (tree) {
-    proto_item* ti = proto_tree_add_item(tree, proto_fast, tvb, 0, -1, ENC_NA);
-    proto_tree* fast_tree = proto_item_add_subtree(ti, ett_fast);
-    packet_data_t* packet_data = (packet_data_t*) p_get_proto_data(wmem_file_scope(), pinfo, proto_fast, 0);
-
-    /* if this packet has not been dissected yet, dissect it */
-    if (!packet_data) {
-      DissectPosition stacked_position;
-      DissectPosition* position;
-      guint header_offset = 0;
-
-      /* ignore headers for CME and UMDF */
-      switch(fast_data->flavor)
-      {
+    proto_item* item = proto_tree_add_item(tree, hf_fast_header, tvb, 0, *header_len, ENC_NA);
+    proto_tree* subtree = proto_item_add_subtree(item, ett_fast_header);
+
+    switch (fast_data->flavor) {
       case CMEImplem:
-        header_offset = 5;
+        seq_item = proto_tree_add_item(subtree, hf_fast_seq_num, tvb, 0, 4, ENC_BIG_ENDIAN);
+        proto_tree_add_item(subtree, hf_fast_subchannel, tvb, 4, 1, ENC_BIG_ENDIAN);
         break;
       case UMDFImplem:
-        header_offset = 10;
+        seq_item = proto_tree_add_item(subtree, hf_fast_seq_num, tvb, 0, 4, ENC_BIG_ENDIAN);
+        proto_tree_add_item(subtree, hf_fast_chunks, tvb, 4, 2, ENC_BIG_ENDIAN);
+        proto_tree_add_item(subtree, hf_fast_cur_chunk, tvb, 6, 2, ENC_BIG_ENDIAN);
+        proto_tree_add_item(subtree, hf_fast_chunk_len, tvb, 8, 2, ENC_BIG_ENDIAN);
         break;
       case MOEXImplem:
-        header_offset = 4;
+        seq_item = proto_tree_add_item(subtree, hf_fast_seq_num, tvb, 0, 4, ENC_LITTLE_ENDIAN);
         break;
-      }
+    }
+    if (fast_data->arbiter) {
+      proto_item* line = proto_tree_add_uint(subtree, hf_fast_line, tvb, 0, 0, fast_data->line);
+      PROTO_ITEM_SET_GENERATED(line);
+    }
+    if (verdict == SeqGap) {
+      proto_item* missing = proto_tree_add_uint(subtree, hf_fast_seq_missing, tvb, 0, 0, delta);
+      PROTO_ITEM_SET_GENERATED(missing);
+    }
+  }
 
-      /* Store pointers to display tree so it can be
-       * loaded if user clicks on this packet again.
-       */
-      packet_data = (packet_data_t*)wmem_new0(wmem_file_scope(), packet_data_t);
-      packet_data->dataTrees = wmem_list_new(wmem_file_scope());
-      packet_data->tmplTrees = wmem_list_new(wmem_file_scope());
-      packet_data->frameNum = pinfo->fd->num;
-
-      position = &stacked_position;
-      position->offjmp = header_offset;
-      position->offset = 0;
-      position->nbytes = tvb_reported_length (tvb);
-      position->bytes  = (guint8*)tvb_memdup (wmem_packet_scope(), tvb, 0, position->nbytes);
-
-      ShiftBytes(position);
-
-      while (position->nbytes) {
-        GNode* tmpl;
-        GNode* data = wmem_node_new(wmem_file_scope(), 0);
-
-        /* call function in dissect.c that dissects the data */
-        tmpl = dissect_fast_bytes (fast_data->templates_table, position, data, &pinfo->src, &pinfo->dst);
-
-        /* If no template is found for the message make a fake message/template then break out */
-        if(tmpl == NULL){
-          GNode* tnode;
-          GNode* vnode;
-          GNode* dnode;
-          FieldType* tfield;
-          FieldType* vfield;
-          FieldData* fdata;
-
-          /* Create a template that contains one ascii field */
-          tnode = create_field(FieldTypeUInt32, FieldOperatorCopy);
-          tfield = (FieldType*) tnode->data;
-          tfield->name = "Error Template";
-          /* Put the erronous tid in as this templates id */
-          fdata = (FieldData*)data->data;
-          tfield->id = fdata->value.u32;
-          vnode = create_field(FieldTypeAsciiString, FieldOperatorNone);
-          vfield = (FieldType*) vnode->data;
-          vfield->name = "Error Message";
-          vfield->id = 0;
-          g_node_insert_after(tnode,0,vnode);
-          tmpl = tnode;
-
-          /* Create data for the above template that describes the error */
-          fdata = (FieldData*) wmem_new(wmem_file_scope(), FieldData);
-
-          g_node_unlink(data);
-          data = wmem_node_new(wmem_file_scope(), fdata);
-          fdata->start = 0;
-          fdata->nbytes = 0;
-          fdata->status = FieldEmpty;
-          fdata->value.u32 = -1;
-
-          fdata = (FieldData*) wmem_new(wmem_file_scope(), FieldData);
-          dnode = wmem_node_new(wmem_file_scope(), fdata);
-          g_node_insert_after(data, NULL, dnode);
-          fdata->start = 0;
-          fdata->nbytes = 0;
-
-          /* throw dynamic error D9: template does not exist */
-          err_d(9, fdata);
-
-          /* Stop parsing the packet as we don't know whats going on any more */
-          position->nbytes = 0;
-        }
-        wmem_list_append(packet_data->dataTrees, data);
-        wmem_list_append(packet_data->tmplTrees, tmpl);
-      }
+  switch (verdict) {
+    case SeqGap:
+      expert_add_info_format(pinfo, seq_item, &ei_fast_seq_gap,
+                             "Sequence gap: %u packet(s) missing before %u",
+                             delta, header.seq_num);
+      break;
+    case SeqDuplicate:
+      expert_add_info_format(pinfo, seq_item, &ei_fast_seq_dup,
+                             "Duplicate packet %u", header.seq_num);
+      break;
+    case SeqOutOfOrder:
+      expert_add_info_format(pinfo, seq_item, &ei_fast_seq_ooo,
+                             "Out of order packet %u, %u behind the highest",
+                             header.seq_num, delta);
+      break;
+    case SeqReset:
+      expert_add_info_format(pinfo, seq_item, &ei_fast_seq_reset,
+                             "Sequence number reset to %u", header.seq_num);
+      break;
+    default:
+      break;
+  }
 
-      /* TODO: Issue 87 should remove this */
-      switch(fast_data->flavor)
-      {
-      case CMEImplem:
-      case UMDFImplem:
-      case  MOEXImplem:
-        /* resets the dictionaries for CME and UMDF between packets */
-        clear_dictionaries(pinfo->src, pinfo->dst);
-        break;
-      }
+  first_arrival = arbitrate_lines(tvb, pinfo, tree, fast_data, &header);
 
-      p_add_proto_data(wmem_file_scope(), pinfo, proto_fast, 0, packet_data);
-    }
+  tap_info = wmem_new(wmem_packet_scope(), fast_seq_tap_info_t);
+  tap_info->flavor = fast_data->flavor;
+  tap_info->seq_num = header.seq_num;
+  tap_info->verdict = verdict;
+  tap_info->delta = delta;
+  tap_info->line = fast_data->line;
+  tap_info->arb_duplicate = !first_arrival;
+  tap_queue_packet(fast_tap, pinfo, tap_info);
+
+  return first_arrival;
+}
+
+/*! \brief  Arbitrate a packet between the A/B lines of its feed.
+ *  \param tvb packet data
+ *  \param pinfo packet metadata
+ *  \param tree FAST protocol tree, may be NULL
+ *  \param fast_data conversation (channel) state
+ *  \param header parsed packet header
+ *  \return FALSE if the packet was already received on another line
+ */
+gboolean arbitrate_lines (tvbuff_t* tvb, packet_info* pinfo,
+                          proto_tree* tree,
+                          fast_conversation_data_t* fast_data,
+                          const FeedHeader* header)
+{
+  const fast_arb_duplicate_t* dup;
+
+  if (!fast_data->arbiter || !header->has_seq) {
+    return TRUE;
+  }
 
-    /* scope created to escape compile error due to mixed code and declarations */
+  if (!PINFO_FD_VISITED(pinfo)) {
+    ArbiterSlot first;
+    gint64 now = (gint64)pinfo->abs_ts.secs * 1000000000 + pinfo->abs_ts.nsecs;
+    if (line_arbiter_update(fast_data->arbiter, header, fast_data->line,
+                            pinfo->fd->num, now, &first)) {
+      return TRUE;
+    }
     {
-      wmem_list_frame_t* tmplTrees = wmem_list_head(packet_data->tmplTrees);
-      wmem_list_frame_t* dataTrees = wmem_list_head(packet_data->dataTrees);
-      GNode* template_node;
-      GNode* parent;
-      guint message_cnt = 0;
-
-      while (tmplTrees && dataTrees) {
-        template_node  = (GNode*) wmem_list_frame_data(tmplTrees);
-        parent         = (GNode*) wmem_list_frame_data(dataTrees);
-        message_error = FALSE;
-        display_message (tvb, fast_tree, template_node, parent, pinfo);
-
-        /* add info to the info column */
-        message_cnt++;
-        if (CHECK_COL(pinfo->cinfo, COL_INFO)) {
-          if(message_error) {
-            /* leave error message in info column */
-          } else if(message_cnt > 1) {
-            col_add_fstr(pinfo->cinfo, COL_INFO,"%d messages", message_cnt);
-          } else {
-            /* dig up template name and tid from previously dissected message */
-            col_add_fstr(pinfo->cinfo, COL_INFO,"%s - tid: %d",
-                         ((FieldType *)template_node->data)->name,
-                         ((FieldType *)template_node->data)->id);
-          }
-        }
+      fast_arb_duplicate_t* rec = wmem_new(wmem_file_scope(), fast_arb_duplicate_t);
+      gint64 delta = now - first.ts;
+      rec->first_frame = first.frame;
+      rec->first_line = first.line;
+      rec->delta.secs = (time_t)(delta / 1000000000);
+      rec->delta.nsecs = (int)(delta % 1000000000);
+      wmem_tree_insert32(fast_data->arb_duplicates, pinfo->fd->num, rec);
+    }
+  }
+
+  dup = (const fast_arb_duplicate_t*)
+    wmem_tree_lookup32(fast_data->arb_duplicates, pinfo->fd->num);
+  if (!dup) {
+    return TRUE;
+  }
+
+  if (tree) {
+    proto_item* item;
+    item = proto_tree_add_uint(tree, hf_fast_arb_first, tvb, 0, 0, dup->first_frame);
+    PROTO_ITEM_SET_GENERATED(item);
+    item = proto_tree_add_time(tree, hf_fast_arb_delta, tvb, 0, 0, &dup->delta);
+    proto_item_append_text(item, " behind line %s", feed_line_name(dup->first_line));
+    PROTO_ITEM_SET_GENERATED(item);
+  }
+
+  if (CHECK_COL(pinfo->cinfo, COL_INFO)) {
+    col_add_fstr(pinfo->cinfo, COL_INFO, "Line %s duplicate of frame %u (+%.6f s)",
+                 feed_line_name(fast_data->line), dup->first_frame,
+                 nstime_to_sec(&dup->delta));
+  }
+  return FALSE;
+}
+
+/*! \brief  Show the top of the books a packet touched.
+ *  \param tvb packet data
+ *  \param tree FAST protocol tree
+ *  \param packet_data decoded packet
+ */
+void display_books (tvbuff_t* tvb, proto_tree* tree,
+                    const packet_data_t* packet_data)
+{
+  guint i;
+
+  for (i = 0; i < packet_data->nBookTops; i++) {
+    const BookTop* top = &packet_data->bookTops[i];
+    proto_item* item;
+    proto_tree* subtree;
+
+    item = proto_tree_add_none_format(tree, hf_fast_book, tvb, 0, 0,
+                                      "Order book - SecurityID %" G_GINT64_MODIFIER "u",
+                                      top->security_id);
+    PROTO_ITEM_SET_GENERATED(item);
+    subtree = proto_item_add_subtree(item, ett_fast_book);
+
+    proto_tree_add_uint64(subtree, hf_fast_book_security_id, tvb, 0, 0, top->security_id);
+    if (top->depth[BookBid]) {
+      proto_tree_add_double(subtree, hf_fast_book_bid, tvb, 0, 0,
+                            book_level_price(&top->best[BookBid]));
+      proto_tree_add_int64(subtree, hf_fast_book_bid_size, tvb, 0, 0,
+                           top->best[BookBid].size);
+    }
+    if (top->depth[BookAsk]) {
+      proto_tree_add_double(subtree, hf_fast_book_ask, tvb, 0, 0,
+                            book_level_price(&top->best[BookAsk]));
+      proto_tree_add_int64(subtree, hf_fast_book_ask_size, tvb, 0, 0,
+                           top->best[BookAsk].size);
+    }
+    if (top->depth[BookBid] && top->depth[BookAsk]) {
+      proto_tree_add_double(subtree, hf_fast_book_spread, tvb, 0, 0,
+                            book_level_price(&top->best[BookAsk]) -
+                            book_level_price(&top->best[BookBid]));
+    }
+    proto_tree_add_string_format_value(subtree, hf_fast_book_depth, tvb, 0, 0, "",
+                                       "%u bid, %u ask",
+                                       top->depth[BookBid], top->depth[BookAsk]);
+  }
+}
+
+/*! \brief  Show where the packet leaves a recovering consumer.
+ *  \param tvb packet data
+ *  \param tree FAST protocol tree
+ *  \param pinfo packet metadata
+ *  \param packet_data decoded packet
+ */
+void display_recovery (tvbuff_t* tvb, proto_tree* tree,
+                       packet_info* pinfo,
+                       const packet_data_t* packet_data)
+{
+  const RecoveryMarks* marks = packet_data->recovery;
+  proto_item* item;
+  proto_tree* subtree;
+  nstime_t latency;
+
+  if (!marks) {
+    return;
+  }
+
+  item = proto_tree_add_item(tree, hf_fast_recovery, tvb, 0, 0, ENC_NA);
+  PROTO_ITEM_SET_GENERATED(item);
+  subtree = proto_item_add_subtree(item, ett_fast_recovery);
+
+  if (marks->sync_points) {
+    proto_tree_add_uint(subtree, hf_fast_recovery_synced, tvb, 0, 0, marks->sync_points);
+    proto_tree_add_uint(subtree, hf_fast_recovery_replayed, tvb, 0, 0, marks->replayed);
+    latency.secs = (time_t)(marks->latency / 1000000000);
+    latency.nsecs = (int)(marks->latency % 1000000000);
+    proto_tree_add_time(subtree, hf_fast_recovery_latency, tvb, 0, 0, &latency);
+    expert_add_info_format(pinfo, item, &ei_fast_recovery_sync,
+                           "Synchronization point for %u instrument(s)",
+                           marks->sync_points);
+  }
+  if (marks->has_last_msg_seq) {
+    proto_tree_add_uint(subtree, hf_fast_recovery_last_msg_seq, tvb, 0, 0, marks->last_msg_seq);
+  }
+  if (marks->applied) {
+    proto_tree_add_uint(subtree, hf_fast_recovery_applied, tvb, 0, 0, marks->applied);
+  }
+  if (marks->buffered) {
+    proto_tree_add_uint(subtree, hf_fast_recovery_buffered, tvb, 0, 0, marks->buffered);
+  }
+  if (marks->stale) {
+    proto_tree_add_uint(subtree, hf_fast_recovery_stale, tvb, 0, 0, marks->stale);
+  }
+  if (marks->gaps) {
+    expert_add_info_format(pinfo, item, &ei_fast_recovery_gap,
+                           "RptSeq gap on %u instrument(s), waiting for a snapshot",
+                           marks->gaps);
+  }
+  if (marks->market_synced) {
+    latency.secs = (time_t)(marks->market_latency / 1000000000);
+    latency.nsecs = (int)(marks->market_latency % 1000000000);
+    proto_tree_add_time(subtree, hf_fast_recovery_market_latency, tvb, 0, 0, &latency);
+    expert_add_info(pinfo, item, &ei_fast_recovery_market);
+  }
+}
+
+/****** Dynamic errors ******/
+
+/*! \brief  Record the fields of a decoded message that have a dynamic error.
+ *  \param tnode first template field
+ *  \param dnode first data field
+ *  \param frame frame number of the packet
+ *  \param packet_data decoded packet, its error list is filled
+ */
+void collect_errors (const GNode* tnode, const GNode* dnode,
+                     guint32 frame, packet_data_t* packet_data)
+{
+  while (tnode && dnode) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* fdata = (const FieldData*) dnode->data;
 
-        tmplTrees = wmem_list_frame_next(tmplTrees);
-        dataTrees = wmem_list_frame_next(dataTrees);
+    if (fdata && fdata->status == FieldError) {
+      record_error(ftype, fdata, frame, packet_data);
+    }
+    else if (fdata && fdata->status == FieldExists) {
+      if (ftype->type == FieldTypeGroup) {
+        collect_errors(tnode->children, dnode->children, frame, packet_data);
+      }
+      else if (ftype->type == FieldTypeSequence &&
+               tnode->children && tnode->children->next) {
+        const GNode* element;
+        for (element = dnode->children; element; element = element->next) {
+          collect_errors(tnode->children->next->children, element->children,
+                         frame, packet_data);
+        }
       }
     }
+
+    tnode = tnode->next;
+    dnode = dnode->next;
+  }
+}
+
+/*! \brief  Log a dynamic error, its count is the one of the error log.
+ */
+void record_error (const FieldType* ftype, const FieldData* fdata,
+                   guint32 frame, packet_data_t* packet_data)
+{
+  ErrorCount* count = fast_log_dynamic_error(ftype, fdata);
+
+  if (count->seen == 1) {
+    count->first_frame = frame;
   }
+  count->last_frame = frame;
 
-  return tvb_reported_length(tvb);
+  if (!packet_data->errors) {
+    packet_data->errors = wmem_list_new(wmem_file_scope());
+  }
+  wmem_list_append(packet_data->errors, count);
+}
+
+static const gchar* st_str_errors = "FAST/Dynamic Errors";
+
+static int fast_errors_stats_tree_packet (stats_tree* st, packet_info* pinfo _U_,
+                                          epan_dissect_t* edt _U_, const void* p)
+{
+  const packet_data_t* packet_data = (const packet_data_t*) p;
+  wmem_list_frame_t* frame;
+
+  /* one node per D-code, one child per template and field */
+  for (frame = wmem_list_head(packet_data->errors); frame; frame = wmem_list_frame_next(frame)) {
+    const ErrorCount* count = (const ErrorCount*) wmem_list_frame_data(frame);
+    int code_node = tick_stat_node(st, err_d_message(count->code), 0, TRUE);
+    const gchar* field = wmem_strdup_printf(wmem_packet_scope(), "template %d, %s (%d)",
+                                            count->tid,
+                                            count->field_name ? count->field_name : UNNAMED,
+                                            count->field_id);
+    tick_stat_node(st, field, code_node, FALSE);
+  }
+  return 1;
+}
+
+/****** Sequence gap statistics ******/
+static const gchar* st_str_seq      = "FAST/Sequence Gaps";
+static const gchar* st_str_packets  = "Packets";
+static const gchar* st_str_gaps     = "Gaps";
+static const gchar* st_str_missing  = "Missing packets";
+static const gchar* st_str_dups     = "Duplicates";
+static const gchar* st_str_ooo      = "Out of order";
+static const gchar* st_str_resets   = "Resets";
+static const gchar* st_str_arb      = "Arbitration";
+
+static int st_node_packets = -1;
+static int st_node_gaps    = -1;
+static int st_node_missing = -1;
+static int st_node_dups    = -1;
+static int st_node_ooo     = -1;
+static int st_node_resets  = -1;
+static int st_node_arb     = -1;
+
+static void fast_seq_stats_tree_init (stats_tree* st)
+{
+  st_node_packets = stats_tree_create_node(st, st_str_packets, 0, TRUE);
+  st_node_gaps    = stats_tree_create_node(st, st_str_gaps, 0, TRUE);
+  st_node_missing = stats_tree_create_node(st, st_str_missing, 0, TRUE);
+  st_node_dups    = stats_tree_create_node(st, st_str_dups, 0, TRUE);
+  st_node_ooo     = stats_tree_create_node(st, st_str_ooo, 0, TRUE);
+  st_node_resets  = stats_tree_create_node(st, st_str_resets, 0, TRUE);
+  st_node_arb     = stats_tree_create_node(st, st_str_arb, 0, TRUE);
+}
+
+static int fast_seq_stats_tree_packet (stats_tree* st, packet_info* pinfo,
+                                       epan_dissect_t* edt _U_, const void* p)
+{
+  const fast_seq_tap_info_t* info = (const fast_seq_tap_info_t*) p;
+  /* one child per channel, named after its destination */
+  const gchar* channel = wmem_strdup_printf(wmem_packet_scope(), "%s:%u",
+                                            address_to_str(wmem_packet_scope(), &pinfo->dst),
+                                            pinfo->destport);
+
+  tick_stat_node(st, st_str_packets, 0, FALSE);
+  tick_stat_node(st, channel, st_node_packets, FALSE);
+
+  switch (info->verdict) {
+    case SeqGap:
+      tick_stat_node(st, st_str_gaps, 0, FALSE);
+      tick_stat_node(st, channel, st_node_gaps, FALSE);
+      increase_stat_node(st, st_str_missing, 0, FALSE, info->delta);
+      increase_stat_node(st, channel, st_node_missing, FALSE, info->delta);
+      break;
+    case SeqDuplicate:
+      tick_stat_node(st, st_str_dups, 0, FALSE);
+      tick_stat_node(st, channel, st_node_dups, FALSE);
+      break;
+    case SeqOutOfOrder:
+      tick_stat_node(st, st_str_ooo, 0, FALSE);
+      tick_stat_node(st, channel, st_node_ooo, FALSE);
+      break;
+    case SeqReset:
+      tick_stat_node(st, st_str_resets, 0, FALSE);
+      tick_stat_node(st, channel, st_node_resets, FALSE);
+      break;
+    default:
+      break;
+  }
+
+  /* which line delivered each packet first */
+  if (info->line != LineNone) {
+    tick_stat_node(st, st_str_arb, 0, FALSE);
+    tick_stat_node(st, info->arb_duplicate ? "Duplicates" : (info->line == LineA ? "Line A first" : "Line B first"),
+                   st_node_arb, FALSE);
+  }
+  return 1;
+}
+
+/*! \brief  Register the statistics trees fed by the "fast" tap.
+ */
+void register_fast_stat_trees (void)
+{
+  stats_tree_register_plugin("fast", "fast_seq", st_str_seq, 0,
+                             fast_seq_stats_tree_packet,
+                             fast_seq_stats_tree_init, NULL);
+  /* errors are only known once messages are decoded, which needs a tree */
+  stats_tree_register_plugin("fast_errors", "fast_errors", st_str_errors, TL_REQUIRES_PROTO_TREE,
+                             fast_errors_stats_tree_packet,
+                             NULL, NULL);
 }
 
 
@@ -663,6 +2311,13 @@ void display_message (tvbuff_t* tvb, proto_tree* tree,
     }
 
     /* add message information to the proto_tree */
+    if (ftype->skip) {
+      /* no fields were built */
+      proto_tree_add_none_format(tree, hf_fast_tid, tvb,
+                                 fdata->start, fdata->nbytes,
+                                 "%s - tid: %d [skipped]", field_name, ftype->id);
+      return;
+    }
     item = proto_tree_add_none_format(tree, hf_fast_tid, tvb,
                                       fdata->start, fdata->nbytes,
                                       "%s - tid: %d", field_name, ftype->id);
@@ -697,7 +2352,9 @@ void display_fields (tvbuff_t* tvb, proto_tree* tree,
     const char* field_name = ftype->name ? ftype->name : UNNAMED;
     /* Generate optional field_info string */
     char* field_inf = generate_field_info(ftype);
-    char* decimal_num = NULL;
+    char decimal_num[DECIMAL_STRING_MAX];
+    proto_item* value_item;
+    proto_item* error_item;
 
     if (ftype->type < FieldTypeEnumLimit) {
       header_field = hf_fast[ftype->type];
@@ -749,11 +2406,7 @@ void display_fields (tvbuff_t* tvb, proto_tree* tree,
           break;
 
         case FieldTypeDecimal:
-          if(!sciNotation)
-            /* get the decimal representation of the field */
-            decimal_num = to_decimal(fdata->value.decimal.exponent, fdata->value.decimal.mantissa);
-
-          if(sciNotation || !decimal_num) {
+          if(sciNotation || !decimal_to_string(&fdata->value.decimal, decimal_num)) {
             proto_tree_add_none_format(tree, header_field, tvb,
                                      fdata->start, fdata->nbytes,
                                      "decimal - %s (%d)%s: %" G_GINT64_MODIFIER "de%d",
@@ -771,6 +2424,11 @@ void display_fields (tvbuff_t* tvb, proto_tree* tree,
                                      field_inf,
                                      decimal_num);
           }
+          /* typed value, so filters can compare prices */
+          value_item = proto_tree_add_double(tree, hf_fast_decimal_value, tvb,
+                                             fdata->start, fdata->nbytes,
+                                             decimal_to_double(&fdata->value.decimal));
+          PROTO_ITEM_SET_HIDDEN(value_item);
           break;
 
         case FieldTypeAsciiString:
@@ -883,20 +2541,34 @@ void display_fields (tvbuff_t* tvb, proto_tree* tree,
       header_field = hf_fast[FieldTypeError];
       message_error = TRUE;
 
-      proto_tree_add_none_format(tree, header_field, tvb, 0, 0,
+      error_item = proto_tree_add_none_format(tree, header_field, tvb, 0, 0,
                                  "%s - %s (%d): %s",
                                  "ERROR",
                                  field_name,
                                  ftype->id,
                                  fdata->value.ascii.bytes);
 
+      if (fdata->error >= 1 && fdata->error <= ErrDCount) {
+        const ErrorCount* count = fast_error_count(ftype, fdata);
+        proto_tree* error_tree = proto_item_add_subtree(error_item, ett_fast_error);
+
+        expert_add_info(pinfo, error_item, &ei_fast_err_d[fdata->error - 1]);
+        value_item = proto_tree_add_uint(error_tree, hf_fast_error_code, tvb, 0, 0, fdata->error);
+        PROTO_ITEM_SET_GENERATED(value_item);
+        if (count) {
+          value_item = proto_tree_add_uint(error_tree, hf_fast_error_count, tvb, 0, 0, (guint32) count->seen);
+          PROTO_ITEM_SET_GENERATED(value_item);
+          value_item = proto_tree_add_uint(error_tree, hf_fast_error_first, tvb, 0, 0, count->first_frame);
+          PROTO_ITEM_SET_GENERATED(value_item);
+          value_item = proto_tree_add_uint(error_tree, hf_fast_error_last, tvb, 0, 0, count->last_frame);
+          PROTO_ITEM_SET_GENERATED(value_item);
+        }
+      }
 
       /* display error message in info column */
       if(CHECK_COL(pinfo->cinfo, COL_INFO)) {
         col_add_fstr(pinfo->cinfo, COL_INFO, "%s", fdata->value.ascii.bytes);
       }
-
-      fast_log_dynamic_error(ftype, fdata);
     }
 
     tnode = tnode->next;
@@ -967,80 +2639,6 @@ char * generate_field_info(const FieldType* ftype){
 }
 
 
-#define MaxMant 21 /* max char length (decimal) of 64bit number including sign */
-#define MaxExpt 10
-/*! \brief takes an exponent and mantissa and converts it into a decimal in a string
- *  \param expt exponent of decimal number
- *  \param mant mantissa of decimal number
- *  \return string representation of decimal number
- */
-char* to_decimal(gint32 expt, gint64 mant)
-{
-  char zeros[MaxExpt+1]; /*array to hold zero padding */
-  char neg[2]; /* array to hold negative sign or null string*/
-  int i;
-
-  if(expt == 0)
-    return wmem_strdup(wmem_file_scope(), "1");
-
-  if(expt < -MaxExpt || expt > MaxExpt)
-    return NULL;
-
-  /* Char* to hold string represenation of mant */
-
-  if(expt < 0) {
-    char* result = (char*) wmem_alloc(wmem_file_scope(), sizeof(char)*MaxMant);
-    char left [MaxExpt+2];
-    char right [MaxMant];
-    int point;
-    int len;
-    int r;
-
-    expt = (-1)*expt; /*abs(expt) */
-    if(mant < 0) {
-      mant = (-1) * mant;
-      neg[0]='-'; neg[1]='\0';
-    } else {
-      neg[0]='\0';
-    }
-    len = sprintf (result, "%" G_GINT64_MODIFIER "d", mant); /* print base to string and get length */
-    point = len - expt; /* figure out where the decimal should be */
-    if(point > 0) { /*point in middle of base */
-      /* break into two parts and put back together */
-      for(i = 0; i < point; i++)
-        left[i] = result[i];
-
-      left[i]='\0';
-
-      r = 0;
-      for(i = point; i < MaxMant; i++, r++) {
-        right[r] = result[i];
-        if(result[i] == '\0')
-            break;
-      }
-      sprintf(result, "%s%s.%s", neg, left, right);
-    } else { /* point to left of base */
-      point = (-1)*point;
-      /* gen zeros for left of base */
-      for(i = 0; i < point; i++)
-        zeros[i] = '0';
-
-      zeros[i] = '\0';
-      sprintf(right, "%s.%s%s", neg, zeros, result);
-      sprintf(result, "%s", right);
-    }
-
-    return result;
-  } else {
-    /* gen zeros to pad right side of base */
-    for(i = 0; i < expt; i++)
-      zeros[i] = '0';
-
-    zeros[i] = '\0';
-
-    return wmem_strdup_printf(wmem_packet_scope(), "%" G_GINT64_MODIFIER "d%s", mant, zeros);
-  }
-}
 
 /*
  * Local Variables:
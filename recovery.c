@@ -0,0 +1,316 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file recovery.c
+ * \brief  Snapshot/incremental recovery of a market.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "debug.h"
+#include "template.h"
+#include "basic-dissect.h"
+#include "recovery.h"
+
+static const char* default_field_names[RecoveryFieldEnumLimit] =
+{
+  NULL,
+  "SecurityID",
+  "RptSeq",
+  "LastMsgSeqNumProcessed"
+};
+
+/*! \brief  Values of one market data entry.
+ */
+struct recovery_entry_struct
+{
+  gboolean has[RecoveryFieldEnumLimit];
+  gboolean nested;
+  guint64  security_id;
+  guint32  rpt_seq;
+  guint32  last_msg_seq;
+};
+typedef struct recovery_entry_struct RecoveryEntry;
+
+struct recovery_resolve_struct
+{
+  wmem_map_t* fields;
+  const RecoveryFieldNames* names;
+  gboolean has_rpt_seq;
+};
+
+static gboolean resolve_field (GNode* node, gpointer data);
+static void gather_entry (RecoveryMarket* market, wmem_map_t* fields,
+                          guint8 role, const GNode* tnode, const GNode* dnode,
+                          RecoveryEntry* entry, guint32 frame, gint64 ts,
+                          RecoveryMarks* marks);
+static gboolean field_as_uint (const FieldType* ftype, const FieldData* fdata,
+                               guint64* result);
+static void apply_entry (RecoveryMarket* market, guint8 role,
+                         const RecoveryEntry* entry, guint32 frame, gint64 ts,
+                         RecoveryMarks* marks);
+
+wmem_map_t* recovery_resolve_fields (wmem_allocator_t* scope, GNode* templates,
+                                     const RecoveryFieldNames* fields)
+{
+  struct recovery_resolve_struct resolve;
+
+  if (!templates) {
+    return NULL;
+  }
+
+  resolve.fields = wmem_map_new(scope, g_direct_hash, g_direct_equal);
+  resolve.names = fields;
+  resolve.has_rpt_seq = FALSE;
+
+  g_node_traverse(templates, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+                  resolve_field, &resolve);
+
+  if (!resolve.has_rpt_seq) {
+    return NULL;
+  }
+  return resolve.fields;
+}
+
+RecoveryMarket* recovery_market_new (wmem_allocator_t* scope)
+{
+  RecoveryMarket* market = wmem_new0(scope, RecoveryMarket);
+  market->scope = scope;
+  market->instruments = wmem_map_new(scope, g_int64_hash, g_int64_equal);
+  return market;
+}
+
+void recovery_apply_message (RecoveryMarket* market, wmem_map_t* fields,
+                             guint8 role, const GNode* tmpl, const GNode* data,
+                             guint32 frame, gint64 ts, RecoveryMarks* marks)
+{
+  RecoveryEntry entry;
+
+  if (!market || !fields || !tmpl || !data || role == RecoveryNone) {
+    return;
+  }
+
+  if (!market->started && role == RecoveryIncremental) {
+    market->started = TRUE;
+    market->start_ts = ts;
+  }
+
+  memset(&entry, 0, sizeof(RecoveryEntry));
+  gather_entry(market, fields, role, tmpl->children, data->children,
+               &entry, frame, ts, marks);
+
+  if (!entry.nested) {
+    apply_entry(market, role, &entry, frame, ts, marks);
+  }
+
+  if (!market->all_synced && market->started &&
+      market->n_instruments && market->n_synced == market->n_instruments) {
+    market->all_synced = TRUE;
+    marks->market_synced = TRUE;
+    marks->market_latency = ts - market->start_ts;
+  }
+}
+
+/*! \brief  g_node_traverse callback, record the recovery fields.
+ */
+gboolean resolve_field (GNode* node, gpointer data)
+{
+  struct recovery_resolve_struct* resolve = (struct recovery_resolve_struct*) data;
+  const FieldType* ftype = (const FieldType*) node->data;
+  gint field;
+
+  if (!ftype || !ftype->name) {
+    return FALSE;
+  }
+
+  for (field = RecoveryFieldSecurityID; field < RecoveryFieldEnumLimit; ++field) {
+    const char* name = resolve->names ? resolve->names->names[field] : NULL;
+    if (!name || !name[0]) {
+      name = default_field_names[field];
+    }
+    if (strcmp(ftype->name, name) == 0) {
+      wmem_map_insert(resolve->fields, ftype, GINT_TO_POINTER(field));
+      if (field == RecoveryFieldRptSeq) {
+        resolve->has_rpt_seq = TRUE;
+      }
+      break;
+    }
+  }
+  return FALSE;
+}
+
+/*! \brief  Walk sibling fields, every sequence element is an entry.
+ */
+void gather_entry (RecoveryMarket* market, wmem_map_t* fields,
+                   guint8 role, const GNode* tnode, const GNode* dnode,
+                   RecoveryEntry* entry, guint32 frame, gint64 ts,
+                   RecoveryMarks* marks)
+{
+  while (tnode && dnode) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* fdata = (const FieldData*) dnode->data;
+
+    if (fdata && fdata->status == FieldExists) {
+      gint field = GPOINTER_TO_INT(wmem_map_lookup(fields, ftype));
+      guint64 n;
+
+      if (field != RecoveryFieldNone && field_as_uint(ftype, fdata, &n)) {
+        switch (field) {
+          case RecoveryFieldSecurityID:
+            entry->security_id = n;
+            break;
+          case RecoveryFieldRptSeq:
+            entry->rpt_seq = (guint32) n;
+            break;
+          case RecoveryFieldLastMsgSeqNum:
+            entry->last_msg_seq = (guint32) n;
+            break;
+        }
+        entry->has[field] = TRUE;
+      }
+
+      if (ftype->type == FieldTypeGroup) {
+        gather_entry(market, fields, role, tnode->children, dnode->children,
+                     entry, frame, ts, marks);
+      }
+      else if (ftype->type == FieldTypeSequence &&
+               tnode->children && tnode->children->next) {
+        const GNode* group_tnode = tnode->children->next;
+        const GNode* element;
+
+        for (element = dnode->children; element; element = element->next) {
+          RecoveryEntry nested = *entry;
+          nested.nested = FALSE;
+          gather_entry(market, fields, role, group_tnode->children,
+                       element->children, &nested, frame, ts, marks);
+          if (!nested.nested) {
+            apply_entry(market, role, &nested, frame, ts, marks);
+          }
+        }
+        entry->nested = TRUE;
+      }
+    }
+
+    tnode = tnode->next;
+    dnode = dnode->next;
+  }
+}
+
+gboolean field_as_uint (const FieldType* ftype, const FieldData* fdata,
+                        guint64* result)
+{
+  switch (ftype->type) {
+    case FieldTypeUInt32:
+      *result = fdata->value.u32;
+      return TRUE;
+    case FieldTypeUInt64:
+      *result = fdata->value.u64;
+      return TRUE;
+    case FieldTypeInt32:
+      *result = (guint64) fdata->value.i32;
+      return TRUE;
+    case FieldTypeInt64:
+      *result = (guint64) fdata->value.i64;
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/*! \brief  Move an instrument through the recovery states.
+ */
+void apply_entry (RecoveryMarket* market, guint8 role,
+                  const RecoveryEntry* entry, guint32 frame, gint64 ts,
+                  RecoveryMarks* marks)
+{
+  RecoveryInstrument* inst;
+
+  if (role == RecoverySnapshot && entry->has[RecoveryFieldLastMsgSeqNum]) {
+    marks->has_last_msg_seq = TRUE;
+    marks->last_msg_seq = entry->last_msg_seq;
+  }
+
+  if (!entry->has[RecoveryFieldSecurityID] || !entry->has[RecoveryFieldRptSeq]) {
+    return;
+  }
+
+  inst = (RecoveryInstrument*) wmem_map_lookup(market->instruments, &entry->security_id);
+  if (!inst) {
+    inst = wmem_new0(market->scope, RecoveryInstrument);
+    inst->security_id = entry->security_id;
+    wmem_map_insert(market->instruments, &inst->security_id, inst);
+    market->n_instruments++;
+  }
+
+  if (role == RecoverySnapshot) {
+    if (!inst->synced) {
+      /* a consumer can synchronize the instrument here */
+      inst->synced = TRUE;
+      market->n_synced++;
+      marks->sync_points++;
+      marks->replayed += inst->buffered;
+      if (inst->buffered) {
+        marks->latency = MAX(marks->latency, ts - inst->first_buffered_ts);
+      }
+      inst->buffered = 0;
+    }
+    if (entry->rpt_seq > inst->rpt_seq) {
+      inst->rpt_seq = entry->rpt_seq;
+    }
+    return;
+  }
+
+  if (!inst->synced) {
+    if (inst->buffered == 0) {
+      inst->first_buffered_frame = frame;
+      inst->first_buffered_ts = ts;
+    }
+    inst->buffered++;
+    marks->buffered++;
+    return;
+  }
+
+  if (entry->rpt_seq <= inst->rpt_seq) {
+    marks->stale++;
+  }
+  else if (entry->rpt_seq == inst->rpt_seq + 1) {
+    inst->rpt_seq = entry->rpt_seq;
+    marks->applied++;
+  }
+  else {
+    /* lost an update, wait for the next snapshot */
+    inst->synced = FALSE;
+    market->n_synced--;
+    inst->buffered = 1;
+    inst->first_buffered_frame = frame;
+    inst->first_buffered_ts = ts;
+    marks->gaps++;
+    marks->buffered++;
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * tab-width: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
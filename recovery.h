@@ -0,0 +1,134 @@
+/*
+* This file is part of FAST Wireshark.
+*
+* FAST Wireshark is free software: you can redistribute it and/or modify
+* it under the terms of the Lesser GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* FAST Wireshark is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* Lesser GNU General Public License for more details.
+*
+* You should have received a copy of the Lesser GNU General Public License
+* along with FAST Wireshark.  If not, see
+* <http://www.gnu.org/licenses/lgpl.txt>.
+*/
+
+/*!
+ * \file recovery.h
+ * \brief  Snapshot/incremental recovery of a market.
+ *  Models a consumer joining a market late: incremental refreshes are
+ *  buffered per instrument until a snapshot of the instrument arrives,
+ *  after which incrementals with a higher RptSeq are applied. Keeps a
+ *  fixed amount of state per instrument.
+ */
+
+#ifndef RECOVERY_H_INCLUDED_
+#define RECOVERY_H_INCLUDED_
+
+#include <glib.h>
+#include <epan/wmem/wmem.h>
+
+/*! \brief Role of a channel in the recovery of its market.
+ */
+enum RecoveryRole { RecoveryNone, RecoveryIncremental, RecoverySnapshot };
+
+/*! \brief Fields the recovery is driven by.
+ */
+enum recovery_field_enum
+{
+  RecoveryFieldNone,
+  RecoveryFieldSecurityID,
+  RecoveryFieldRptSeq,
+  RecoveryFieldLastMsgSeqNum,
+  RecoveryFieldEnumLimit
+};
+typedef enum recovery_field_enum RecoveryField;
+
+/*! \brief Field names to look for, indexed by RecoveryField.
+ *         NULL or empty entries use the FIX tag name.
+ */
+struct recovery_field_names_struct
+{
+  const char* names[RecoveryFieldEnumLimit];
+};
+typedef struct recovery_field_names_struct RecoveryFieldNames;
+
+/*! \brief Recovery state of one instrument.
+ */
+struct recovery_instrument_struct
+{
+  guint64  security_id;
+  guint32  rpt_seq;          /*!< Last RptSeq applied. */
+  gboolean synced;
+  guint32  buffered;         /*!< Incrementals waiting for a snapshot. */
+  guint32  first_buffered_frame;
+  gint64   first_buffered_ts;
+};
+typedef struct recovery_instrument_struct RecoveryInstrument;
+
+/*! \brief Recovery state of a market (snapshot plus incremental channels).
+ */
+struct recovery_market_struct
+{
+  wmem_allocator_t* scope;
+  wmem_map_t* instruments;   /*!< security id -> RecoveryInstrument */
+  guint    n_instruments;
+  guint    n_synced;
+  gboolean started;
+  gint64   start_ts;         /*!< First incremental seen. */
+  gboolean all_synced;       /*!< Every known instrument was synced once. */
+};
+typedef struct recovery_market_struct RecoveryMarket;
+
+/*! \brief What happened to the entries of a packet.
+ */
+struct recovery_marks_struct
+{
+  guint    applied;      /*!< Incrementals a synced consumer applies. */
+  guint    buffered;     /*!< Incrementals waiting for a snapshot. */
+  guint    stale;        /*!< Incrementals already in the snapshot. */
+  guint    gaps;         /*!< RptSeq gaps, instrument lost sync. */
+  guint    sync_points;  /*!< Instruments synchronized by this packet. */
+  guint32  replayed;     /*!< Buffered incrementals released by the sync. */
+  gint64   latency;      /*!< Longest wait of an instrument synced here. */
+  gboolean has_last_msg_seq;
+  guint32  last_msg_seq; /*!< LastMsgSeqNumProcessed of the snapshot. */
+  gboolean market_synced;  /*!< Last instrument of the market synced. */
+  gint64   market_latency; /*!< Time since the first incremental. */
+};
+typedef struct recovery_marks_struct RecoveryMarks;
+
+/*! \brief  Find the SecurityID, RptSeq and LastMsgSeqNumProcessed fields.
+ * \param scope  Scope the returned map lives in.
+ * \param templates  Root of the templates tree.
+ * \param fields  Field names to look for.
+ * \return  Map of FieldType pointer -> role, NULL if no template
+ *          has an RptSeq field.
+ */
+wmem_map_t* recovery_resolve_fields (wmem_allocator_t* scope, GNode* templates,
+                                     const RecoveryFieldNames* fields);
+
+/*! \brief  Create the recovery state of a market.
+ * \param scope  Scope the state lives in, usually the capture file.
+ * \return  The new market.
+ */
+RecoveryMarket* recovery_market_new (wmem_allocator_t* scope);
+
+/*! \brief  Account a decoded message of a snapshot or incremental channel.
+ * \param market  Market state.
+ * \param fields  Map returned by recovery_resolve_fields.
+ * \param role  RecoveryIncremental or RecoverySnapshot.
+ * \param tmpl  Template of the message.
+ * \param data  Decoded message.
+ * \param frame  Frame number of the packet.
+ * \param ts  Arrival time in nanoseconds.
+ * \param marks  Return value, accumulated over the messages of a packet.
+ */
+void recovery_apply_message (RecoveryMarket* market, wmem_map_t* fields,
+                             guint8 role, const GNode* tmpl, const GNode* data,
+                             guint32 frame, gint64 ts, RecoveryMarks* marks);
+
+#endif
@@ -26,7 +26,6 @@
 #include "decode.h"
 #include "template.h"
 
-static gboolean requires_pmap_bit (const FieldType* ftype);
 static void fixup_walk_template (FieldType* parent, GNode* parent_node);
 
 wmem_map_t* create_templates_table(GNode* templates)
@@ -95,6 +94,7 @@ GNode* create_field (FieldTypeIdentifier type,
   field->hasDefault = FALSE;
   init_field_value(&field->value);
   field->dictionary = 0;
+  field->skip       = FALSE;
 
   return node;
 }
@@ -46,6 +46,7 @@ struct field_type_struct
   gboolean hasDefault;
   FieldValue value;
   char * dictionary; /* Name of the dictionary used for this field */
+  gboolean skip; /* Template only. Decoded for the dictionaries, not shown */
 
 };
 typedef struct field_type_struct FieldType;
@@ -55,6 +56,13 @@ typedef struct field_type_struct FieldType;
  */
 wmem_map_t* create_templates_table(GNode* tmpl);
 
+/*! \brief  Check if a field takes a bit in the PMAP of its group.
+ * \param ftype  The field.
+ * \return  TRUE for optional groups and constants, and for the
+ *          default, copy, increment and tail operators.
+ */
+gboolean requires_pmap_bit (const FieldType* ftype);
+
 /*!
  * \brief  Retrieve the name of the field type.
  * \param type  Field type for the name lookup.
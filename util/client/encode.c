@@ -58,40 +58,63 @@ void encode_int32 (gint32 x, GByteArray** arr)
 
 void encode_uint64 (guint64 x, GByteArray** arr)
 {
-    guint8 buf[17];
-    size_t maxc = 9;
-    int i = maxc;
+    guint8 buf[ENCODE_INT_MAX];
+    guint n = encode_uint64_bytes (x, buf);
 
-    do
+    *arr = g_byte_array_append (*arr, buf, n);
+}
+
+void encode_int64 (gint64 x, GByteArray** arr)
+{
+    guint8 buf[ENCODE_INT_MAX];
+    guint n = encode_int64_bytes (x, buf);
+
+    *arr = g_byte_array_append (*arr, buf, n);
+}
+
+guint encode_uint64_bytes (guint64 x, guint8* buf)
+{
+    guint64 rest = x >> 7;
+    guint n = 1;
+    guint i;
+
+    while (0 != rest)
     {
-        --i;
-        buf[i] = x & 0x7f;
-        x >>= 7;
-    } while (0 != x);
+        rest >>= 7;
+        ++n;
+    }
 
-    buf[maxc -1] |= 0x80;
+    for (i = n; i > 0; --i)
+    {
+        buf[i-1] = x & 0x7f;
+        x >>= 7;
+    }
 
-    *arr = g_byte_array_append (*arr, &buf[i], maxc - i);
+    buf[n-1] |= 0x80;
+    return n;
 }
 
-void encode_int64 (gint64 x, GByteArray** arr)
+guint encode_int64_bytes (gint64 x, guint8* buf)
 {
-    guint8 buf[17];
-    guint maxc = 9;
-    guint i = maxc;
+    gint64 rest = x >> 6;
+    guint n = 1;
+    guint i;
 
-    while (1)
+    /* Room for the sign bit in the top byte. */
+    while (rest != 0 && ~rest != 0)
     {
-        --i;
-        buf[i] = x & 0x7f;
-        x >>= 6;
-        if (x == 0 || ~x == 0)  break;
-        x >>= 1;
+        rest >>= 7;
+        ++n;
     }
 
-    buf[maxc -1] |= 0x80;
+    for (i = n; i > 0; --i)
+    {
+        buf[i-1] = x & 0x7f;
+        x >>= 7;
+    }
 
-    *arr = g_byte_array_append (*arr, &buf[i], maxc - i);
+    buf[n-1] |= 0x80;
+    return n;
 }
 
 void encode_ascii (const guint8* str, GByteArray** arr)
@@ -36,5 +36,13 @@ void encode_bytevec (const guint8* str, GByteArray** arr);
 void encode_hex (const guint8* str, GByteArray** arr);
 void encode_bit (const guint8* str, GByteArray** arr);
 
+/* Longest stop bit encoded integer, a 64 bit value takes 10 bytes. */
+#define ENCODE_INT_MAX 10
+
+/* Stop bit encode into a caller buffer of at least ENCODE_INT_MAX
+ * bytes, return the number of bytes written. */
+guint encode_uint64_bytes (guint64 x, guint8* buf);
+guint encode_int64_bytes (gint64 x, guint8* buf);
+
 #endif
 
@@ -0,0 +1,1225 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <string.h>
+
+#include "template.h"
+#include "basic-dissect.h"
+#include "dictionaries.h"
+#include "encode.h"
+#include "encoder.h"
+
+/*! \brief  A template field with its dictionary entry resolved.
+ */
+struct encoder_field_struct
+{
+  const GNode* tnode;
+  const FieldType* ftype;
+  EncoderEntry* entry;    /*!< NULL for a field without a key. */
+  EncoderField* children; /*!< Decimal, length and group fields. */
+  guint nchildren;
+  guint pmap_bits;        /*!< Groups, most bits of their own PMAP. */
+};
+
+/*! \brief  A dictionary value. Sized data lives in a buffer of the
+ *          entry which only grows.
+ */
+struct encoder_entry_struct
+{
+  FieldTypeIdentifier type;
+  guint32 generation;
+  gboolean empty;
+  FieldValue value;
+  guint8* buffer;
+  guint capacity;
+};
+
+/*! \brief  An entry as it was before a store, see encode_message.
+ */
+struct encoder_undo_struct
+{
+  EncoderEntry* entry;
+  FieldTypeIdentifier type;
+  guint32 generation;
+  gboolean empty;
+  FieldValue value;
+  guint offset;           /*!< Of the sized value in undo_bytes. */
+};
+typedef struct encoder_undo_struct EncoderUndo;
+
+/*! \brief  The buffer of the caller being filled.
+ */
+struct encode_output_struct
+{
+  guint8* bytes;
+  gsize size;
+  gsize len;
+};
+typedef struct encode_output_struct EncodeOutput;
+
+/*! \brief  A PMAP being laid out, its bytes are reserved in the output.
+ */
+struct encode_pmap_struct
+{
+  gsize start;
+  guint nbytes;
+  guint nbits;
+};
+typedef struct encode_pmap_struct EncodePmap;
+
+/*! \brief  Compile sibling template fields.
+ * \param count  Return value, number of fields.
+ */
+static EncoderField* compile_fields (Encoder* encoder, const GNode* tnode,
+                                     guint* count);
+
+/*! \brief  Entry of a field, shared by the fields of the same key.
+ */
+static EncoderEntry* compile_entry (Encoder* encoder, const FieldType* ftype);
+
+/*! \brief  Bits sibling fields take in the PMAP of their group.
+ *          The same walk as fixup_walk_template in template.c.
+ */
+static guint count_pmap_bits (const GNode* tnode);
+
+static void free_fields (EncoderField* fields, guint count);
+static void free_entry (EncoderEntry* entry);
+
+static gboolean encode_fields (Encoder* encoder, EncodeOutput* out,
+                               EncodePmap* pmap, const EncoderField* fields,
+                               guint count, const GNode* dnode);
+static gboolean encode_group (Encoder* encoder, EncodeOutput* out,
+                              EncodePmap* pmap, const EncoderField* field,
+                              const GNode* dnode);
+static gboolean encode_group_body (Encoder* encoder, EncodeOutput* out,
+                                   EncodePmap* pmap, const EncoderField* field,
+                                   const GNode* dnode);
+static gboolean encode_sequence (Encoder* encoder, EncodeOutput* out,
+                                 EncodePmap* pmap, const EncoderField* field,
+                                 const GNode* dnode);
+static gboolean encode_integer (Encoder* encoder, EncodeOutput* out,
+                                EncodePmap* pmap, const EncoderField* field,
+                                gboolean present, const FieldValue* value);
+static gboolean encode_decimal (Encoder* encoder, EncodeOutput* out,
+                                EncodePmap* pmap, const EncoderField* field,
+                                gboolean present, const FieldValue* value);
+static gboolean encode_sized (Encoder* encoder, EncodeOutput* out,
+                              EncodePmap* pmap, const EncoderField* field,
+                              gboolean present, const SizedData* value);
+
+/*! \brief  Write the value of a decimal, or a null.
+ */
+static gboolean put_decimal (Encoder* encoder, EncodeOutput* out,
+                             EncodePmap* pmap, const EncoderField* field,
+                             gboolean present, const FieldValue* value);
+
+/*! \brief  Write the value of a string or byte vector, or a null.
+ */
+static gboolean put_sized (Encoder* encoder, EncodeOutput* out,
+                           EncodePmap* pmap, const EncoderField* field,
+                           gboolean present, const SizedData* value);
+
+/*! \brief  Write the subtraction length and the difference of a
+ *          delta string or byte vector.
+ */
+static gboolean put_sized_delta (Encoder* encoder, EncodeOutput* out,
+                                 const EncoderField* field,
+                                 const SizedData* value);
+
+/*! \brief  Write the tail of a string or byte vector.
+ */
+static gboolean put_sized_tail (Encoder* encoder, EncodeOutput* out,
+                                EncodePmap* pmap, const EncoderField* field,
+                                const SizedData* value);
+
+static gboolean begin_pmap (Encoder* encoder, EncodeOutput* out,
+                            EncodePmap* pmap, guint nbits);
+static gboolean push_bit (Encoder* encoder, EncodeOutput* out,
+                          EncodePmap* pmap, gboolean bit);
+static void end_pmap (EncodeOutput* out, const EncodePmap* pmap);
+
+static gboolean put_bytes (Encoder* encoder, EncodeOutput* out,
+                           const guint8* bytes, gsize nbytes);
+static gboolean put_uint (Encoder* encoder, EncodeOutput* out, guint64 x);
+static gboolean put_int (Encoder* encoder, EncodeOutput* out, gint64 x);
+static gboolean put_null (Encoder* encoder, EncodeOutput* out);
+static gboolean put_ascii (Encoder* encoder, EncodeOutput* out,
+                           gboolean nullable, const guint8* bytes,
+                           guint nbytes);
+
+/*! \brief  Previous value of a field, NULL unless it is assigned.
+ */
+static const FieldValue* entry_assigned (const Encoder* encoder,
+                                         const EncoderField* field);
+
+/*! \brief  Check if the previous value of a field is empty.
+ */
+static gboolean entry_empty (const Encoder* encoder, const EncoderField* field);
+
+/*! \brief  Store the value of a field, or its absence.
+ */
+static void entry_store (Encoder* encoder, const EncoderField* field,
+                         gboolean present, const FieldValue* value);
+
+/*! \brief  Undo the stores of the message being encoded.
+ */
+static void rollback_entries (Encoder* encoder);
+
+/*! \brief  An integer as 64 bits, signed types are sign extended.
+ */
+static guint64 integer_bits (FieldTypeIdentifier type, const FieldValue* value);
+
+/*! \brief  Cut 64 bits to the width of an integer type.
+ */
+static guint64 integer_truncate (FieldTypeIdentifier type, guint64 bits);
+
+/*! \brief  Store 64 bits as an integer of the given type.
+ */
+static void integer_value (FieldTypeIdentifier type, guint64 bits,
+                           FieldValue* value);
+
+static gboolean is_signed (FieldTypeIdentifier type);
+static gboolean is_sized (FieldTypeIdentifier type);
+static gboolean sized_equal (const SizedData* a, const SizedData* b);
+
+/*! \brief  Data of a field, NULL if it is absent.
+ */
+static const FieldData* present_data (const GNode* dnode);
+
+/*! \brief  Record why the message failed.
+ * \return  FALSE
+ */
+static gboolean encode_fail (Encoder* encoder, const char* error);
+
+
+Encoder* encoder_new (const GNode* templates)
+{
+  Encoder* encoder = g_new0(Encoder, 1);
+  const GNode* tmpl;
+
+  encoder->templates = g_hash_table_new(g_int_hash, g_int_equal);
+  encoder->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) free_entry);
+  encoder->generation = 1;
+  encoder->undo = g_array_new(FALSE, FALSE, sizeof(EncoderUndo));
+  encoder->undo_bytes = g_byte_array_new();
+
+  for (tmpl = templates->children; tmpl; tmpl = tmpl->next) {
+    EncoderField* root = g_new0(EncoderField, 1);
+    root->tnode = tmpl;
+    root->ftype = (const FieldType*) tmpl->data;
+    root->children = compile_fields(encoder, tmpl->children, &root->nchildren);
+    /* the template id takes the first bit */
+    root->pmap_bits = 1 + count_pmap_bits(tmpl->children);
+    g_hash_table_insert(encoder->templates, (gpointer) &root->ftype->id, root);
+  }
+  return encoder;
+}
+
+
+const GNode* encoder_template (const Encoder* encoder, guint32 tid)
+{
+  gint id = (gint) tid;
+  const EncoderField* root =
+    (const EncoderField*) g_hash_table_lookup(encoder->templates, &id);
+  return root ? root->tnode : NULL;
+}
+
+
+void encoder_reset (Encoder* encoder)
+{
+  /* entries stored before are undefined from now on */
+  encoder->generation++;
+  encoder->tid_sent = FALSE;
+}
+
+
+gsize encode_message (Encoder* encoder, const GNode* tmpl, const GNode* data,
+                      guint8* buf, gsize size)
+{
+  const FieldType* ttype = (const FieldType*) tmpl->data;
+  const EncoderField* root;
+  EncodeOutput out;
+  EncodePmap pmap;
+  gboolean tid_bit;
+  gboolean ok;
+
+  encoder->error = NULL;
+  root = (const EncoderField*) g_hash_table_lookup(encoder->templates,
+                                                   &ttype->id);
+  if (!root) {
+    encode_fail(encoder, "Unknown template.");
+    return 0;
+  }
+
+  out.bytes = buf;
+  out.size = size;
+  out.len = 0;
+  g_array_set_size(encoder->undo, 0);
+  g_byte_array_set_size(encoder->undo_bytes, 0);
+
+  tid_bit = !encoder->tid_sent || encoder->tid != (guint32) ttype->id;
+  ok = begin_pmap(encoder, &out, &pmap, root->pmap_bits) &&
+       push_bit(encoder, &out, &pmap, tid_bit) &&
+       (!tid_bit || put_uint(encoder, &out, (guint32) ttype->id)) &&
+       encode_fields(encoder, &out, &pmap, root->children, root->nchildren,
+                     data->children);
+  if (!ok) {
+    rollback_entries(encoder);
+    return 0;
+  }
+  end_pmap(&out, &pmap);
+
+  encoder->tid_sent = TRUE;
+  encoder->tid = (guint32) ttype->id;
+  return out.len;
+}
+
+
+void encoder_free (Encoder* encoder)
+{
+  GHashTableIter iter;
+  gpointer root;
+
+  g_hash_table_iter_init(&iter, encoder->templates);
+  while (g_hash_table_iter_next(&iter, NULL, &root)) {
+    free_fields(((EncoderField*) root)->children,
+                ((EncoderField*) root)->nchildren);
+    g_free(root);
+  }
+  g_hash_table_destroy(encoder->templates);
+  g_hash_table_destroy(encoder->entries);
+  g_array_free(encoder->undo, TRUE);
+  g_byte_array_free(encoder->undo_bytes, TRUE);
+  g_free(encoder);
+}
+
+
+EncoderField* compile_fields (Encoder* encoder, const GNode* tnode,
+                              guint* count)
+{
+  EncoderField* fields;
+  const GNode* node;
+  guint i = 0;
+
+  *count = 0;
+  for (node = tnode; node; node = node->next) {
+    ++*count;
+  }
+  if (!*count) {
+    return NULL;
+  }
+
+  fields = g_new0(EncoderField, *count);
+  for (node = tnode; node; node = node->next, ++i) {
+    EncoderField* field = &fields[i];
+    field->tnode = node;
+    field->ftype = (const FieldType*) node->data;
+    field->entry = compile_entry(encoder, field->ftype);
+    field->children = compile_fields(encoder, node->children,
+                                     &field->nchildren);
+    if (FieldTypeGroup == field->ftype->type) {
+      field->pmap_bits = count_pmap_bits(node->children);
+    }
+  }
+  return fields;
+}
+
+
+EncoderEntry* compile_entry (Encoder* encoder, const FieldType* ftype)
+{
+  EncoderEntry* entry;
+  gchar* name;
+
+  if (!ftype->key ||
+      FieldTypeGroup == ftype->type || FieldTypeSequence == ftype->type) {
+    return NULL;
+  }
+
+  /* the same dictionaries as dictionaries.c, one per template for the
+   * template dictionary */
+  if (!g_strcmp0(ftype->dictionary, TEMPLATE_DICTIONARY)) {
+    name = g_strdup_printf("%s/%d/%s", TEMPLATE_DICTIONARY, ftype->tid,
+                           ftype->key);
+  }
+  else {
+    name = g_strdup_printf("%s//%s", ftype->dictionary ? ftype->dictionary : "",
+                           ftype->key);
+  }
+
+  entry = (EncoderEntry*) g_hash_table_lookup(encoder->entries, name);
+  if (entry) {
+    g_free(name);
+    return entry;
+  }
+  entry = g_new0(EncoderEntry, 1);
+  g_hash_table_insert(encoder->entries, name, entry);
+  return entry;
+}
+
+
+guint count_pmap_bits (const GNode* tnode)
+{
+  guint nbits = 0;
+
+  for (; tnode; tnode = tnode->next) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    if (requires_pmap_bit(ftype)) {
+      ++nbits;
+    }
+    /* decimal parts and lengths use the PMAP of the group they are in */
+    if (FieldTypeGroup != ftype->type) {
+      nbits += count_pmap_bits(tnode->children);
+    }
+  }
+  return nbits;
+}
+
+
+void free_fields (EncoderField* fields, guint count)
+{
+  guint i;
+  for (i = 0; i < count; ++i) {
+    free_fields(fields[i].children, fields[i].nchildren);
+  }
+  g_free(fields);
+}
+
+
+void free_entry (EncoderEntry* entry)
+{
+  g_free(entry->buffer);
+  g_free(entry);
+}
+
+
+gboolean encode_fields (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                        const EncoderField* fields, guint count,
+                        const GNode* dnode)
+{
+  guint i;
+
+  for (i = 0; i < count; ++i, dnode = dnode ? dnode->next : NULL) {
+    const EncoderField* field = &fields[i];
+    const FieldData* fdata = present_data(dnode);
+    gboolean ok;
+
+    switch (field->ftype->type) {
+      case FieldTypeUInt32:
+      case FieldTypeUInt64:
+      case FieldTypeInt32:
+      case FieldTypeInt64:
+        ok = encode_integer(encoder, out, pmap, field, fdata != NULL,
+                            fdata ? &fdata->value : NULL);
+        break;
+      case FieldTypeDecimal:
+        ok = encode_decimal(encoder, out, pmap, field, fdata != NULL,
+                            fdata ? &fdata->value : NULL);
+        break;
+      case FieldTypeAsciiString:
+      case FieldTypeUnicodeString:
+      case FieldTypeByteVector:
+        ok = encode_sized(encoder, out, pmap, field, fdata != NULL,
+                          fdata ? &fdata->value.bytevec : NULL);
+        break;
+      case FieldTypeGroup:
+        ok = encode_group(encoder, out, pmap, field, dnode);
+        break;
+      case FieldTypeSequence:
+        ok = encode_sequence(encoder, out, pmap, field, dnode);
+        break;
+      default:
+        ok = encode_fail(encoder, "Unknown field type.");
+        break;
+    }
+    if (!ok) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+gboolean encode_group (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                       const EncoderField* field, const GNode* dnode)
+{
+  gboolean present = present_data(dnode) != NULL;
+
+  if (!field->ftype->mandatory) {
+    if (!push_bit(encoder, out, pmap, present)) {
+      return FALSE;
+    }
+  }
+  else if (!present) {
+    return encode_fail(encoder, "Mandatory group without a value.");
+  }
+  return !present || encode_group_body(encoder, out, pmap, field, dnode);
+}
+
+
+gboolean encode_group_body (Encoder* encoder, EncodeOutput* out,
+                            EncodePmap* pmap, const EncoderField* field,
+                            const GNode* dnode)
+{
+  EncodePmap nested;
+
+  if (!field->pmap_bits) {
+    return encode_fields(encoder, out, pmap, field->children,
+                         field->nchildren, dnode->children);
+  }
+  if (!begin_pmap(encoder, out, &nested, field->pmap_bits) ||
+      !encode_fields(encoder, out, &nested, field->children,
+                     field->nchildren, dnode->children)) {
+    return FALSE;
+  }
+  end_pmap(out, &nested);
+  return TRUE;
+}
+
+
+gboolean encode_sequence (Encoder* encoder, EncodeOutput* out,
+                          EncodePmap* pmap, const EncoderField* field,
+                          const GNode* dnode)
+{
+  const FieldData* fdata = present_data(dnode);
+  const GNode* element;
+  FieldValue length;
+
+  if (field->nchildren != 2) {
+    return encode_fail(encoder, "Error in sequence setup.");
+  }
+
+  init_field_value(&length);
+  length.u32 = fdata ? g_node_n_children((GNode*) dnode) : 0;
+  if (!encode_integer(encoder, out, pmap, &field->children[0],
+                      fdata != NULL, &length)) {
+    return FALSE;
+  }
+  if (!fdata) {
+    return TRUE;
+  }
+  for (element = dnode->children; element; element = element->next) {
+    if (!present_data(element)) {
+      return encode_fail(encoder, "Sequence element without a value.");
+    }
+    if (!encode_group_body(encoder, out, pmap, &field->children[1], element)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+gboolean encode_integer (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                         const EncoderField* field, gboolean present,
+                         const FieldValue* value)
+{
+  const FieldType* ftype = field->ftype;
+  const FieldValue* prev = entry_assigned(encoder, field);
+  gboolean nullable = !ftype->mandatory;
+  guint64 bits = present ? integer_bits(ftype->type, value) : 0;
+  gboolean elide = FALSE;
+
+  if (!present && !nullable && FieldOperatorConstant != ftype->op) {
+    return encode_fail(encoder, "Mandatory field without a value.");
+  }
+
+  switch (ftype->op) {
+    case FieldOperatorConstant:
+      return !nullable || push_bit(encoder, out, pmap, present);
+
+    case FieldOperatorDelta:
+      if (!present) {
+        /* a null delta leaves the dictionary alone */
+        return put_null(encoder, out);
+      }
+      else {
+        guint64 base = prev ? integer_bits(ftype->type, prev) :
+          ftype->hasDefault ? integer_bits(ftype->type, &ftype->value) : 0;
+        gint64 delta = (gint64) (bits - base);
+        if (nullable && delta >= 0) {
+          ++delta;
+        }
+        if (!put_int(encoder, out, delta)) {
+          return FALSE;
+        }
+      }
+      entry_store(encoder, field, TRUE, value);
+      return TRUE;
+
+    case FieldOperatorDefault:
+      elide = present && ftype->hasDefault &&
+        bits == integer_bits(ftype->type, &ftype->value);
+      break;
+
+    case FieldOperatorCopy:
+      elide = present ? (prev && bits == integer_bits(ftype->type, prev)) :
+        entry_empty(encoder, field);
+      break;
+
+    case FieldOperatorIncrement:
+      elide = present ?
+        (prev && bits == integer_truncate(ftype->type,
+                                          integer_bits(ftype->type, prev) + 1)) :
+        entry_empty(encoder, field);
+      break;
+
+    default:
+      break;
+  }
+
+  if (FieldOperatorDefault == ftype->op ||
+      FieldOperatorCopy == ftype->op ||
+      FieldOperatorIncrement == ftype->op) {
+    if (!push_bit(encoder, out, pmap, !elide)) {
+      return FALSE;
+    }
+  }
+  if (!elide) {
+    gboolean ok;
+    if (!present) {
+      ok = put_null(encoder, out);
+    }
+    else if (is_signed(ftype->type)) {
+      gint64 x = (gint64) bits;
+      ok = put_int(encoder, out, (nullable && x >= 0) ? x + 1 : x);
+    }
+    else {
+      ok = put_uint(encoder, out, nullable ? bits + 1 : bits);
+    }
+    if (!ok) {
+      return FALSE;
+    }
+  }
+  entry_store(encoder, field, present, value);
+  return TRUE;
+}
+
+
+gboolean encode_decimal (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                         const EncoderField* field, gboolean present,
+                         const FieldValue* value)
+{
+  const FieldType* ftype = field->ftype;
+  const FieldValue* prev = entry_assigned(encoder, field);
+  gboolean nullable = !ftype->mandatory;
+  gboolean elide = FALSE;
+
+  if (field->nchildren != 2) {
+    return encode_fail(encoder, "Error in internal decimal field setup.");
+  }
+  if (!present && !nullable && FieldOperatorConstant != ftype->op) {
+    return encode_fail(encoder, "Mandatory field without a value.");
+  }
+
+  switch (ftype->op) {
+    case FieldOperatorNone:
+      /* exponent and mantissa with operators of their own */
+      if (!put_decimal(encoder, out, pmap, field, present, value)) {
+        return FALSE;
+      }
+      if (present) {
+        entry_store(encoder, field, TRUE, value);
+      }
+      return TRUE;
+
+    case FieldOperatorConstant:
+      return !nullable || push_bit(encoder, out, pmap, present);
+
+    case FieldOperatorDelta:
+      if (!present) {
+        return put_null(encoder, out);
+      }
+      else {
+        DecimalFieldValue base;
+        gint64 delta;
+        memset(&base, 0, sizeof(DecimalFieldValue));
+        if (prev) {
+          base = prev->decimal;
+        }
+        else if (ftype->hasDefault) {
+          base = ftype->value.decimal;
+        }
+        delta = (gint64) value->decimal.exponent - base.exponent;
+        if (nullable && delta >= 0) {
+          ++delta;
+        }
+        if (!put_int(encoder, out, delta) ||
+            !put_int(encoder, out, (gint64) ((guint64) value->decimal.mantissa -
+                                             (guint64) base.mantissa))) {
+          return FALSE;
+        }
+      }
+      entry_store(encoder, field, TRUE, value);
+      return TRUE;
+
+    case FieldOperatorDefault:
+      elide = present && ftype->hasDefault &&
+        value->decimal.exponent == ftype->value.decimal.exponent &&
+        value->decimal.mantissa == ftype->value.decimal.mantissa;
+      break;
+
+    case FieldOperatorCopy:
+      elide = present ?
+        (prev && value->decimal.exponent == prev->decimal.exponent &&
+         value->decimal.mantissa == prev->decimal.mantissa) :
+        entry_empty(encoder, field);
+      break;
+
+    default:
+      break;
+  }
+
+  if (FieldOperatorDefault == ftype->op || FieldOperatorCopy == ftype->op) {
+    if (!push_bit(encoder, out, pmap, !elide)) {
+      return FALSE;
+    }
+  }
+  if (!elide && !put_decimal(encoder, out, pmap, field, present, value)) {
+    return FALSE;
+  }
+  entry_store(encoder, field, present, value);
+  return TRUE;
+}
+
+
+gboolean put_decimal (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                      const EncoderField* field, gboolean present,
+                      const FieldValue* value)
+{
+  FieldValue exponent;
+  FieldValue mantissa;
+
+  init_field_value(&exponent);
+  init_field_value(&mantissa);
+  if (present) {
+    exponent.i32 = value->decimal.exponent;
+    mantissa.i64 = value->decimal.mantissa;
+  }
+  /* the exponent carries the null of an optional decimal */
+  return encode_integer(encoder, out, pmap, &field->children[0],
+                        present, &exponent) &&
+         (!present ||
+          encode_integer(encoder, out, pmap, &field->children[1],
+                         TRUE, &mantissa));
+}
+
+
+gboolean encode_sized (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                       const EncoderField* field, gboolean present,
+                       const SizedData* value)
+{
+  const FieldType* ftype = field->ftype;
+  const FieldValue* prev = entry_assigned(encoder, field);
+  gboolean nullable = !ftype->mandatory;
+  gboolean elide = FALSE;
+  SizedData ascii;
+
+  if (!present && !nullable && FieldOperatorConstant != ftype->op) {
+    return encode_fail(encoder, "Mandatory field without a value.");
+  }
+  if (present && FieldTypeAsciiString == ftype->type) {
+    /* up to the terminator, if the length counts one */
+    ascii.bytes = value->bytes;
+    ascii.nbytes = 0;
+    while (ascii.nbytes < value->nbytes && value->bytes[ascii.nbytes]) {
+      ++ascii.nbytes;
+    }
+    value = &ascii;
+  }
+
+  switch (ftype->op) {
+    case FieldOperatorConstant:
+      return !nullable || push_bit(encoder, out, pmap, present);
+
+    case FieldOperatorDelta:
+      if (!present) {
+        return put_null(encoder, out);
+      }
+      if (!put_sized_delta(encoder, out, field, value)) {
+        return FALSE;
+      }
+      entry_store(encoder, field, TRUE, (const FieldValue*) value);
+      return TRUE;
+
+    case FieldOperatorTail:
+      elide = present ? (prev && sized_equal(value, &prev->bytevec)) :
+        entry_empty(encoder, field);
+      if (!push_bit(encoder, out, pmap, !elide)) {
+        return FALSE;
+      }
+      if (!elide) {
+        gboolean ok = present ?
+          put_sized_tail(encoder, out, pmap, field, value) :
+          put_sized(encoder, out, pmap, field, FALSE, NULL);
+        if (!ok) {
+          return FALSE;
+        }
+      }
+      entry_store(encoder, field, present, (const FieldValue*) value);
+      return TRUE;
+
+    case FieldOperatorDefault:
+      elide = present && ftype->hasDefault &&
+        sized_equal(value, &ftype->value.bytevec);
+      break;
+
+    case FieldOperatorCopy:
+      elide = present ? (prev && sized_equal(value, &prev->bytevec)) :
+        entry_empty(encoder, field);
+      break;
+
+    default:
+      break;
+  }
+
+  if (FieldOperatorDefault == ftype->op || FieldOperatorCopy == ftype->op) {
+    if (!push_bit(encoder, out, pmap, !elide)) {
+      return FALSE;
+    }
+  }
+  if (!elide && !put_sized(encoder, out, pmap, field, present, value)) {
+    return FALSE;
+  }
+  entry_store(encoder, field, present, (const FieldValue*) value);
+  return TRUE;
+}
+
+
+gboolean put_sized (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                    const EncoderField* field, gboolean present,
+                    const SizedData* value)
+{
+  FieldValue length;
+
+  if (FieldTypeAsciiString == field->ftype->type) {
+    return present ?
+      put_ascii(encoder, out, !field->ftype->mandatory,
+                value->bytes, value->nbytes) :
+      put_null(encoder, out);
+  }
+
+  if (!field->nchildren) {
+    return encode_fail(encoder, "Length should be a child node.");
+  }
+  /* the length field carries the null */
+  init_field_value(&length);
+  length.u32 = present ? value->nbytes : 0;
+  return encode_integer(encoder, out, pmap, &field->children[0],
+                        present, &length) &&
+         (!present || put_bytes(encoder, out, value->bytes, value->nbytes));
+}
+
+
+gboolean put_sized_delta (Encoder* encoder, EncodeOutput* out,
+                          const EncoderField* field, const SizedData* value)
+{
+  const FieldType* ftype = field->ftype;
+  const FieldValue* prev = entry_assigned(encoder, field);
+  SizedData base;
+  guint prefix = 0;
+  guint suffix = 0;
+  gint64 subtract;
+  const guint8* diff;
+  guint ndiff;
+
+  memset(&base, 0, sizeof(SizedData));
+  if (prev) {
+    base = prev->bytevec;
+  }
+  else if (ftype->hasDefault && !entry_empty(encoder, field)) {
+    base = ftype->value.bytevec;
+  }
+
+  if (!prev) {
+    /* replace the whole base, whichever initial value the decoder uses */
+    subtract = base.nbytes;
+    diff = value->bytes;
+    ndiff = value->nbytes;
+  }
+  else {
+    while (prefix < base.nbytes && prefix < value->nbytes &&
+           base.bytes[prefix] == value->bytes[prefix]) {
+      ++prefix;
+    }
+    while (suffix < base.nbytes && suffix < value->nbytes &&
+           base.bytes[base.nbytes - 1 - suffix] ==
+           value->bytes[value->nbytes - 1 - suffix]) {
+      ++suffix;
+    }
+    if (prefix >= suffix) {
+      /* keep the front, replace the tail */
+      subtract = base.nbytes - prefix;
+      diff = value->bytes + prefix;
+      ndiff = value->nbytes - prefix;
+    }
+    else {
+      /* keep the tail, replace the front */
+      subtract = -(gint64) (base.nbytes - suffix) - 1;
+      diff = value->bytes;
+      ndiff = value->nbytes - suffix;
+    }
+  }
+
+  if (!ftype->mandatory && subtract >= 0) {
+    ++subtract;
+  }
+  if (!put_int(encoder, out, subtract)) {
+    return FALSE;
+  }
+  if (FieldTypeAsciiString == ftype->type) {
+    return put_ascii(encoder, out, FALSE, diff, ndiff);
+  }
+  return put_uint(encoder, out, ndiff) &&
+         put_bytes(encoder, out, diff, ndiff);
+}
+
+
+gboolean put_sized_tail (Encoder* encoder, EncodeOutput* out,
+                         EncodePmap* pmap, const EncoderField* field,
+                         const SizedData* value)
+{
+  const FieldType* ftype = field->ftype;
+  const FieldValue* prev = entry_assigned(encoder, field);
+  SizedData base;
+  SizedData tail;
+
+  memset(&base, 0, sizeof(SizedData));
+  if (prev) {
+    base = prev->bytevec;
+  }
+  else if (ftype->hasDefault && !entry_empty(encoder, field)) {
+    base = ftype->value.bytevec;
+  }
+
+  /* a tail replaces as many bytes at the end of the base, it cannot
+   * make the value shorter */
+  tail = *value;
+  if (value->nbytes < base.nbytes) {
+    return encode_fail(encoder, "Tail value shorter than the previous one.");
+  }
+  if (prev && value->nbytes == base.nbytes) {
+    guint prefix = 0;
+    while (prefix < base.nbytes && base.bytes[prefix] == value->bytes[prefix]) {
+      ++prefix;
+    }
+    tail.bytes = value->bytes + prefix;
+    tail.nbytes = value->nbytes - prefix;
+  }
+  return put_sized(encoder, out, pmap, field, TRUE, &tail);
+}
+
+
+gboolean begin_pmap (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                     guint nbits)
+{
+  pmap->start = out->len;
+  pmap->nbytes = nbits ? (nbits + 6) / 7 : 1;
+  pmap->nbits = 0;
+  if (out->size - out->len < pmap->nbytes) {
+    return encode_fail(encoder, "Buffer too small.");
+  }
+  memset(out->bytes + out->len, 0, pmap->nbytes);
+  out->len += pmap->nbytes;
+  return TRUE;
+}
+
+
+gboolean push_bit (Encoder* encoder, EncodeOutput* out, EncodePmap* pmap,
+                   gboolean bit)
+{
+  if (pmap->nbits >= pmap->nbytes * 7) {
+    return encode_fail(encoder, "PMAP overflow.");
+  }
+  if (bit) {
+    out->bytes[pmap->start + pmap->nbits / 7] |= 0x40 >> (pmap->nbits % 7);
+  }
+  pmap->nbits++;
+  return TRUE;
+}
+
+
+void end_pmap (EncodeOutput* out, const EncodePmap* pmap)
+{
+  guint8* bytes = out->bytes + pmap->start;
+  guint used = pmap->nbytes;
+
+  /* trailing zero bytes are implied, drop them */
+  while (used > 1 && !bytes[used - 1]) {
+    --used;
+  }
+  bytes[used - 1] |= 0x80;
+  if (used < pmap->nbytes) {
+    gsize body = out->len - pmap->start - pmap->nbytes;
+    memmove(bytes + used, bytes + pmap->nbytes, body);
+    out->len -= pmap->nbytes - used;
+  }
+}
+
+
+gboolean put_bytes (Encoder* encoder, EncodeOutput* out,
+                    const guint8* bytes, gsize nbytes)
+{
+  if (out->size - out->len < nbytes) {
+    return encode_fail(encoder, "Buffer too small.");
+  }
+  memcpy(out->bytes + out->len, bytes, nbytes);
+  out->len += nbytes;
+  return TRUE;
+}
+
+
+gboolean put_uint (Encoder* encoder, EncodeOutput* out, guint64 x)
+{
+  guint8 buf[ENCODE_INT_MAX];
+
+  if (out->size - out->len >= ENCODE_INT_MAX) {
+    out->len += encode_uint64_bytes(x, out->bytes + out->len);
+    return TRUE;
+  }
+  return put_bytes(encoder, out, buf, encode_uint64_bytes(x, buf));
+}
+
+
+gboolean put_int (Encoder* encoder, EncodeOutput* out, gint64 x)
+{
+  guint8 buf[ENCODE_INT_MAX];
+
+  if (out->size - out->len >= ENCODE_INT_MAX) {
+    out->len += encode_int64_bytes(x, out->bytes + out->len);
+    return TRUE;
+  }
+  return put_bytes(encoder, out, buf, encode_int64_bytes(x, buf));
+}
+
+
+gboolean put_null (Encoder* encoder, EncodeOutput* out)
+{
+  static const guint8 null = 0x80;
+  return put_bytes(encoder, out, &null, 1);
+}
+
+
+gboolean put_ascii (Encoder* encoder, EncodeOutput* out, gboolean nullable,
+                    const guint8* bytes, guint nbytes)
+{
+  guint i;
+
+  if (!nbytes) {
+    /* an empty string is a zero byte when nullable, 0x80 is the null */
+    static const guint8 empty[2] = { 0x00, 0x80 };
+    return nullable ? put_bytes(encoder, out, empty, 2) :
+                      put_bytes(encoder, out, empty + 1, 1);
+  }
+  if (out->size - out->len < nbytes) {
+    return encode_fail(encoder, "Buffer too small.");
+  }
+  for (i = 0; i < nbytes; ++i) {
+    out->bytes[out->len + i] = bytes[i] & 0x7f;
+  }
+  out->bytes[out->len + nbytes - 1] |= 0x80;
+  out->len += nbytes;
+  return TRUE;
+}
+
+
+const FieldValue* entry_assigned (const Encoder* encoder,
+                                  const EncoderField* field)
+{
+  const EncoderEntry* entry = field->entry;
+
+  if (entry && entry->generation == encoder->generation &&
+      entry->type == field->ftype->type && !entry->empty) {
+    return &entry->value;
+  }
+  return NULL;
+}
+
+
+gboolean entry_empty (const Encoder* encoder, const EncoderField* field)
+{
+  const EncoderEntry* entry = field->entry;
+
+  return entry && entry->generation == encoder->generation &&
+    entry->type == field->ftype->type && entry->empty;
+}
+
+
+void entry_store (Encoder* encoder, const EncoderField* field,
+                  gboolean present, const FieldValue* value)
+{
+  EncoderEntry* entry = field->entry;
+  FieldTypeIdentifier type = field->ftype->type;
+  EncoderUndo undo;
+
+  if (!entry) {
+    return;
+  }
+
+  undo.entry = entry;
+  undo.type = entry->type;
+  undo.generation = entry->generation;
+  undo.empty = entry->empty;
+  undo.value = entry->value;
+  undo.offset = encoder->undo_bytes->len;
+  if (is_sized(entry->type) && !entry->empty && entry->value.bytevec.bytes) {
+    g_byte_array_append(encoder->undo_bytes, entry->value.bytevec.bytes,
+                        entry->value.bytevec.nbytes);
+  }
+  g_array_append_val(encoder->undo, undo);
+
+  entry->type = type;
+  entry->generation = encoder->generation;
+  entry->empty = !present;
+  if (!present) {
+    return;
+  }
+  if (is_sized(type)) {
+    /* the value may point into the buffer, the tail of a string */
+    guint nbytes = value->bytevec.nbytes;
+    if (nbytes > entry->capacity) {
+      guint8* buffer = (guint8*) g_malloc(nbytes);
+      memcpy(buffer, value->bytevec.bytes, nbytes);
+      g_free(entry->buffer);
+      entry->buffer = buffer;
+      entry->capacity = nbytes;
+    }
+    else if (nbytes) {
+      memmove(entry->buffer, value->bytevec.bytes, nbytes);
+    }
+    entry->value.bytevec.bytes = entry->buffer;
+    entry->value.bytevec.nbytes = nbytes;
+  }
+  else if (FieldTypeDecimal == type) {
+    entry->value.decimal = value->decimal;
+  }
+  else {
+    integer_value(type, integer_bits(type, value), &entry->value);
+  }
+}
+
+
+void rollback_entries (Encoder* encoder)
+{
+  guint i;
+
+  /* newest first, an entry may have been stored twice */
+  for (i = encoder->undo->len; i > 0; --i) {
+    const EncoderUndo* undo = &g_array_index(encoder->undo, EncoderUndo, i - 1);
+    EncoderEntry* entry = undo->entry;
+
+    entry->type = undo->type;
+    entry->generation = undo->generation;
+    entry->empty = undo->empty;
+    entry->value = undo->value;
+    if (is_sized(undo->type) && !undo->empty && undo->value.bytevec.bytes) {
+      /* the buffer only grew, the saved value fits */
+      memcpy(entry->buffer, encoder->undo_bytes->data + undo->offset,
+             undo->value.bytevec.nbytes);
+      entry->value.bytevec.bytes = entry->buffer;
+    }
+  }
+  g_array_set_size(encoder->undo, 0);
+  g_byte_array_set_size(encoder->undo_bytes, 0);
+}
+
+
+guint64 integer_bits (FieldTypeIdentifier type, const FieldValue* value)
+{
+  switch (type) {
+    case FieldTypeUInt32:
+      return value->u32;
+    case FieldTypeInt32:
+      return (guint64) (gint64) value->i32;
+    case FieldTypeUInt64:
+      return value->u64;
+    case FieldTypeInt64:
+      return (guint64) value->i64;
+    default:
+      return 0;
+  }
+}
+
+
+guint64 integer_truncate (FieldTypeIdentifier type, guint64 bits)
+{
+  switch (type) {
+    case FieldTypeUInt32:
+      return (guint32) bits;
+    case FieldTypeInt32:
+      return (guint64) (gint64) (gint32) bits;
+    default:
+      return bits;
+  }
+}
+
+
+void integer_value (FieldTypeIdentifier type, guint64 bits, FieldValue* value)
+{
+  switch (type) {
+    case FieldTypeUInt32:
+      value->u32 = (guint32) bits;
+      break;
+    case FieldTypeInt32:
+      value->i32 = (gint32) bits;
+      break;
+    case FieldTypeUInt64:
+      value->u64 = bits;
+      break;
+    case FieldTypeInt64:
+      value->i64 = (gint64) bits;
+      break;
+    default:
+      break;
+  }
+}
+
+
+gboolean is_signed (FieldTypeIdentifier type)
+{
+  return FieldTypeInt32 == type || FieldTypeInt64 == type;
+}
+
+
+gboolean is_sized (FieldTypeIdentifier type)
+{
+  return FieldTypeAsciiString == type || FieldTypeUnicodeString == type ||
+    FieldTypeByteVector == type;
+}
+
+
+gboolean sized_equal (const SizedData* a, const SizedData* b)
+{
+  return a->nbytes == b->nbytes &&
+    (!a->nbytes || !memcmp(a->bytes, b->bytes, a->nbytes));
+}
+
+
+const FieldData* present_data (const GNode* dnode)
+{
+  const FieldData* fdata = dnode ? (const FieldData*) dnode->data : NULL;
+  return (fdata && fdata->status == FieldExists) ? fdata : NULL;
+}
+
+
+gboolean encode_fail (Encoder* encoder, const char* error)
+{
+  if (!encoder->error) {
+    encoder->error = error;
+  }
+  return FALSE;
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file encoder.h
+ * \brief  Template driven FAST encoder, the inverse of dissect.c.
+ *  Messages are given as data trees shaped like the ones the dissector
+ *  builds: a FieldData per field, parallel to the template fields,
+ *  groups holding their fields as children and sequences their
+ *  elements. The encoder applies the field operators against its own
+ *  dictionaries, lays out the presence maps and writes into a buffer
+ *  of the caller.
+ *
+ *  The templates are compiled once: every field gets its dictionary
+ *  entry resolved up front, so a message is encoded without hashing
+ *  or allocation.
+ *
+ *  Values are encoded after the FAST 1.1 specification. Where the
+ *  previous value is undefined, the value is sent in full rather than
+ *  relying on an initial value, which decoders do not all agree on.
+ */
+
+#ifndef ENCODER_H_
+#define ENCODER_H_
+
+#include <glib.h>
+
+/*! \brief  A template field compiled for encoding, see encoder.c. */
+typedef struct encoder_field_struct EncoderField;
+
+/*! \brief  A value of the encoder dictionaries, see encoder.c. */
+typedef struct encoder_entry_struct EncoderEntry;
+
+/*! \brief  An encoder and its dictionaries.
+ */
+struct encoder_struct
+{
+  GHashTable* templates;   /*!< template id -> EncoderField */
+  GHashTable* entries;     /*!< dictionary and key -> EncoderEntry */
+  guint32 generation;      /*!< Entries of older generations are undefined. */
+  gboolean tid_sent;       /*!< A template id was sent since the reset. */
+  guint32 tid;             /*!< Template id of the previous message. */
+  GArray* undo;            /*!< Stores of the message being encoded. */
+  GByteArray* undo_bytes;  /*!< Sized values they replaced. */
+  const char* error;       /*!< Why the last message failed. */
+};
+typedef struct encoder_struct Encoder;
+
+/*! \brief  Compile templates for encoding.
+ * \param templates  Root of the templates, from parse_templates_xml.
+ * \return  The encoder, its dictionaries undefined.
+ */
+Encoder* encoder_new (const GNode* templates);
+
+/*! \brief  Find a template.
+ * \param encoder  The encoder.
+ * \param tid  Template id.
+ * \return  Template node, NULL if there is none with this id.
+ */
+const GNode* encoder_template (const Encoder* encoder, guint32 tid);
+
+/*! \brief  Make every dictionary value undefined and forget the
+ *          template id, as a decoder does at a packet boundary.
+ * \param encoder  The encoder.
+ */
+void encoder_reset (Encoder* encoder);
+
+/*! \brief  Encode a message.
+ * \param encoder  The encoder.
+ * \param tmpl  Template node of the message.
+ * \param data  Data node, its children are the fields of the message.
+ * \param buf  Output buffer.
+ * \param size  Bytes available in buf.
+ * \return  Bytes written, 0 if the message does not fit or cannot be
+ *          encoded, see encoder->error. The dictionaries are then left
+ *          as they were, the message can be encoded again in a new
+ *          buffer.
+ */
+gsize encode_message (Encoder* encoder, const GNode* tmpl, const GNode* data,
+                      guint8* buf, gsize size);
+
+/*! \brief  Free an encoder.
+ * \param encoder  The encoder.
+ */
+void encoder_free (Encoder* encoder);
+
+#endif
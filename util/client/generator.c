@@ -0,0 +1,1049 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file generator.c
+ * \brief  Synthesize large captures of FAST messages.
+ *  Messages follow a mix profile: the weight of every template, the
+ *  fields that name instruments, the lengths of the sequences and how
+ *  often each operator gets to reuse the previous value. One data tree
+ *  per template is allocated up front and refilled for every message,
+ *  which is encoded straight into the record buffer of the pcap writer.
+ *  With check, every message is decoded again by the dissector core and
+ *  compared with its data tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libxml/parser.h>
+
+#include "wmem_aux.h"
+#include "template.h"
+#include "parse-template.h"
+#include "basic-dissect.h"
+#include "dictionaries.h"
+#include "dissect.h"
+#include "error_log.h"
+
+#include "encoder.h"
+#include "pcap-writer.h"
+
+/*! \brief  Longest string or byte vector generated. */
+#define GEN_SIZED_MAX 16
+
+/*! \brief  First timestamp of a capture, 2020-01-01 UTC in seconds. */
+#define GEN_EPOCH 1577836800
+
+/*! \brief  Statistical profile of the messages.
+ */
+struct gen_profile_struct
+{
+  guint64 seed;
+  guint instruments;         /*!< Distinct values of instrument fields. */
+  gdouble absent;            /*!< Chance an optional field is absent. */
+  gdouble reuse[FieldOperatorEnumLimit];  /*!< Chance to reuse, by operator. */
+  guint seq_min;             /*!< Default sequence lengths. */
+  guint seq_max;
+  GHashTable* instrument_fields;  /*!< Field name -> itself */
+  GHashTable* sequences;     /*!< Sequence name -> GenRange */
+  GArray* weights;           /*!< GenChoice, empty for all templates. */
+  guint packet_bytes;
+  guint packet_messages;     /*!< 0 for as many as fit. */
+  gboolean packet_reset;     /*!< Dictionaries reset with every packet. */
+};
+typedef struct gen_profile_struct GenProfile;
+
+/*! \brief  Lengths of a sequence. */
+struct gen_range_struct
+{
+  guint min;
+  guint max;
+};
+typedef struct gen_range_struct GenRange;
+
+/*! \brief  A template field and the last value generated for it.
+ *  Values are kept per template field rather than per data node, so
+ *  reusing a value means what the operator of the field sees.
+ */
+struct gen_field_struct
+{
+  const FieldType* ftype;
+  gboolean instrument;
+  gboolean assigned;
+  guint64 bits;              /*!< Integer value, or decimal mantissa. */
+  gint32 exponent;
+  guint8 bytes[GEN_SIZED_MAX];
+  guint nbytes;
+  GenRange range;            /*!< Sequences, elements per message. */
+  struct gen_field_struct* children;  /*!< Group fields, element fields. */
+  guint nchildren;
+};
+typedef struct gen_field_struct GenField;
+
+/*! \brief  Data node of a field. The FieldData comes first, the
+ *          encoder sees the slot as the FieldData of the node.
+ */
+struct gen_slot_struct
+{
+  FieldData fdata;
+  guint8 bytes[GEN_SIZED_MAX];  /*!< Sized values, the field moves on. */
+  GNode** elements;          /*!< Sequences, preallocated to the maximum. */
+};
+typedef struct gen_slot_struct GenSlot;
+
+/*! \brief  A template, its fields and its data tree.
+ */
+struct gen_choice_struct
+{
+  const GNode* tmpl;
+  gdouble weight;            /*!< Cumulative once the profile is read. */
+  GenField* fields;
+  guint nfields;
+  GNode* data;
+};
+typedef struct gen_choice_struct GenChoice;
+
+/*! \brief  Print the usage, or a bad argument.
+ * \return  The exit status.
+ */
+static int ArgParseBailOut (const char* arg, const char* reason);
+
+/*! \brief  Set the profile defaults.
+ */
+static void init_profile (GenProfile* profile);
+
+/*! \brief  Read a profile file over the defaults.
+ * \return  FALSE if the file is not a valid profile.
+ */
+static gboolean read_profile (GenProfile* profile, const GNode* templates,
+                              const char* filename);
+
+/*! \brief  Find a template by name or id.
+ */
+static const GNode* find_template (const GNode* templates, const char* what);
+
+/*! \brief  Ratio attribute of a profile element.
+ */
+static gdouble xml_ratio (xmlNodePtr node, const char* name, gdouble fallback);
+
+/*! \brief  Unsigned attribute of a profile element.
+ */
+static guint64 xml_uint (xmlNodePtr node, const char* name, guint64 fallback);
+
+/*! \brief  Build the generator fields of template siblings.
+ */
+static GenField* compile_fields (const GenProfile* profile,
+                                 const GNode* tnode, guint* count);
+
+/*! \brief  Build the data nodes of generator fields under parent.
+ */
+static void build_data (const GenField* fields, guint count, GNode* parent);
+
+/*! \brief  Give the data nodes of fields their next values.
+ */
+static void fill_fields (const GenProfile* profile, GenField* fields,
+                         guint count, GNode* dnode);
+
+/*! \brief  Next value of a field, kept in the field.
+ */
+static void next_value (const GenProfile* profile, GenField* field);
+
+/*! \brief  A fresh random value of a field.
+ */
+static void fresh_value (const GenProfile* profile, GenField* field);
+
+/*! \brief  Keep the value of an integer within its type.
+ */
+static guint64 truncate_bits (FieldTypeIdentifier type, guint64 bits);
+
+/*! \brief  Give a data node the value of its field.
+ */
+static void set_data (const GenField* field, GenSlot* slot);
+
+/*! \brief  Decode an encoded message and compare it with its data tree.
+ * \param n  Number of the message, from 0.
+ * \return  FALSE if it decodes otherwise, which is printed.
+ */
+static gboolean check_message (wmem_map_t* templates, const GenChoice* choice,
+                               const guint8* bytes, gsize nbytes,
+                               address* src, address* dest, guint64 n);
+
+/*! \brief  First field of template siblings decoded otherwise than sent.
+ * \return  NULL if they all decoded as sent.
+ */
+static const FieldType* compare_fields (const GNode* tnode, const GNode* sent,
+                                        const GNode* decoded);
+
+/*! \brief  Whether the values of a field sent and decoded are the same.
+ */
+static gboolean same_value (const FieldType* ftype, const FieldData* sent,
+                            const FieldData* decoded);
+
+/*! \brief  Flush the payload filled so far as one datagram.
+ */
+static gboolean flush_packet (PcapWriter* writer, gint64 ts, guint* len,
+                              guint* in_packet);
+
+static guint64 rng_next (void);
+static guint64 rng_below (guint64 n);
+static gdouble rng_unit (void);
+
+/*! \brief  State of the xorshift generator, never 0. */
+static guint64 rng_state = 88172645463325252ULL;
+
+
+int main (const int argc, const char* const* argv)
+{
+  const char* template_filename = 0;
+  const char* pcap_filename = 0;
+  const char* profile_filename = 0;
+  guint64 messages = 1000000;
+  guint64 seed = 0;
+  guint64 rate = 100000;
+  guint port = 5000;
+  guint8 group[4] = { 239, 0, 0, 1 };
+  guint8 host[4] = { 127, 0, 0, 1 };
+  gboolean check = FALSE;
+  wmem_map_t* templates_table = 0;
+  address src;
+  address dest;
+  GNode* templates;
+  const GNode* tmpl;
+  GenProfile profile;
+  GArray* choices;
+  gdouble total_weight = 0;
+  Encoder* encoder;
+  PcapWriter* writer;
+  guint8* payload;
+  guint len = 0;
+  guint in_packet = 0;
+  guint64 n;
+  gint64 start;
+  gint64 ts = 0;
+  gdouble seconds;
+  gboolean goodp = TRUE;
+  guint i;
+  int argi;
+
+  if (argc == 1) {
+    return ArgParseBailOut(0, 0);
+  }
+
+  /* Loop thru arguments to set internal data. */
+  for (argi = 1; argi < argc; ++argi) {
+    const char* arg = argv[argi];
+    if (argc == argi+1) {
+      return ArgParseBailOut(arg, "Trailing flag without a value.");
+    }
+    else if (!strcmp("tmpl", arg)) {
+      template_filename = argv[++argi];
+    }
+    else if (!strcmp("pcap", arg)) {
+      pcap_filename = argv[++argi];
+    }
+    else if (!strcmp("profile", arg)) {
+      profile_filename = argv[++argi];
+    }
+    else if (!strcmp("messages", arg)) {
+      messages = g_ascii_strtoull(argv[++argi], NULL, 10);
+    }
+    else if (!strcmp("seed", arg)) {
+      seed = g_ascii_strtoull(argv[++argi], NULL, 10);
+    }
+    else if (!strcmp("rate", arg)) {
+      rate = g_ascii_strtoull(argv[++argi], NULL, 10);
+      if (!rate) {
+        return ArgParseBailOut(argv[argi], "Rate must be positive.");
+      }
+    }
+    else if (!strcmp("p", arg) || !strcmp("port", arg)) {
+      port = (guint) atoi(argv[++argi]);
+    }
+    else if (!strcmp("check", arg)) {
+      ++argi;
+      check = !strcmp("yes", argv[argi]) || !strcmp("true", argv[argi]);
+    }
+    else {
+      return ArgParseBailOut(arg, "Unknown argument.");
+    }
+  }
+  if (!template_filename || !pcap_filename) {
+    return ArgParseBailOut(0, "Both tmpl and pcap are required.");
+  }
+
+  wmem_init();
+  wmem_init_scopes();
+  wmem_enter_file_scope();
+  fast_set_log_settings(FALSE, FALSE, NULL);
+
+  templates = parse_templates_xml(template_filename);
+  if (!templates) {
+    fprintf(stderr, "%s: no templates could be read\n", template_filename);
+    return 1;
+  }
+
+  init_profile(&profile);
+  if (profile_filename &&
+      !read_profile(&profile, templates, profile_filename)) {
+    return 1;
+  }
+  if (seed) {
+    profile.seed = seed;
+  }
+  rng_state = profile.seed ? profile.seed : rng_state;
+
+  /* without weights every template is equally likely */
+  choices = profile.weights;
+  if (!choices->len) {
+    for (tmpl = templates->children; tmpl; tmpl = tmpl->next) {
+      GenChoice choice;
+      memset(&choice, 0, sizeof(GenChoice));
+      choice.tmpl = tmpl;
+      choice.weight = 1;
+      g_array_append_val(choices, choice);
+    }
+  }
+  for (i = 0; i < choices->len; ++i) {
+    GenChoice* choice = &g_array_index(choices, GenChoice, i);
+    total_weight += choice->weight;
+    choice->weight = total_weight;
+    choice->fields = compile_fields(&profile, choice->tmpl->children,
+                                    &choice->nfields);
+    choice->data = g_node_new(NULL);
+    build_data(choice->fields, choice->nfields, choice->data);
+  }
+  if (total_weight <= 0) {
+    fprintf(stderr, "%s: no messages to generate\n",
+            profile_filename ? profile_filename : template_filename);
+    return 1;
+  }
+
+  encoder = encoder_new(templates);
+  if (check) {
+    /* the dictionaries of the dissector follow the ones of the encoder */
+    templates_table = create_templates_table(templates);
+    dissect_set_tree_scope(wmem_packet_scope());
+    set_sized_data_scope(wmem_packet_scope());
+    set_address(&src, AT_IPv4, 4, host);
+    set_address(&dest, AT_IPv4, 4, group);
+  }
+  writer = pcap_writer_open(pcap_filename, group, (guint16) port);
+  if (!writer) {
+    return 1;
+  }
+  payload = pcap_writer_payload(writer);
+
+  start = g_get_monotonic_time();
+  for (n = 0; n < messages && goodp; ++n) {
+    gdouble pick = rng_unit() * total_weight;
+    GenChoice* choice = &g_array_index(choices, GenChoice, 0);
+
+    for (i = 1; i < choices->len && choice->weight <= pick; ++i) {
+      choice = &g_array_index(choices, GenChoice, i);
+    }
+    fill_fields(&profile, choice->fields, choice->nfields,
+                choice->data->children);
+
+    for (;;) {
+      gsize nbytes;
+      if (!in_packet) {
+        ts = (gint64) GEN_EPOCH * 1000000000 +
+          (gint64) ((gdouble) n * 1e9 / rate);
+        if (profile.packet_reset) {
+          encoder_reset(encoder);
+          if (check) {
+            reset_dictionaries();
+            dissect_reset();
+          }
+        }
+      }
+      nbytes = encode_message(encoder, choice->tmpl, choice->data,
+                              payload + len, profile.packet_bytes - len);
+      if (nbytes && check &&
+          !check_message(templates_table, choice, payload + len, nbytes,
+                         &src, &dest, n)) {
+        goodp = FALSE;
+        break;
+      }
+      if (nbytes) {
+        len += nbytes;
+        in_packet++;
+        break;
+      }
+      if (!in_packet) {
+        fprintf(stderr, "%s: message %" G_GUINT64_FORMAT ": %s\n",
+                ((const FieldType*) choice->tmpl->data)->name, n + 1,
+                encoder->error);
+        goodp = FALSE;
+        break;
+      }
+      /* the message starts the next packet */
+      goodp = flush_packet(writer, ts, &len, &in_packet);
+      if (!goodp) {
+        break;
+      }
+    }
+    if (goodp && in_packet == profile.packet_messages) {
+      goodp = flush_packet(writer, ts, &len, &in_packet);
+    }
+  }
+  if (goodp && in_packet) {
+    goodp = flush_packet(writer, ts, &len, &in_packet);
+  }
+  seconds = (g_get_monotonic_time() - start) / 1e6;
+
+  fprintf(stderr, "%" G_GUINT64_FORMAT " packets, %" G_GUINT64_FORMAT
+          " messages, %" G_GUINT64_FORMAT " bytes in %.3f s",
+          writer->packets, n, writer->bytes, seconds);
+  if (seconds > 0) {
+    fprintf(stderr, " (%.0f msg/s)", n / seconds);
+  }
+  fputc('\n', stderr);
+
+  if (!pcap_writer_close(writer)) {
+    fprintf(stderr, "%s: write failed\n", pcap_filename);
+    goodp = FALSE;
+  }
+  encoder_free(encoder);
+
+  wmem_leave_file_scope();
+  wmem_cleanup_scopes();
+  wmem_cleanup();
+  return goodp ? 0 : 1;
+}
+
+
+int ArgParseBailOut (const char* arg, const char* reason)
+{
+  if (arg) {
+    fprintf(stderr, "Error with argument: %s\n", arg);
+  }
+  if (reason) {
+    fprintf(stderr, "Reason: %s\n", reason);
+  }
+  fputs("Usage: fastgen tmpl FILE pcap FILE [profile FILE] [messages N]\n"
+        "              [seed N] [rate N] [port N] [check yes]\n"
+        "  tmpl      FAST templates of the messages.\n"
+        "  pcap      Capture to write.\n"
+        "  profile   Message mix, see example-profile.xml.\n"
+        "  messages  Messages to generate, 1000000 by default.\n"
+        "  seed      Seed of the random values, over the one of the profile.\n"
+        "  rate      Messages per second of the timestamps.\n"
+        "  port      Destination UDP port of the datagrams.\n"
+        "  check     Decode every message again and compare it.\n", stderr);
+  return (arg || reason) ? 1 : 0;
+}
+
+
+void init_profile (GenProfile* profile)
+{
+  memset(profile, 0, sizeof(GenProfile));
+  profile->instruments = 100;
+  profile->absent = 0.1;
+  profile->reuse[FieldOperatorNone] = 0.2;
+  profile->reuse[FieldOperatorConstant] = 1;
+  profile->reuse[FieldOperatorDefault] = 0.7;
+  profile->reuse[FieldOperatorCopy] = 0.8;
+  profile->reuse[FieldOperatorIncrement] = 0.9;
+  profile->reuse[FieldOperatorDelta] = 0.9;
+  profile->reuse[FieldOperatorTail] = 0.7;
+  profile->seq_min = 1;
+  profile->seq_max = 4;
+  profile->instrument_fields = g_hash_table_new(g_str_hash, g_str_equal);
+  profile->sequences = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, g_free);
+  profile->weights = g_array_new(FALSE, FALSE, sizeof(GenChoice));
+  profile->packet_bytes = 1400;
+}
+
+
+gboolean read_profile (GenProfile* profile, const GNode* templates,
+                       const char* filename)
+{
+  xmlDocPtr doc = xmlParseFile(filename);
+  xmlNodePtr root;
+  xmlNodePtr node;
+  gboolean goodp = TRUE;
+
+  if (!doc) {
+    fprintf(stderr, "%s: cannot be parsed\n", filename);
+    return FALSE;
+  }
+  root = xmlDocGetRootElement(doc);
+  if (!root || xmlStrcasecmp(root->name, (const xmlChar*) "profile")) {
+    fprintf(stderr, "%s: not a profile\n", filename);
+    xmlFreeDoc(doc);
+    return FALSE;
+  }
+  profile->seed = xml_uint(root, "seed", profile->seed);
+  profile->instruments = (guint) xml_uint(root, "instruments",
+                                          profile->instruments);
+  profile->absent = xml_ratio(root, "absent", profile->absent);
+
+  for (node = root->children; node && goodp; node = node->next) {
+    xmlChar* name;
+    if (node->type != XML_ELEMENT_NODE) {
+      continue;
+    }
+    if (!xmlStrcasecmp(node->name, (const xmlChar*) "message")) {
+      GenChoice choice;
+      name = xmlGetProp(node, (const xmlChar*) "template");
+      memset(&choice, 0, sizeof(GenChoice));
+      choice.tmpl = name ? find_template(templates, (const char*) name) : 0;
+      choice.weight = xml_ratio(node, "weight", 1);
+      if (choice.tmpl) {
+        g_array_append_val(profile->weights, choice);
+      }
+      else {
+        fprintf(stderr, "%s: no template %s\n", filename,
+                name ? (const char*) name : "given");
+        goodp = FALSE;
+      }
+      xmlFree(name);
+    }
+    else if (!xmlStrcasecmp(node->name, (const xmlChar*) "instrument")) {
+      name = xmlGetProp(node, (const xmlChar*) "field");
+      if (name) {
+        char* field = g_strdup((const char*) name);
+        g_hash_table_insert(profile->instrument_fields, field, field);
+        xmlFree(name);
+      }
+    }
+    else if (!xmlStrcasecmp(node->name, (const xmlChar*) "sequence")) {
+      GenRange range;
+      name = xmlGetProp(node, (const xmlChar*) "field");
+      range.min = (guint) xml_uint(node, "min", profile->seq_min);
+      range.max = (guint) xml_uint(node, "max", MAX(range.min,
+                                                    profile->seq_max));
+      if (range.max < range.min) {
+        range.max = range.min;
+      }
+      if (name) {
+        g_hash_table_insert(profile->sequences, g_strdup((const char*) name),
+                            g_memdup(&range, sizeof(GenRange)));
+        xmlFree(name);
+      }
+      else {
+        profile->seq_min = range.min;
+        profile->seq_max = range.max;
+      }
+    }
+    else if (!xmlStrcasecmp(node->name, (const xmlChar*) "reuse")) {
+      FieldOperatorIdentifier op = FieldOperatorEnumLimit;
+      guint k;
+      name = xmlGetProp(node, (const xmlChar*) "operator");
+      if (name && !xmlStrcasecmp(name, (const xmlChar*) "none")) {
+        op = FieldOperatorNone;
+      }
+      for (k = 0; name && k < FieldOperatorEnumLimit; ++k) {
+        if (!xmlStrcasecmp(name, (const xmlChar*) operator_typename(k))) {
+          op = (FieldOperatorIdentifier) k;
+        }
+      }
+      if (op != FieldOperatorEnumLimit) {
+        profile->reuse[op] = xml_ratio(node, "ratio", profile->reuse[op]);
+      }
+      else {
+        fprintf(stderr, "%s: unknown operator %s\n", filename,
+                name ? (const char*) name : "");
+        goodp = FALSE;
+      }
+      xmlFree(name);
+    }
+    else if (!xmlStrcasecmp(node->name, (const xmlChar*) "packet")) {
+      profile->packet_bytes = (guint) xml_uint(node, "bytes",
+                                               profile->packet_bytes);
+      profile->packet_messages = (guint) xml_uint(node, "messages",
+                                                  profile->packet_messages);
+      name = xmlGetProp(node, (const xmlChar*) "reset");
+      profile->packet_reset = name &&
+        (!xmlStrcasecmp(name, (const xmlChar*) "yes") ||
+         !xmlStrcasecmp(name, (const xmlChar*) "true"));
+      xmlFree(name);
+    }
+  }
+  xmlFreeDoc(doc);
+
+  if (goodp && (!profile->packet_bytes ||
+                profile->packet_bytes > PCAP_WRITER_PAYLOAD_MAX)) {
+    fprintf(stderr, "%s: packet bytes must be within 1 and %d\n", filename,
+            PCAP_WRITER_PAYLOAD_MAX);
+    goodp = FALSE;
+  }
+  return goodp;
+}
+
+
+const GNode* find_template (const GNode* templates, const char* what)
+{
+  const GNode* tmpl;
+  char* end;
+  glong id = strtol(what, &end, 10);
+
+  for (tmpl = templates->children; tmpl; tmpl = tmpl->next) {
+    const FieldType* ttype = (const FieldType*) tmpl->data;
+    if ((!*end && ttype->id == id) ||
+        (ttype->name && !strcmp(ttype->name, what))) {
+      return tmpl;
+    }
+  }
+  return 0;
+}
+
+
+gdouble xml_ratio (xmlNodePtr node, const char* name, gdouble fallback)
+{
+  xmlChar* prop = xmlGetProp(node, (const xmlChar*) name);
+  gdouble x = fallback;
+
+  if (prop) {
+    x = g_ascii_strtod((const char*) prop, NULL);
+    xmlFree(prop);
+  }
+  return x < 0 ? 0 : x;
+}
+
+
+guint64 xml_uint (xmlNodePtr node, const char* name, guint64 fallback)
+{
+  xmlChar* prop = xmlGetProp(node, (const xmlChar*) name);
+  guint64 x = fallback;
+
+  if (prop) {
+    x = g_ascii_strtoull((const char*) prop, NULL, 10);
+    xmlFree(prop);
+  }
+  return x;
+}
+
+
+GenField* compile_fields (const GenProfile* profile, const GNode* tnode,
+                          guint* count)
+{
+  GenField* fields;
+  const GNode* it;
+  guint i = 0;
+
+  *count = 0;
+  for (it = tnode; it; it = it->next) {
+    ++*count;
+  }
+  fields = g_new0(GenField, MAX(*count, 1));
+
+  for (it = tnode; it; it = it->next, ++i) {
+    GenField* field = &fields[i];
+    const FieldType* ftype = (const FieldType*) it->data;
+    field->ftype = ftype;
+    field->instrument = ftype->name &&
+      g_hash_table_lookup(profile->instrument_fields, ftype->name) != NULL;
+
+    if (FieldTypeGroup == ftype->type) {
+      field->children = compile_fields(profile, it->children,
+                                       &field->nchildren);
+    }
+    else if (FieldTypeSequence == ftype->type) {
+      const GenRange* range = ftype->name ?
+        (const GenRange*) g_hash_table_lookup(profile->sequences,
+                                              ftype->name) : 0;
+      field->range.min = range ? range->min : profile->seq_min;
+      field->range.max = range ? range->max : profile->seq_max;
+      /* after the length come the fields of an element */
+      field->children = compile_fields(profile, it->children->next->children,
+                                       &field->nchildren);
+    }
+    else if (FieldTypeDecimal == ftype->type) {
+      const FieldType* exponent = (const FieldType*) it->children->data;
+      field->exponent = ftype->hasDefault ? ftype->value.decimal.exponent :
+        exponent->hasDefault ? exponent->value.i32 : -2;
+    }
+  }
+  return fields;
+}
+
+
+void build_data (const GenField* fields, guint count, GNode* parent)
+{
+  guint i;
+
+  for (i = 0; i < count; ++i) {
+    const GenField* field = &fields[i];
+    GenSlot* slot = g_new0(GenSlot, 1);
+    GNode* dnode = g_node_append_data(parent, slot);
+
+    if (FieldTypeGroup == field->ftype->type) {
+      build_data(field->children, field->nchildren, dnode);
+    }
+    else if (FieldTypeSequence == field->ftype->type) {
+      guint k;
+      /* linked into the sequence node per message */
+      slot->elements = g_new0(GNode*, MAX(field->range.max, 1));
+      for (k = 0; k < field->range.max; ++k) {
+        GenSlot* element = g_new0(GenSlot, 1);
+        element->fdata.status = FieldExists;
+        slot->elements[k] = g_node_new(element);
+        slot->elements[k]->parent = dnode;
+        slot->elements[k]->prev = k ? slot->elements[k - 1] : NULL;
+        build_data(field->children, field->nchildren, slot->elements[k]);
+      }
+    }
+  }
+}
+
+
+void fill_fields (const GenProfile* profile, GenField* fields, guint count,
+                  GNode* dnode)
+{
+  guint i;
+
+  for (i = 0; i < count; ++i, dnode = dnode->next) {
+    GenField* field = &fields[i];
+    const FieldType* ftype = field->ftype;
+    GenSlot* slot = (GenSlot*) dnode->data;
+
+    if (!ftype->mandatory && rng_unit() < profile->absent) {
+      slot->fdata.status = FieldEmpty;
+      continue;
+    }
+    slot->fdata.status = FieldExists;
+
+    if (FieldTypeGroup == ftype->type) {
+      fill_fields(profile, field->children, field->nchildren, dnode->children);
+    }
+    else if (FieldTypeSequence == ftype->type) {
+      guint n = field->range.min +
+        (guint) rng_below(field->range.max - field->range.min + 1);
+      guint k;
+      for (k = 0; k < n; ++k) {
+        slot->elements[k]->next = k + 1 < n ? slot->elements[k + 1] : NULL;
+        fill_fields(profile, field->children, field->nchildren,
+                    slot->elements[k]->children);
+      }
+      dnode->children = n ? slot->elements[0] : NULL;
+    }
+    else {
+      next_value(profile, field);
+      set_data(field, slot);
+    }
+  }
+}
+
+
+void next_value (const GenProfile* profile, GenField* field)
+{
+  const FieldType* ftype = field->ftype;
+  FieldTypeIdentifier type = ftype->type;
+  gboolean sized = type == FieldTypeAsciiString ||
+    type == FieldTypeUnicodeString || type == FieldTypeByteVector;
+
+  if (FieldOperatorConstant == ftype->op ||
+      (FieldOperatorDefault == ftype->op && ftype->hasDefault &&
+       rng_unit() < profile->reuse[FieldOperatorDefault])) {
+    if (sized) {
+      field->nbytes = MIN(ftype->value.bytevec.nbytes, GEN_SIZED_MAX);
+      memcpy(field->bytes, ftype->value.bytevec.bytes, field->nbytes);
+    }
+    else if (FieldTypeDecimal == type) {
+      field->bits = (guint64) ftype->value.decimal.mantissa;
+      field->exponent = ftype->value.decimal.exponent;
+    }
+    else {
+      field->bits = FieldTypeUInt32 == type ? ftype->value.u32 :
+        FieldTypeInt32 == type ? (guint64) (gint64) ftype->value.i32 :
+        ftype->value.u64;
+    }
+    field->assigned = TRUE;
+    return;
+  }
+
+  if (!field->assigned || rng_unit() >= profile->reuse[ftype->op]) {
+    guint nbytes = field->assigned ? field->nbytes : 0;
+    fresh_value(profile, field);
+    field->assigned = TRUE;
+    /* a tail cannot make the value shorter */
+    if (sized && FieldOperatorTail == ftype->op) {
+      while (field->nbytes < nbytes) {
+        field->bytes[field->nbytes++] = (guint8) ('A' + rng_below(26));
+      }
+    }
+    return;
+  }
+
+  /* reuse the previous value the way the operator expects it */
+  if (field->instrument) {
+    return;
+  }
+  switch (ftype->op) {
+    case FieldOperatorIncrement:
+      field->bits = truncate_bits(type, field->bits + 1);
+      break;
+    case FieldOperatorDelta:
+      if (sized) {
+        /* a different last character */
+        if (field->nbytes < GEN_SIZED_MAX && rng_below(2)) {
+          field->nbytes++;
+        }
+        if (field->nbytes) {
+          field->bytes[field->nbytes - 1] = (guint8) ('A' + rng_below(26));
+        }
+      }
+      else {
+        /* a small step, away from zero for unsigned values */
+        gint64 step = (gint64) rng_below(9) - 4;
+        if (field->bits < 4 && (FieldTypeUInt32 == type ||
+                                FieldTypeUInt64 == type)) {
+          step = step < 0 ? -step : step;
+        }
+        field->bits = truncate_bits(type, field->bits + (guint64) step);
+      }
+      break;
+    case FieldOperatorTail:
+      if (sized && field->nbytes) {
+        field->bytes[field->nbytes - 1] = (guint8) ('A' + rng_below(26));
+      }
+      break;
+    default:
+      /* the same value again */
+      break;
+  }
+}
+
+
+void fresh_value (const GenProfile* profile, GenField* field)
+{
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  FieldTypeIdentifier type = field->ftype->type;
+  guint64 instrument = rng_below(MAX(profile->instruments, 1));
+  guint k;
+
+  switch (type) {
+    case FieldTypeUInt32:
+    case FieldTypeUInt64:
+      field->bits = field->instrument ? 1000 + instrument : rng_below(1 << 20);
+      break;
+    case FieldTypeInt32:
+    case FieldTypeInt64:
+      field->bits = field->instrument ? 1000 + instrument :
+        truncate_bits(type, (guint64) ((gint64) rng_below(1 << 20) -
+                                       (1 << 19)));
+      break;
+    case FieldTypeDecimal:
+      field->bits = 1 + rng_below(1000000);
+      break;
+    case FieldTypeAsciiString:
+    case FieldTypeUnicodeString:
+    case FieldTypeByteVector:
+      if (field->instrument) {
+        field->nbytes = (guint) g_snprintf((char*) field->bytes,
+                                           GEN_SIZED_MAX, "SYM%05u",
+                                           (guint) instrument);
+      }
+      else {
+        field->nbytes = 1 + (guint) rng_below(12);
+        for (k = 0; k < field->nbytes; ++k) {
+          field->bytes[k] = (guint8) alphabet[rng_below(sizeof(alphabet) - 1)];
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+guint64 truncate_bits (FieldTypeIdentifier type, guint64 bits)
+{
+  switch (type) {
+    case FieldTypeUInt32:
+      return (guint32) bits;
+    case FieldTypeInt32:
+      return (guint64) (gint64) (gint32) bits;
+    default:
+      return bits;
+  }
+}
+
+
+void set_data (const GenField* field, GenSlot* slot)
+{
+  FieldValue* value = &slot->fdata.value;
+
+  switch (field->ftype->type) {
+    case FieldTypeUInt32:
+      value->u32 = (guint32) field->bits;
+      break;
+    case FieldTypeInt32:
+      value->i32 = (gint32) field->bits;
+      break;
+    case FieldTypeUInt64:
+    case FieldTypeInt64:
+      value->u64 = field->bits;
+      break;
+    case FieldTypeDecimal:
+      value->decimal.mantissa = (gint64) field->bits;
+      value->decimal.exponent = field->exponent;
+      break;
+    default:
+      /* other elements of a sequence change the field before encoding */
+      memcpy(slot->bytes, field->bytes, field->nbytes);
+      value->bytevec.nbytes = field->nbytes;
+      value->bytevec.bytes = slot->bytes;
+      break;
+  }
+}
+
+
+gboolean check_message (wmem_map_t* templates, const GenChoice* choice,
+                        const guint8* bytes, gsize nbytes,
+                        address* src, address* dest, guint64 n)
+{
+  DissectPosition position;
+  GNode* data;
+  const GNode* tmpl;
+  const FieldType* differs = 0;
+  gboolean goodp;
+
+  wmem_enter_packet_scope();
+  memset(&position, 0, sizeof(DissectPosition));
+  position.nbytes = (guint) nbytes;
+  position.bytes = bytes;
+  ShiftBytes(&position);
+
+  data = wmem_node_new(wmem_packet_scope(), 0);
+  tmpl = dissect_fast_bytes(templates, &position, data, src, dest);
+  goodp = tmpl == choice->tmpl && !position.nbytes;
+  if (goodp) {
+    differs = compare_fields(tmpl->children, choice->data->children,
+                             data->children);
+    goodp = !differs;
+  }
+  if (!goodp) {
+    fprintf(stderr, "%s: message %" G_GUINT64_FORMAT " does not decode as "
+            "encoded%s%s\n", ((const FieldType*) choice->tmpl->data)->name,
+            n + 1, differs ? ", first at " : "",
+            differs ? (differs->name ? differs->name : "unnamed field") : "");
+  }
+  wmem_leave_packet_scope();
+  return goodp;
+}
+
+
+const FieldType* compare_fields (const GNode* tnode, const GNode* sent,
+                                 const GNode* decoded)
+{
+  const FieldType* differs = 0;
+
+  for (; tnode && !differs; tnode = tnode->next) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* a;
+    const FieldData* b;
+
+    if (!sent || !decoded) {
+      return ftype;
+    }
+    a = (const FieldData*) sent->data;
+    b = (const FieldData*) decoded->data;
+    if ((FieldExists == a->status) != (FieldExists == b->status)) {
+      return ftype;
+    }
+    if (FieldExists != a->status) {
+      /* left out both ways, nothing more to compare */
+    }
+    else if (FieldTypeGroup == ftype->type) {
+      differs = compare_fields(tnode->children, sent->children,
+                               decoded->children);
+    }
+    else if (FieldTypeSequence == ftype->type) {
+      const GNode* group = tnode->children->next;
+      const GNode* x = sent->children;
+      const GNode* y = decoded->children;
+      for (; x && y && !differs; x = x->next, y = y->next) {
+        differs = compare_fields(group->children, x->children, y->children);
+      }
+      if (!differs && (x || y)) {
+        differs = ftype;
+      }
+    }
+    else if (!same_value(ftype, a, b)) {
+      differs = ftype;
+    }
+    sent = sent->next;
+    decoded = decoded->next;
+  }
+  return differs;
+}
+
+
+gboolean same_value (const FieldType* ftype, const FieldData* sent,
+                     const FieldData* decoded)
+{
+  const FieldValue* a = &sent->value;
+  const FieldValue* b = &decoded->value;
+
+  switch (ftype->type) {
+    case FieldTypeUInt32:
+      return a->u32 == b->u32;
+    case FieldTypeInt32:
+      return a->i32 == b->i32;
+    case FieldTypeUInt64:
+    case FieldTypeInt64:
+      return a->u64 == b->u64;
+    case FieldTypeDecimal:
+      return a->decimal.mantissa == b->decimal.mantissa &&
+             a->decimal.exponent == b->decimal.exponent;
+    case FieldTypeAsciiString:
+    case FieldTypeUnicodeString:
+    case FieldTypeByteVector:
+      return a->bytevec.nbytes == b->bytevec.nbytes &&
+             !memcmp(a->bytevec.bytes, b->bytevec.bytes, a->bytevec.nbytes);
+    default:
+      return TRUE;
+  }
+}
+
+
+gboolean flush_packet (PcapWriter* writer, gint64 ts, guint* len,
+                       guint* in_packet)
+{
+  gboolean goodp = pcap_writer_commit(writer, ts, *len);
+  *len = 0;
+  *in_packet = 0;
+  return goodp;
+}
+
+
+guint64 rng_next (void)
+{
+  /* xorshift64* */
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+
+guint64 rng_below (guint64 n)
+{
+  return n ? rng_next() % n : 0;
+}
+
+
+gdouble rng_unit (void)
+{
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
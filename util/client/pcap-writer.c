@@ -0,0 +1,194 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <string.h>
+
+#include "pcap-writer.h"
+
+/*! \brief  Write buffer of the file, records go out in large writes. */
+#define PCAP_WRITE_BUFFER (4 << 20)
+
+#define PCAP_MAGIC_NS  0xa1b23c4d
+#define LINKTYPE_ETHERNET  1
+
+/*! \brief  Record header, then Ethernet, IPv4 and UDP headers. */
+#define RECORD_HEADER  16
+#define ETH_HEADER     14
+#define IP_HEADER      20
+#define UDP_HEADER     8
+#define FRAME_HEADERS  (ETH_HEADER + IP_HEADER + UDP_HEADER)
+
+/*! \brief  Global header of the file.
+ */
+struct pcap_file_header_struct
+{
+  guint32 magic;
+  guint16 version_major;
+  guint16 version_minor;
+  gint32 thiszone;
+  guint32 sigfigs;
+  guint32 snaplen;
+  guint32 network;
+};
+typedef struct pcap_file_header_struct PcapFileHeader;
+
+/*! \brief  Write the frame headers that stay the same for every record.
+ */
+static void init_headers (PcapWriter* writer);
+
+static void put_u16 (guint8* bytes, guint16 x);
+
+
+PcapWriter* pcap_writer_open (const char* filename, const guint8* dst,
+                              guint16 dst_port)
+{
+  static const guint8 src[4] = { 10, 0, 0, 1 };
+  PcapWriter* writer;
+  PcapFileHeader header;
+  FILE* file = fopen(filename, "wb");
+
+  if (!file) {
+    perror(filename);
+    return NULL;
+  }
+  setvbuf(file, NULL, _IOFBF, PCAP_WRITE_BUFFER);
+
+  /* in host order, readers swap by the magic */
+  memset(&header, 0, sizeof(PcapFileHeader));
+  header.magic = PCAP_MAGIC_NS;
+  header.version_major = 2;
+  header.version_minor = 4;
+  header.snaplen = 65535;
+  header.network = LINKTYPE_ETHERNET;
+
+  writer = g_new0(PcapWriter, 1);
+  writer->file = file;
+  writer->record = (guint8*) g_malloc0(RECORD_HEADER + FRAME_HEADERS +
+                                       PCAP_WRITER_PAYLOAD_MAX);
+  memcpy(writer->src, src, 4);
+  memcpy(writer->dst, dst, 4);
+  writer->src_port = 40000;
+  writer->dst_port = dst_port;
+  init_headers(writer);
+
+  if (fwrite(&header, sizeof(PcapFileHeader), 1, file) != 1) {
+    writer->failed = TRUE;
+  }
+  return writer;
+}
+
+
+guint8* pcap_writer_payload (PcapWriter* writer)
+{
+  return writer->record + RECORD_HEADER + FRAME_HEADERS;
+}
+
+
+gboolean pcap_writer_commit (PcapWriter* writer, gint64 ts, guint nbytes)
+{
+  guint8* ip = writer->record + RECORD_HEADER + ETH_HEADER;
+  guint8* udp = ip + IP_HEADER;
+  guint32 record[4];
+  guint32 sum = 0;
+  guint i;
+
+  if (nbytes > PCAP_WRITER_PAYLOAD_MAX) {
+    return FALSE;
+  }
+
+  record[0] = (guint32) (ts / 1000000000);
+  record[1] = (guint32) (ts % 1000000000);
+  record[2] = FRAME_HEADERS + nbytes;
+  record[3] = FRAME_HEADERS + nbytes;
+  memcpy(writer->record, record, RECORD_HEADER);
+
+  put_u16(ip + 2, (guint16) (IP_HEADER + UDP_HEADER + nbytes));
+  put_u16(ip + 4, writer->ip_id++);
+  put_u16(ip + 10, 0);
+  for (i = 0; i < IP_HEADER; i += 2) {
+    sum += (ip[i] << 8) | ip[i + 1];
+  }
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  put_u16(ip + 10, (guint16) ~sum);
+  /* no UDP checksum */
+  put_u16(udp + 4, (guint16) (UDP_HEADER + nbytes));
+
+  if (fwrite(writer->record, RECORD_HEADER + FRAME_HEADERS + nbytes, 1,
+             writer->file) != 1) {
+    writer->failed = TRUE;
+    return FALSE;
+  }
+  writer->packets++;
+  writer->bytes += nbytes;
+  return TRUE;
+}
+
+
+gboolean pcap_writer_close (PcapWriter* writer)
+{
+  gboolean ok = !writer->failed;
+
+  if (fclose(writer->file) != 0) {
+    ok = FALSE;
+  }
+  g_free(writer->record);
+  g_free(writer);
+  return ok;
+}
+
+
+void init_headers (PcapWriter* writer)
+{
+  guint8* eth = writer->record + RECORD_HEADER;
+  guint8* ip = eth + ETH_HEADER;
+  guint8* udp = ip + IP_HEADER;
+
+  /* multicast groups map to 01:00:5e and their low 23 bits */
+  if (writer->dst[0] >= 224 && writer->dst[0] <= 239) {
+    eth[0] = 0x01;
+    eth[1] = 0x00;
+    eth[2] = 0x5e;
+    eth[3] = writer->dst[1] & 0x7f;
+    eth[4] = writer->dst[2];
+    eth[5] = writer->dst[3];
+  }
+  else {
+    eth[0] = 0x02;
+    eth[5] = 0x02;
+  }
+  eth[6] = 0x02;
+  eth[11] = 0x01;
+  put_u16(eth + 12, 0x0800);
+
+  ip[0] = 0x45;
+  ip[6] = 0x40;   /* don't fragment */
+  ip[8] = 64;
+  ip[9] = 17;
+  memcpy(ip + 12, writer->src, 4);
+  memcpy(ip + 16, writer->dst, 4);
+
+  put_u16(udp, writer->src_port);
+  put_u16(udp + 2, writer->dst_port);
+}
+
+
+void put_u16 (guint8* bytes, guint16 x)
+{
+  bytes[0] = (guint8) (x >> 8);
+  bytes[1] = (guint8) x;
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file pcap-writer.h
+ * \brief  Sequential writer of UDP datagrams into a pcap file.
+ *  Records are Ethernet/IPv4/UDP frames with nanosecond timestamps.
+ *  A single record buffer holds the headers in front of the payload,
+ *  the caller fills the payload in place and commits it.
+ */
+
+#ifndef PCAP_WRITER_H_
+#define PCAP_WRITER_H_
+
+#include <stdio.h>
+#include <glib.h>
+
+/*! \brief  Largest payload of a datagram. */
+#define PCAP_WRITER_PAYLOAD_MAX (65535 - 20 - 8)
+
+/*! \brief  A capture file being written.
+ */
+struct pcap_writer_struct
+{
+  FILE* file;
+  guint8* record;       /*!< Record header, frame headers and payload. */
+  guint8 src[4];        /*!< IPv4 addresses, network order. */
+  guint8 dst[4];
+  guint16 src_port;
+  guint16 dst_port;
+  guint16 ip_id;
+  guint64 packets;
+  guint64 bytes;        /*!< Payload bytes written. */
+  gboolean failed;      /*!< A write failed. */
+};
+typedef struct pcap_writer_struct PcapWriter;
+
+/*! \brief  Create a capture file.
+ * \param filename  Path of the file.
+ * \param dst  Destination IPv4 address of the datagrams, network order.
+ * \param dst_port  Destination UDP port.
+ * \return  The writer, NULL if the file cannot be created.
+ */
+PcapWriter* pcap_writer_open (const char* filename, const guint8* dst,
+                              guint16 dst_port);
+
+/*! \brief  Payload of the next datagram, PCAP_WRITER_PAYLOAD_MAX bytes.
+ */
+guint8* pcap_writer_payload (PcapWriter* writer);
+
+/*! \brief  Write the payload filled so far as a datagram.
+ * \param writer  The writer.
+ * \param ts  Timestamp in nanoseconds since the epoch.
+ * \param nbytes  Bytes of payload.
+ * \return  FALSE if the write failed.
+ */
+gboolean pcap_writer_commit (PcapWriter* writer, gint64 ts, guint nbytes);
+
+/*! \brief  Flush and close the file, free the writer.
+ * \return  FALSE if a write failed.
+ */
+gboolean pcap_writer_close (PcapWriter* writer);
+
+#endif
@@ -0,0 +1,428 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file replay.c
+ * \brief  Send the UDP payloads of a capture again, to a local listener.
+ *  Datagrams keep the spacing of their timestamps, divided by a speed
+ *  factor, or go out as fast as the socket takes them. The ones that
+ *  are due together are sent with one sendmmsg call; waits sleep to
+ *  shortly before the due time and spin the rest, so the pacing holds
+ *  at microsecond spacings.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <glib.h>
+
+#include "pcap-file.h"
+
+/*! \brief  Datagrams sent with one sendmmsg call, by default. */
+#define REPLAY_BATCH 64
+
+/*! \brief  Largest UDP payload. */
+#define REPLAY_PAYLOAD_MAX 65535
+
+/*! \brief  Waits shorter than this spin instead of sleeping, in ns. */
+#define REPLAY_SPIN 50000
+
+/*! \brief  A datagram sent this late counts as late, in ns. */
+#define REPLAY_LATE 100000
+
+/*! \brief  Datagrams waiting for the next sendmmsg call.
+ */
+struct replay_batch_struct
+{
+  struct mmsghdr* msgs;
+  struct iovec* iovs;
+  struct sockaddr_in* addrs;
+  guint8* buffers;           /*!< REPLAY_PAYLOAD_MAX bytes per datagram. */
+  guint size;
+  guint len;
+};
+typedef struct replay_batch_struct ReplayBatch;
+
+/*! \brief  What went out, and how close to its due time.
+ */
+struct replay_counters_struct
+{
+  guint64 datagrams;
+  guint64 bytes;
+  guint64 calls;             /*!< sendmmsg calls. */
+  guint64 failed;            /*!< datagrams the socket refused */
+  guint64 paced;             /*!< batches sent at a due time */
+  guint64 late;              /*!< sent REPLAY_LATE after due or later */
+  gint64 late_max;
+  gint64 late_sum;
+};
+typedef struct replay_counters_struct ReplayCounters;
+
+/*! \brief  Set by SIGINT and SIGTERM, the replay stops early. */
+static volatile sig_atomic_t replay_stop = 0;
+
+/*! \brief  Print the usage, or a bad argument.
+ * \return  The exit status.
+ */
+static int ArgParseBailOut (const char* arg, const char* reason);
+
+static void replay_signal (int sig);
+
+/*! \brief  Current time of a clock in nanoseconds.
+ */
+static gint64 clock_ns (clockid_t clock);
+
+/*! \brief  Wait until a CLOCK_MONOTONIC time.
+ */
+static void wait_until (gint64 due);
+
+static void batch_init (ReplayBatch* batch, guint size);
+static void batch_free (ReplayBatch* batch);
+
+/*! \brief  Queue a datagram, its payload is copied.
+ */
+static void batch_add (ReplayBatch* batch, const struct sockaddr_in* addr,
+                       const guint8* payload, guint nbytes);
+
+/*! \brief  Send the queued datagrams.
+ * \param due  When the last of them was due, 0 when there is no pacing.
+ * \return  FALSE if the socket failed.
+ */
+static gboolean batch_send (ReplayBatch* batch, int sock, gint64 due,
+                            ReplayCounters* counters);
+
+static void report (const ReplayCounters* counters, gint64 elapsed);
+
+
+int main (const int argc, const char* const* argv)
+{
+  const char* pcap_filename = 0;
+  const char* host = "127.0.0.1";
+  gdouble speed = 1;
+  guint port = 0;
+  guint batch_size = REPLAY_BATCH;
+  guint sndbuf = 0;
+  guint64 loops = 1;
+  struct sockaddr_in addr;
+  ReplayBatch batch;
+  ReplayCounters counters;
+  gint64 start;
+  gint64 offset = 0;
+  gboolean goodp = TRUE;
+  guint64 loop;
+  int sock;
+  int argi;
+
+  if (argc == 1) {
+    return ArgParseBailOut(0, 0);
+  }
+
+  /* Loop thru arguments to set internal data. */
+  for (argi = 1; argi < argc; ++argi) {
+    const char* arg = argv[argi];
+    if (argc == argi+1) {
+      return ArgParseBailOut(arg, "Trailing flag without a value.");
+    }
+    else if (!strcmp("pcap", arg)) {
+      pcap_filename = argv[++argi];
+    }
+    else if (!strcmp("host", arg)) {
+      host = argv[++argi];
+    }
+    else if (!strcmp("p", arg) || !strcmp("port", arg)) {
+      port = (guint) atoi(argv[++argi]);
+    }
+    else if (!strcmp("speed", arg)) {
+      gboolean maxp = !strcmp("max", argv[++argi]);
+      speed = maxp ? 0 : g_ascii_strtod(argv[argi], NULL);
+      if (!maxp && !(speed > 0)) {
+        return ArgParseBailOut(argv[argi],
+                               "Speed is a positive factor or max.");
+      }
+    }
+    else if (!strcmp("batch", arg)) {
+      batch_size = (guint) atoi(argv[++argi]);
+      if (!batch_size || batch_size > 1024) {
+        return ArgParseBailOut(argv[argi], "Batch is within [1, 1024].");
+      }
+    }
+    else if (!strcmp("loop", arg)) {
+      loops = g_ascii_strtoull(argv[++argi], NULL, 10);
+      if (!loops) {
+        return ArgParseBailOut(argv[argi], "Loop must be positive.");
+      }
+    }
+    else if (!strcmp("sndbuf", arg)) {
+      sndbuf = (guint) atoi(argv[++argi]);
+    }
+    else {
+      return ArgParseBailOut(arg, "Unknown argument.");
+    }
+  }
+  if (!pcap_filename) {
+    return ArgParseBailOut(0, "A pcap is required.");
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    return ArgParseBailOut(host, "Host is an IPv4 address.");
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    return 1;
+  }
+  if (sndbuf &&
+      setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
+    perror("SO_SNDBUF");
+  }
+
+  signal(SIGINT, replay_signal);
+  signal(SIGTERM, replay_signal);
+
+  batch_init(&batch, batch_size);
+  memset(&counters, 0, sizeof(counters));
+  start = clock_ns(CLOCK_MONOTONIC);
+
+  for (loop = 0; loop < loops && goodp && !replay_stop; ++loop) {
+    PcapFile* pcap = pcap_file_open(pcap_filename);
+    PcapDatagram dgram;
+    gint64 first = -1;
+    gint64 due = 0;
+
+    if (!pcap) {
+      goodp = FALSE;
+      break;
+    }
+    while (goodp && !replay_stop && pcap_file_next(pcap, &dgram)) {
+      if (first < 0) {
+        first = dgram.ts;
+      }
+
+      if (speed > 0) {
+        gint64 next = start + offset +
+          (gint64) ((gdouble) (dgram.ts - first) / speed);
+        /* what is queued is due before this one */
+        if (batch.len && next > clock_ns(CLOCK_MONOTONIC)) {
+          goodp = batch_send(&batch, sock, due, &counters);
+        }
+        due = MAX(due, next);
+        wait_until(due);
+      }
+
+      /* the capture address is rarely local, only its port is kept */
+      addr.sin_port = htons((guint16) (port ? port : dgram.dst_port));
+      batch_add(&batch, &addr, dgram.payload, dgram.nbytes);
+      if (goodp && batch.len == batch.size) {
+        goodp = batch_send(&batch, sock, due, &counters);
+      }
+    }
+    if (goodp && batch.len) {
+      goodp = batch_send(&batch, sock, due, &counters);
+    }
+    pcap_file_close(pcap);
+
+    /* the next loop starts where this one ended */
+    if (first >= 0 && speed > 0) {
+      offset = MAX(offset, due - start) + 1;
+    }
+  }
+
+  report(&counters, clock_ns(CLOCK_MONOTONIC) - start);
+
+  batch_free(&batch);
+  close(sock);
+  return goodp ? 0 : 1;
+}
+
+
+int ArgParseBailOut (const char* arg, const char* reason)
+{
+  if (arg) {
+    fprintf(stderr, "Error with argument: %s\n", arg);
+  }
+  if (reason) {
+    fprintf(stderr, "Reason: %s\n", reason);
+  }
+  fputs("Usage: fastreplay pcap FILE [host ADDR] [port N] [speed X|max]\n"
+        "                  [batch N] [loop N] [sndbuf N]\n"
+        "  pcap    Capture whose UDP payloads are sent.\n"
+        "  host    IPv4 destination, 127.0.0.1 by default.\n"
+        "  port    Destination port, the captured one by default.\n"
+        "  speed   Factor over the captured timing, 1 by default, or max.\n"
+        "  batch   Datagrams per sendmmsg call, 64 by default.\n"
+        "  loop    Times the capture is sent, back to back.\n"
+        "  sndbuf  Send buffer of the socket, in bytes.\n", stderr);
+  return (arg || reason) ? 1 : 0;
+}
+
+
+void replay_signal (int sig)
+{
+  (void) sig;
+  replay_stop = 1;
+}
+
+
+gint64 clock_ns (clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+void wait_until (gint64 due)
+{
+  gint64 now = clock_ns(CLOCK_MONOTONIC);
+
+  /* sleeping wakes up late by tens of microseconds, spin the end */
+  if (due - now > REPLAY_SPIN) {
+    struct timespec ts;
+    gint64 wake = due - REPLAY_SPIN;
+    ts.tv_sec = (time_t) (wake / 1000000000);
+    ts.tv_nsec = (long) (wake % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR && !replay_stop) {
+    }
+  }
+  while (!replay_stop && clock_ns(CLOCK_MONOTONIC) < due) {
+  }
+}
+
+
+void batch_init (ReplayBatch* batch, guint size)
+{
+  guint i;
+
+  batch->msgs = g_new0(struct mmsghdr, size);
+  batch->iovs = g_new0(struct iovec, size);
+  batch->addrs = g_new0(struct sockaddr_in, size);
+  batch->buffers = (guint8*) g_malloc((gsize) size * REPLAY_PAYLOAD_MAX);
+  batch->size = size;
+  batch->len = 0;
+
+  for (i = 0; i < size; ++i) {
+    struct msghdr* hdr = &batch->msgs[i].msg_hdr;
+    batch->iovs[i].iov_base = batch->buffers + (gsize) i * REPLAY_PAYLOAD_MAX;
+    hdr->msg_iov = &batch->iovs[i];
+    hdr->msg_iovlen = 1;
+    hdr->msg_name = &batch->addrs[i];
+    hdr->msg_namelen = sizeof(struct sockaddr_in);
+  }
+}
+
+
+void batch_free (ReplayBatch* batch)
+{
+  g_free(batch->msgs);
+  g_free(batch->iovs);
+  g_free(batch->addrs);
+  g_free(batch->buffers);
+}
+
+
+void batch_add (ReplayBatch* batch, const struct sockaddr_in* addr,
+                const guint8* payload, guint nbytes)
+{
+  guint i = batch->len++;
+
+  nbytes = MIN(nbytes, REPLAY_PAYLOAD_MAX);
+  memcpy(batch->iovs[i].iov_base, payload, nbytes);
+  batch->iovs[i].iov_len = nbytes;
+  batch->addrs[i] = *addr;
+}
+
+
+gboolean batch_send (ReplayBatch* batch, int sock, gint64 due,
+                     ReplayCounters* counters)
+{
+  guint sent = 0;
+
+  while (sent < batch->len) {
+    int n = sendmmsg(sock, batch->msgs + sent, batch->len - sent, 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* nobody listens on the port, or the datagram is refused:
+         count it and go on with the rest */
+      if (errno == ECONNREFUSED || errno == EMSGSIZE || errno == ENOBUFS) {
+        counters->failed++;
+        sent++;
+        continue;
+      }
+      perror("sendmmsg");
+      batch->len = 0;
+      return FALSE;
+    }
+    counters->calls++;
+    while (n--) {
+      counters->datagrams++;
+      counters->bytes += batch->iovs[sent].iov_len;
+      sent++;
+    }
+  }
+  batch->len = 0;
+
+  if (due) {
+    gint64 late = clock_ns(CLOCK_MONOTONIC) - due;
+    counters->paced++;
+    if (late >= REPLAY_LATE) {
+      counters->late++;
+    }
+    counters->late_max = MAX(counters->late_max, late);
+    counters->late_sum += late;
+  }
+  return TRUE;
+}
+
+
+void report (const ReplayCounters* counters, gint64 elapsed)
+{
+  gdouble seconds = elapsed / 1e9;
+
+  fprintf(stderr, "%" G_GUINT64_FORMAT " datagrams, %" G_GUINT64_FORMAT
+          " bytes in %.3f s", counters->datagrams, counters->bytes, seconds);
+  if (seconds > 0) {
+    fprintf(stderr, " (%.0f datagrams/s, %.1f MB/s)",
+            counters->datagrams / seconds, counters->bytes / seconds / 1e6);
+  }
+  fputc('\n', stderr);
+  if (counters->calls) {
+    fprintf(stderr, "%" G_GUINT64_FORMAT " sendmmsg calls, %.1f datagrams"
+            " per call, %" G_GUINT64_FORMAT " refused\n", counters->calls,
+            (gdouble) counters->datagrams / counters->calls,
+            counters->failed);
+  }
+  if (counters->paced) {
+    fprintf(stderr, "pacing: %" G_GUINT64_FORMAT " batches late by 100 us"
+            " or more, mean %.1f us, max %.1f us\n", counters->late,
+            counters->late_sum / 1e3 / counters->paced,
+            counters->late_max / 1e3);
+  }
+}
@@ -0,0 +1,676 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <string.h>
+
+#include "arrow-writer.h"
+
+/*
+ * The metadata is a flatbuffer written front to back: every table is
+ * preceded by its vtable and followed by the objects it points to,
+ * so all offsets are positive and can be patched once the pointed
+ * object is placed. Scalars are aligned to their size from the start
+ * of the flatbuffer, which starts 8-byte aligned in the file.
+ */
+
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_CONTINUATION 0xffffffff
+
+/* Schema.fbs and Message.fbs */
+#define MetadataVersionV5   4
+#define MessageHeaderSchema 1
+#define MessageHeaderRecordBatch 3
+#define TypeInt             2
+#define TypeFloatingPoint   3
+#define TypeBinary          4
+#define TypeUtf8            5
+#define TypeTimestamp       10
+#define PrecisionDouble     2
+#define TimeUnitNanosecond  3
+
+/*! \brief  Most fields of a table written by the writer. */
+#define FB_MAX_FIELDS 8
+
+/*! \brief  Fields of a flatbuffer table being written.
+ */
+struct fb_table_struct
+{
+  guint   nfields;
+  guint8  size[FB_MAX_FIELDS];  /* 0 if the field is absent */
+  guint64 value[FB_MAX_FIELDS];
+  guint   slot[FB_MAX_FIELDS];  /* position of the field once written */
+};
+typedef struct fb_table_struct FbTable;
+
+/*! \brief  A record batch written, entry of the file footer.
+ */
+struct arrow_block_struct
+{
+  guint64 offset;
+  guint32 meta_length;
+  guint64 body_length;
+};
+typedef struct arrow_block_struct ArrowBlock;
+
+static void fb_align (GByteArray* fb, guint align);
+static guint fb_put (GByteArray* fb, guint size, guint64 value);
+static void fb_set (GByteArray* fb, guint pos, guint size, guint64 value);
+static void fb_patch (GByteArray* fb, guint slot, guint target);
+static void fb_table_start (FbTable* table, guint nfields);
+static void fb_table_scalar (FbTable* table, guint id, guint size, guint64 value);
+static guint fb_table_end (GByteArray* fb, FbTable* table);
+static guint fb_vector (GByteArray* fb, guint count, guint elem_size);
+static guint fb_string (GByteArray* fb, const char* str);
+static guint fb_message (GByteArray* fb, guint8 header_type,
+                         guint64 body_length, guint* header_slot);
+static guint fb_schema (GByteArray* fb, GPtrArray* columns);
+static guint fb_field (GByteArray* fb, const ArrowColumn* column);
+
+/*! \brief  Bytes of a value of a fixed width column. */
+static guint column_width (const ArrowColumn* column);
+
+/*! \brief  Record a row as null or not null. */
+static void column_set_valid (ArrowColumn* column, gboolean valid);
+
+/*! \brief  Empty the column for the next batch. */
+static void column_reset (ArrowColumn* column);
+
+/*! \brief  Buffers of a column in a record batch. */
+static guint column_nbuffers (const ArrowColumn* column);
+
+/*! \brief  Length of the i-th buffer of a column, before padding. */
+static guint64 column_buffer_length (const ArrowColumn* column, guint i);
+
+/*! \brief  Bytes of the i-th buffer of a column. */
+static const guint8* column_buffer (const ArrowColumn* column, guint i);
+
+static void write_bytes (ArrowWriter* writer, const void* bytes, guint64 nbytes);
+static void write_padding (ArrowWriter* writer, guint64 nbytes);
+
+/*! \brief  Write the length prefix and the metadata of a message.
+ * \return  Bytes written, what the footer calls the metadata length.
+ */
+static guint32 write_message (ArrowWriter* writer, const GByteArray* fb);
+
+#define PAD8(n) (((n) + 7) & ~(guint64) 7)
+
+
+ArrowWriter* arrow_writer_new (void)
+{
+  ArrowWriter* writer = g_new0(ArrowWriter, 1);
+  writer->columns = g_ptr_array_new();
+  writer->blocks = g_array_new(FALSE, FALSE, sizeof(ArrowBlock));
+  return writer;
+}
+
+
+ArrowColumn* arrow_writer_add_column (ArrowWriter* writer, const char* name,
+                                      ArrowType type)
+{
+  ArrowColumn* column = g_new0(ArrowColumn, 1);
+
+  column->name = g_strdup(name);
+  column->type = type;
+  column->validity = g_byte_array_new();
+  column->values = g_byte_array_new();
+  if (type == ArrowUtf8 || type == ArrowBinary) {
+    column->offsets = g_byte_array_new();
+  }
+  column_reset(column);
+  g_ptr_array_add(writer->columns, column);
+  return column;
+}
+
+
+gboolean arrow_writer_open (ArrowWriter* writer, const char* filename)
+{
+  static const guint8 magic[8] = ARROW_MAGIC;
+  GByteArray* fb;
+  guint slot;
+
+  writer->file = fopen(filename, "wb");
+  if (!writer->file) {
+    perror(filename);
+    writer->failed = TRUE;
+    return FALSE;
+  }
+  writer->filename = g_strdup(filename);
+  write_bytes(writer, magic, sizeof(magic));
+
+  fb = g_byte_array_new();
+  fb_message(fb, MessageHeaderSchema, 0, &slot);
+  fb_patch(fb, slot, fb_schema(fb, writer->columns));
+  write_message(writer, fb);
+  g_byte_array_free(fb, TRUE);
+
+  return !writer->failed;
+}
+
+
+void arrow_column_append_integer (ArrowColumn* column, guint64 value)
+{
+  if (column_width(column) == 4) {
+    guint32 le = GUINT32_TO_LE((guint32) value);
+    g_byte_array_append(column->values, (const guint8*) &le, 4);
+  }
+  else {
+    guint64 le = GUINT64_TO_LE(value);
+    g_byte_array_append(column->values, (const guint8*) &le, 8);
+  }
+  column_set_valid(column, TRUE);
+}
+
+
+void arrow_column_append_double (ArrowColumn* column, gdouble value)
+{
+  guint64 bits;
+  memcpy(&bits, &value, 8);
+  bits = GUINT64_TO_LE(bits);
+  g_byte_array_append(column->values, (const guint8*) &bits, 8);
+  column_set_valid(column, TRUE);
+}
+
+
+void arrow_column_append_bytes (ArrowColumn* column, const guint8* bytes,
+                                guint nbytes)
+{
+  guint32 end;
+
+  g_byte_array_append(column->values, bytes, nbytes);
+  end = GUINT32_TO_LE(column->values->len);
+  g_byte_array_append(column->offsets, (const guint8*) &end, 4);
+  column_set_valid(column, TRUE);
+}
+
+
+void arrow_column_append_null (ArrowColumn* column)
+{
+  if (column->offsets) {
+    guint32 end = GUINT32_TO_LE(column->values->len);
+    g_byte_array_append(column->offsets, (const guint8*) &end, 4);
+  }
+  else {
+    static const guint8 zeros[8];
+    g_byte_array_append(column->values, zeros, column_width(column));
+  }
+  column_set_valid(column, FALSE);
+}
+
+
+guint32 arrow_writer_end_row (ArrowWriter* writer)
+{
+  return ++writer->nrows;
+}
+
+
+gboolean arrow_writer_flush (ArrowWriter* writer)
+{
+  ArrowBlock block;
+  GByteArray* fb;
+  FbTable batch;
+  guint slot;
+  guint nodes;
+  guint buffers;
+  guint nbuffers = 0;
+  guint64 body_length = 0;
+  guint64 offset = 0;
+  guint c;
+  guint i;
+
+  if (!writer->nrows || writer->failed) {
+    return !writer->failed;
+  }
+
+  for (c = 0; c < writer->columns->len; ++c) {
+    const ArrowColumn* column = (const ArrowColumn*) g_ptr_array_index(writer->columns, c);
+    nbuffers += column_nbuffers(column);
+    for (i = 0; i < column_nbuffers(column); ++i) {
+      body_length += PAD8(column_buffer_length(column, i));
+    }
+  }
+
+  fb = g_byte_array_new();
+  fb_message(fb, MessageHeaderRecordBatch, body_length, &slot);
+
+  fb_table_start(&batch, 3);
+  fb_table_scalar(&batch, 0, 8, writer->nrows);
+  fb_table_scalar(&batch, 1, 4, 0);
+  fb_table_scalar(&batch, 2, 4, 0);
+  fb_patch(fb, slot, fb_table_end(fb, &batch));
+
+  nodes = fb_vector(fb, writer->columns->len, 16);
+  fb_patch(fb, batch.slot[1], nodes);
+  for (c = 0; c < writer->columns->len; ++c) {
+    const ArrowColumn* column = (const ArrowColumn*) g_ptr_array_index(writer->columns, c);
+    fb_set(fb, nodes + 4 + 16 * c, 8, column->nrows);
+    fb_set(fb, nodes + 12 + 16 * c, 8, column->null_count);
+  }
+
+  buffers = fb_vector(fb, nbuffers, 16);
+  fb_patch(fb, batch.slot[2], buffers);
+  nbuffers = 0;
+  for (c = 0; c < writer->columns->len; ++c) {
+    const ArrowColumn* column = (const ArrowColumn*) g_ptr_array_index(writer->columns, c);
+    for (i = 0; i < column_nbuffers(column); ++i, ++nbuffers) {
+      guint64 length = column_buffer_length(column, i);
+      fb_set(fb, buffers + 4 + 16 * nbuffers, 8, offset);
+      fb_set(fb, buffers + 12 + 16 * nbuffers, 8, length);
+      offset += PAD8(length);
+    }
+  }
+
+  block.offset = writer->position;
+  block.meta_length = write_message(writer, fb);
+  block.body_length = body_length;
+  g_byte_array_free(fb, TRUE);
+
+  for (c = 0; c < writer->columns->len; ++c) {
+    ArrowColumn* column = (ArrowColumn*) g_ptr_array_index(writer->columns, c);
+    for (i = 0; i < column_nbuffers(column); ++i) {
+      guint64 length = column_buffer_length(column, i);
+      write_bytes(writer, column_buffer(column, i), length);
+      write_padding(writer, PAD8(length) - length);
+    }
+    column_reset(column);
+  }
+
+  g_array_append_val(writer->blocks, block);
+  writer->total_rows += writer->nrows;
+  writer->nrows = 0;
+  return !writer->failed;
+}
+
+
+gboolean arrow_writer_close (ArrowWriter* writer)
+{
+  static const guint8 magic[6] = { 'A', 'R', 'R', 'O', 'W', '1' };
+  gboolean ok = TRUE;
+  guint c;
+
+  if (writer->file) {
+    GByteArray* fb = g_byte_array_new();
+    FbTable footer;
+    guint32 footer_length;
+    guint32 eos[2];
+    guint blocks;
+    guint i;
+
+    arrow_writer_flush(writer);
+
+    /* end of stream marker */
+    eos[0] = ARROW_CONTINUATION;
+    eos[1] = 0;
+    write_bytes(writer, eos, sizeof(eos));
+
+    fb_put(fb, 4, 0);
+    fb_table_start(&footer, 4);
+    fb_table_scalar(&footer, 0, 2, MetadataVersionV5);
+    fb_table_scalar(&footer, 1, 4, 0);
+    fb_table_scalar(&footer, 2, 4, 0);
+    fb_table_scalar(&footer, 3, 4, 0);
+    fb_patch(fb, 0, fb_table_end(fb, &footer));
+    fb_patch(fb, footer.slot[1], fb_schema(fb, writer->columns));
+    fb_patch(fb, footer.slot[2], fb_vector(fb, 0, 24));
+
+    blocks = fb_vector(fb, writer->blocks->len, 24);
+    fb_patch(fb, footer.slot[3], blocks);
+    for (i = 0; i < writer->blocks->len; ++i) {
+      const ArrowBlock* block = &g_array_index(writer->blocks, ArrowBlock, i);
+      fb_set(fb, blocks + 4 + 24 * i, 8, block->offset);
+      fb_set(fb, blocks + 12 + 24 * i, 4, block->meta_length);
+      fb_set(fb, blocks + 20 + 24 * i, 8, block->body_length);
+    }
+
+    write_bytes(writer, fb->data, fb->len);
+    footer_length = GUINT32_TO_LE(fb->len);
+    write_bytes(writer, &footer_length, 4);
+    write_bytes(writer, magic, sizeof(magic));
+    g_byte_array_free(fb, TRUE);
+
+    if (fclose(writer->file) != 0) {
+      writer->failed = TRUE;
+    }
+    if (writer->failed) {
+      fprintf(stderr, "%s: write failed, the file is incomplete\n", writer->filename);
+    }
+  }
+  ok = !writer->failed;
+
+  for (c = 0; c < writer->columns->len; ++c) {
+    ArrowColumn* column = (ArrowColumn*) g_ptr_array_index(writer->columns, c);
+    g_free(column->name);
+    g_byte_array_free(column->validity, TRUE);
+    g_byte_array_free(column->values, TRUE);
+    if (column->offsets) {
+      g_byte_array_free(column->offsets, TRUE);
+    }
+    g_free(column);
+  }
+  g_ptr_array_free(writer->columns, TRUE);
+  g_array_free(writer->blocks, TRUE);
+  g_free(writer->filename);
+  g_free(writer);
+  return ok;
+}
+
+
+void fb_align (GByteArray* fb, guint align)
+{
+  static const guint8 zeros[8];
+  g_byte_array_append(fb, zeros, (align - fb->len % align) % align);
+}
+
+
+guint fb_put (GByteArray* fb, guint size, guint64 value)
+{
+  guint pos = fb->len;
+  g_byte_array_set_size(fb, pos + size);
+  fb_set(fb, pos, size, value);
+  return pos;
+}
+
+
+void fb_set (GByteArray* fb, guint pos, guint size, guint64 value)
+{
+  guint i;
+  for (i = 0; i < size; ++i) {
+    fb->data[pos + i] = (guint8) (value >> (8 * i));
+  }
+}
+
+
+void fb_patch (GByteArray* fb, guint slot, guint target)
+{
+  fb_set(fb, slot, 4, target - slot);
+}
+
+
+void fb_table_start (FbTable* table, guint nfields)
+{
+  memset(table, 0, sizeof(FbTable));
+  table->nfields = nfields;
+}
+
+
+void fb_table_scalar (FbTable* table, guint id, guint size, guint64 value)
+{
+  table->size[id] = (guint8) size;
+  table->value[id] = value;
+}
+
+
+guint fb_table_end (GByteArray* fb, FbTable* table)
+{
+  guint16 field_offset[FB_MAX_FIELDS];
+  guint table_size = 4;  /* the vtable offset */
+  guint vtable;
+  guint pos;
+  guint align;
+  guint i;
+
+  /* biggest fields first, the table starts 8-byte aligned */
+  for (align = 8; align; align /= 2) {
+    for (i = 0; i < table->nfields; ++i) {
+      if (table->size[i] == align) {
+        table_size = (table_size + align - 1) & ~(align - 1);
+        field_offset[i] = (guint16) table_size;
+        table_size += align;
+      }
+    }
+  }
+
+  fb_align(fb, 2);
+  vtable = fb_put(fb, 2, 4 + 2 * table->nfields);
+  fb_put(fb, 2, table_size);
+  for (i = 0; i < table->nfields; ++i) {
+    fb_put(fb, 2, table->size[i] ? field_offset[i] : 0);
+  }
+
+  fb_align(fb, 8);
+  pos = fb_put(fb, 4, fb->len - vtable);
+  g_byte_array_set_size(fb, pos + table_size);
+  memset(fb->data + pos + 4, 0, table_size - 4);
+  for (i = 0; i < table->nfields; ++i) {
+    if (table->size[i]) {
+      table->slot[i] = pos + field_offset[i];
+      fb_set(fb, table->slot[i], table->size[i], table->value[i]);
+    }
+  }
+  return pos;
+}
+
+
+guint fb_vector (GByteArray* fb, guint count, guint elem_size)
+{
+  guint pos;
+
+  /* elements of 8 byte structs are aligned to 8 */
+  fb_align(fb, 4);
+  if (elem_size % 8 == 0 && (fb->len + 4) % 8) {
+    fb_put(fb, 4, 0);
+  }
+  pos = fb_put(fb, 4, count);
+  g_byte_array_set_size(fb, pos + 4 + count * elem_size);
+  memset(fb->data + pos + 4, 0, count * elem_size);
+  return pos;
+}
+
+
+guint fb_string (GByteArray* fb, const char* str)
+{
+  guint nbytes = (guint) strlen(str);
+  guint pos;
+
+  fb_align(fb, 4);
+  pos = fb_put(fb, 4, nbytes);
+  g_byte_array_append(fb, (const guint8*) str, nbytes + 1);
+  return pos;
+}
+
+
+guint fb_message (GByteArray* fb, guint8 header_type,
+                  guint64 body_length, guint* header_slot)
+{
+  FbTable message;
+  guint pos;
+
+  fb_put(fb, 4, 0);
+  fb_table_start(&message, 4);
+  fb_table_scalar(&message, 0, 2, MetadataVersionV5);
+  fb_table_scalar(&message, 1, 1, header_type);
+  fb_table_scalar(&message, 2, 4, 0);
+  fb_table_scalar(&message, 3, 8, body_length);
+  pos = fb_table_end(fb, &message);
+  fb_patch(fb, 0, pos);
+  *header_slot = message.slot[2];
+  return pos;
+}
+
+
+guint fb_schema (GByteArray* fb, GPtrArray* columns)
+{
+  FbTable schema;
+  guint pos;
+  guint fields;
+  guint c;
+
+  fb_table_start(&schema, 2);
+  fb_table_scalar(&schema, 1, 4, 0);
+  pos = fb_table_end(fb, &schema);
+
+  fields = fb_vector(fb, columns->len, 4);
+  fb_patch(fb, schema.slot[1], fields);
+  for (c = 0; c < columns->len; ++c) {
+    const ArrowColumn* column = (const ArrowColumn*) g_ptr_array_index(columns, c);
+    fb_patch(fb, fields + 4 + 4 * c, fb_field(fb, column));
+  }
+  return pos;
+}
+
+
+guint fb_field (GByteArray* fb, const ArrowColumn* column)
+{
+  FbTable field;
+  FbTable type;
+  guint8 type_type;
+  guint pos;
+
+  fb_table_start(&type, 2);
+  switch (column->type) {
+    case ArrowUInt32:
+    case ArrowUInt64:
+    case ArrowInt32:
+    case ArrowInt64:
+      type_type = TypeInt;
+      fb_table_scalar(&type, 0, 4, 8 * column_width(column));
+      fb_table_scalar(&type, 1, 1, column->type == ArrowInt32 ||
+                                   column->type == ArrowInt64);
+      break;
+    case ArrowFloat64:
+      type_type = TypeFloatingPoint;
+      fb_table_scalar(&type, 0, 2, PrecisionDouble);
+      break;
+    case ArrowTimestamp:
+      type_type = TypeTimestamp;
+      fb_table_scalar(&type, 0, 2, TimeUnitNanosecond);
+      break;
+    case ArrowUtf8:
+      type_type = TypeUtf8;
+      type.nfields = 0;
+      break;
+    default:
+      type_type = TypeBinary;
+      type.nfields = 0;
+      break;
+  }
+
+  fb_table_start(&field, 6);
+  fb_table_scalar(&field, 0, 4, 0);
+  fb_table_scalar(&field, 1, 1, TRUE);
+  fb_table_scalar(&field, 2, 1, type_type);
+  fb_table_scalar(&field, 3, 4, 0);
+  fb_table_scalar(&field, 5, 4, 0);
+  pos = fb_table_end(fb, &field);
+
+  fb_patch(fb, field.slot[0], fb_string(fb, column->name));
+  fb_patch(fb, field.slot[3], fb_table_end(fb, &type));
+  fb_patch(fb, field.slot[5], fb_vector(fb, 0, 4));
+  return pos;
+}
+
+
+guint column_width (const ArrowColumn* column)
+{
+  return (column->type == ArrowUInt32 || column->type == ArrowInt32) ? 4 : 8;
+}
+
+
+void column_set_valid (ArrowColumn* column, gboolean valid)
+{
+  if (column->nrows % 8 == 0) {
+    guint8 zero = 0;
+    g_byte_array_append(column->validity, &zero, 1);
+  }
+  if (valid) {
+    column->validity->data[column->nrows / 8] |= (guint8) (1 << (column->nrows % 8));
+  }
+  else {
+    column->null_count++;
+  }
+  column->nrows++;
+}
+
+
+void column_reset (ArrowColumn* column)
+{
+  column->nrows = 0;
+  column->null_count = 0;
+  g_byte_array_set_size(column->validity, 0);
+  g_byte_array_set_size(column->values, 0);
+  if (column->offsets) {
+    guint32 zero = 0;
+    g_byte_array_set_size(column->offsets, 0);
+    g_byte_array_append(column->offsets, (const guint8*) &zero, 4);
+  }
+}
+
+
+guint column_nbuffers (const ArrowColumn* column)
+{
+  return column->offsets ? 3 : 2;
+}
+
+
+guint64 column_buffer_length (const ArrowColumn* column, guint i)
+{
+  switch (i) {
+    case 0:
+      /* a column without nulls needs no bitmap */
+      return column->null_count ? column->validity->len : 0;
+    case 1:
+      return column->offsets ? column->offsets->len : column->values->len;
+    default:
+      return column->values->len;
+  }
+}
+
+
+const guint8* column_buffer (const ArrowColumn* column, guint i)
+{
+  switch (i) {
+    case 0:
+      return column->validity->data;
+    case 1:
+      return column->offsets ? column->offsets->data : column->values->data;
+    default:
+      return column->values->data;
+  }
+}
+
+
+void write_bytes (ArrowWriter* writer, const void* bytes, guint64 nbytes)
+{
+  if (writer->failed || !nbytes) {
+    return;
+  }
+  if (fwrite(bytes, 1, nbytes, writer->file) != nbytes) {
+    writer->failed = TRUE;
+    return;
+  }
+  writer->position += nbytes;
+}
+
+
+void write_padding (ArrowWriter* writer, guint64 nbytes)
+{
+  static const guint8 zeros[8];
+  write_bytes(writer, zeros, nbytes);
+}
+
+
+guint32 write_message (ArrowWriter* writer, const GByteArray* fb)
+{
+  guint32 prefix[2];
+  guint32 padded = (guint32) PAD8(fb->len);
+
+  prefix[0] = ARROW_CONTINUATION;
+  prefix[1] = GUINT32_TO_LE(padded);
+  write_bytes(writer, prefix, sizeof(prefix));
+  write_bytes(writer, fb->data, fb->len);
+  write_padding(writer, padded - fb->len);
+  return padded + sizeof(prefix);
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file arrow-writer.h
+ * \brief  Writer of Arrow IPC files (the Feather v2 format).
+ *  Rows are appended column by column and written as record batches,
+ *  only the batch being built is kept in memory. The buffers of a
+ *  column keep their size from batch to batch. The flatbuffers
+ *  metadata of the format is encoded by hand so the tool needs no
+ *  Arrow library. Only flat schemas of primitive, string and binary
+ *  columns are supported, every column is nullable.
+ */
+
+#ifndef ARROW_WRITER_H_
+#define ARROW_WRITER_H_
+
+#include <stdio.h>
+#include <glib.h>
+
+/*! \brief  Types a column can have.
+ */
+enum arrow_type_enum
+{
+  ArrowUInt32,
+  ArrowUInt64,
+  ArrowInt32,
+  ArrowInt64,
+  ArrowFloat64,
+  ArrowTimestamp,  /*!< Nanoseconds since the epoch, no time zone. */
+  ArrowUtf8,
+  ArrowBinary
+};
+typedef enum arrow_type_enum ArrowType;
+
+/*! \brief  A column and the values of the batch being built.
+ */
+struct arrow_column_struct
+{
+  gchar* name;
+  ArrowType type;
+  guint32 nrows;
+  guint32 null_count;
+  GByteArray* validity;  /*!< One bit per row, set if not null. */
+  GByteArray* values;    /*!< Fixed width values, or the variable bytes. */
+  GByteArray* offsets;   /*!< Utf8 and Binary, nrows + 1 int32 offsets. */
+};
+typedef struct arrow_column_struct ArrowColumn;
+
+/*! \brief  An Arrow file being written.
+ */
+struct arrow_writer_struct
+{
+  FILE* file;
+  gchar* filename;
+  guint64 position;     /*!< Bytes written so far. */
+  GPtrArray* columns;   /*!< ArrowColumn */
+  GArray* blocks;       /*!< Record batches written, for the footer. */
+  guint32 nrows;        /*!< Rows of the batch being built. */
+  guint64 total_rows;
+  gboolean failed;      /*!< A write failed, the file is unusable. */
+};
+typedef struct arrow_writer_struct ArrowWriter;
+
+/*! \brief  Start the description of a file.
+ * \return  A writer without columns.
+ */
+ArrowWriter* arrow_writer_new (void);
+
+/*! \brief  Add a column, only before the file is opened.
+ * \param writer  The writer.
+ * \param name  Column name, copied.
+ * \param type  Column type.
+ * \return  The column, valid as long as the writer.
+ */
+ArrowColumn* arrow_writer_add_column (ArrowWriter* writer, const char* name,
+                                      ArrowType type);
+
+/*! \brief  Create the file and write its schema.
+ * \param writer  The writer, with all its columns.
+ * \param filename  Path of the file.
+ * \return  FALSE if the file cannot be created.
+ */
+gboolean arrow_writer_open (ArrowWriter* writer, const char* filename);
+
+/*! \brief  Append an integer or a timestamp to a column.
+ *          Signed values are passed as their two's complement.
+ */
+void arrow_column_append_integer (ArrowColumn* column, guint64 value);
+
+/*! \brief  Append a floating point number to a column.
+ */
+void arrow_column_append_double (ArrowColumn* column, gdouble value);
+
+/*! \brief  Append a string or byte vector to a column.
+ */
+void arrow_column_append_bytes (ArrowColumn* column, const guint8* bytes,
+                                guint nbytes);
+
+/*! \brief  Append a null to a column.
+ */
+void arrow_column_append_null (ArrowColumn* column);
+
+/*! \brief  Count a row once a value was appended to every column.
+ * \param writer  The writer.
+ * \return  Rows in the batch being built.
+ */
+guint32 arrow_writer_end_row (ArrowWriter* writer);
+
+/*! \brief  Write the rows appended so far as a record batch.
+ * \param writer  The writer.
+ * \return  FALSE if the write failed.
+ */
+gboolean arrow_writer_flush (ArrowWriter* writer);
+
+/*! \brief  Flush the last batch, write the footer and free the writer.
+ * \param writer  The writer.
+ * \return  FALSE if the file is incomplete.
+ */
+gboolean arrow_writer_close (ArrowWriter* writer);
+
+#endif
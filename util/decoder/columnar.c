@@ -0,0 +1,357 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <string.h>
+
+#include "template.h"
+#include "basic-dissect.h"
+#include "arrow-writer.h"
+#include "columnar.h"
+
+/*! \brief  Table of a template or of a sequence.
+ */
+struct export_table_struct
+{
+  ArrowWriter* writer;
+  GPtrArray* children;  /* tables of the sequences, in template order */
+  gboolean sequence;    /* keyed by message_id and index */
+  gboolean nested;      /* sequence in a sequence, has a parent column */
+};
+typedef struct export_table_struct ExportTable;
+
+/*! \brief  Create the table of a template or a sequence and its file.
+ * \param name  Table name, also the file name.
+ * \param tnode  First field of the template or of the sequence group.
+ * \param parent  Table of the enclosing template or sequence, NULL
+ *                for a template.
+ */
+static ExportTable* table_new (ColumnarExport* columnar, const char* name,
+                               const GNode* tnode, const ExportTable* parent);
+
+/*! \brief  Add the columns of sibling fields, recursing into groups.
+ * \param prefix  Prepended to the field names, "" at the top.
+ */
+static void add_columns (ColumnarExport* columnar, ExportTable* table,
+                         const char* table_name, const char* prefix,
+                         const GNode* tnode);
+
+/*! \brief  Append the values of sibling fields to a row.
+ * \param tnode  First field of the template.
+ * \param dnode  First field of the data, NULL if the enclosing group
+ *               is absent.
+ * \param column  Next column of the row, updated.
+ * \param child  Next child table, updated.
+ * \param element  Index of the enclosing sequence element.
+ */
+static void append_fields (ColumnarExport* columnar, ExportTable* table,
+                           const GNode* tnode, const GNode* dnode,
+                           guint* column, guint* child,
+                           const DecodedMessage* msg, guint32 element);
+
+/*! \brief  Append a field value, or a null if the field is absent.
+ */
+static void append_value (ArrowColumn* column, const FieldType* ftype,
+                          const FieldData* fdata);
+
+/*! \brief  Count a row, write the batch once it is full.
+ */
+static void end_row (ColumnarExport* columnar, ExportTable* table);
+
+/*! \brief  Replace the characters that do not belong in a file name.
+ */
+static void sanitize_name (gchar* name);
+
+#define table_column(table, i) \
+  ((ArrowColumn*) g_ptr_array_index((table)->writer->columns, (i)))
+
+
+ColumnarExport* columnar_export_new (const char* directory, guint rows_per_group)
+{
+  ColumnarExport* columnar = g_new0(ColumnarExport, 1);
+
+  columnar->directory = g_strdup(directory);
+  columnar->rows_per_group = rows_per_group ? rows_per_group : COLUMNAR_ROWS_PER_GROUP;
+  columnar->tables = g_hash_table_new(g_direct_hash, g_direct_equal);
+  columnar->all = g_ptr_array_new();
+  return columnar;
+}
+
+
+void columnar_export_message (ColumnarExport* columnar, const DecodedMessage* msg)
+{
+  ExportTable* table = (ExportTable*) g_hash_table_lookup(columnar->tables, msg->tmpl);
+  guint column = 0;
+  guint child = 0;
+
+  if (!table) {
+    const FieldType* ftype = (const FieldType*) msg->tmpl->data;
+    gchar* name = g_strdup_printf("%d-%s", ftype->id,
+                                  ftype->name ? ftype->name : "unnamed");
+    sanitize_name(name);
+    table = table_new(columnar, name, msg->tmpl->children, NULL);
+    g_hash_table_insert(columnar->tables, (gpointer) msg->tmpl, table);
+    g_free(name);
+  }
+
+  arrow_column_append_integer(table_column(table, column++), msg->id);
+  arrow_column_append_integer(table_column(table, column++), msg->frame);
+  arrow_column_append_integer(table_column(table, column++), (guint64) msg->ts);
+  append_fields(columnar, table, msg->tmpl->children, msg->data->children,
+                &column, &child, msg, 0);
+  end_row(columnar, table);
+}
+
+
+gboolean columnar_export_finish (ColumnarExport* columnar)
+{
+  gboolean ok = !columnar->failed;
+  guint i;
+
+  for (i = 0; i < columnar->all->len; ++i) {
+    ExportTable* table = (ExportTable*) g_ptr_array_index(columnar->all, i);
+    ok = arrow_writer_close(table->writer) && ok;
+    g_ptr_array_free(table->children, TRUE);
+    g_free(table);
+  }
+  g_ptr_array_free(columnar->all, TRUE);
+  g_hash_table_destroy(columnar->tables);
+  g_free(columnar->directory);
+  g_free(columnar);
+  return ok;
+}
+
+
+ExportTable* table_new (ColumnarExport* columnar, const char* name,
+                        const GNode* tnode, const ExportTable* parent)
+{
+  ExportTable* table = g_new0(ExportTable, 1);
+  gchar* filename;
+
+  table->writer = arrow_writer_new();
+  table->children = g_ptr_array_new();
+  table->sequence = (parent != NULL);
+  table->nested = parent && parent->sequence;
+  g_ptr_array_add(columnar->all, table);
+
+  arrow_writer_add_column(table->writer, "message_id", ArrowUInt64);
+  if (!table->sequence) {
+    arrow_writer_add_column(table->writer, "frame", ArrowUInt32);
+    arrow_writer_add_column(table->writer, "ts", ArrowTimestamp);
+  }
+  else {
+    if (table->nested) {
+      arrow_writer_add_column(table->writer, "parent", ArrowUInt32);
+    }
+    arrow_writer_add_column(table->writer, "index", ArrowUInt32);
+  }
+  add_columns(columnar, table, name, "", tnode);
+
+  filename = g_strdup_printf("%s/%s.arrow", columnar->directory, name);
+  if (!arrow_writer_open(table->writer, filename)) {
+    columnar->failed = TRUE;
+  }
+  g_free(filename);
+  return table;
+}
+
+
+void add_columns (ColumnarExport* columnar, ExportTable* table,
+                  const char* table_name, const char* prefix,
+                  const GNode* tnode)
+{
+  for (; tnode; tnode = tnode->next) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    gchar* name = g_strconcat(prefix, ftype->name ? ftype->name : "unnamed", NULL);
+
+    switch (ftype->type) {
+      case FieldTypeUInt32:
+        arrow_writer_add_column(table->writer, name, ArrowUInt32);
+        break;
+      case FieldTypeUInt64:
+        arrow_writer_add_column(table->writer, name, ArrowUInt64);
+        break;
+      case FieldTypeInt32:
+        arrow_writer_add_column(table->writer, name, ArrowInt32);
+        break;
+      case FieldTypeInt64:
+        arrow_writer_add_column(table->writer, name, ArrowInt64);
+        break;
+      case FieldTypeDecimal:
+        arrow_writer_add_column(table->writer, name, ArrowFloat64);
+        break;
+      case FieldTypeAsciiString:
+      case FieldTypeUnicodeString:
+        arrow_writer_add_column(table->writer, name, ArrowUtf8);
+        break;
+      case FieldTypeByteVector:
+        arrow_writer_add_column(table->writer, name, ArrowBinary);
+        break;
+      case FieldTypeGroup:
+      {
+        gchar* group_prefix = g_strconcat(name, ".", NULL);
+        add_columns(columnar, table, table_name, group_prefix, tnode->children);
+        g_free(group_prefix);
+        break;
+      }
+      case FieldTypeSequence:
+      {
+        gchar* length = g_strconcat(name, ".length", NULL);
+        gchar* child_name = g_strconcat(table_name, ".", name, NULL);
+        const GNode* elements = NULL;
+
+        if (tnode->children && tnode->children->next) {
+          elements = tnode->children->next->children;
+        }
+        sanitize_name(child_name);
+        arrow_writer_add_column(table->writer, length, ArrowUInt32);
+        g_ptr_array_add(table->children,
+                        table_new(columnar, child_name, elements, table));
+        g_free(child_name);
+        g_free(length);
+        break;
+      }
+      default:
+        break;
+    }
+    g_free(name);
+  }
+}
+
+
+void append_fields (ColumnarExport* columnar, ExportTable* table,
+                    const GNode* tnode, const GNode* dnode,
+                    guint* column, guint* child,
+                    const DecodedMessage* msg, guint32 element)
+{
+  for (; tnode; tnode = tnode->next, dnode = dnode ? dnode->next : NULL) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* fdata = dnode ? (const FieldData*) dnode->data : NULL;
+    gboolean present = fdata && fdata->status == FieldExists;
+
+    switch (ftype->type) {
+      case FieldTypeGroup:
+        append_fields(columnar, table, tnode->children,
+                      present ? dnode->children : NULL,
+                      column, child, msg, element);
+        break;
+      case FieldTypeSequence:
+      {
+        ArrowColumn* length = table_column(table, (*column)++);
+        ExportTable* elements = (ExportTable*) g_ptr_array_index(table->children, (*child)++);
+        const GNode* group_tnode = tnode->children ? tnode->children->next : NULL;
+        const GNode* enode;
+        guint32 index = 0;
+
+        if (!present || !group_tnode) {
+          arrow_column_append_null(length);
+          break;
+        }
+        arrow_column_append_integer(length, g_node_n_children((GNode*) dnode));
+
+        for (enode = dnode->children; enode; enode = enode->next, ++index) {
+          const FieldData* edata = (const FieldData*) enode->data;
+          guint element_column = 0;
+          guint element_child = 0;
+
+          arrow_column_append_integer(table_column(elements, element_column++), msg->id);
+          if (elements->nested) {
+            arrow_column_append_integer(table_column(elements, element_column++), element);
+          }
+          arrow_column_append_integer(table_column(elements, element_column++), index);
+          append_fields(columnar, elements, group_tnode->children,
+                        edata && edata->status == FieldExists ? enode->children : NULL,
+                        &element_column, &element_child, msg, index);
+          end_row(columnar, elements);
+        }
+        break;
+      }
+      case FieldTypeEnumLimit:
+      case FieldTypeError:
+      case FieldTypeInvalid:
+        break;
+      default:
+        append_value(table_column(table, (*column)++), ftype, present ? fdata : NULL);
+        break;
+    }
+  }
+}
+
+
+void append_value (ArrowColumn* column, const FieldType* ftype,
+                   const FieldData* fdata)
+{
+  if (!fdata) {
+    arrow_column_append_null(column);
+    return;
+  }
+
+  switch (ftype->type) {
+    case FieldTypeUInt32:
+      arrow_column_append_integer(column, fdata->value.u32);
+      break;
+    case FieldTypeUInt64:
+      arrow_column_append_integer(column, fdata->value.u64);
+      break;
+    case FieldTypeInt32:
+      arrow_column_append_integer(column, (guint64) (gint64) fdata->value.i32);
+      break;
+    case FieldTypeInt64:
+      arrow_column_append_integer(column, (guint64) fdata->value.i64);
+      break;
+    case FieldTypeDecimal:
+      arrow_column_append_double(column, decimal_to_double(&fdata->value.decimal));
+      break;
+    case FieldTypeAsciiString:
+    {
+      /* the decoded length can count a terminator */
+      guint nbytes = 0;
+      while (nbytes < fdata->value.ascii.nbytes && fdata->value.ascii.bytes[nbytes]) {
+        ++nbytes;
+      }
+      arrow_column_append_bytes(column, fdata->value.ascii.bytes, nbytes);
+      break;
+    }
+    case FieldTypeUnicodeString:
+      arrow_column_append_bytes(column, fdata->value.unicode.bytes,
+                                fdata->value.unicode.nbytes);
+      break;
+    default:
+      arrow_column_append_bytes(column, fdata->value.bytevec.bytes,
+                                fdata->value.bytevec.nbytes);
+      break;
+  }
+}
+
+
+void end_row (ColumnarExport* columnar, ExportTable* table)
+{
+  columnar->rows++;
+  if (arrow_writer_end_row(table->writer) >= columnar->rows_per_group &&
+      !arrow_writer_flush(table->writer)) {
+    columnar->failed = TRUE;
+  }
+}
+
+
+void sanitize_name (gchar* name)
+{
+  for (; *name; ++name) {
+    if (!g_ascii_isalnum(*name) && *name != '.' && *name != '-' && *name != '_') {
+      *name = '_';
+    }
+  }
+}
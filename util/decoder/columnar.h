@@ -0,0 +1,76 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file columnar.h
+ * \brief  Export of decoded messages as one Arrow table per template.
+ *  A template gets a table named after its id and name, with a
+ *  message_id, frame and ts column followed by one column per field.
+ *  Fields of groups are flattened into the table as group.field.
+ *  Every sequence gets a child table (template.sequence) keyed by
+ *  message_id and the index of the element; the parent table only
+ *  keeps the length. A sequence nested in a sequence also has the
+ *  index of the enclosing element in a parent column.
+ *
+ *  Columns are typed by the FieldType: integers keep their width and
+ *  sign, decimals become doubles, ascii and unicode strings become
+ *  utf8 and byte vectors binary. Absent optional fields are nulls.
+ */
+
+#ifndef COLUMNAR_H_
+#define COLUMNAR_H_
+
+#include <glib.h>
+
+#include "decoder.h"
+
+/*! \brief  Default number of rows of a record batch. */
+#define COLUMNAR_ROWS_PER_GROUP 65536
+
+/*! \brief  Tables of an export.
+ */
+struct columnar_export_struct
+{
+  gchar* directory;
+  guint rows_per_group;
+  GHashTable* tables;  /*!< template GNode -> table of the template */
+  GPtrArray* all;      /*!< every table, child tables included */
+  guint64 rows;
+  gboolean failed;
+};
+typedef struct columnar_export_struct ColumnarExport;
+
+/*! \brief  Start an export.
+ * \param directory  Existing directory the tables are written to.
+ * \param rows_per_group  Rows buffered per table before they are
+ *                        written as a batch, bounds the memory used.
+ * \return  The export.
+ */
+ColumnarExport* columnar_export_new (const char* directory, guint rows_per_group);
+
+/*! \brief  Add a message to the table of its template.
+ *          The table is created by the first message of a template.
+ */
+void columnar_export_message (ColumnarExport* columnar, const DecodedMessage* msg);
+
+/*! \brief  Write the buffered rows, close the tables and free the export.
+ * \return  FALSE if a table could not be written completely.
+ */
+gboolean columnar_export_finish (ColumnarExport* columnar);
+
+#endif
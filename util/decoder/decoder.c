@@ -0,0 +1,293 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wmem_aux.h"
+#include "template.h"
+#include "parse-template.h"
+#include "dictionaries.h"
+#include "dissect.h"
+#include "error_log.h"
+#include "feed-header.h"
+
+#include "decoder.h"
+#include "pcap-file.h"
+#include "columnar.h"
+#include "text-output.h"
+
+/*! \brief  What the decoder went through.
+ */
+struct decoder_counters_struct
+{
+  guint64 packets;
+  guint64 skipped;   /* no room for the feed header, or a UMDF chunk */
+  guint64 messages;
+  guint64 unknown;   /* packets left at an unknown template id */
+  guint64 bytes;
+};
+typedef struct decoder_counters_struct DecoderCounters;
+
+/*! \brief  Outputs the decoded messages go to.
+ */
+struct decoder_outputs_struct
+{
+  ColumnarExport* columnar;
+  TextOutput* json;
+  TextOutput* csv;
+};
+typedef struct decoder_outputs_struct DecoderOutputs;
+
+/*! \brief  Print the usage, or a bad argument.
+ * \return  The exit status.
+ */
+static int ArgParseBailOut (const char* arg, const char* reason);
+
+/*! \brief  Decode the FAST messages of a datagram.
+ */
+static void decode_datagram (wmem_map_t* templates, guint8 flavor,
+                             const PcapDatagram* dgram,
+                             DecoderCounters* counters,
+                             DecoderOutputs* outputs);
+
+
+int main (const int argc, const char* const* argv)
+{
+  const char* template_filename = 0;
+  const char* pcap_filename = 0;
+  const char* arrow_directory = 0;
+  const char* json_filename = 0;
+  const char* csv_directory = 0;
+  guint8 flavor = GenericImplem;
+  guint port = 0;
+  guint rows = COLUMNAR_ROWS_PER_GROUP;
+  GNode* templates;
+  wmem_map_t* templates_table;
+  PcapFile* pcap;
+  PcapDatagram dgram;
+  DecoderCounters counters;
+  DecoderOutputs outputs;
+  gboolean goodp = TRUE;
+  gint64 start;
+  gdouble seconds;
+  int argi;
+
+  if (argc == 1) {
+    return ArgParseBailOut(0, 0);
+  }
+
+  /* Loop thru arguments to set internal data. */
+  for (argi = 1; argi < argc; ++argi) {
+    const char* arg = argv[argi];
+    if (argc == argi+1) {
+      return ArgParseBailOut(arg, "Trailing flag without a value.");
+    }
+    else if (!strcmp("tmpl", arg)) {
+      template_filename = argv[++argi];
+    }
+    else if (!strcmp("pcap", arg)) {
+      pcap_filename = argv[++argi];
+    }
+    else if (!strcmp("flavor", arg)) {
+      flavor = feed_flavor_by_name(argv[++argi]);
+      if (flavor == NImplem) {
+        return ArgParseBailOut(argv[argi], "Unknown flavor.");
+      }
+    }
+    else if (!strcmp("p", arg) || !strcmp("port", arg)) {
+      port = (guint) atoi(argv[++argi]);
+    }
+    else if (!strcmp("arrow", arg)) {
+      arrow_directory = argv[++argi];
+    }
+    else if (!strcmp("json", arg)) {
+      json_filename = argv[++argi];
+    }
+    else if (!strcmp("csv", arg)) {
+      csv_directory = argv[++argi];
+    }
+    else if (!strcmp("rows", arg)) {
+      rows = (guint) atoi(argv[++argi]);
+    }
+    else {
+      return ArgParseBailOut(arg, "Unknown argument.");
+    }
+  }
+  if (!template_filename || !pcap_filename) {
+    return ArgParseBailOut(0, "Both tmpl and pcap are required.");
+  }
+
+  wmem_init();
+  wmem_init_scopes();
+  wmem_enter_file_scope();
+  fast_set_log_settings(FALSE, FALSE, NULL);
+  /* every tree is consumed before the next packet, and so are its values */
+  dissect_set_tree_scope(wmem_packet_scope());
+  set_sized_data_scope(wmem_packet_scope());
+
+  templates = parse_templates_xml(template_filename);
+  if (!templates) {
+    fprintf(stderr, "%s: no templates could be read\n", template_filename);
+    return 1;
+  }
+  templates_table = create_templates_table(templates);
+
+  pcap = pcap_file_open(pcap_filename);
+  if (!pcap) {
+    return 1;
+  }
+
+  memset(&counters, 0, sizeof(DecoderCounters));
+  memset(&outputs, 0, sizeof(DecoderOutputs));
+  if (arrow_directory) {
+    outputs.columnar = columnar_export_new(arrow_directory, rows);
+  }
+  if (json_filename) {
+    outputs.json = text_output_json(json_filename);
+    if (!outputs.json) {
+      return 1;
+    }
+  }
+  if (csv_directory) {
+    outputs.csv = text_output_csv(csv_directory);
+  }
+
+  start = g_get_monotonic_time();
+  while (pcap_file_next(pcap, &dgram)) {
+    if (port && dgram.dst_port != port) {
+      continue;
+    }
+    wmem_enter_packet_scope();
+    decode_datagram(templates_table, flavor, &dgram, &counters, &outputs);
+    wmem_leave_packet_scope();
+  }
+  seconds = (g_get_monotonic_time() - start) / 1e6;
+
+  if (outputs.columnar) {
+    goodp = columnar_export_finish(outputs.columnar) && goodp;
+  }
+  if (outputs.json) {
+    goodp = text_output_finish(outputs.json) && goodp;
+  }
+  if (outputs.csv) {
+    goodp = text_output_finish(outputs.csv) && goodp;
+  }
+  pcap_file_close(pcap);
+
+  fprintf(stderr, "%" G_GUINT64_FORMAT " packets, %" G_GUINT64_FORMAT
+          " messages, %" G_GUINT64_FORMAT " bytes in %.3f s",
+          counters.packets, counters.messages, counters.bytes, seconds);
+  if (seconds > 0) {
+    fprintf(stderr, " (%.0f msg/s)", counters.messages / seconds);
+  }
+  fputc('\n', stderr);
+  if (counters.skipped || counters.unknown || dissect_stats()->errors) {
+    fprintf(stderr, "%" G_GUINT64_FORMAT " packets skipped, %" G_GUINT64_FORMAT
+            " with an unknown template, %" G_GUINT64_FORMAT " field errors\n",
+            counters.skipped, counters.unknown, dissect_stats()->errors);
+  }
+
+  wmem_leave_file_scope();
+  wmem_cleanup_scopes();
+  wmem_cleanup();
+  return goodp ? 0 : 1;
+}
+
+
+int ArgParseBailOut (const char* arg, const char* reason)
+{
+  if (arg) {
+    fprintf(stderr, "Error with argument: %s\n", arg);
+  }
+  if (reason) {
+    fprintf(stderr, "Reason: %s\n", reason);
+  }
+  fputs("Usage: fastdecode tmpl FILE pcap FILE [flavor generic|cme|umdf|moex]\n"
+        "                  [port N] [arrow DIR [rows N]] [json FILE] [csv DIR]\n"
+        "  tmpl    FAST templates of the feed.\n"
+        "  pcap    Capture to decode, UDP datagrams only.\n"
+        "  flavor  Packet header of the feed, generic has none.\n"
+        "  port    Only decode datagrams sent to this port.\n"
+        "  arrow   Write one Arrow table per template into DIR.\n"
+        "  rows    Rows per record batch of the tables.\n"
+        "  json    Write the messages as JSON lines into FILE, - for stdout.\n"
+        "  csv     Write one CSV file per template into DIR.\n", stderr);
+  return (arg || reason) ? 1 : 0;
+}
+
+
+void decode_datagram (wmem_map_t* templates, guint8 flavor,
+                      const PcapDatagram* dgram,
+                      DecoderCounters* counters,
+                      DecoderOutputs* outputs)
+{
+  FeedHeader header;
+  DissectPosition position;
+  address src;
+  address dest;
+
+  counters->packets++;
+  counters->bytes += dgram->nbytes;
+
+  /* messages split over UMDF chunks are not reassembled */
+  if (!parse_feed_header(flavor, dgram->payload, dgram->nbytes, &header) ||
+      header.chunks > 1) {
+    counters->skipped++;
+    return;
+  }
+
+  set_address(&src, AT_IPv4, 4, dgram->src);
+  set_address(&dest, AT_IPv4, 4, dgram->dst);
+
+  memset(&position, 0, sizeof(DissectPosition));
+  position.offjmp = header.nbytes;
+  position.nbytes = dgram->nbytes;
+  position.bytes = dgram->payload;
+  ShiftBytes(&position);
+
+  while (position.nbytes) {
+    DecodedMessage msg;
+    GNode* data = wmem_node_new(wmem_packet_scope(), 0);
+
+    msg.tmpl = dissect_fast_bytes(templates, &position, data, &src, &dest);
+    if (!msg.tmpl) {
+      counters->unknown++;
+      break;
+    }
+    msg.id = ++counters->messages;
+    msg.frame = dgram->frame;
+    msg.ts = dgram->ts;
+    msg.data = data;
+
+    if (outputs->columnar) {
+      columnar_export_message(outputs->columnar, &msg);
+    }
+    if (outputs->json) {
+      text_output_message(outputs->json, &msg);
+    }
+    if (outputs->csv) {
+      text_output_message(outputs->csv, &msg);
+    }
+  }
+
+  if (flavor != GenericImplem) {
+    /* the feeds reset the dictionaries between packets */
+    clear_dictionaries(src, dest);
+  }
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file decoder.h
+ * \brief  Headless decoder of FAST captures, built on the plugin's
+ *         dissect.c without Wireshark's protocol trees.
+ */
+
+#ifndef DECODER_H_
+#define DECODER_H_
+
+#include <glib.h>
+
+/*! \brief  A message decoded from the capture, handed to the outputs.
+ *          The trees are only valid until the next packet.
+ */
+struct decoded_message_struct
+{
+  guint64 id;           /*!< Number of the message in the capture, from 1. */
+  guint32 frame;        /*!< Record of the pcap file it was read from. */
+  gint64  ts;           /*!< Arrival time in nanoseconds. */
+  const GNode* tmpl;    /*!< Template, of FieldType. */
+  const GNode* data;    /*!< Message, of FieldData, parallel to tmpl. */
+};
+typedef struct decoded_message_struct DecodedMessage;
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <string.h>
+
+#include "pcap-file.h"
+
+/*! \brief  Read buffer of the file, records are read sequentially. */
+#define PCAP_READ_BUFFER (1 << 20)
+
+/*! \brief  Largest record accepted, bigger ones are a corrupt file. */
+#define PCAP_MAX_RECORD (256 * 1024)
+
+#define PCAP_MAGIC     0xa1b2c3d4
+#define PCAP_MAGIC_NS  0xa1b23c4d
+
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_IPV4       228
+
+#define ETHERTYPE_IPV4  0x0800
+#define ETHERTYPE_VLAN  0x8100
+#define ETHERTYPE_QINQ  0x88a8
+#define IPPROTO_UDP_    17
+
+/*! \brief  Read a 32 bit field of the file headers. */
+static guint32 read_u32 (const PcapFile* pcap, const guint8* bytes);
+
+/*! \brief  Find the UDP payload of a record.
+ * \return  FALSE if the record does not carry an unfragmented
+ *          UDP datagram over IPv4.
+ */
+static gboolean find_udp (const PcapFile* pcap, const guint8* bytes,
+                          guint nbytes, PcapDatagram* dgram);
+
+
+PcapFile* pcap_file_open (const char* filename)
+{
+  PcapFile* pcap;
+  guint8 header[24];
+  guint32 magic;
+  FILE* file = fopen(filename, "rb");
+
+  if (!file) {
+    perror(filename);
+    return NULL;
+  }
+
+  pcap = g_new0(PcapFile, 1);
+  pcap->file = file;
+  setvbuf(file, NULL, _IOFBF, PCAP_READ_BUFFER);
+
+  if (fread(header, sizeof(header), 1, file) != 1) {
+    fprintf(stderr, "%s: too short for a pcap file\n", filename);
+    pcap_file_close(pcap);
+    return NULL;
+  }
+
+  memcpy(&magic, header, 4);
+  if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NS) {
+    pcap->swapped = FALSE;
+  }
+  else if (GUINT32_SWAP_LE_BE(magic) == PCAP_MAGIC ||
+           GUINT32_SWAP_LE_BE(magic) == PCAP_MAGIC_NS) {
+    pcap->swapped = TRUE;
+    magic = GUINT32_SWAP_LE_BE(magic);
+  }
+  else {
+    fprintf(stderr, "%s: not a pcap file (pcapng is not supported)\n", filename);
+    pcap_file_close(pcap);
+    return NULL;
+  }
+
+  pcap->nanosecond = (magic == PCAP_MAGIC_NS);
+  pcap->linktype = read_u32(pcap, header + 20) & 0x0fffffff;
+  if (pcap->linktype != LINKTYPE_ETHERNET && pcap->linktype != LINKTYPE_RAW &&
+      pcap->linktype != LINKTYPE_LINUX_SLL && pcap->linktype != LINKTYPE_IPV4) {
+    fprintf(stderr, "%s: link type %u is not supported\n", filename, pcap->linktype);
+    pcap_file_close(pcap);
+    return NULL;
+  }
+  return pcap;
+}
+
+
+gboolean pcap_file_next (PcapFile* pcap, PcapDatagram* dgram)
+{
+  guint8 header[16];
+
+  while (fread(header, sizeof(header), 1, pcap->file) == 1) {
+    guint32 caplen = read_u32(pcap, header + 8);
+    guint32 frac = read_u32(pcap, header + 4);
+
+    if (caplen > PCAP_MAX_RECORD) {
+      fprintf(stderr, "record %u: length %u, the file is corrupt\n",
+              pcap->frame + 1, caplen);
+      return FALSE;
+    }
+    if (caplen > pcap->record_size) {
+      pcap->record_size = MAX(caplen, 2 * pcap->record_size);
+      pcap->record = (guint8*) g_realloc(pcap->record, pcap->record_size);
+    }
+    if (caplen && fread(pcap->record, caplen, 1, pcap->file) != 1) {
+      fprintf(stderr, "record %u: cut short by the end of the file\n",
+              pcap->frame + 1);
+      return FALSE;
+    }
+    pcap->frame++;
+
+    if (find_udp(pcap, pcap->record, caplen, dgram)) {
+      dgram->frame = pcap->frame;
+      dgram->ts = (gint64) read_u32(pcap, header) * 1000000000 +
+        (pcap->nanosecond ? frac : (gint64) frac * 1000);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+
+void pcap_file_close (PcapFile* pcap)
+{
+  if (!pcap) {
+    return;
+  }
+  if (pcap->file) {
+    fclose(pcap->file);
+  }
+  g_free(pcap->record);
+  g_free(pcap);
+}
+
+
+guint32 read_u32 (const PcapFile* pcap, const guint8* bytes)
+{
+  guint32 value;
+  memcpy(&value, bytes, 4);
+  return pcap->swapped ? GUINT32_SWAP_LE_BE(value) : value;
+}
+
+
+gboolean find_udp (const PcapFile* pcap, const guint8* bytes,
+                   guint nbytes, PcapDatagram* dgram)
+{
+  guint offset = 0;
+  guint ihl;
+  guint total;
+  guint udp_len;
+
+  switch (pcap->linktype) {
+    case LINKTYPE_ETHERNET:
+    {
+      guint16 ethertype;
+      offset = 12;
+      if (nbytes < offset + 2) {
+        return FALSE;
+      }
+      ethertype = (bytes[offset] << 8) | bytes[offset + 1];
+      while (ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ) {
+        offset += 4;
+        if (nbytes < offset + 2) {
+          return FALSE;
+        }
+        ethertype = (bytes[offset] << 8) | bytes[offset + 1];
+      }
+      if (ethertype != ETHERTYPE_IPV4) {
+        return FALSE;
+      }
+      offset += 2;
+      break;
+    }
+    case LINKTYPE_LINUX_SLL:
+      if (nbytes < 16 || ((bytes[14] << 8) | bytes[15]) != ETHERTYPE_IPV4) {
+        return FALSE;
+      }
+      offset = 16;
+      break;
+    default:
+      offset = 0;
+      break;
+  }
+
+  /* IPv4 header */
+  if (nbytes < offset + 20 || (bytes[offset] >> 4) != 4) {
+    return FALSE;
+  }
+  ihl = (bytes[offset] & 0x0f) * 4;
+  total = (bytes[offset + 2] << 8) | bytes[offset + 3];
+  if (ihl < 20 || total < ihl || bytes[offset + 9] != IPPROTO_UDP_) {
+    return FALSE;
+  }
+  /* more fragments or a fragment offset */
+  if (((bytes[offset + 6] << 8) | bytes[offset + 7]) & 0x3fff) {
+    return FALSE;
+  }
+  memcpy(dgram->src, bytes + offset + 12, 4);
+  memcpy(dgram->dst, bytes + offset + 16, 4);
+  if (offset + total < nbytes) {
+    nbytes = offset + total;  /* drop the Ethernet trailer */
+  }
+  offset += ihl;
+
+  /* UDP header */
+  if (nbytes < offset + 8) {
+    return FALSE;
+  }
+  dgram->src_port = (bytes[offset] << 8) | bytes[offset + 1];
+  dgram->dst_port = (bytes[offset + 2] << 8) | bytes[offset + 3];
+  udp_len = (bytes[offset + 4] << 8) | bytes[offset + 5];
+  offset += 8;
+
+  dgram->payload = bytes + offset;
+  dgram->nbytes = nbytes - offset;
+  if (udp_len >= 8 && udp_len - 8 < dgram->nbytes) {
+    dgram->nbytes = udp_len - 8;
+  }
+  return TRUE;
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file pcap-file.h
+ * \brief  Sequential reader of the UDP datagrams of a pcap file.
+ *  Only the classic pcap format is read, with Ethernet, Linux cooked
+ *  or raw IPv4 frames. Fragmented and non UDP packets are skipped.
+ */
+
+#ifndef PCAP_FILE_H_
+#define PCAP_FILE_H_
+
+#include <stdio.h>
+#include <glib.h>
+
+/*! \brief  An open capture file.
+ */
+struct pcap_file_struct
+{
+  FILE* file;
+  gboolean swapped;     /*!< Written on a host of the other endianness. */
+  gboolean nanosecond;  /*!< Timestamps have nanosecond resolution. */
+  guint32 linktype;
+  guint32 frame;        /*!< Number of the last record read, from 1. */
+  guint8* record;       /*!< Reused for every record. */
+  guint32 record_size;
+};
+typedef struct pcap_file_struct PcapFile;
+
+/*! \brief  UDP payload of a record.
+ */
+struct pcap_datagram_struct
+{
+  guint32 frame;
+  gint64  ts;           /*!< Arrival time in nanoseconds. */
+  guint8  src[4];       /*!< IPv4 addresses, network order. */
+  guint8  dst[4];
+  guint16 src_port;
+  guint16 dst_port;
+  const guint8* payload; /*!< Valid until the next record is read. */
+  guint   nbytes;
+};
+typedef struct pcap_datagram_struct PcapDatagram;
+
+/*! \brief  Open a capture file and read its header.
+ * \param filename  Path of the file.
+ * \return  The file, NULL if it is not a readable pcap file.
+ */
+PcapFile* pcap_file_open (const char* filename);
+
+/*! \brief  Read up to the next UDP datagram.
+ * \param pcap  The file.
+ * \param dgram  Return value.
+ * \return  FALSE at the end of the file.
+ */
+gboolean pcap_file_next (PcapFile* pcap, PcapDatagram* dgram);
+
+/*! \brief  Close a capture file.
+ */
+void pcap_file_close (PcapFile* pcap);
+
+#endif
+
@@ -0,0 +1,553 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#include <string.h>
+
+#include "template.h"
+#include "basic-dissect.h"
+#include "text-output.h"
+
+/*! \brief  Write buffer of the files, written in one go when full. */
+#define TEXT_WRITE_BUFFER (1 << 20)
+
+/*! \brief  Write buffer of a CSV file, there is one per template. */
+#define CSV_WRITE_BUFFER (1 << 16)
+
+/*! \brief  Open a file with a write buffer of the given size.
+ */
+static FILE* open_buffered (const char* filename, gsize buffer);
+
+/*! \brief  Create the CSV file of a template and write its header.
+ */
+static FILE* open_csv_table (TextOutput* output, const GNode* tmpl);
+
+/*! \brief  Append the header cells of sibling fields.
+ */
+static void append_csv_header (GString* line, const char* prefix,
+                               const GNode* tnode);
+
+/*! \brief  Append the cells of sibling fields, groups are flattened.
+ * \param dnode  First data node, NULL if the enclosing group is absent.
+ */
+static void append_csv_fields (TextOutput* output, const GNode* tnode,
+                               const GNode* dnode);
+
+/*! \brief  Append a cell, quoted if it needs to be.
+ */
+static void append_csv_cell (GString* line, const gchar* text, gsize len);
+
+/*! \brief  Append the members of a JSON object for sibling fields.
+ * \param dnode  First data node.
+ */
+static void append_json_fields (GString* line, const GNode* tnode,
+                                const GNode* dnode);
+
+/*! \brief  Append a sequence as a JSON array of objects, or null.
+ */
+static void append_json_sequence (GString* line, const GNode* tnode,
+                                  const GNode* dnode);
+
+/*! \brief  Append the value of a field that is not a group or a sequence.
+ * \param quote  TRUE to write strings as JSON strings, FALSE for CSV.
+ */
+static void append_value (GString* line, const FieldType* ftype,
+                          const FieldData* fdata, gboolean quote);
+
+/*! \brief  Append a string as a JSON string.
+ *          Bytes above 0x7f of an ascii string, and those of a unicode
+ *          string that are not valid UTF-8, are written as \\u00XX.
+ */
+static void append_json_string (GString* line, const guint8* bytes, gsize len,
+                                gboolean utf8);
+
+static void append_uint (GString* line, guint64 value);
+static void append_int (GString* line, gint64 value);
+static void append_decimal (GString* line, const DecimalFieldValue* value);
+static void append_hex (GString* line, const guint8* bytes, guint nbytes);
+
+/*! \brief  Length of an ascii string, which can count a terminator.
+ */
+static guint ascii_length (const SizedData* ascii);
+
+/*! \brief  Data of a field, NULL if it is absent.
+ */
+static const FieldData* present_data (const GNode* dnode);
+
+
+TextOutput* text_output_json (const char* filename)
+{
+  TextOutput* output;
+  FILE* file = open_buffered(filename, TEXT_WRITE_BUFFER);
+
+  if (!file) {
+    return NULL;
+  }
+  output = g_new0(TextOutput, 1);
+  output->format = TextJson;
+  output->file = file;
+  output->line = g_string_sized_new(4096);
+  return output;
+}
+
+
+TextOutput* text_output_csv (const char* directory)
+{
+  TextOutput* output = g_new0(TextOutput, 1);
+
+  output->format = TextCsv;
+  output->directory = g_strdup(directory);
+  output->tables = g_hash_table_new(g_direct_hash, g_direct_equal);
+  output->line = g_string_sized_new(4096);
+  output->cell = g_string_sized_new(4096);
+  return output;
+}
+
+
+void text_output_message (TextOutput* output, const DecodedMessage* msg)
+{
+  const FieldType* ftype = (const FieldType*) msg->tmpl->data;
+  GString* line = output->line;
+  FILE* file;
+
+  g_string_truncate(line, 0);
+
+  if (output->format == TextJson) {
+    file = output->file;
+    g_string_append_len(line, "{\"message_id\":", 14);
+    append_uint(line, msg->id);
+    g_string_append_len(line, ",\"frame\":", 9);
+    append_uint(line, msg->frame);
+    g_string_append_len(line, ",\"ts\":", 6);
+    append_int(line, msg->ts);
+    g_string_append_len(line, ",\"tid\":", 7);
+    append_int(line, ftype->id);
+    g_string_append_len(line, ",\"template\":", 12);
+    append_json_string(line, (const guint8*) (ftype->name ? ftype->name : ""),
+                       ftype->name ? strlen(ftype->name) : 0, TRUE);
+    g_string_append_len(line, ",\"fields\":{", 11);
+    append_json_fields(line, msg->tmpl->children, msg->data->children);
+    g_string_append_len(line, "}}\n", 3);
+  }
+  else {
+    file = (FILE*) g_hash_table_lookup(output->tables, msg->tmpl);
+    if (!file) {
+      file = open_csv_table(output, msg->tmpl);
+      if (!file) {
+        output->failed = TRUE;
+        return;
+      }
+      g_hash_table_insert(output->tables, (gpointer) msg->tmpl, file);
+    }
+    append_uint(line, msg->id);
+    g_string_append_c(line, ',');
+    append_uint(line, msg->frame);
+    g_string_append_c(line, ',');
+    append_int(line, msg->ts);
+    append_csv_fields(output, msg->tmpl->children, msg->data->children);
+    g_string_append_c(line, '\n');
+  }
+
+  if (fwrite(line->str, 1, line->len, file) != line->len) {
+    output->failed = TRUE;
+  }
+}
+
+
+gboolean text_output_finish (TextOutput* output)
+{
+  gboolean ok;
+
+  if (output->file && output->file != stdout) {
+    output->failed = (fclose(output->file) != 0) || output->failed;
+  }
+  else if (output->file) {
+    output->failed = (fflush(output->file) != 0) || output->failed;
+  }
+  if (output->tables) {
+    GHashTableIter iter;
+    gpointer file;
+
+    g_hash_table_iter_init(&iter, output->tables);
+    while (g_hash_table_iter_next(&iter, NULL, &file)) {
+      output->failed = (fclose((FILE*) file) != 0) || output->failed;
+    }
+    g_hash_table_destroy(output->tables);
+  }
+  if (output->failed) {
+    fprintf(stderr, "text output: write failed, the output is incomplete\n");
+  }
+  ok = !output->failed;
+
+  g_string_free(output->line, TRUE);
+  if (output->cell) {
+    g_string_free(output->cell, TRUE);
+  }
+  g_free(output->directory);
+  g_free(output);
+  return ok;
+}
+
+
+FILE* open_buffered (const char* filename, gsize buffer)
+{
+  FILE* file;
+
+  if (!strcmp(filename, "-")) {
+    file = stdout;
+  }
+  else {
+    file = fopen(filename, "w");
+    if (!file) {
+      perror(filename);
+      return NULL;
+    }
+  }
+  setvbuf(file, NULL, _IOFBF, buffer);
+  return file;
+}
+
+
+FILE* open_csv_table (TextOutput* output, const GNode* tmpl)
+{
+  const FieldType* ftype = (const FieldType*) tmpl->data;
+  gchar* filename;
+  gchar* p;
+  FILE* file;
+
+  filename = g_strdup_printf("%d-%s.csv", ftype->id,
+                             ftype->name ? ftype->name : "unnamed");
+  for (p = filename; *p; ++p) {
+    if (!g_ascii_isalnum(*p) && *p != '.' && *p != '-' && *p != '_') {
+      *p = '_';
+    }
+  }
+  p = g_strdup_printf("%s/%s", output->directory, filename);
+  file = open_buffered(p, CSV_WRITE_BUFFER);
+  g_free(p);
+  g_free(filename);
+
+  if (file) {
+    GString* header = g_string_new("message_id,frame,ts");
+    append_csv_header(header, "", tmpl->children);
+    g_string_append_c(header, '\n');
+    fwrite(header->str, 1, header->len, file);
+    g_string_free(header, TRUE);
+  }
+  return file;
+}
+
+
+void append_csv_header (GString* line, const char* prefix, const GNode* tnode)
+{
+  for (; tnode; tnode = tnode->next) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    gchar* name = g_strconcat(prefix, ftype->name ? ftype->name : "unnamed", NULL);
+
+    if (ftype->type == FieldTypeGroup) {
+      gchar* group_prefix = g_strconcat(name, ".", NULL);
+      append_csv_header(line, group_prefix, tnode->children);
+      g_free(group_prefix);
+    }
+    else {
+      g_string_append_c(line, ',');
+      append_csv_cell(line, name, strlen(name));
+    }
+    g_free(name);
+  }
+}
+
+
+void append_csv_fields (TextOutput* output, const GNode* tnode,
+                        const GNode* dnode)
+{
+  GString* line = output->line;
+
+  for (; tnode; tnode = tnode->next, dnode = dnode ? dnode->next : NULL) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* fdata = present_data(dnode);
+
+    switch (ftype->type) {
+      case FieldTypeGroup:
+        append_csv_fields(output, tnode->children, fdata ? dnode->children : NULL);
+        break;
+      case FieldTypeSequence:
+        g_string_append_c(line, ',');
+        if (fdata) {
+          g_string_truncate(output->cell, 0);
+          append_json_sequence(output->cell, tnode, dnode);
+          append_csv_cell(line, output->cell->str, output->cell->len);
+        }
+        break;
+      default:
+        g_string_append_c(line, ',');
+        if (fdata) {
+          append_value(line, ftype, fdata, FALSE);
+        }
+        break;
+    }
+  }
+}
+
+
+void append_csv_cell (GString* line, const gchar* text, gsize len)
+{
+  gsize i;
+
+  for (i = 0; i < len; ++i) {
+    if (text[i] == ',' || text[i] == '"' || text[i] == '\n' || text[i] == '\r') {
+      break;
+    }
+  }
+  if (i == len) {
+    g_string_append_len(line, text, len);
+    return;
+  }
+
+  g_string_append_c(line, '"');
+  for (i = 0; i < len; ++i) {
+    if (text[i] == '"') {
+      g_string_append_c(line, '"');
+    }
+    g_string_append_c(line, text[i]);
+  }
+  g_string_append_c(line, '"');
+}
+
+
+void append_json_fields (GString* line, const GNode* tnode, const GNode* dnode)
+{
+  gboolean first = TRUE;
+
+  for (; tnode; tnode = tnode->next, dnode = dnode ? dnode->next : NULL) {
+    const FieldType* ftype = (const FieldType*) tnode->data;
+    const FieldData* fdata = present_data(dnode);
+
+    if (!first) {
+      g_string_append_c(line, ',');
+    }
+    first = FALSE;
+    append_json_string(line, (const guint8*) (ftype->name ? ftype->name : ""),
+                       ftype->name ? strlen(ftype->name) : 0, TRUE);
+    g_string_append_c(line, ':');
+
+    if (!fdata) {
+      g_string_append_len(line, "null", 4);
+    }
+    else if (ftype->type == FieldTypeGroup) {
+      g_string_append_c(line, '{');
+      append_json_fields(line, tnode->children, dnode->children);
+      g_string_append_c(line, '}');
+    }
+    else if (ftype->type == FieldTypeSequence) {
+      append_json_sequence(line, tnode, dnode);
+    }
+    else {
+      append_value(line, ftype, fdata, TRUE);
+    }
+  }
+}
+
+
+void append_json_sequence (GString* line, const GNode* tnode, const GNode* dnode)
+{
+  const GNode* group_tnode = tnode->children ? tnode->children->next : NULL;
+  const GNode* element;
+
+  if (!group_tnode || !present_data(dnode)) {
+    g_string_append_len(line, "null", 4);
+    return;
+  }
+
+  g_string_append_c(line, '[');
+  for (element = dnode->children; element; element = element->next) {
+    if (element != dnode->children) {
+      g_string_append_c(line, ',');
+    }
+    g_string_append_c(line, '{');
+    append_json_fields(line, group_tnode->children,
+                       present_data(element) ? element->children : NULL);
+    g_string_append_c(line, '}');
+  }
+  g_string_append_c(line, ']');
+}
+
+
+void append_value (GString* line, const FieldType* ftype,
+                   const FieldData* fdata, gboolean quote)
+{
+  switch (ftype->type) {
+    case FieldTypeUInt32:
+      append_uint(line, fdata->value.u32);
+      break;
+    case FieldTypeUInt64:
+      append_uint(line, fdata->value.u64);
+      break;
+    case FieldTypeInt32:
+      append_int(line, fdata->value.i32);
+      break;
+    case FieldTypeInt64:
+      append_int(line, fdata->value.i64);
+      break;
+    case FieldTypeDecimal:
+      append_decimal(line, &fdata->value.decimal);
+      break;
+    case FieldTypeAsciiString:
+      if (quote) {
+        append_json_string(line, fdata->value.ascii.bytes,
+                           ascii_length(&fdata->value.ascii), FALSE);
+      }
+      else {
+        append_csv_cell(line, (const gchar*) fdata->value.ascii.bytes,
+                        ascii_length(&fdata->value.ascii));
+      }
+      break;
+    case FieldTypeUnicodeString:
+      if (quote) {
+        append_json_string(line, fdata->value.unicode.bytes,
+                           fdata->value.unicode.nbytes, TRUE);
+      }
+      else {
+        append_csv_cell(line, (const gchar*) fdata->value.unicode.bytes,
+                        fdata->value.unicode.nbytes);
+      }
+      break;
+    case FieldTypeByteVector:
+      if (quote) {
+        g_string_append_c(line, '"');
+      }
+      append_hex(line, fdata->value.bytevec.bytes, fdata->value.bytevec.nbytes);
+      if (quote) {
+        g_string_append_c(line, '"');
+      }
+      break;
+    default:
+      g_string_append_len(line, "null", 4);
+      break;
+  }
+}
+
+
+void append_json_string (GString* line, const guint8* bytes, gsize len,
+                         gboolean utf8)
+{
+  static const char hex[] = "0123456789abcdef";
+  const gchar* valid_end = (const gchar*) bytes;
+  gsize start = 0;
+  gsize i;
+
+  g_string_append_c(line, '"');
+  for (i = 0; i < len; ++i) {
+    guint8 c = bytes[i];
+    if (c >= 0x80 && utf8) {
+      /* validate from here on once a valid run ended */
+      if ((const gchar*) bytes + i >= valid_end) {
+        g_utf8_validate((const gchar*) bytes + i, len - i, &valid_end);
+      }
+      if ((const gchar*) bytes + i < valid_end) {
+        continue;
+      }
+    }
+    else if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80) {
+      continue;
+    }
+    /* copy the run of plain characters at once */
+    g_string_append_len(line, (const gchar*) bytes + start, i - start);
+    start = i + 1;
+    if (c == '"' || c == '\\') {
+      g_string_append_c(line, '\\');
+      g_string_append_c(line, (gchar) c);
+    }
+    else {
+      char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0f] };
+      g_string_append_len(line, escaped, 6);
+    }
+  }
+  g_string_append_len(line, (const gchar*) bytes + start, len - start);
+  g_string_append_c(line, '"');
+}
+
+
+void append_uint (GString* line, guint64 value)
+{
+  char digits[20];
+  guint n = sizeof(digits);
+
+  do {
+    digits[--n] = (char) ('0' + value % 10);
+    value /= 10;
+  } while (value);
+  g_string_append_len(line, digits + n, sizeof(digits) - n);
+}
+
+
+void append_int (GString* line, gint64 value)
+{
+  if (value < 0) {
+    g_string_append_c(line, '-');
+    /* negate in unsigned arithmetic, G_MININT64 has no positive twin */
+    append_uint(line, (guint64) 0 - (guint64) value);
+  }
+  else {
+    append_uint(line, (guint64) value);
+  }
+}
+
+
+void append_decimal (GString* line, const DecimalFieldValue* value)
+{
+  char buf[DECIMAL_STRING_MAX];
+  gsize len = decimal_to_string(value, buf);
+
+  if (len) {
+    g_string_append_len(line, buf, len);
+  }
+  else {
+    /* exponent too large to spell out */
+    append_int(line, value->mantissa);
+    g_string_append_c(line, 'e');
+    append_int(line, value->exponent);
+  }
+}
+
+
+void append_hex (GString* line, const guint8* bytes, guint nbytes)
+{
+  static const char hex[] = "0123456789abcdef";
+  guint i;
+
+  for (i = 0; i < nbytes; ++i) {
+    g_string_append_c(line, hex[bytes[i] >> 4]);
+    g_string_append_c(line, hex[bytes[i] & 0x0f]);
+  }
+}
+
+
+guint ascii_length (const SizedData* ascii)
+{
+  guint len = 0;
+  while (len < ascii->nbytes && ascii->bytes[len]) {
+    ++len;
+  }
+  return len;
+}
+
+
+const FieldData* present_data (const GNode* dnode)
+{
+  const FieldData* fdata = dnode ? (const FieldData*) dnode->data : NULL;
+  return (fdata && fdata->status == FieldExists) ? fdata : NULL;
+}
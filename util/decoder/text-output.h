@@ -0,0 +1,84 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file text-output.h
+ * \brief  Streaming JSON lines and CSV output of decoded messages.
+ *  A message is formatted straight from the template and data trees
+ *  into a buffer reused for every message, then handed to a file with
+ *  a large write buffer. Memory does not grow with the capture.
+ *
+ *  JSON writes one object per line:
+ *    {"message_id":1,"frame":1,"ts":...,"tid":52,"template":"...",
+ *     "fields":{"Price":123.45,"Entries":[{...},{...}],...}}
+ *  Decimals keep their exact digits, byte vectors are hex strings and
+ *  absent optional fields are null.
+ *
+ *  CSV writes one file per template, one row per message, with a
+ *  header line. Groups are flattened as group.field columns and a
+ *  sequence is a single cell holding its elements as a JSON array.
+ */
+
+#ifndef TEXT_OUTPUT_H_
+#define TEXT_OUTPUT_H_
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "decoder.h"
+
+/*! \brief  Formats of the text output.
+ */
+enum TextFormat { TextJson, TextCsv };
+
+/*! \brief  A text output.
+ */
+struct text_output_struct
+{
+  guint8 format;       /*!< One of TextFormat. */
+  FILE* file;          /*!< JSON stream. */
+  gchar* directory;    /*!< CSV files. */
+  GHashTable* tables;  /*!< template GNode -> FILE, CSV only */
+  GString* line;       /*!< Message being formatted. */
+  GString* cell;       /*!< Sequence being formatted, CSV only. */
+  gboolean failed;
+};
+typedef struct text_output_struct TextOutput;
+
+/*! \brief  Start a JSON lines output.
+ * \param filename  File to write, "-" for the standard output.
+ * \return  The output, NULL if the file cannot be created.
+ */
+TextOutput* text_output_json (const char* filename);
+
+/*! \brief  Start a CSV output.
+ * \param directory  Existing directory the files are written to.
+ * \return  The output.
+ */
+TextOutput* text_output_csv (const char* directory);
+
+/*! \brief  Write a message.
+ */
+void text_output_message (TextOutput* output, const DecodedMessage* msg);
+
+/*! \brief  Flush and close the files, free the output.
+ * \return  FALSE if a write failed.
+ */
+gboolean text_output_finish (TextOutput* output);
+
+#endif
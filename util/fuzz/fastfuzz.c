@@ -0,0 +1,607 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file fastfuzz.c
+ * \brief  Fuzzing harness of dissect_fast_bytes.
+ *  An input is a few datagrams decoded as one capture file, so the
+ *  delta and tail operators can grow their strings from one to the next:
+ *  every datagram is a 16 bit big endian length and its bytes, the last
+ *  one takes whatever is left. The dictionaries are reset before every
+ *  input, which makes the cost of an input reproducible.
+ *
+ *  Built with FASTFUZZ_LIBFUZZER it is a libFuzzer target, configured by
+ *  the environment. Else it runs the inputs it is given and ranks them
+ *  by their cost per byte, which also serves AFL with "run @@".
+ *
+ *  The cost of an input is the work of the dissector per input byte:
+ *  fields decoded, buffers allocated, bytes allocated or, on Linux, the
+ *  instructions retired. libFuzzer is told the cost as extra coverage,
+ *  one feature per step of its logarithm, so an input costlier than any
+ *  before is kept and mutated further.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "wmem_aux.h"
+#include "template.h"
+#include "parse-template.h"
+#include "dictionaries.h"
+#include "dissect.h"
+#include "error_log.h"
+
+#include "byte-plan.h"
+
+/*! \brief  What the cost of an input counts. */
+enum fuzz_cost_enum
+{
+  FuzzCostFields,
+  FuzzCostAllocs,
+  FuzzCostBytes,
+  FuzzCostInstructions,
+  FuzzCostEnumLimit
+};
+typedef enum fuzz_cost_enum FuzzCost;
+
+static const char* const fuzz_cost_names[FuzzCostEnumLimit] =
+{
+  "fields", "allocs", "bytes", "instructions"
+};
+
+/*! \brief  Steps of the cost logarithm told to libFuzzer, per octave. */
+#define FuzzCostSteps 8
+
+/*! \brief  Number of cost features. */
+#define FuzzCostFeatures 256
+
+#ifdef FASTFUZZ_LIBFUZZER
+/*! \brief  Extra coverage of libFuzzer, the cost steps reached. */
+__attribute__((used, section("__libfuzzer_extra_counters")))
+static guint8 cost_features[FuzzCostFeatures];
+#endif
+
+/*! \brief  Cost of one input run.
+ */
+struct fuzz_run_struct
+{
+  char* name;
+  gsize nbytes;
+  guint ndatagrams;
+  guint messages;
+  guint64 cost;
+  gdouble per_byte;
+  gint64 usecs;
+};
+typedef struct fuzz_run_struct FuzzRun;
+
+/*! \brief  Templates, cost measure and limit of the harness.
+ */
+struct fuzz_setup_struct
+{
+  wmem_map_t* templates;
+  FuzzCost cost;
+  gdouble limit;             /*!< Cost per byte aborting, 0 for none. */
+  int perf_fd;               /*!< Instruction counter, -1 if none. */
+};
+typedef struct fuzz_setup_struct FuzzSetup;
+
+static FuzzSetup setup;
+
+/*! \brief  Print the usage, or a bad argument.
+ * \return  The exit status.
+ */
+static int ArgParseBailOut (const char* arg, const char* reason);
+
+/*! \brief  Read the templates and open the cost counter.
+ * \return  FALSE if the templates cannot be read.
+ */
+static gboolean setup_fuzz (const char* template_filename,
+                            const char* cost_name, gdouble limit);
+
+/*! \brief  Current value of the counter of the cost measure.
+ */
+static guint64 read_cost (void);
+
+/*! \brief  Decode an input as one capture file and measure its cost.
+ *          Aborts when the cost per byte is over the limit, so the fuzzer
+ *          keeps the input as a finding.
+ */
+static void run_input (const char* name, const guint8* data, gsize size,
+                       FuzzRun* run);
+
+/*! \brief  Decode the messages of a datagram, till an unknown template.
+ * \return  Number of messages.
+ */
+static guint decode_datagram (const guint8* bytes, guint nbytes);
+
+#ifdef FASTFUZZ_LIBFUZZER
+/*! \brief  Feature of libFuzzer of a cost per byte.
+ */
+static guint cost_feature (gdouble per_byte);
+#else
+/*! \brief  Run a file, or every file of a directory, and rank them.
+ * \return  The exit status.
+ */
+static int run_inputs (const char* path, guint top);
+
+/*! \brief  Write every byte plan of a test directory as an input.
+ * \return  The exit status.
+ */
+static int write_corpus (const char* test_dir, const char* out_dir);
+
+static gint compare_runs (gconstpointer a, gconstpointer b);
+#endif
+
+
+#ifdef FASTFUZZ_LIBFUZZER
+
+int LLVMFuzzerInitialize (int* argc, char*** argv)
+{
+  const char* template_filename = getenv("FASTFUZZ_TEMPLATES");
+  const char* cost_name = getenv("FASTFUZZ_COST");
+  const char* limit = getenv("FASTFUZZ_LIMIT");
+
+  (void) argc;
+  (void) argv;
+  if (!template_filename) {
+    template_filename = FASTFUZZ_TEMPLATES;
+  }
+  if (!setup_fuzz(template_filename, cost_name ? cost_name : "fields",
+                  limit ? atof(limit) : 0)) {
+    exit(1);
+  }
+  return 0;
+}
+
+
+int LLVMFuzzerTestOneInput (const guint8* data, size_t size)
+{
+  FuzzRun run;
+
+  run_input(0, data, size, &run);
+  cost_features[cost_feature(run.per_byte)] = 1;
+  return 0;
+}
+
+#else
+
+int main (const int argc, const char* const* argv)
+{
+  const char* template_filename = 0;
+  const char* cost_name = "fields";
+  const char* run_path = 0;
+  const char* corpus_dir = 0;
+  const char* out_dir = 0;
+  gdouble limit = 0;
+  guint top = 10;
+  int argi;
+
+  if (argc == 1) {
+    return ArgParseBailOut(0, 0);
+  }
+
+  /* Loop thru arguments to set internal data. */
+  for (argi = 1; argi < argc; ++argi) {
+    const char* arg = argv[argi];
+    if (argc == argi+1) {
+      return ArgParseBailOut(arg, "Trailing flag without a value.");
+    }
+    else if (!strcmp("tmpl", arg)) {
+      template_filename = argv[++argi];
+    }
+    else if (!strcmp("cost", arg)) {
+      cost_name = argv[++argi];
+    }
+    else if (!strcmp("limit", arg)) {
+      limit = atof(argv[++argi]);
+      if (limit <= 0) {
+        return ArgParseBailOut(argv[argi], "Limit must be positive.");
+      }
+    }
+    else if (!strcmp("top", arg)) {
+      top = (guint) atoi(argv[++argi]);
+    }
+    else if (!strcmp("run", arg)) {
+      run_path = argv[++argi];
+    }
+    else if (!strcmp("corpus", arg)) {
+      corpus_dir = argv[++argi];
+    }
+    else if (!strcmp("out", arg)) {
+      out_dir = argv[++argi];
+    }
+    else {
+      return ArgParseBailOut(arg, "Unknown argument.");
+    }
+  }
+
+  if (corpus_dir) {
+    if (!out_dir) {
+      return ArgParseBailOut(0, "A corpus needs out.");
+    }
+    return write_corpus(corpus_dir, out_dir);
+  }
+  if (!template_filename || !run_path) {
+    return ArgParseBailOut(0, "Inputs are run with tmpl and run.");
+  }
+
+  if (!setup_fuzz(template_filename, cost_name, limit)) {
+    return 1;
+  }
+  return run_inputs(run_path, top);
+}
+
+#endif
+
+
+int ArgParseBailOut (const char* arg, const char* reason)
+{
+  if (arg) {
+    fprintf(stderr, "Error with argument: %s\n", arg);
+  }
+  if (reason) {
+    fprintf(stderr, "Reason: %s\n", reason);
+  }
+  fputs("Usage: fastfuzz tmpl FILE run FILE|DIR [cost C] [limit X] [top N]\n"
+        "       fastfuzz corpus DIR out DIR\n"
+        "  tmpl    FAST templates the inputs are decoded with.\n"
+        "  run     Input, or directory of inputs, to decode.\n"
+        "  cost    What an input costs: fields (default), allocs, bytes\n"
+        "          or instructions (Linux).\n"
+        "  limit   Abort on an input costing more per byte.\n"
+        "  top     Costliest inputs listed, 10 by default.\n"
+        "  corpus  Test directory, its byte plans become inputs\n"
+        "  out     in this directory.\n", stderr);
+  return (arg || reason) ? 1 : 0;
+}
+
+
+gboolean setup_fuzz (const char* template_filename,
+                     const char* cost_name, gdouble limit)
+{
+  GNode* templates;
+  guint i;
+
+  memset(&setup, 0, sizeof(FuzzSetup));
+  setup.perf_fd = -1;
+  setup.limit = limit;
+  setup.cost = FuzzCostEnumLimit;
+  for (i = 0; i < FuzzCostEnumLimit; ++i) {
+    if (!strcmp(cost_name, fuzz_cost_names[i])) {
+      setup.cost = (FuzzCost) i;
+    }
+  }
+  if (FuzzCostEnumLimit == setup.cost) {
+    fprintf(stderr, "%s: unknown cost\n", cost_name);
+    return FALSE;
+  }
+
+  if (FuzzCostInstructions == setup.cost) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    setup.perf_fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    if (setup.perf_fd < 0) {
+      fprintf(stderr, "No instruction counter, fields are counted.\n");
+      setup.cost = FuzzCostFields;
+    }
+  }
+
+  wmem_init();
+  wmem_init_scopes();
+  fast_set_log_settings(FALSE, FALSE, NULL);
+  /* nothing is kept of a packet once decoded */
+  dissect_set_tree_scope(wmem_packet_scope());
+
+  /* the templates live in the epan scope, for every input */
+  templates = parse_templates_xml(template_filename);
+  if (!templates) {
+    fprintf(stderr, "%s: no templates could be read\n", template_filename);
+    return FALSE;
+  }
+  setup.templates = create_templates_table(templates);
+  return TRUE;
+}
+
+
+guint64 read_cost (void)
+{
+  const DissectStats* stats = dissect_stats();
+
+  switch (setup.cost) {
+    case FuzzCostFields:
+      return stats->fields;
+    case FuzzCostAllocs:
+      /* the data and the node of every field, and the sized buffers */
+      return 2 * stats->fields + stats->sized_allocs;
+    case FuzzCostBytes:
+      return stats->fields * (sizeof(FieldData) + sizeof(GNode)) +
+        stats->sized_bytes;
+    case FuzzCostInstructions:
+    default:
+      break;
+  }
+#ifdef __linux__
+  {
+    guint64 count = 0;
+    if (read(setup.perf_fd, &count, sizeof(count)) == sizeof(count)) {
+      return count;
+    }
+  }
+#endif
+  return 0;
+}
+
+
+void run_input (const char* name, const guint8* data, gsize size,
+                FuzzRun* run)
+{
+  gsize offset = 0;
+  gint64 start;
+  guint64 cost;
+
+  memset(run, 0, sizeof(FuzzRun));
+  run->name = (char*) name;
+  run->nbytes = size;
+
+  /* a new capture file for every input */
+  wmem_enter_file_scope();
+  reset_dictionaries();
+  reset_string_pool();
+  dissect_reset();
+
+  start = g_get_monotonic_time();
+  cost = read_cost();
+  while (offset < size) {
+    guint nbytes = (guint) (size - offset);
+    guint8* bytes;
+
+    if (nbytes >= 2) {
+      nbytes = MIN((guint) (data[offset] << 8 | data[offset + 1]),
+                   nbytes - 2);
+      offset += 2;
+    }
+    else {
+      offset = size;
+      break;
+    }
+    /* a copy, an overrun past the datagram is caught by ASan */
+    bytes = (guint8*) g_malloc(nbytes ? nbytes : 1);
+    memcpy(bytes, data + offset, nbytes);
+    offset += nbytes;
+
+    wmem_enter_packet_scope();
+    run->messages += decode_datagram(bytes, nbytes);
+    wmem_leave_packet_scope();
+    g_free(bytes);
+    run->ndatagrams++;
+  }
+  run->cost = read_cost() - cost;
+  run->usecs = g_get_monotonic_time() - start;
+  wmem_leave_file_scope();
+
+  run->per_byte = (gdouble) run->cost / (gdouble) MAX(size, 1);
+  if (setup.limit && run->per_byte > setup.limit) {
+    fprintf(stderr, "%s: %" G_GUINT64_FORMAT " %s for %lu bytes, "
+            "%.1f per byte over the limit of %.1f\n",
+            run->name ? run->name : "input", run->cost,
+            fuzz_cost_names[setup.cost], (unsigned long) size,
+            run->per_byte, setup.limit);
+    abort();
+  }
+}
+
+
+guint decode_datagram (const guint8* bytes, guint nbytes)
+{
+  DissectPosition position;
+  address src;
+  address dest;
+  guint8 localhost[4] = { 127, 0, 0, 1 };
+  guint messages = 0;
+
+  set_address(&src, AT_IPv4, 4, localhost);
+  set_address(&dest, AT_IPv4, 4, localhost);
+
+  memset(&position, 0, sizeof(DissectPosition));
+  position.nbytes = nbytes;
+  position.bytes = bytes;
+  ShiftBytes(&position);
+
+  while (position.nbytes) {
+    GNode* data = wmem_node_new(wmem_packet_scope(), 0);
+    messages++;
+    /* like the plugin, nothing more is told past an unknown template */
+    if (!dissect_fast_bytes(setup.templates, &position, data,
+                            &src, &dest)) {
+      break;
+    }
+  }
+  return messages;
+}
+
+
+#ifdef FASTFUZZ_LIBFUZZER
+
+guint cost_feature (gdouble per_byte)
+{
+  guint feature = (guint) (log2(1 + per_byte) * FuzzCostSteps);
+  return MIN(feature, FuzzCostFeatures - 1);
+}
+
+#else
+
+int run_inputs (const char* path, guint top)
+{
+  GPtrArray* names = g_ptr_array_new();
+  GArray* runs = g_array_new(FALSE, FALSE, sizeof(FuzzRun));
+  gdouble per_byte = 0;
+  guint64 bytes = 0;
+  guint64 cost = 0;
+  guint i;
+
+  if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+    GDir* dir = g_dir_open(path, 0, NULL);
+    const char* name;
+    if (!dir) {
+      fprintf(stderr, "%s: cannot be read\n", path);
+      return 1;
+    }
+    while ((name = g_dir_read_name(dir))) {
+      g_ptr_array_add(names, g_build_filename(path, name, NULL));
+    }
+    g_dir_close(dir);
+  }
+  else {
+    g_ptr_array_add(names, g_strdup(path));
+  }
+
+  for (i = 0; i < names->len; ++i) {
+    char* name = (char*) g_ptr_array_index(names, i);
+    gchar* data;
+    gsize size;
+    FuzzRun run;
+
+    if (!g_file_get_contents(name, &data, &size, NULL)) {
+      fprintf(stderr, "%s: cannot be read\n", name);
+      g_free(name);
+      continue;
+    }
+    run_input(name, (const guint8*) data, size, &run);
+    g_array_append_val(runs, run);
+    bytes += size;
+    cost += run.cost;
+    g_free(data);
+  }
+  g_ptr_array_free(names, TRUE);
+
+  g_array_sort(runs, &compare_runs);
+  for (i = 0; i < runs->len && i < top; ++i) {
+    const FuzzRun* run = &g_array_index(runs, FuzzRun, i);
+    printf("%12.1f %s/byte %8lu bytes %4u datagrams %5u messages "
+           "%8" G_GINT64_FORMAT " us  %s\n",
+           run->per_byte, fuzz_cost_names[setup.cost],
+           (unsigned long) run->nbytes, run->ndatagrams, run->messages,
+           run->usecs, run->name);
+  }
+  if (bytes) {
+    per_byte = (gdouble) cost / (gdouble) bytes;
+  }
+  printf("%u inputs, %" G_GUINT64_FORMAT " bytes, %.1f %s per byte\n",
+         runs->len, bytes, per_byte, fuzz_cost_names[setup.cost]);
+  if (runs->len && per_byte > 0) {
+    printf("costliest input: %.1f times the average\n",
+           g_array_index(runs, FuzzRun, 0).per_byte / per_byte);
+  }
+
+  for (i = 0; i < runs->len; ++i) {
+    g_free(g_array_index(runs, FuzzRun, i).name);
+  }
+  g_array_free(runs, TRUE);
+  return 0;
+}
+
+
+int write_corpus (const char* test_dir, const char* out_dir)
+{
+  char* byteplans_dir = g_build_filename(test_dir, "byteplans", NULL);
+  GDir* dir = g_dir_open(byteplans_dir, 0, NULL);
+  const char* name;
+  guint ninputs = 0;
+  int status = 0;
+
+  if (!dir) {
+    fprintf(stderr, "%s: cannot be read\n", byteplans_dir);
+    g_free(byteplans_dir);
+    return 1;
+  }
+  g_mkdir_with_parents(out_dir, 0755);
+
+  while ((name = g_dir_read_name(dir))) {
+    char* plan = g_build_filename(byteplans_dir, name, NULL);
+    GArray* dgrams;
+    GByteArray* input;
+    char* input_name;
+    char* out;
+    guint i;
+
+    if (!g_str_has_suffix(name, ".xml") ||
+        !(dgrams = read_byte_plan(plan))) {
+      g_free(plan);
+      continue;
+    }
+    /* the datagrams of the plan, framed as the harness reads them */
+    input = g_byte_array_new();
+    for (i = 0; i < dgrams->len; ++i) {
+      const PlanDatagram* dgram = &g_array_index(dgrams, PlanDatagram, i);
+      guint8 length[2];
+      length[0] = (guint8) (dgram->nbytes >> 8);
+      length[1] = (guint8) dgram->nbytes;
+      g_byte_array_append(input, length, 2);
+      g_byte_array_append(input, dgram->bytes, dgram->nbytes);
+    }
+    input_name = g_strndup(name, strlen(name) - 4);
+    out = g_build_filename(out_dir, input_name, NULL);
+    if (!g_file_set_contents(out, (const gchar*) input->data,
+                             input->len, NULL)) {
+      fprintf(stderr, "%s: cannot be written\n", out);
+      status = 1;
+    }
+    else {
+      ninputs++;
+    }
+    g_free(out);
+    g_free(input_name);
+    g_byte_array_free(input, TRUE);
+    free_byte_plan(dgrams);
+    g_free(plan);
+  }
+  g_dir_close(dir);
+  g_free(byteplans_dir);
+
+  printf("%u inputs written to %s\n", ninputs, out_dir);
+  return status;
+}
+
+
+gint compare_runs (gconstpointer a, gconstpointer b)
+{
+  const FuzzRun* run_a = (const FuzzRun*) a;
+  const FuzzRun* run_b = (const FuzzRun*) b;
+  if (run_a->per_byte != run_b->per_byte) {
+    return run_a->per_byte < run_b->per_byte ? 1 : -1;
+  }
+  return strcmp(run_a->name, run_b->name);
+}
+
+#endif
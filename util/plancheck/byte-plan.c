@@ -0,0 +1,162 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file byte-plan.c
+ * \brief  Read the byte plans of the tests, the bytes the Plan Runner
+ *  sends, without the JVM.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libxml/parser.h>
+
+#include "byte-plan.h"
+
+/*! \brief  Skip to the next element, from node itself.
+ */
+static xmlNodePtr next_element (xmlNodePtr node);
+
+
+GArray* read_byte_plan (const char* filename)
+{
+  xmlDocPtr doc = xmlParseFile(filename);
+  xmlNodePtr node;
+  GArray* dgrams;
+  PlanDatagram dgram;
+  GString* bits;
+  gboolean goodp = TRUE;
+
+  if (!doc) {
+    fprintf(stderr, "%s: cannot be read\n", filename);
+    return 0;
+  }
+
+  /* like the Plan Runner, the addresses stay until changed */
+  memset(&dgram, 0, sizeof(PlanDatagram));
+  parse_ipv4("127.0.0.1", dgram.src);
+  parse_ipv4("127.0.0.1", dgram.dst);
+
+  dgrams = g_array_new(FALSE, FALSE, sizeof(PlanDatagram));
+  bits = g_string_new("");
+  for (node = next_element(xmlDocGetRootElement(doc)->children);
+       node && goodp; node = next_element(node->next)) {
+    xmlChar* from;
+    xmlChar* to;
+    xmlNodePtr text;
+    guint i;
+
+    if (xmlStrcasecmp(node->name, BAD_CAST "bytemessage")) {
+      fprintf(stderr, "%s:%ld: %s is not a bytemessage\n", filename,
+              xmlGetLineNo(node), node->name);
+      goodp = FALSE;
+      break;
+    }
+    from = xmlGetProp(node, BAD_CAST "from");
+    to = xmlGetProp(node, BAD_CAST "to");
+    if ((from && !parse_ipv4((const char*) from, dgram.src)) ||
+        (to && !parse_ipv4((const char*) to, dgram.dst))) {
+      fprintf(stderr, "%s:%ld: bad address\n", filename, xmlGetLineNo(node));
+      goodp = FALSE;
+    }
+    if (from) {
+      xmlFree(from);
+    }
+    if (to) {
+      xmlFree(to);
+    }
+
+    /* the bits, the comments between them left out */
+    g_string_truncate(bits, 0);
+    for (text = node->children; text; text = text->next) {
+      const xmlChar* c;
+      if (text->type != XML_TEXT_NODE || !text->content) {
+        continue;
+      }
+      for (c = text->content; *c; ++c) {
+        if (*c == '0' || *c == '1') {
+          g_string_append_c(bits, (gchar) *c);
+        }
+        else if (!g_ascii_isspace(*c)) {
+          fprintf(stderr, "%s:%ld: %c is not a bit\n", filename,
+                  xmlGetLineNo(node), *c);
+          goodp = FALSE;
+        }
+      }
+    }
+    if (bits->len % 8) {
+      fprintf(stderr, "%s:%ld: bits are not a multiple of 8\n", filename,
+              xmlGetLineNo(node));
+      goodp = FALSE;
+    }
+
+    dgram.nbytes = (guint) (bits->len / 8);
+    dgram.bytes = (guint8*) g_malloc0(dgram.nbytes + 1);
+    dgram.line = xmlGetLineNo(node);
+    for (i = 0; i < bits->len; ++i) {
+      dgram.bytes[i / 8] |= (bits->str[i] - '0') << (7 - i % 8);
+    }
+    g_array_append_val(dgrams, dgram);
+  }
+  g_string_free(bits, TRUE);
+  xmlFreeDoc(doc);
+
+  if (!goodp) {
+    free_byte_plan(dgrams);
+    return 0;
+  }
+  return dgrams;
+}
+
+
+gboolean parse_ipv4 (const char* text, guint8* addr)
+{
+  guint a, b, c, d;
+  char extra;
+
+  if (sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 ||
+      a > 255 || b > 255 || c > 255 || d > 255) {
+    return FALSE;
+  }
+  addr[0] = (guint8) a;
+  addr[1] = (guint8) b;
+  addr[2] = (guint8) c;
+  addr[3] = (guint8) d;
+  return TRUE;
+}
+
+
+
+
+void free_byte_plan (GArray* dgrams)
+{
+  guint i;
+  for (i = 0; i < dgrams->len; ++i) {
+    g_free(g_array_index(dgrams, PlanDatagram, i).bytes);
+  }
+  g_array_free(dgrams, TRUE);
+}
+
+
+xmlNodePtr next_element (xmlNodePtr node)
+{
+  while (node && node->type != XML_ELEMENT_NODE) {
+    node = node->next;
+  }
+  return node;
+}
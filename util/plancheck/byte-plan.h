@@ -0,0 +1,51 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#ifndef BYTE_PLAN_H_
+#define BYTE_PLAN_H_
+
+#include <glib.h>
+
+/*! \brief  The bytes of a bytemessage, and where they were sent.
+ */
+struct plan_datagram_struct
+{
+  guint8* bytes;
+  guint nbytes;
+  guint8 src[4];
+  guint8 dst[4];
+  long line;                 /*!< Of the bytemessage in the plan. */
+};
+typedef struct plan_datagram_struct PlanDatagram;
+
+/*! \brief  Read the bytemessages of a byte plan.
+ *          The "from" and "to" addresses stay in effect until changed,
+ *          as with the Plan Runner, and default to 127.0.0.1.
+ * \return  Array of PlanDatagram, NULL if the plan cannot be read.
+ */
+GArray* read_byte_plan (const char* filename);
+
+/*! \brief  Free the datagrams of read_byte_plan().
+ */
+void free_byte_plan (GArray* dgrams);
+
+/*! \brief  Parse a dotted IPv4 address.
+ */
+gboolean parse_ipv4 (const char* text, guint8* addr);
+
+#endif
+
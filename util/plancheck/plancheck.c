@@ -0,0 +1,1010 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file plancheck.c
+ * \brief  Check the byte plans of the tests without tshark or the JVM.
+ *  The bytes of every bytemessage go straight to dissect_fast_bytes and
+ *  the data trees are walked against the expected plan, field by field,
+ *  under the rules display_fields() shows them by: the element is named
+ *  after the field type, its value is what follows the colon of the
+ *  tree item, with decimals in scientific notation and empty fields
+ *  without a value. A plan file is then the one rwcompare would have
+ *  written from the PDML of tshark.
+ *  A plan may also have the order books expected at its end, which
+ *  are rebuilt from its messages as with "Build order books", a work
+ *  budget of its own, the string buffers its decoding may allocate,
+ *  and templates skipped as with the "Skipped templates" preference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libxml/parser.h>
+
+#include "wmem_aux.h"
+#include "template.h"
+#include "parse-template.h"
+#include "dictionaries.h"
+#include "dissect.h"
+#include "error_log.h"
+#include "book.h"
+
+#include "byte-plan.h"
+
+/*! \brief  Name of the element of a field type, from its filter name. */
+static const char* const field_elements[FieldTypeEnumLimit] =
+{
+  "uint32", "uint64", "int32", "int64", "decimal",
+  "ascii", "unicode", "bytevector", "group", "sequence", "ERROR"
+};
+
+/*! \brief  State of the check of one plan.
+ */
+struct plan_check_struct
+{
+  const char* name;
+  xmlNodePtr enode;          /*!< Next expected message. */
+  long line;                 /*!< Of the last expected node matched. */
+  GString* value;            /*!< Value of the field being checked. */
+  GString* failure;          /*!< First mismatch, empty if none. */
+  guint messages;
+  wmem_map_t* book_roles;    /*!< NULL if no books are checked. */
+  BookSet* books;
+};
+typedef struct plan_check_struct PlanCheck;
+
+/*! \brief  Number of DissectStats counters a work file can check. */
+#define PLAN_WORK_COUNTERS 4
+
+/*! \brief  Counter of a work file left unchecked. */
+#define PLAN_WORK_ANY G_MAXUINT64
+
+/*! \brief  Attributes of a work file, in the order of plan_work_counter. */
+static const char* const plan_work_names[PLAN_WORK_COUNTERS] =
+{
+  "sized_fields", "sized_allocs", "sized_bytes", "sized_interned"
+};
+
+/*! \brief  Print the usage, or a bad argument.
+ * \return  The exit status.
+ */
+static int ArgParseBailOut (const char* arg, const char* reason);
+
+static gint compare_names (gconstpointer a, gconstpointer b);
+
+/*! \brief  Check a byte plan against its expected plan.
+ * \param books_filename  Expected order books, NULL if none.
+ * \param budget_filename  Work budget of the packets, NULL for the default.
+ * \param work_filename  Work expected of every pass, NULL if unchecked.
+ * \param skip_filename  Templates to skip, NULL if none.
+ * \param repeat  Times the plan is decoded, for its timing.
+ * \return  TRUE iff every pass matched.
+ */
+static gboolean check_plan (const char* name, const char* template_filename,
+                            const char* bytes_filename,
+                            const char* expect_filename,
+                            const char* books_filename,
+                            const char* budget_filename,
+                            const char* work_filename,
+                            const char* skip_filename, guint repeat);
+
+/*! \brief  Read a work budget, the limits it leaves out keep their
+ *          default.
+ * \return  FALSE if the file cannot be read.
+ */
+static gboolean read_budget (const char* filename, DissectBudget* budget);
+
+/*! \brief  Read the work expected of a plan, the counters it leaves
+ *          out are PLAN_WORK_ANY.
+ * \return  FALSE if the file cannot be read.
+ */
+static gboolean read_work (const char* filename,
+                           guint64 expected[PLAN_WORK_COUNTERS]);
+
+/*! \brief  A counter of the dissector work, by its index in
+ *          plan_work_names.
+ */
+static guint64 plan_work_counter (const DissectStats* stats, guint i);
+
+/*! \brief  Read the ids of the templates to skip, a comma separated
+ *          "templates" list.
+ * \return  Array of guint32, NULL if the file cannot be read.
+ */
+static GArray* read_skip (const char* filename);
+
+/*! \brief  Mark the templates to skip, as the plugin does from its
+ *          preference.
+ */
+static void mark_skipped (GNode* templates, const GArray* skip);
+
+/*! \brief  Decode the messages of a datagram and check them.
+ * \return  FALSE at the first mismatch.
+ */
+static gboolean check_datagram (PlanCheck* check, wmem_map_t* templates,
+                                const PlanDatagram* dgram);
+
+static gboolean check_message (PlanCheck* check, const GNode* tmpl,
+                               const GNode* data);
+
+/*! \brief  Check sibling fields against sibling elements.
+ * \param enode  Return value. Element after the last checked one.
+ */
+static gboolean check_fields (PlanCheck* check, const GNode* tnode,
+                              const GNode* dnode, xmlNodePtr* enode);
+
+static gboolean check_field (PlanCheck* check, const GNode* tnode,
+                             const GNode* dnode, xmlNodePtr* enode);
+
+/*! \brief  Check the books rebuilt from the plan, every book and
+ *          every level of its sides in order.
+ */
+static gboolean check_books (PlanCheck* check, xmlNodePtr root);
+
+/*! \brief  Check there are no more elements.
+ */
+static gboolean check_no_more (PlanCheck* check, xmlNodePtr enode);
+
+/*! \brief  Check an element, its name without case and its value.
+ * \param value  NULL if the element has no value.
+ */
+static gboolean check_element (PlanCheck* check, xmlNodePtr enode,
+                               const char* name, const char* value);
+
+/*! \brief  Value of a present field, as shown in the tree.
+ */
+static void format_value (GString* value, const FieldType* ftype,
+                          const FieldData* fdata);
+
+/*! \brief  Skip to the next element, from node itself.
+ */
+static xmlNodePtr next_element (xmlNodePtr node);
+
+
+int main (const int argc, const char* const* argv)
+{
+  const char* test_dir = 0;
+  const char* template_filename = 0;
+  const char* bytes_filename = 0;
+  const char* expect_filename = 0;
+  const char* books_filename = 0;
+  const char* budget_filename = 0;
+  const char* work_filename = 0;
+  const char* skip_filename = 0;
+  guint repeat = 1;
+  guint nplans = 0;
+  guint nfailed = 0;
+  gint64 start;
+  int argi;
+
+  if (argc == 1) {
+    return ArgParseBailOut(0, 0);
+  }
+
+  /* Loop thru arguments to set internal data. */
+  for (argi = 1; argi < argc; ++argi) {
+    const char* arg = argv[argi];
+    if (argc == argi+1) {
+      return ArgParseBailOut(arg, "Trailing flag without a value.");
+    }
+    else if (!strcmp("test", arg)) {
+      test_dir = argv[++argi];
+    }
+    else if (!strcmp("tmpl", arg)) {
+      template_filename = argv[++argi];
+    }
+    else if (!strcmp("bytes", arg)) {
+      bytes_filename = argv[++argi];
+    }
+    else if (!strcmp("expect", arg)) {
+      expect_filename = argv[++argi];
+    }
+    else if (!strcmp("books", arg)) {
+      books_filename = argv[++argi];
+    }
+    else if (!strcmp("budget", arg)) {
+      budget_filename = argv[++argi];
+    }
+    else if (!strcmp("work", arg)) {
+      work_filename = argv[++argi];
+    }
+    else if (!strcmp("skip", arg)) {
+      skip_filename = argv[++argi];
+    }
+    else if (!strcmp("repeat", arg)) {
+      repeat = (guint) atoi(argv[++argi]);
+      if (!repeat) {
+        return ArgParseBailOut(argv[argi], "Repeat must be positive.");
+      }
+    }
+    else {
+      return ArgParseBailOut(arg, "Unknown argument.");
+    }
+  }
+  if (!test_dir && !(bytes_filename && expect_filename)) {
+    return ArgParseBailOut(0, "Either test, or bytes and expect are needed.");
+  }
+  if (!test_dir && !template_filename) {
+    return ArgParseBailOut(0, "A single plan needs tmpl.");
+  }
+
+  wmem_init();
+  wmem_init_scopes();
+  fast_set_log_settings(FALSE, FALSE, NULL);
+  /* every tree is checked before the next packet, long dictionary
+   * values are then copied out of it as by the decoder and the server */
+  dissect_set_tree_scope(wmem_packet_scope());
+  set_sized_data_scope(wmem_packet_scope());
+  xmlLineNumbersDefault(1);
+
+  start = g_get_monotonic_time();
+  if (bytes_filename) {
+    nplans++;
+    if (!check_plan(bytes_filename, template_filename, bytes_filename,
+                    expect_filename, books_filename, budget_filename,
+                    work_filename, skip_filename, repeat)) {
+      nfailed++;
+    }
+  }
+  else {
+    char* byteplans_dir = g_build_filename(test_dir, "byteplans", NULL);
+    GDir* dir = g_dir_open(byteplans_dir, 0, NULL);
+    GPtrArray* names = g_ptr_array_new();
+    const char* name;
+    guint i;
+
+    if (!dir) {
+      fprintf(stderr, "%s: cannot be read\n", byteplans_dir);
+      return 1;
+    }
+    while ((name = g_dir_read_name(dir))) {
+      if (g_str_has_suffix(name, ".xml")) {
+        g_ptr_array_add(names, g_strdup(name));
+      }
+    }
+    g_dir_close(dir);
+    g_ptr_array_sort(names, &compare_names);
+
+    for (i = 0; i < names->len; ++i) {
+      const char* plan = (const char*) g_ptr_array_index(names, i);
+      char* bytes = g_build_filename(byteplans_dir, plan, NULL);
+      char* expect = g_build_filename(test_dir, "expected", plan, NULL);
+      char* books = g_build_filename(test_dir, "books", plan, NULL);
+      char* budget = g_build_filename(test_dir, "budgets", plan, NULL);
+      char* work = g_build_filename(test_dir, "work", plan, NULL);
+      char* skip = g_build_filename(test_dir, "skip", plan, NULL);
+      char* tmpl = 0;
+      const char* sep = strchr(plan, '_');
+
+      /* what rwcompare is told to expect, by the same name */
+      if (!g_file_test(expect, G_FILE_TEST_EXISTS)) {
+        g_free(expect);
+        expect = g_build_filename(test_dir, "plans", plan, NULL);
+      }
+      /* bv_delta.xml goes with bv_templates.xml, if there is one */
+      if (sep) {
+        char* prefix = g_strndup(plan, sep - plan);
+        char* own = g_strdup_printf("%s_templates.xml", prefix);
+        tmpl = g_build_filename(test_dir, own, NULL);
+        if (!g_file_test(tmpl, G_FILE_TEST_EXISTS)) {
+          g_free(tmpl);
+          tmpl = 0;
+        }
+        g_free(own);
+        g_free(prefix);
+      }
+      if (!tmpl) {
+        tmpl = template_filename ? g_strdup(template_filename) :
+          g_build_filename(test_dir, "templates.xml", NULL);
+      }
+
+      if (!g_file_test(expect, G_FILE_TEST_EXISTS)) {
+        printf("  ----  %s (nothing expected)\n", plan);
+      }
+      else {
+        nplans++;
+        if (!check_plan(plan, tmpl, bytes, expect,
+                        g_file_test(books, G_FILE_TEST_EXISTS) ? books : 0,
+                        g_file_test(budget, G_FILE_TEST_EXISTS) ? budget : 0,
+                        g_file_test(work, G_FILE_TEST_EXISTS) ? work : 0,
+                        g_file_test(skip, G_FILE_TEST_EXISTS) ? skip : 0,
+                        repeat)) {
+          nfailed++;
+        }
+      }
+      g_free(bytes);
+      g_free(expect);
+      g_free(books);
+      g_free(budget);
+      g_free(work);
+      g_free(skip);
+      g_free(tmpl);
+    }
+    for (i = 0; i < names->len; ++i) {
+      g_free(g_ptr_array_index(names, i));
+    }
+    g_ptr_array_free(names, TRUE);
+    g_free(byteplans_dir);
+  }
+
+  printf("%u plans, %u passed, %u failed in %.3f s\n", nplans,
+         nplans - nfailed, nfailed,
+         (g_get_monotonic_time() - start) / 1e6);
+
+  wmem_cleanup_scopes();
+  wmem_cleanup();
+  return nfailed ? 1 : 0;
+}
+
+
+int ArgParseBailOut (const char* arg, const char* reason)
+{
+  if (arg) {
+    fprintf(stderr, "Error with argument: %s\n", arg);
+  }
+  if (reason) {
+    fprintf(stderr, "Reason: %s\n", reason);
+  }
+  fputs("Usage: plancheck test DIR [tmpl FILE] [repeat N]\n"
+        "       plancheck tmpl FILE bytes FILE expect FILE [books FILE]"
+        " [budget FILE]\n"
+        "                 [work FILE] [skip FILE] [repeat N]\n"
+        "  test    Test directory, every plan of DIR/byteplans is checked\n"
+        "          against DIR/expected or else DIR/plans by its name,\n"
+        "          and against DIR/books if there is one, with the\n"
+        "          budget of DIR/budgets if there is one, DIR/work and\n"
+        "          DIR/skip.\n"
+        "  tmpl    FAST templates, DIR/templates.xml by default.\n"
+        "  bytes   Byte plan to decode.\n"
+        "  expect  Plan the decoded messages must match.\n"
+        "  books   Order books expected at the end of the plan.\n"
+        "  budget  Work budget of every packet of the plan.\n"
+        "  work    String buffers every pass of the plan may allocate.\n"
+        "  skip    Templates decoded for their dictionaries only.\n"
+        "  repeat  Times every plan is decoded, for its timing.\n", stderr);
+  return (arg || reason) ? 1 : 0;
+}
+
+
+gint compare_names (gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+
+gboolean check_plan (const char* name, const char* template_filename,
+                     const char* bytes_filename,
+                     const char* expect_filename,
+                     const char* books_filename,
+                     const char* budget_filename,
+                     const char* work_filename,
+                     const char* skip_filename, guint repeat)
+{
+  static const DissectBudget default_budget =
+  {
+    BudgetMaxFields, BudgetMaxElements, BudgetMaxStringBytes
+  };
+  DissectBudget budget = default_budget;
+  guint64 work[PLAN_WORK_COUNTERS];
+  DissectStats work_start;
+  GArray* dgrams = read_byte_plan(bytes_filename);
+  xmlDocPtr expect_doc = xmlParseFile(expect_filename);
+  xmlDocPtr books_doc = books_filename ? xmlParseFile(books_filename) : 0;
+  gboolean budget_read = !budget_filename ||
+    read_budget(budget_filename, &budget);
+  gboolean work_read = !work_filename || read_work(work_filename, work);
+  GArray* skip = skip_filename ? read_skip(skip_filename) : 0;
+  PlanCheck check;
+  gint64 elapsed = 0;
+  gboolean goodp = dgrams && expect_doc && xmlDocGetRootElement(expect_doc) &&
+    (!books_filename || (books_doc && xmlDocGetRootElement(books_doc))) &&
+    budget_read && work_read && (!skip_filename || skip);
+  guint pass;
+  guint i;
+
+  memset(&check, 0, sizeof(PlanCheck));
+  check.name = name;
+  check.value = g_string_new("");
+  check.failure = g_string_new("");
+  if (!expect_doc || !xmlDocGetRootElement(expect_doc)) {
+    g_string_printf(check.failure, "%s cannot be read", expect_filename);
+  }
+  else if (!dgrams) {
+    g_string_printf(check.failure, "%s cannot be read", bytes_filename);
+  }
+  else if (books_filename && (!books_doc || !xmlDocGetRootElement(books_doc))) {
+    g_string_printf(check.failure, "%s cannot be read", books_filename);
+  }
+  else if (!budget_read) {
+    g_string_printf(check.failure, "%s cannot be read", budget_filename);
+  }
+  else if (!work_read) {
+    g_string_printf(check.failure, "%s cannot be read", work_filename);
+  }
+  else if (!goodp) {
+    g_string_printf(check.failure, "%s cannot be read", skip_filename);
+  }
+  dissect_set_budget(&budget);
+
+  for (pass = 0; pass < repeat && goodp; ++pass) {
+    GNode* templates;
+    wmem_map_t* templates_table;
+    gint64 pass_start;
+
+    /* a new capture file for every pass */
+    wmem_enter_file_scope();
+    reset_dictionaries();
+    reset_string_pool();
+    dissect_reset();
+    work_start = *dissect_stats();
+
+    templates = parse_templates_xml(template_filename);
+    if (!templates) {
+      g_string_printf(check.failure, "%s: no templates could be read",
+                      template_filename);
+      goodp = FALSE;
+    }
+    else {
+      if (skip) {
+        mark_skipped(templates, skip);
+      }
+      templates_table = create_templates_table(templates);
+      check.enode = next_element(xmlDocGetRootElement(expect_doc)->children);
+      check.line = 0;
+      check.messages = 0;
+      check.book_roles = 0;
+      check.books = 0;
+      if (books_doc) {
+        check.book_roles = book_resolve_roles(wmem_file_scope(), templates,
+                                              NULL);
+        check.books = book_set_new(wmem_file_scope());
+      }
+
+      pass_start = g_get_monotonic_time();
+      for (i = 0; i < dgrams->len && goodp; ++i) {
+        wmem_enter_packet_scope();
+        goodp = check_datagram(&check, templates_table,
+                               &g_array_index(dgrams, PlanDatagram, i));
+        wmem_leave_packet_scope();
+      }
+      elapsed += g_get_monotonic_time() - pass_start;
+      if (goodp) {
+        goodp = check_no_more(&check, check.enode);
+      }
+      if (goodp && books_doc) {
+        goodp = check_books(&check, xmlDocGetRootElement(books_doc));
+      }
+      for (i = 0; i < PLAN_WORK_COUNTERS && goodp && work_filename; ++i) {
+        guint64 done = plan_work_counter(dissect_stats(), i) -
+          plan_work_counter(&work_start, i);
+        if (work[i] != PLAN_WORK_ANY && work[i] != done) {
+          g_string_printf(check.failure, "work: %" G_GUINT64_FORMAT " %s, "
+                          "expected %" G_GUINT64_FORMAT, done,
+                          plan_work_names[i], work[i]);
+          goodp = FALSE;
+        }
+      }
+    }
+    wmem_leave_file_scope();
+  }
+
+  dissect_set_budget(&default_budget);
+
+  if (goodp) {
+    printf("  PASS  %s, %u messages, %.1f us\n", name, check.messages,
+           (gdouble) elapsed / repeat);
+  }
+  else {
+    printf("  FAIL  %s: %s\n", name, check.failure->str);
+  }
+
+  if (dgrams) {
+    free_byte_plan(dgrams);
+  }
+  if (expect_doc) {
+    xmlFreeDoc(expect_doc);
+  }
+  if (books_doc) {
+    xmlFreeDoc(books_doc);
+  }
+  if (skip) {
+    g_array_free(skip, TRUE);
+  }
+  g_string_free(check.value, TRUE);
+  g_string_free(check.failure, TRUE);
+  return goodp;
+}
+
+
+gboolean read_budget (const char* filename, DissectBudget* budget)
+{
+  static const char* const limit_names[] = { "fields", "elements", "strings" };
+  guint* limits[] =
+  {
+    &budget->max_fields, &budget->max_elements, &budget->max_string_bytes
+  };
+  xmlDocPtr doc = xmlParseFile(filename);
+  xmlNodePtr root = doc ? xmlDocGetRootElement(doc) : 0;
+  guint i;
+
+  if (!root) {
+    if (doc) {
+      xmlFreeDoc(doc);
+    }
+    return FALSE;
+  }
+  for (i = 0; i < G_N_ELEMENTS(limit_names); ++i) {
+    xmlChar* limit = xmlGetProp(root, BAD_CAST limit_names[i]);
+    if (limit) {
+      *limits[i] = (guint) g_ascii_strtoull((const char*) limit, NULL, 10);
+      xmlFree(limit);
+    }
+  }
+  xmlFreeDoc(doc);
+  return TRUE;
+}
+
+
+gboolean read_work (const char* filename, guint64 expected[PLAN_WORK_COUNTERS])
+{
+  xmlDocPtr doc = xmlParseFile(filename);
+  xmlNodePtr root = doc ? xmlDocGetRootElement(doc) : 0;
+  guint i;
+
+  if (!root) {
+    if (doc) {
+      xmlFreeDoc(doc);
+    }
+    return FALSE;
+  }
+  for (i = 0; i < PLAN_WORK_COUNTERS; ++i) {
+    xmlChar* counter = xmlGetProp(root, BAD_CAST plan_work_names[i]);
+    expected[i] = PLAN_WORK_ANY;
+    if (counter) {
+      expected[i] = g_ascii_strtoull((const char*) counter, NULL, 10);
+      xmlFree(counter);
+    }
+  }
+  xmlFreeDoc(doc);
+  return TRUE;
+}
+
+
+guint64 plan_work_counter (const DissectStats* stats, guint i)
+{
+  const guint64 counters[PLAN_WORK_COUNTERS] =
+  {
+    stats->sized_fields, stats->sized_allocs, stats->sized_bytes,
+    stats->sized_interned
+  };
+  return counters[i];
+}
+
+
+GArray* read_skip (const char* filename)
+{
+  xmlDocPtr doc = xmlParseFile(filename);
+  xmlNodePtr root = doc ? xmlDocGetRootElement(doc) : 0;
+  xmlChar* list = root ? xmlGetProp(root, BAD_CAST "templates") : 0;
+  GArray* skip = 0;
+
+  if (list) {
+    gchar** ids = g_strsplit((const char*) list, ",", -1);
+    guint i;
+
+    skip = g_array_new(FALSE, FALSE, sizeof(guint32));
+    for (i = 0; ids[i]; ++i) {
+      guint32 id = (guint32) g_ascii_strtoull(ids[i], NULL, 10);
+      g_array_append_val(skip, id);
+    }
+    g_strfreev(ids);
+    xmlFree(list);
+  }
+  if (doc) {
+    xmlFreeDoc(doc);
+  }
+  return skip;
+}
+
+
+void mark_skipped (GNode* templates, const GArray* skip)
+{
+  GNode* tmpl;
+  guint i;
+
+  for (tmpl = templates->children; tmpl; tmpl = tmpl->next) {
+    FieldType* tfield = (FieldType*) tmpl->data;
+    tfield->skip = FALSE;
+    for (i = 0; i < skip->len; ++i) {
+      if (g_array_index(skip, guint32, i) == (guint32) tfield->id) {
+        tfield->skip = TRUE;
+      }
+    }
+  }
+}
+
+
+gboolean check_datagram (PlanCheck* check, wmem_map_t* templates,
+                         const PlanDatagram* dgram)
+{
+  DissectPosition position;
+  address src;
+  address dest;
+
+  set_address(&src, AT_IPv4, 4, dgram->src);
+  set_address(&dest, AT_IPv4, 4, dgram->dst);
+
+  memset(&position, 0, sizeof(DissectPosition));
+  position.nbytes = dgram->nbytes;
+  position.bytes = dgram->bytes;
+  ShiftBytes(&position);
+
+  while (position.nbytes) {
+    GNode* data = wmem_node_new(wmem_packet_scope(), 0);
+    const GNode* tmpl = dissect_fast_bytes(templates, &position, data,
+                                           &src, &dest);
+    check->messages++;
+
+    if (!tmpl) {
+      /* shown as a template of its id with a D9 error, like the plugin */
+      FieldData error;
+      xmlNodePtr enode;
+      guint32 tid = data->data ? ((FieldData*) data->data)->value.u32 : 0;
+
+      g_string_printf(check->value, "%d", (int) tid);
+      if (!check_element(check, check->enode, "message", check->value->str)) {
+        return FALSE;
+      }
+      memset(&error, 0, sizeof(FieldData));
+      err_d(9, &error);
+      enode = next_element(check->enode->children);
+      if (!check_element(check, enode, "ERROR",
+                         (const char*) error.value.ascii.bytes) ||
+          !check_no_more(check, next_element(enode->next))) {
+        return FALSE;
+      }
+      check->enode = next_element(check->enode->next);
+      /* nothing more can be told of the datagram */
+      break;
+    }
+    if (!check_message(check, tmpl, data)) {
+      return FALSE;
+    }
+    if (check->books) {
+      guint ntops = 0;
+      book_apply_message(check->books, check->book_roles, tmpl, data,
+                         NULL, &ntops, 0);
+    }
+  }
+  return TRUE;
+}
+
+
+gboolean check_message (PlanCheck* check, const GNode* tmpl,
+                        const GNode* data)
+{
+  const FieldType* ftype = (const FieldType*) tmpl->data;
+  xmlNodePtr enode;
+
+  g_string_printf(check->value, "%d", (int) ftype->id);
+  if (!check_element(check, check->enode, "message", check->value->str)) {
+    return FALSE;
+  }
+  enode = next_element(check->enode->children);
+  if (!ftype->skip &&
+      !check_fields(check, tmpl->children, data->children, &enode)) {
+    return FALSE;
+  }
+  if (!check_no_more(check, enode)) {
+    return FALSE;
+  }
+  check->enode = next_element(check->enode->next);
+  return TRUE;
+}
+
+
+gboolean check_fields (PlanCheck* check, const GNode* tnode,
+                       const GNode* dnode, xmlNodePtr* enode)
+{
+  while (tnode && dnode) {
+    if (!check_field(check, tnode, dnode, enode)) {
+      return FALSE;
+    }
+    tnode = tnode->next;
+    dnode = dnode->next;
+  }
+  return TRUE;
+}
+
+
+gboolean check_field (PlanCheck* check, const GNode* tnode,
+                      const GNode* dnode, xmlNodePtr* enode)
+{
+  const FieldType* ftype = (const FieldType*) tnode->data;
+  const FieldData* fdata = (const FieldData*) dnode->data;
+  const char* element = (guint) ftype->type < FieldTypeEnumLimit ?
+    field_elements[ftype->type] : "unknown";
+  xmlNodePtr node = *enode;
+
+  if (fdata->status == FieldEmpty) {
+    if (!check_element(check, node, element, NULL)) {
+      return FALSE;
+    }
+  }
+  else if (fdata->status != FieldExists) {
+    if (!check_element(check, node, field_elements[FieldTypeError],
+                       (const char*) fdata->value.ascii.bytes)) {
+      return FALSE;
+    }
+  }
+  else if (ftype->type == FieldTypeGroup) {
+    xmlNodePtr child;
+    if (!check_element(check, node, element, "")) {
+      return FALSE;
+    }
+    child = next_element(node->children);
+    if (!check_fields(check, tnode->children, dnode->children, &child) ||
+        !check_no_more(check, child)) {
+      return FALSE;
+    }
+  }
+  else if (ftype->type == FieldTypeSequence) {
+    const GNode* group_tnode = tnode->children ? tnode->children->next : 0;
+    const GNode* element_dnode;
+    xmlNodePtr child;
+    if (!check_element(check, node, element, "")) {
+      return FALSE;
+    }
+    child = next_element(node->children);
+    for (element_dnode = dnode->children; group_tnode && element_dnode;
+         element_dnode = element_dnode->next) {
+      if (!check_field(check, group_tnode, element_dnode, &child)) {
+        return FALSE;
+      }
+    }
+    if (!check_no_more(check, child)) {
+      return FALSE;
+    }
+  }
+  else {
+    format_value(check->value, ftype, fdata);
+    if (!check_element(check, node, element, check->value->str)) {
+      return FALSE;
+    }
+  }
+
+  *enode = next_element(node->next);
+  return TRUE;
+}
+
+
+gboolean check_books (PlanCheck* check, xmlNodePtr root)
+{
+  static const char* const side_names[BookSideEnumLimit] = { "bid", "ask" };
+  xmlNodePtr bnode;
+  guint nbooks = 0;
+
+  if (!check->book_roles) {
+    g_string_assign(check->failure, "books: no template has a price field");
+    return FALSE;
+  }
+
+  for (bnode = next_element(root->children); bnode;
+       bnode = next_element(bnode->next)) {
+    xmlChar* security = xmlGetProp(bnode, BAD_CAST "security");
+    guint64 security_id = security ?
+      g_ascii_strtoull((const char*) security, NULL, 10) : 0;
+    const OrderBook* book = (const OrderBook*)
+      wmem_map_lookup(check->books->books, &security_id);
+    guint depth[BookSideEnumLimit] = { 0, 0 };
+    xmlNodePtr lnode;
+    gint side;
+
+    if (security) {
+      xmlFree(security);
+    }
+    nbooks++;
+    if (!book) {
+      g_string_printf(check->failure, "book %" G_GINT64_MODIFIER "u"
+                      " was not built (line %ld)", security_id,
+                      xmlGetLineNo(bnode));
+      return FALSE;
+    }
+
+    for (lnode = next_element(bnode->children); lnode;
+         lnode = next_element(lnode->next)) {
+      const BookLevel* level;
+      xmlChar* price;
+      xmlChar* size;
+      char* expected;
+      gboolean equivp;
+
+      for (side = 0; side < BookSideEnumLimit; ++side) {
+        if (!xmlStrcasecmp(lnode->name, BAD_CAST side_names[side])) {
+          break;
+        }
+      }
+      if (side == BookSideEnumLimit) {
+        g_string_printf(check->failure, "book %" G_GINT64_MODIFIER "u:"
+                        " %s is no side (line %ld)", security_id,
+                        lnode->name, xmlGetLineNo(lnode));
+        return FALSE;
+      }
+      if (depth[side] >= book->depth[side]) {
+        g_string_printf(check->failure, "book %" G_GINT64_MODIFIER "u:"
+                        " only %u %s levels (line %ld)",
+                        security_id, (guint) book->depth[side],
+                        side_names[side], xmlGetLineNo(lnode));
+        return FALSE;
+      }
+
+      level = &book->levels[side][depth[side]++];
+      price = xmlGetProp(lnode, BAD_CAST "price");
+      size = xmlGetProp(lnode, BAD_CAST "size");
+      /* a price as the decimal fields show it, then the size */
+      g_string_printf(check->value, "%" G_GINT64_MODIFIER "de%d"
+                      " %" G_GINT64_MODIFIER "d", level->mantissa,
+                      level->exponent, level->size);
+      expected = g_strdup_printf("%s %s", price ? (const char*) price : "?",
+                                 size ? (const char*) size : "?");
+      equivp = !strcmp(check->value->str, expected);
+      if (!equivp) {
+        g_string_printf(check->failure, "book %" G_GINT64_MODIFIER "u:"
+                        " %s level %u is %s instead of %s (line %ld)",
+                        security_id, side_names[side], depth[side],
+                        check->value->str, expected, xmlGetLineNo(lnode));
+      }
+      g_free(expected);
+      if (price) {
+        xmlFree(price);
+      }
+      if (size) {
+        xmlFree(size);
+      }
+      if (!equivp) {
+        return FALSE;
+      }
+    }
+
+    for (side = 0; side < BookSideEnumLimit; ++side) {
+      if (depth[side] != book->depth[side]) {
+        g_string_printf(check->failure, "book %" G_GINT64_MODIFIER "u:"
+                        " %u %s levels instead of %u (line %ld)",
+                        security_id, (guint) book->depth[side],
+                        side_names[side], depth[side], xmlGetLineNo(bnode));
+        return FALSE;
+      }
+    }
+  }
+
+  if (nbooks != wmem_map_size(check->books->books)) {
+    g_string_printf(check->failure, "%u books instead of %u",
+                    wmem_map_size(check->books->books), nbooks);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+gboolean check_no_more (PlanCheck* check, xmlNodePtr enode)
+{
+  if (enode) {
+    g_string_printf(check->failure, "message %u: fewer fields than"
+                    " expected (line %ld)", check->messages,
+                    xmlGetLineNo(enode));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+gboolean check_element (PlanCheck* check, xmlNodePtr enode,
+                        const char* name, const char* value)
+{
+  xmlChar* expected;
+  gboolean equivp;
+
+  if (!enode) {
+    g_string_printf(check->failure, "message %u: %s%s%s after line %ld"
+                    " was not expected", check->messages, name,
+                    value ? " " : "", value ? value : "", check->line);
+    return FALSE;
+  }
+  check->line = xmlGetLineNo(enode);
+  if (xmlStrcasecmp(enode->name, BAD_CAST name)) {
+    g_string_printf(check->failure, "message %u: %s instead of %s"
+                    " (line %ld)", check->messages, name, enode->name,
+                    check->line);
+    return FALSE;
+  }
+
+  expected = xmlGetProp(enode, BAD_CAST "value");
+  if (expected && value) {
+    equivp = !xmlStrcmp(expected, BAD_CAST value);
+  }
+  else {
+    equivp = !expected && !value;
+  }
+  if (!equivp) {
+    g_string_printf(check->failure, "message %u: %s is %s%s%s instead of"
+                    " %s%s%s (line %ld)", check->messages, name,
+                    value ? "\"" : "", value ? value : "empty",
+                    value ? "\"" : "",
+                    expected ? "\"" : "",
+                    expected ? (const char*) expected : "empty",
+                    expected ? "\"" : "", check->line);
+  }
+  if (expected) {
+    xmlFree(expected);
+  }
+  return equivp;
+}
+
+
+void format_value (GString* value, const FieldType* ftype,
+                   const FieldData* fdata)
+{
+  guint i;
+
+  switch (ftype->type) {
+    case FieldTypeUInt32:
+      g_string_printf(value, "%u", fdata->value.u32);
+      break;
+    case FieldTypeUInt64:
+      g_string_printf(value, "%" G_GINT64_MODIFIER "u", fdata->value.u64);
+      break;
+    case FieldTypeInt32:
+      g_string_printf(value, "%d", fdata->value.i32);
+      break;
+    case FieldTypeInt64:
+      g_string_printf(value, "%" G_GINT64_MODIFIER "d", fdata->value.i64);
+      break;
+    case FieldTypeDecimal:
+      g_string_printf(value, "%" G_GINT64_MODIFIER "de%d",
+                      fdata->value.decimal.mantissa,
+                      fdata->value.decimal.exponent);
+      break;
+    case FieldTypeAsciiString:
+      /* shown with %s, up to the first zero */
+      g_string_assign(value, fdata->value.ascii.bytes ?
+                      (const char*) fdata->value.ascii.bytes : "");
+      break;
+    case FieldTypeUnicodeString:
+      g_string_assign(value, fdata->value.unicode.bytes ?
+                      (const char*) fdata->value.unicode.bytes : "");
+      break;
+    case FieldTypeByteVector:
+      g_string_truncate(value, 0);
+      for (i = 0; i < fdata->value.bytevec.nbytes; ++i) {
+        g_string_append_printf(value, "%02x", fdata->value.bytevec.bytes[i]);
+      }
+      break;
+    default:
+      g_string_truncate(value, 0);
+      break;
+  }
+}
+
+
+xmlNodePtr next_element (xmlNodePtr node)
+{
+  while (node && node->type != XML_ELEMENT_NODE) {
+    node = node->next;
+  }
+  return node;
+}
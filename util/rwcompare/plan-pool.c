@@ -0,0 +1,300 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+
+/*!
+ * \file plan-pool.c
+ * \brief  Run the regression plans of a directory on a pool of workers.
+ *  The PDML parser and the plan writer keep their state in globals, so
+ *  a worker thread does not compare a plan itself: it runs rwcompare
+ *  on it, with a port taken from a queue of free ones and files named
+ *  after that port, and keeps its standard error for the report.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "run-exe.h"
+
+#include "plan-pool.h"
+
+/*! \brief  One plan to run, and how it went.
+ */
+struct plan_job_struct
+{
+  char* name;
+  char* send_filename;
+  char* expect_filename;
+  gboolean passedp;
+  gdouble seconds;
+  int port;
+  char* log;                 /*!< Standard error of the run. */
+};
+typedef struct plan_job_struct PlanJob;
+
+/*! \brief  What the workers share.
+ */
+struct plan_pool_run_struct
+{
+  const PlanPool* pool;
+  GAsyncQueue* ports;        /*!< Ports no worker is using. */
+  guint32 stamp;             /*!< Tells the files of this run apart. */
+};
+typedef struct plan_pool_run_struct PlanPoolRun;
+
+/*! \brief  List the plans of the directory, sorted by name.
+ * \return  Array of PlanJob*, NULL if the directory cannot be read.
+ */
+static GPtrArray* list_plan_jobs (const PlanPool* pool);
+
+static gint compare_plan_jobs (gconstpointer a, gconstpointer b);
+
+/*! \brief  Worker function, run the plan of a job.
+ */
+static void run_plan_job (gpointer data, gpointer user_data);
+
+/*! \brief  Print the result and time of every plan, and the totals.
+ */
+static void report_plan_jobs (const GPtrArray* jobs, guint njobs,
+                              gdouble wall_seconds);
+
+static void free_plan_job (PlanJob* job);
+
+
+gboolean run_plan_pool (const PlanPool* pool)
+{
+  PlanPoolRun run;
+  GThreadPool* threads;
+  GPtrArray* jobs;
+  GTimer* timer;
+  gboolean goodp = TRUE;
+  guint i;
+
+  jobs = list_plan_jobs (pool);
+  if (!jobs) {
+    return FALSE;
+  }
+  if (!jobs->len) {
+    fprintf (stderr, "No plans in %s.\n", pool->plans_dir);
+    g_ptr_array_free (jobs, TRUE);
+    return FALSE;
+  }
+
+  g_thread_init (0);
+  run.pool = pool;
+  run.ports = g_async_queue_new ();
+  run.stamp = g_random_int ();
+  for (i = 0; i < pool->jobs; ++i) {
+    g_async_queue_push (run.ports, GINT_TO_POINTER (pool->port + i));
+  }
+
+  fprintf (stderr, ">-> Run %u plans, %u at a time.\n",
+           jobs->len, pool->jobs);
+  timer = g_timer_new ();
+  threads = g_thread_pool_new (&run_plan_job, &run,
+                               pool->jobs, TRUE, 0);
+  for (i = 0; i < jobs->len; ++i) {
+    g_thread_pool_push (threads, g_ptr_array_index (jobs, i), 0);
+  }
+  /* Wait for every plan to be done. */
+  g_thread_pool_free (threads, FALSE, TRUE);
+  g_timer_stop (timer);
+
+  report_plan_jobs (jobs, pool->jobs, g_timer_elapsed (timer, 0));
+
+  for (i = 0; i < jobs->len; ++i) {
+    PlanJob* job = g_ptr_array_index (jobs, i);
+    if (!job->passedp)  goodp = FALSE;
+    free_plan_job (job);
+  }
+  g_ptr_array_free (jobs, TRUE);
+  g_timer_destroy (timer);
+  g_async_queue_unref (run.ports);
+  return goodp;
+}
+
+
+GPtrArray* list_plan_jobs (const PlanPool* pool)
+{
+  GPtrArray* jobs;
+  GDir* dir;
+  const char* name;
+
+  dir = g_dir_open (pool->plans_dir, 0, 0);
+  if (!dir) {
+    fprintf (stderr, "Cannot read the plans of %s.\n", pool->plans_dir);
+    return 0;
+  }
+
+  jobs = g_ptr_array_new ();
+  while ((name = g_dir_read_name (dir))) {
+    PlanJob* job;
+    if (!g_str_has_suffix (name, ".xml"))  continue;
+
+    job = g_malloc0 (sizeof (PlanJob));
+    job->name = g_strdup (name);
+    job->send_filename = g_build_filename (pool->plans_dir, name, NULL);
+    job->expect_filename = 0;
+    if (pool->expect_dir) {
+      char* expect = g_build_filename (pool->expect_dir, name, NULL);
+      if (g_file_test (expect, G_FILE_TEST_EXISTS)) {
+        job->expect_filename = expect;
+      }
+      else {
+        g_free (expect);
+      }
+    }
+    if (!job->expect_filename) {
+      job->expect_filename = g_strdup (job->send_filename);
+    }
+    g_ptr_array_add (jobs, job);
+  }
+  g_dir_close (dir);
+
+  g_ptr_array_sort (jobs, &compare_plan_jobs);
+  return jobs;
+}
+
+
+gint compare_plan_jobs (gconstpointer a, gconstpointer b)
+{
+  const PlanJob* job_a = *(const PlanJob* const*) a;
+  const PlanJob* job_b = *(const PlanJob* const*) b;
+  return strcmp (job_a->name, job_b->name);
+}
+
+
+void run_plan_job (gpointer data, gpointer user_data)
+{
+  PlanJob* job = data;
+  const PlanPoolRun* run = user_data;
+  const PlanPool* pool = run->pool;
+  const char* argv[30];
+  unsigned argi = 0;
+  char* port_option;
+  char* prefix;
+  char* pcap_filename;
+  char* pdml_filename;
+  char* plan_filename;
+  GTimer* timer;
+  int status = -1;
+  gboolean ranp;
+
+  job->port = GPOINTER_TO_INT (g_async_queue_pop (run->ports));
+
+  /* Files of the worker are named after its port. */
+  port_option = g_strdup_printf ("%d", job->port);
+  prefix = g_strdup_printf ("rwcompare-%08x-%d-%s",
+                            run->stamp, job->port, job->name);
+  pcap_filename = g_strdup_printf ("%s%c%s.pcap", pool->tmp_dir,
+                                   G_DIR_SEPARATOR, prefix);
+  pdml_filename = g_strdup_printf ("%s-pdml.xml", pcap_filename);
+  plan_filename = g_strdup_printf ("%s-plan.xml", pcap_filename);
+
+  argv[argi++] = pool->self_exe;
+  argv[argi++] = "runner";
+  argv[argi++] = pool->plan_runner_jar;
+  argv[argi++] = "tmpl";
+  argv[argi++] = pool->template_filename;
+  argv[argi++] = "tshark";
+  argv[argi++] = pool->tshark_exe;
+  argv[argi++] = "send";
+  argv[argi++] = job->send_filename;
+  argv[argi++] = "expect";
+  argv[argi++] = job->expect_filename;
+  argv[argi++] = "port";
+  argv[argi++] = port_option;
+  argv[argi++] = "pcap";
+  argv[argi++] = pcap_filename;
+  if (pool->keepp) {
+    /* Given files are left behind by rwcompare. */
+    argv[argi++] = "pdml";
+    argv[argi++] = pdml_filename;
+    argv[argi++] = "plan";
+    argv[argi++] = plan_filename;
+  }
+  if (pool->networkp)  argv[argi++] = "network";
+  if (pool->bypassp)   argv[argi++] = "bypass";
+
+  timer = g_timer_new ();
+  ranp = run_status (argi, argv, &job->log, &status);
+  job->seconds = g_timer_elapsed (timer, 0);
+  g_timer_destroy (timer);
+
+  job->passedp = ranp && status == 0;
+  if (!ranp) {
+    g_free (job->log);
+    job->log = g_strdup_printf ("Cannot run %s.\n", pool->self_exe);
+  }
+
+  if (!pool->keepp)  remove (pcap_filename);
+  g_async_queue_push (run->ports, GINT_TO_POINTER (job->port));
+
+  g_free (port_option);
+  g_free (prefix);
+  g_free (pcap_filename);
+  g_free (pdml_filename);
+  g_free (plan_filename);
+}
+
+
+void report_plan_jobs (const GPtrArray* jobs, guint njobs,
+                       gdouble wall_seconds)
+{
+  gdouble plan_seconds = 0;
+  guint npassed = 0;
+  int width = 0;
+  guint i;
+
+  for (i = 0; i < jobs->len; ++i) {
+    const PlanJob* job = g_ptr_array_index (jobs, i);
+    width = MAX (width, (int) strlen (job->name));
+  }
+
+  /* Logs of the failures first, the table stays at the bottom. */
+  for (i = 0; i < jobs->len; ++i) {
+    const PlanJob* job = g_ptr_array_index (jobs, i);
+    if (!job->passedp) {
+      fprintf (stderr, ">-> %s (port %d):\n%s\n", job->name, job->port,
+               job->log ? job->log : "");
+    }
+  }
+
+  for (i = 0; i < jobs->len; ++i) {
+    const PlanJob* job = g_ptr_array_index (jobs, i);
+    fprintf (stderr, "  %s  %-*s %7.2f s\n", job->passedp ? "PASS" : "FAIL",
+             width, job->name, job->seconds);
+    plan_seconds += job->seconds;
+    if (job->passedp)  ++npassed;
+  }
+  fprintf (stderr,
+           "%u plans, %u passed, %u failed in %.2f s"
+           " (%.2f s of plans over %u workers)\n",
+           jobs->len, npassed, jobs->len - npassed, wall_seconds,
+           plan_seconds, njobs);
+}
+
+
+void free_plan_job (PlanJob* job)
+{
+  g_free (job->name);
+  g_free (job->send_filename);
+  g_free (job->expect_filename);
+  if (job->log)  g_free (job->log);
+  g_free (job);
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of FAST Wireshark.
+ *
+ * FAST Wireshark is free software: you can redistribute it and/or modify
+ * it under the terms of the Lesser GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FAST Wireshark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * Lesser GNU General Public License for more details.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with FAST Wireshark.  If not, see
+ * <http://www.gnu.org/licenses/lgpl.txt>.
+ */
+#ifndef PLAN_POOL_H_
+#define PLAN_POOL_H_
+
+#include <glib.h>
+
+/*! \brief  How to run every plan of a directory.
+ */
+struct plan_pool_struct
+{
+  const char* self_exe;          /*!< This rwcompare, run once per plan. */
+  const char* plan_runner_jar;
+  const char* template_filename;
+  const char* tshark_exe;
+  const char* plans_dir;
+  const char* expect_dir;        /*!< Expected plans overriding the sent. */
+  const char* tmp_dir;           /*!< Where the workers write their files. */
+  int port;                      /*!< First port, one more per worker. */
+  guint jobs;
+  gboolean networkp;
+  gboolean bypassp;
+  gboolean keepp;                /*!< Keep the files of the workers. */
+};
+typedef struct plan_pool_struct PlanPool;
+
+/*! \brief  Run the plans of a directory concurrently and report.
+ *
+ * Every plan is a separate rwcompare run, on a port and with files of
+ * its own, so the runs share nothing.
+ *
+ * \return  TRUE iff every plan matched its expected plan.
+ */
+gboolean run_plan_pool (const PlanPool* pool);
+
+#endif
+
@@ -18,6 +18,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <sys/wait.h>
+#endif
 
 #include "run-exe.h"
 
@@ -95,6 +100,55 @@ gboolean run_gather (guint argc, const char* const* argv, char** output_ptr)
 }
 
 
+/*! \brief  Run a program and get how it exited.
+ * \param argc  Number of arguments (including executable name).
+ * \param argv  Hold executable name and arguments.
+ * \param outerr_ptr  Return value. Will hold program's standard error,
+ *                    free it with g_free().
+ * \param exit_status  Return value. Exit code of the program.
+ * \return  TRUE iff the program could be run.
+ */
+gboolean run_status (guint argc, const char* const* argv,
+                     char** outerr_ptr, int* exit_status)
+{
+  char** argv_mutable;
+  guint i;
+  gboolean successp;
+  int status = -1;
+
+  argv_mutable = g_malloc ((1+ argc) * sizeof (char*));
+  for (i = 0; i < argc; ++i) {
+    argv_mutable[i] = g_strdup (argv[i]);
+  }
+  argv_mutable[argc] = 0;
+
+  successp = g_spawn_sync (0, /* Inherit working directory. */
+                           argv_mutable,
+                           0, /* Inherit environment. */
+                           G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL,
+                           &do_nothing,
+                           0, /* No data passed to do_nothing() */
+                           0,
+                           outerr_ptr,
+                           &status,
+                           0); /* Don't care about the error. */
+
+  for (i = 0; i < argc; ++i) {
+    g_free (argv_mutable[i]);
+  }
+  g_free (argv_mutable);
+
+#ifdef G_OS_UNIX
+  /* The status is the one of waitpid(). */
+  if (successp) {
+    status = WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+  }
+#endif
+  *exit_status = status;
+  return successp;
+}
+
+
 /*! \brief  Run TShark.
  * \param tshark_exe  Name of the TShark executable with optional path.
  * \param pcap_filename  Captured traffic for TShark to read.
@@ -21,6 +21,8 @@
 #include <glib.h>
 
 gboolean run_gather (guint argc, const char* const* argv, char** output_ptr);
+gboolean run_status (guint argc, const char* const* argv,
+                     char** outerr_ptr, int* exit_status);
 gboolean run_tshark (const char* tshark_exe,
                      const char* pcap_filename,
                      const char* template_filename,
@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include "pdmlParser.h"
+#include "plan-pool.h"
 #include "run-exe.h"
 
 #include "rwcompare.h"
@@ -46,6 +47,13 @@ int ArgParseBailOut(const char* arg, const char* reason)
   fputs ("            [expect <plan file>]\n", out);
   fputs ("            [pdml <pdml output file>]\n", out);
   fputs ("            [plan <plan output file>]\n", out);
+  fputs ("  rwcompare plans <plan directory> runner <PlanRunner jar>\n", out);
+  fputs ("            tmpl <template file>\n", out);
+  fputs ("            [expected <expected plan directory>]\n", out);
+  fputs ("            [jobs <workers>] [p[ort] <first port>]\n", out);
+  fputs ("            [tmpdir <directory>] [keep]\n", out);
+  fputs ("            [tshark <TShark executable>] [network] [bypass]\n",
+         out);
 
   if (reason) {
     if (arg) {
@@ -71,6 +79,10 @@ int main (const int argc, const char* const* argv)
   char* plan_filename = 0;
   const char* plan_runner_jar = 0;
   const char* tshark_exe = "tshark";
+  const char* plans_dir = 0;
+  const char* expect_dir = 0;
+  const char* tmp_dir = 0;
+  guint jobs = 4;
   int port = 5000;
   gboolean givenp_pcap = FALSE;
   gboolean givenp_pdml = FALSE;
@@ -78,6 +90,7 @@ int main (const int argc, const char* const* argv)
   gboolean networkp = FALSE;
   gboolean goodp = TRUE;
   gboolean bypassp_fastsend = FALSE;
+  gboolean keepp = FALSE;
   int argi;
 
   if (argc == 1) {
@@ -93,6 +106,9 @@ int main (const int argc, const char* const* argv)
     else if (!strcmp("bypass", arg)) {
       bypassp_fastsend = TRUE;
     }
+    else if (!strcmp("keep", arg)) {
+      keepp = TRUE;
+    }
     else if (argc == argi+1) {
       return ArgParseBailOut(arg, "Trailing flag without a value.");
     }
@@ -128,11 +144,44 @@ int main (const int argc, const char* const* argv)
       plan_filename = g_strdup (argv[++argi]);
       givenp_plan = TRUE;
     }
+    else if (!strcmp("plans", arg)) {
+      plans_dir = argv[++argi];
+    }
+    else if (!strcmp("expected", arg)) {
+      expect_dir = argv[++argi];
+    }
+    else if (!strcmp("jobs", arg)) {
+      jobs = (guint) atoi (argv[++argi]);
+      if (!jobs)  return ArgParseBailOut(argv[argi], "No workers.");
+    }
+    else if (!strcmp("tmpdir", arg)) {
+      tmp_dir = argv[++argi];
+    }
     else {
       return ArgParseBailOut(arg, "Unknown argument.");
     }
   }
 
+  /* Run every plan of a directory, each in its own rwcompare. */
+  if (plans_dir) {
+    PlanPool pool;
+    if (!plan_runner_jar || !template_filename) {
+      return ArgParseBailOut(0, "plans needs a runner and a tmpl.");
+    }
+    pool.self_exe = argv[0];
+    pool.plan_runner_jar = plan_runner_jar;
+    pool.template_filename = template_filename;
+    pool.tshark_exe = tshark_exe;
+    pool.plans_dir = plans_dir;
+    pool.expect_dir = expect_dir;
+    pool.tmp_dir = tmp_dir ? tmp_dir : g_get_tmp_dir ();
+    pool.port = port;
+    pool.jobs = jobs;
+    pool.networkp = networkp;
+    pool.bypassp = bypassp_fastsend;
+    pool.keepp = keepp;
+    return run_plan_pool (&pool) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
   /* Run a TShark capture session. */
   if (goodp && template_filename) {
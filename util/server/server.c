@@ -5,18 +5,84 @@
  * it under the terms of the Lesser GNU General Public License as published by
  * the Free Software Foundation, either version 3 of the License, or
  * (at your option) any later version.
- * 
+ *
  * FAST Wireshark is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * Lesser GNU General Public License for more details.
- * 
+ *
  * You should have received a copy of the Lesser GNU General Public License
- * along with FAST Wireshark.  If not, see 
+ * along with FAST Wireshark.  If not, see
  * <http://www.gnu.org/licenses/lgpl.txt>.
  */
+#include <errno.h>
+
+#include "wmem_aux.h"
+#include "template.h"
+#include "parse-template.h"
+#include "dictionaries.h"
+#include "dissect.h"
+#include "error_log.h"
+#include "feed-header.h"
+
 #include "server.h"
 
+/*! \brief  Largest datagram received. */
+#define DATAGRAM_MAX 65536
+
+/*! \brief  What the listeners do with the datagrams.
+ */
+struct server_config_struct
+{
+    wmem_map_t* templates;  /* NULL to only receive */
+    guint8 flavor;
+    guint batch;
+    guint report;           /* seconds between reports, 0 for none */
+    int rcvbuf;
+    gboolean bits;          /* print the bits of every datagram */
+    const char* group;      /* IPv4 multicast group to join */
+    const char* iface;      /* address of the interface to join it on */
+};
+typedef struct server_config_struct ServerConfig;
+
+static ServerConfig config;
+
+/* totals of the run, and since the last report */
+static ServerCounters total;
+static ServerCounters interval;
+static gint64 start_ns;
+static gint64 interval_ns;
+
+/*! \brief  Decode the FAST messages of a datagram.
+ * \return  Number of messages decoded.
+ */
+static guint decode_datagram (const guint8* bytes, guint nbytes,
+                              address* src, address* dest,
+                              ServerCounters* counters);
+
+/*! \brief  Print the counters of a period to stderr.
+ */
+static void report (const char* label, const ServerCounters* counters,
+                    gint64 ns);
+
+/*! \brief  Print the totals when the listener is killed.
+ */
+static void report_totals (void);
+
+/*! \brief  Join the multicast group of the configuration.
+ */
+static gboolean join_group (int sock);
+
+/*! \brief  Set an address from a socket address, IPv4 or IPv6.
+ */
+static void set_sockaddr (address* addr, const struct sockaddr_storage* ss);
+
+static gint64 clock_ns (clockid_t clock);
+
+/*! \brief  Tell the keyword arguments from a host name.
+ */
+static gboolean is_option (const char* arg);
+
 void chain_func (int s, pid_t p)
 {
     static int   sock = 0;
@@ -43,76 +109,352 @@ void listener_die (int sig)
     chain_func (0, 0);
 }
 
-char* hex_byte (guint n, guint8* buf)
+void print_bits (FILE* out, guint n, const guint8* buf)
 {
-    unsigned i;
-    unsigned len = 2*n;
-    char* res;
-    res = malloc ((len +1) * sizeof (char));
+    guint i;
     for (i = 0; i < n; ++i)
     {
         unsigned j;
-        for (j = 0; j < 2; ++j)
-        {
-            const guint8 x = ((buf[i] << j
-                              ) & 0xf0
-                             ) >> 4;
-            res[2*i+j] = x + (x < 10 ? '0' : 'A'-10);
-        }
+        for (j = 0; j < 8; ++j)
+            putc ('0' + ((buf[i] >> (7 - j)) & 1), out);
+        putc (i % 4 == 3 || i + 1 == n ? '\n' : ' ', out);
     }
-    res[len] = 0;
-    return res;
 }
 
-char* bit_byte (guint n, guint8* buf)
+void latency_add (LatencyHistogram* hist, guint64 ns)
 {
-    unsigned len = 9*n-1;
-    unsigned i;
-    char* res;
-    res = malloc ((len+1) * sizeof (char));
-    for (i = 0; i < n; ++i)
+    guint i = 0;
+    while (i + 1 < LATENCY_BUCKETS && ns >= ((guint64) 1 << i))
+        ++i;
+    hist->count[i]++;
+    hist->n++;
+    if (ns > hist->max)
+        hist->max = ns;
+}
+
+guint64 latency_quantile (const LatencyHistogram* hist, double q)
+{
+    guint64 seen = 0;
+    guint i;
+    for (i = 0; i < LATENCY_BUCKETS; ++i)
     {
-        unsigned j;
-        for (j = 0; j < 8; ++j)
-            res[9*i+j] = '0' + (((1 << 7
-                                 ) & (buf[i] << j)
-                                ) >> 7
-                               );
-        res[9*i+8] = i % 4 == 3 ? '\n' : ' ';
-    }
-    res[len] = 0;
-    return res;
+        seen += hist->count[i];
+        if (seen && seen >= q * hist->n)
+            return (guint64) 1 << i;
+    }
+    return hist->max;
 }
 
-void receive_string (int sock)
+void receive_decode (int sock)
 {
-    struct sockaddr_storage client;
-    socklen_t sizeClient = sizeof (struct sockaddr_storage);
-    guint8 buf[BUFSIZ];
-        /* ssize_t bytecOut; */
-    ssize_t bytecIn;
+    struct mmsghdr* msgs;
+    struct iovec* iovs;
+    struct sockaddr_storage* names;
+    guint8* bufs;
+    char* controls;
+    const size_t control_len = CMSG_SPACE (sizeof (struct timespec)) +
+                               CMSG_SPACE (sizeof (guint32));
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof (struct sockaddr_storage);
+    address dest;
+    guint i;
+    int on = 1;
+
+    if (config.rcvbuf &&
+        0 > setsockopt (sock, SOL_SOCKET, SO_RCVBUF,
+                        &config.rcvbuf, sizeof (int)))
+        perror ("setsockopt(SO_RCVBUF) failed");
+    if (0 > setsockopt (sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof (int)))
+        perror ("setsockopt(SO_TIMESTAMPNS) failed");
+#ifdef SO_RXQ_OVFL
+    if (0 > setsockopt (sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof (int)))
+        perror ("setsockopt(SO_RXQ_OVFL) failed");
+#endif
+    if (config.group && !join_group (sock))
+        exit (1);
+
+        /* Messages are keyed by the addresses, like in Wireshark */
+    memset (&local, 0, sizeof (struct sockaddr_storage));
+    getsockname (sock, (struct sockaddr*) &local, &local_len);
+    if (config.group)
+    {
+        struct sockaddr_in* in = (struct sockaddr_in*) &local;
+        in->sin_family = AF_INET;
+        inet_pton (AF_INET, config.group, &in->sin_addr);
+    }
+    set_sockaddr (&dest, &local);
+
+        /* Everything a batch needs, allocated once */
+    msgs = g_new0 (struct mmsghdr, config.batch);
+    iovs = g_new0 (struct iovec, config.batch);
+    names = g_new0 (struct sockaddr_storage, config.batch);
+    bufs = (guint8*) g_malloc ((gsize) config.batch * DATAGRAM_MAX);
+    controls = (char*) g_malloc0 (config.batch * control_len);
+    for (i = 0; i < config.batch; ++i)
+    {
+        iovs[i].iov_base = bufs + (gsize) i * DATAGRAM_MAX;
+        iovs[i].iov_len = DATAGRAM_MAX;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &names[i];
+        msgs[i].msg_hdr.msg_control = controls + i * control_len;
+    }
+
+    start_ns = clock_ns (CLOCK_MONOTONIC);
+    interval_ns = start_ns;
+    atexit (report_totals);
+    fprintf (stderr, "Listening, %s, batches of %u\n",
+             config.templates ? "decoding" : "receive only", config.batch);
 
-    fprintf (stderr, "Woot bound a socket!\n");
     while (1)
     {
-        bytecIn = recvfrom (sock, buf, BUFSIZ-1, 0,
-                            (struct sockaddr*) &client, &sizeClient);
-        if (bytecIn < 0)
+        int n;
+        gint64 now;
+
+        for (i = 0; i < config.batch; ++i)
         {
-            perror ("recvfrom() failed");
+                /* the kernel shrinks these to what it filled */
+            msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_storage);
+            msgs[i].msg_hdr.msg_controllen = control_len;
+        }
+        n = recvmmsg (sock, msgs, config.batch, MSG_WAITFORONE, NULL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror ("recvmmsg() failed");
                 /* I guess the best action here is to not keep trying */
             pause ();
+            continue;
+        }
+        total.batches++;
+        interval.batches++;
+
+        for (i = 0; i < (guint) n; ++i)
+        {
+            const struct msghdr* hdr = &msgs[i].msg_hdr;
+            const guint8* bytes = (const guint8*) iovs[i].iov_base;
+            guint nbytes = msgs[i].msg_len;
+            struct cmsghdr* cmsg;
+            gint64 wire_ns = 0;
+
+            for (cmsg = CMSG_FIRSTHDR (hdr); cmsg;
+                 cmsg = CMSG_NXTHDR ((struct msghdr*) hdr, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET)
+                    continue;
+                if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+                {
+                    struct timespec ts;
+                    memcpy (&ts, CMSG_DATA (cmsg), sizeof (struct timespec));
+                    wire_ns = (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+                }
+#ifdef SO_RXQ_OVFL
+                else if (cmsg->cmsg_type == SO_RXQ_OVFL)
+                {
+                        /* drops of the socket since it was opened */
+                    guint32 drops;
+                    memcpy (&drops, CMSG_DATA (cmsg), sizeof (guint32));
+                    interval.dropped += drops - total.dropped;
+                    total.dropped = drops;
+                }
+#endif
+            }
+
+            total.datagrams++;
+            interval.datagrams++;
+            total.bytes += nbytes;
+            interval.bytes += nbytes;
+
+            if (config.bits)
+            {
+                fprintf (stderr, "Received:\n");
+                print_bits (stderr, nbytes, bytes);
+            }
+
+            if (config.templates)
+            {
+                address src;
+                gint64 t0;
+                gint64 t1;
+                guint messages;
+
+                set_sockaddr (&src, (const struct sockaddr_storage*) hdr->msg_name);
+                t0 = clock_ns (CLOCK_MONOTONIC);
+                messages = decode_datagram (bytes, nbytes, &src, &dest,
+                                            &interval);
+                t1 = clock_ns (CLOCK_MONOTONIC);
+
+                total.messages += messages;
+                interval.messages += messages;
+                latency_add (&total.decode, t1 - t0);
+                latency_add (&interval.decode, t1 - t0);
+                if (wire_ns)
+                {
+                    gint64 wire = clock_ns (CLOCK_REALTIME) - wire_ns;
+                    if (wire < 0)
+                        wire = 0;
+                    latency_add (&total.wire, wire);
+                    latency_add (&interval.wire, wire);
+                }
+            }
         }
 
+        now = clock_ns (CLOCK_MONOTONIC);
+        if (config.report &&
+            now - interval_ns >= (gint64) config.report * 1000000000)
         {
-                /* char* str = hex_byte (bytecIn, buf); */
-            char* str = bit_byte (bytecIn, buf);
-            fprintf (stderr, "Received:\n%s\n", str);
-            free (str);
+                /* decode_datagram only counts these in the interval */
+            total.unknown += interval.unknown;
+            total.skipped += interval.skipped;
+            report ("interval", &interval, now - interval_ns);
+            memset (&interval, 0, sizeof (ServerCounters));
+            interval_ns = now;
         }
     }
 }
 
+guint decode_datagram (const guint8* bytes, guint nbytes,
+                       address* src, address* dest,
+                       ServerCounters* counters)
+{
+    FeedHeader header;
+    DissectPosition position;
+    guint messages = 0;
+
+        /* messages split over UMDF chunks are not reassembled */
+    if (!parse_feed_header (config.flavor, bytes, nbytes, &header) ||
+        header.chunks > 1)
+    {
+        counters->skipped++;
+        return 0;
+    }
+
+    wmem_enter_packet_scope ();
+    memset (&position, 0, sizeof (DissectPosition));
+    position.offjmp = header.nbytes;
+    position.nbytes = nbytes;
+    position.bytes = bytes;
+    ShiftBytes (&position);
+
+    while (position.nbytes)
+    {
+        GNode* data = wmem_node_new (wmem_packet_scope (), 0);
+        if (!dissect_fast_bytes (config.templates, &position, data,
+                                 src, dest))
+        {
+            counters->unknown++;
+            break;
+        }
+        ++messages;
+    }
+    wmem_leave_packet_scope ();
+
+    if (config.flavor != GenericImplem)
+            /* the feeds reset the dictionaries between packets */
+        clear_dictionaries (*src, *dest);
+    return messages;
+}
+
+void report (const char* label, const ServerCounters* counters, gint64 ns)
+{
+    double seconds = ns / 1e9;
+
+    if (seconds <= 0)
+        seconds = 1e-9;
+    fprintf (stderr, "%s %.1f s: %" G_GUINT64_FORMAT " datagrams, %"
+             G_GUINT64_FORMAT " messages, %.0f dgram/s, %.0f msg/s, %.1f MB/s",
+             label, seconds, counters->datagrams, counters->messages,
+             counters->datagrams / seconds, counters->messages / seconds,
+             counters->bytes / seconds / 1e6);
+    if (counters->batches)
+        fprintf (stderr, ", %.1f dgram/batch",
+                 (double) counters->datagrams / counters->batches);
+    fputc ('\n', stderr);
+    if (counters->decode.n)
+        fprintf (stderr, "  decode p50 <%" G_GUINT64_FORMAT
+                 " p99 <%" G_GUINT64_FORMAT " max %" G_GUINT64_FORMAT " ns",
+                 latency_quantile (&counters->decode, 0.5),
+                 latency_quantile (&counters->decode, 0.99),
+                 counters->decode.max);
+    if (counters->wire.n)
+        fprintf (stderr, ", wire to decoded p50 <%" G_GUINT64_FORMAT
+                 " p99 <%" G_GUINT64_FORMAT " ns",
+                 latency_quantile (&counters->wire, 0.5),
+                 latency_quantile (&counters->wire, 0.99));
+    if (counters->decode.n || counters->wire.n)
+        fputc ('\n', stderr);
+    if (counters->dropped || counters->unknown || counters->skipped)
+        fprintf (stderr, "  %" G_GUINT64_FORMAT " dropped by the socket, %"
+                 G_GUINT64_FORMAT " with an unknown template, %"
+                 G_GUINT64_FORMAT " skipped\n",
+                 counters->dropped, counters->unknown, counters->skipped);
+    if (config.templates)
+        fprintf (stderr, "  %" G_GUINT64_FORMAT " field errors, %.1f MB of"
+                 " strings allocated and freed with their datagram\n",
+                 dissect_stats ()->errors,
+                 dissect_stats ()->sized_bytes / 1e6);
+}
+
+void report_totals (void)
+{
+    total.unknown += interval.unknown;
+    total.skipped += interval.skipped;
+    report ("total", &total, clock_ns (CLOCK_MONOTONIC) - start_ns);
+}
+
+gboolean join_group (int sock)
+{
+    struct ip_mreq mreq;
+
+    memset (&mreq, 0, sizeof (struct ip_mreq));
+    if (1 != inet_pton (AF_INET, config.group, &mreq.imr_multiaddr) ||
+        1 != inet_pton (AF_INET, config.iface ? config.iface : "0.0.0.0",
+                        &mreq.imr_interface))
+    {
+        fprintf (stderr, "Bad group or interface address\n");
+        return FALSE;
+    }
+    if (0 > setsockopt (sock, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                        &mreq, sizeof (struct ip_mreq)))
+    {
+        perror ("setsockopt(IP_ADD_MEMBERSHIP) failed");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void set_sockaddr (address* addr, const struct sockaddr_storage* ss)
+{
+    if (ss->ss_family == AF_INET6)
+        set_address (addr, AT_IPv6, 16,
+                     &((const struct sockaddr_in6*) ss)->sin6_addr);
+    else
+        set_address (addr, AT_IPv4, 4,
+                     &((const struct sockaddr_in*) ss)->sin_addr);
+}
+
+gint64 clock_ns (clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime (clock, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+gboolean is_option (const char* arg)
+{
+    static const char* options[] =
+    {
+        "tmpl", "flavor", "group", "iface", "batch", "report", "rcvbuf",
+        "bits", NULL
+    };
+    guint i;
+    for (i = 0; options[i]; ++i)
+        if (!strcmp (options[i], arg))
+            return TRUE;
+    return FALSE;
+}
+
 int
     spawn_listeners
 (const struct addrinfo* crit,
@@ -184,19 +526,100 @@ int main (int argc, char** argv)
 {
     char* service;
     char* host;
+    const char* template_filename = 0;
     struct addrinfo crit;
+    int argi = 2;
 
     if (2 > argc)
     {
-        fputs ("./server port [host]\n", stderr);
+        fputs ("./server port [host] [tmpl FILE [flavor NAME]]\n"
+               "         [group ADDR [iface ADDR]] [batch N] [report SECONDS]\n"
+               "         [rcvbuf BYTES] [bits yes]\n"
+               "  tmpl    Decode the datagrams with these templates.\n"
+               "  flavor  Packet header of the feed: generic, cme, umdf, moex.\n"
+               "  group   Join this IPv4 multicast group.\n"
+               "  iface   Address of the interface to join the group on.\n"
+               "  batch   Datagrams per recvmmsg call.\n"
+               "  report  Seconds between reports, 0 for the totals only.\n"
+               "  rcvbuf  Receive buffer of the socket.\n"
+               "  bits    Print the bits of every datagram.\n", stderr);
         exit (1);
     }
 
     service = argv[1];
+    host = 0;
+    if (3 <= argc && !is_option (argv[2]))
+    {
+        host = argv[2];
+        argi = 3;
+    }
+
+    config.flavor = GenericImplem;
+    config.batch = SERVER_BATCH;
+    config.report = 1;
+    config.rcvbuf = 8 << 20;
+    for (; argi < argc; ++argi)
+    {
+        const char* arg = argv[argi];
+        if (argc == argi+1)
+        {
+            fprintf (stderr, "Trailing flag without a value: %s\n", arg);
+            exit (1);
+        }
+        else if (!strcmp ("tmpl", arg))
+            template_filename = argv[++argi];
+        else if (!strcmp ("flavor", arg))
+        {
+            config.flavor = feed_flavor_by_name (argv[++argi]);
+            if (config.flavor == NImplem)
+            {
+                fprintf (stderr, "Unknown flavor: %s\n", argv[argi]);
+                exit (1);
+            }
+        }
+        else if (!strcmp ("group", arg))
+            config.group = argv[++argi];
+        else if (!strcmp ("iface", arg))
+            config.iface = argv[++argi];
+        else if (!strcmp ("batch", arg))
+            config.batch = MAX (1, atoi (argv[++argi]));
+        else if (!strcmp ("report", arg))
+            config.report = (guint) atoi (argv[++argi]);
+        else if (!strcmp ("rcvbuf", arg))
+            config.rcvbuf = atoi (argv[++argi]);
+        else if (!strcmp ("bits", arg))
+            config.bits = !strcmp ("yes", argv[++argi]);
+        else
+        {
+            fprintf (stderr, "Unknown argument: %s\n", arg);
+            exit (1);
+        }
+    }
+    if (!host)
+            /* a multicast group is received on its own address */
+        host = config.group ? (char*) config.group : "localhost";
 
-    if (3 <= argc)  host = argv[2];
-    else            host = "localhost";
+    if (template_filename)
+    {
+        GNode* templates;
+        wmem_init ();
+        wmem_init_scopes ();
+        wmem_enter_file_scope ();
+        fast_set_log_settings (FALSE, FALSE, NULL);
+            /* every tree is dropped right after the datagram, and so
+             * are its values */
+        dissect_set_tree_scope (wmem_packet_scope ());
+        set_sized_data_scope (wmem_packet_scope ());
 
+        templates = parse_templates_xml (template_filename);
+        if (!templates)
+        {
+            fprintf (stderr, "%s: no templates could be read\n",
+                     template_filename);
+            exit (1);
+        }
+        config.templates = create_templates_table (templates);
+    }
 
         /* This is used to recursively kill forked processes */
     signal (SIGTERM, listener_die);
@@ -205,15 +628,15 @@ int main (int argc, char** argv)
 
     memset (&crit, 0, sizeof (struct addrinfo));
         /* crit.  ai_family = AF_INET6; */
-    crit.  ai_family = AF_UNSPEC;
+    crit.  ai_family = config.group ? AF_INET : AF_UNSPEC;
     crit.   ai_flags = AI_PASSIVE;
     crit.ai_socktype = SOCK_DGRAM;
     crit.ai_protocol = IPPROTO_UDP;
 
     {
         int spawnc;
-        spawnc = spawn_listeners (&crit, host, service, receive_string);
-        
+        spawnc = spawn_listeners (&crit, host, service, receive_decode);
+
         if (! spawnc)
         {
             fputs ("Not able to bind to any ports!\n", stderr);
@@ -221,12 +644,9 @@ int main (int argc, char** argv)
             exit (1);
         }
 
-        fputs ("should be printing spawn message\n", stderr);
-
             /* Alert parent script of readiness */
         printf ("%d listeners spawned\n", spawnc);
         fflush (stdout);
-        fputs ("should be done printing spawn message\n", stderr);
     }
 
         /* Block until test script signals our termination */
@@ -235,4 +655,3 @@ int main (int argc, char** argv)
     fputs ("Should not have gotten to end of main()\n", stderr);
     exit (1);
 }
-
@@ -5,14 +5,14 @@
  * it under the terms of the Lesser GNU General Public License as published by
  * the Free Software Foundation, either version 3 of the License, or
  * (at your option) any later version.
- * 
+ *
  * FAST Wireshark is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * Lesser GNU General Public License for more details.
- * 
+ *
  * You should have received a copy of the Lesser GNU General Public License
- * along with FAST Wireshark.  If not, see 
+ * along with FAST Wireshark.  If not, see
  * <http://www.gnu.org/licenses/lgpl.txt>.
  */
 #ifndef SERVER_H_
@@ -24,15 +24,70 @@
 
 #include <signal.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <netdb.h>
 #include <glib.h>
 
+/*! \brief  Datagrams received with one recvmmsg call, by default. */
+#define SERVER_BATCH 64
+
+/*! \brief  Buckets of the latency histograms, powers of two in ns. */
+#define LATENCY_BUCKETS 40
+
+/*! \brief  Distribution of latencies in nanoseconds.
+ *  Bucket i counts the values below 2^i ns, not counted before.
+ */
+struct latency_histogram_struct
+{
+    guint64 count[LATENCY_BUCKETS];
+    guint64 n;
+    guint64 max;
+};
+typedef struct latency_histogram_struct LatencyHistogram;
+
+/*! \brief  What a listener went through, totals and since the last
+ *          report.
+ */
+struct server_counters_struct
+{
+    guint64 datagrams;
+    guint64 bytes;
+    guint64 messages;
+    guint64 unknown;      /* datagrams left at an unknown template id */
+    guint64 skipped;      /* too short for the feed header */
+    guint64 dropped;      /* by the socket, its buffer was full */
+    guint64 batches;
+    LatencyHistogram decode;  /* decoding a datagram */
+    LatencyHistogram wire;    /* kernel receive to decoded */
+};
+typedef struct server_counters_struct ServerCounters;
+
 void chain_func (int s, pid_t p);
 void listener_die (int sig);
-char* hex_byte (guint n, guint8* buf);
-void receive_string (int sock);
+
+/*! \brief  Receive datagrams in batches and decode them, forever.
+ * \param sock  Bound UDP socket.
+ */
+void receive_decode (int sock);
+
+/*! \brief  Print the bits of a datagram, without allocating.
+ */
+void print_bits (FILE* out, guint n, const guint8* buf);
+
+/*! \brief  Account a latency.
+ */
+void latency_add (LatencyHistogram* hist, guint64 ns);
+
+/*! \brief  Upper bound of the latency below which a fraction of the
+ *          values fall.
+ * \param q  Fraction, within [0, 1].
+ * \return  Nanoseconds, a power of two.
+ */
+guint64 latency_quantile (const LatencyHistogram* hist, double q);
 
 int spawn_listeners (const struct addrinfo* crit,
                      const char* host,
@@ -40,4 +95,3 @@ int spawn_listeners (const struct addrinfo* crit,
                      void (* listener_fn) (int));
 
 #endif
-